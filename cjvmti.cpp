@@ -27,6 +27,7 @@
 #include "ptypes.h"
 #include "cjvmti.h"
 #include "monitor.h"
+#include "heap.h"
 #include "command.h"
 #include  <thread>
 		
@@ -910,43 +911,293 @@ extern "C" jvmtiError JNICALL CtiIterateOverHeap(
     return JVMTI_ERROR_NONE;
 }
 
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+extern "C" jvmtiError JNICALL CtiIterateThroughHeap(
+    jvmtiEnv                 *aEnv, 
+    jint                      aHeapFilter, 
+    jclass                    jKlass, 
+    const jvmtiHeapCallbacks *aCallbacks, 
+    const void               *aUserData) {
+
+    TJvmtiEnv               *aCtiJti = TJvmtiEnv::getInstance();
+    THashObjects::iterator   aPtr;
+    jint                     aCtrl;
+    TMonitorClass           *aClass;
+    TObject                 *aObject;
+    TMemoryBit              *MemBit;
+
+    if (aCallbacks == NULL || aCallbacks->heap_iteration_callback == NULL) {
+        return JVMTI_ERROR_NONE;
+    }
+
+    for (aPtr  = aCtiJti->mObjects.begin(); 
+         aPtr != aCtiJti->mObjects.end();
+         aPtr  = aCtiJti->mObjects.next()) {
+
+        aObject = aPtr->aValue;
+        aClass  = (TMonitorClass *)aObject->getClass();
+
+        if (jKlass != NULL && (jclass)aClass != jKlass) {
+            continue;
+        }
+        CtiGetTag(aEnv, (jobject)aObject, (jlong *)&MemBit);
+
+        if (MemBit == NULL) {
+            continue;
+        }
+        aCtrl = aCallbacks->heap_iteration_callback(
+                    (jlong)aClass->getTag(), MemBit->mSize, (jlong*)&MemBit, -1, (void*)aUserData);
+
+        if ((aCtrl & JVMTI_VISIT_ABORT) != 0) {
+            break;
+        }
+    }
+    return JVMTI_ERROR_NONE;
+}
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+extern "C" jvmtiError JNICALL CtiGetLoadedClasses(
+    jvmtiEnv                *aEnv, 
+    jint                    *aCount, 
+    jclass                 **aClasses) {
+
+    TJvmtiEnv               *aCtiJti = TJvmtiEnv::getInstance();
+    THashString::iterator    aPtr;
+    jint                     aCnt    = 0;
+
+    aCtiJti->mLockAccess.enter();
+    *aClasses = (jclass *)malloc(sizeof(jclass) * ((size_t)aCtiJti->mClassTags.getSize() + 1));
+
+    for (aPtr  = aCtiJti->mClassTags.begin(); 
+         aPtr != aCtiJti->mClassTags.end();
+         aPtr  = aCtiJti->mClassTags.next()) {
+        (*aClasses)[aCnt++] = (jclass)aPtr->aValue->mCtx;
+    }
+    aCtiJti->mLockAccess.exit();
+    *aCount = aCnt;
+    return JVMTI_ERROR_NONE;
+}
+
+// -----------------------------------------------------------------
+//! CTI has no reference graph
+// -----------------------------------------------------------------
+extern "C" jvmtiError JNICALL CtiFollowReferences(
+    jvmtiEnv                 *aEnv, 
+    jint                      aHeapFilter, 
+    jclass                    jKlass, 
+    jobject                   jInitialObject,
+    const jvmtiHeapCallbacks *aCallbacks, 
+    const void               *aUserData) {
+    return JVMTI_ERROR_NOT_AVAILABLE;
+}
+
+// -----------------------------------------------------------------
+//! CTI shares a single environment
+// -----------------------------------------------------------------
+extern "C" jvmtiError JNICALL CtiDisposeEnvironment(
+    jvmtiEnv                 *aEnv) {
+    return JVMTI_ERROR_NONE;
+}
+
 // ---------------------------------------------------------
 // TMonitor:HeapCallback
 //! \brief Callback for the heap runner
 //! \param  aClassTag The hash to the class
-//! \param  aSize The size of the class
+//! \param  aSize The size of the object
 //! \param  aTag  The hash to the associated memory
-//! \param  aUserData Optional user data of heap runner
-//! \return Operation control: JVMTI_ITERATION_CONTINUE
+//! \param  aLength Array length or -1
+//! \param  aUserData The heap histogram
+//! \return Visit control: 0 to continue
+//!
+//! The class tag refers to the memory bit of the class, which 
+//! leads to the slot of the histogram without hash lookup.
 // ---------------------------------------------------------
-extern "C" jvmtiIterationControl JNICALL TMonitorHeapCallback(
+extern "C" jint JNICALL TMonitorHeapCallback(
         jlong        aClassTag, 
         jlong        aSize, 
         jlong       *aTag, 
+        jint         aLength,
         void        *aUserData)  {
 
     TMemoryBit     *aMemBit;
-    TMonitor       *aMonitor = TMonitor::getInstance();
-    THashClasses::iterator aPtr;
+    TMonitorClass  *aClass;
+    THeapHistogram *aHistogram = (THeapHistogram *)aUserData;
+    THeapSlot      *aSlot;
+    jint            aIndex;
 
-    if (aTag == NULL || *aTag == 0) {
-        return JVMTI_ITERATION_CONTINUE;
+    if (aTag == NULL || *aTag == 0 || aClassTag == 0) {
+        return 0;
     }
 
     aMemBit = (TMemoryBit *)(*aTag);
-    if (aUserData == NULL || (jlong)aUserData == aMemBit->mCtx->getID()) {
-        
-        // TMonitorLock aLockAccess(aMonitor->mRawMonitorAccess, true, false);
-        if (aMonitor->getState() != MONITOR_ACTIVE || aMemBit->mTID != aMonitor->getTransaction()) {
-            return JVMTI_ITERATION_CONTINUE;
-        }
+    if (aMemBit->mTID != aHistogram->mTID) {
+        return 0;
+    }
+    if (aHistogram->mContext != NULL && aHistogram->mContext != aMemBit->mCtx) {
+        return 0;
+    }
 
-        aPtr = aMonitor->mClasses.find(aClassTag);
-        if (aPtr != aMonitor->mClasses.end()) {
-            aPtr->aValue->incHeapCount(aMemBit->mSize);
+    aClass = ((TMemoryBit *)aClassTag)->mCtx;
+    aIndex = aClass->getHeapIndex();
+    if (aIndex < 0 || aIndex >= aHistogram->mNrSlots) {
+        return 0;
+    }
+
+    aSlot = &aHistogram->mSlots[aIndex];
+    if (aSlot->mClass == aClass) {
+        aSlot->mCount ++;
+        aSlot->mSize  += aMemBit->mSize;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// THeapGraph::referenceCallback
+//! \see THeapGraphCallback
+//!
+//! Classes are not part of the graph, references from classes
+//! like static fields are handled as GC roots.
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapGraphCallback(
+        jvmtiHeapReferenceKind         aKind,
+        const jvmtiHeapReferenceInfo  *aInfo,
+        jlong                          aClassTag,
+        jlong                          aRefClassTag,
+        jlong                          aSize,
+        jlong                         *aTag,
+        jlong                         *aRefTag,
+        jint                           aLength,
+        void                          *aUserData) {
+
+    THeapGraph *aGraph = (THeapGraph *)aUserData;
+    jint        aFrom  = 0;
+    jint        aTo;
+
+    switch (aKind) {
+        case JVMTI_HEAP_REFERENCE_CLASS:
+        case JVMTI_HEAP_REFERENCE_CLASS_LOADER:
+        case JVMTI_HEAP_REFERENCE_SIGNERS:
+        case JVMTI_HEAP_REFERENCE_PROTECTION_DOMAIN:
+        case JVMTI_HEAP_REFERENCE_INTERFACE:
+        case JVMTI_HEAP_REFERENCE_SUPERCLASS:
+            return JVMTI_VISIT_OBJECTS;
+        default:
+            break;
+    }
+    if (*aTag != 0 && !HEAPGRAPH_IS_NODE(*aTag)) {
+        return JVMTI_VISIT_OBJECTS;
+    }
+
+    if (*aTag == 0) {
+        if (aGraph->mNrNodes >= HEAPGRAPH_MAX_NODES ||
+           (aGraph->mMaxNodes > 0 && aGraph->mNrNodes >= aGraph->mMaxNodes)) {
+            aGraph->mTruncated = true;
+            return JVMTI_VISIT_ABORT;
         }
+        // a class object tagged as node has no class entry
+        aTo   = aGraph->addNode((aClassTag != 0 && !HEAPGRAPH_IS_NODE(aClassTag)) ? HEAPGRAPH_TAG_VALUE(aClassTag) : 0, aSize);
+        *aTag = HEAPGRAPH_NODE_TAG(aTo);
+    }
+    else {
+        aTo   = HEAPGRAPH_TAG_VALUE(*aTag);
     }
-    return JVMTI_ITERATION_CONTINUE;
+
+    if (aRefTag != NULL && HEAPGRAPH_IS_NODE(*aRefTag)) {
+        aFrom = HEAPGRAPH_TAG_VALUE(*aRefTag);
+    }
+    if (aFrom != aTo) {
+        aGraph->addEdge(aFrom, aTo);
+    }
+    return JVMTI_VISIT_OBJECTS;
+}
+
+// ---------------------------------------------------------
+// THeapDump::referenceCallback
+//! \see THeapDumpReferenceCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpReferenceCallback(
+        jvmtiHeapReferenceKind         aKind,
+        const jvmtiHeapReferenceInfo  *aInfo,
+        jlong                          aClassTag,
+        jlong                          aRefClassTag,
+        jlong                          aSize,
+        jlong                         *aTag,
+        jlong                         *aRefTag,
+        jint                           aLength,
+        void                          *aUserData) {
+
+    THeapDump *aDump = (THeapDump *)aUserData;
+    return aDump->onReference(aKind, aInfo, aClassTag, aRefClassTag, aTag, aRefTag, aLength);
+}
+
+// ---------------------------------------------------------
+// THeapDump::fieldCallback
+//! \see THeapDumpFieldCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpFieldCallback(
+        jvmtiHeapReferenceKind         aKind,
+        const jvmtiHeapReferenceInfo  *aInfo,
+        jlong                          aClassTag,
+        jlong                         *aTag,
+        jvalue                         aValue,
+        jvmtiPrimitiveType             aType,
+        void                          *aUserData) {
+
+    THeapDump *aDump = (THeapDump *)aUserData;
+    return aDump->onField(aInfo, aClassTag, aTag, aValue, aType);
+}
+
+// ---------------------------------------------------------
+// THeapDump::arrayCallback
+//! \see THeapDumpArrayCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpArrayCallback(
+        jlong                          aClassTag,
+        jlong                          aSize,
+        jlong                         *aTag,
+        jint                           aCount,
+        jvmtiPrimitiveType             aType,
+        const void                    *aElements,
+        void                          *aUserData) {
+
+    THeapDump *aDump = (THeapDump *)aUserData;
+    return aDump->onArray(aTag, aCount, aType, aElements);
+}
+
+// ---------------------------------------------------------
+// THeapDump::iterationCallback
+//! \see THeapDumpIterationCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpIterationCallback(
+        jlong                          aClassTag,
+        jlong                          aSize,
+        jlong                         *aTag,
+        jint                           aLength,
+        void                          *aUserData) {
+
+    THeapDump *aDump = (THeapDump *)aUserData;
+    return aDump->onObject(aClassTag, aTag);
+}
+
+// ---------------------------------------------------------
+// THeapPath::referenceCallback
+//! \see THeapPathCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapPathCallback(
+        jvmtiHeapReferenceKind         aKind,
+        const jvmtiHeapReferenceInfo  *aInfo,
+        jlong                          aClassTag,
+        jlong                          aRefClassTag,
+        jlong                          aSize,
+        jlong                         *aTag,
+        jlong                         *aRefTag,
+        jint                           aLength,
+        void                          *aUserData) {
+
+    THeapPath *aPath = (THeapPath *)aUserData;
+    return aPath->onReference(aKind, aInfo, aClassTag, aTag, aRefTag);
 }
 
 // -----------------------------------------------------------------
@@ -1008,7 +1259,12 @@ TJvmtiEnv *TJvmtiEnv::mInstance = NULL;
 extern "C" void JNICALL onVmInit (jvmtiEnv *, JNIEnv *, jthread);
 extern "C" void JNICALL onVmDeath(jvmtiEnv *, JNIEnv *);
 extern "C" void JNICALL doTelnetThread (jvmtiEnv *, JNIEnv *, void *);
-extern "C" void JNICALL doRepeatThread (jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doScheduleThread (jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doAnalyseThread(jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doAlertThread  (jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doTraceThread  (jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doOutputThread (jvmtiEnv *, JNIEnv *, void *);
+extern "C" void JNICALL doMetricsThread(jvmtiEnv *, JNIEnv *, void *);
 
 // -----------------------------------------------------------------
 // -----------------------------------------------------------------
@@ -1082,6 +1338,10 @@ extern "C" JNIEXPORT jint JNICALL CtiAgentOnLoad(     /*SAPUNICODEOK_CHARTYPE*/
         aJtiFunctions->SetEventNotificationMode = CtiSetEventNotificationMode;
         aJtiFunctions->ForceGarbageCollection   = CtiForceGarbageCollection;
         aJtiFunctions->IterateOverHeap          = CtiIterateOverHeap;
+        aJtiFunctions->IterateThroughHeap       = CtiIterateThroughHeap;
+        aJtiFunctions->GetLoadedClasses         = CtiGetLoadedClasses;
+        aJtiFunctions->FollowReferences         = CtiFollowReferences;
+        aJtiFunctions->DisposeEnvironment       = CtiDisposeEnvironment;
         aJtiFunctions->GetFrameCount            = CtiGetFrameCount;
 
         aJniFunctions->GetObjectClass           = CtiGetObjectClass;
@@ -1097,7 +1357,12 @@ extern "C" JNIEXPORT jint JNICALL CtiAgentOnLoad(     /*SAPUNICODEOK_CHARTYPE*/
         onVmInit(aCtiJvti->mCtiJvmti, NULL, NULL);
 
         CtiRunAgentThread(NULL, doTelnetThread, NULL, 0);
-        CtiRunAgentThread(NULL, doRepeatThread, NULL, 0);
+        CtiRunAgentThread(NULL, doScheduleThread, NULL, 0);
+        CtiRunAgentThread(NULL, doAnalyseThread, NULL, 0);
+        CtiRunAgentThread(NULL, doAlertThread,   NULL, 0);
+        CtiRunAgentThread(NULL, doTraceThread,   NULL, 0);
+        CtiRunAgentThread(NULL, doOutputThread,  NULL, 0);
+        CtiRunAgentThread(NULL, doMetricsThread, NULL, 0);
     }
 
     (*pCtiEnv)->mVersion           = aVersion;
@@ -21,6 +21,379 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // -----------------------------------------------------------------
+#define SCHEDULER_JOBS          16      //!< Maximal number of jobs
+#define SCHEDULER_SLEEP       1000      //!< Maximal wait of the scheduler thread in ms
+
+// -----------------------------------------------------------------
+//! \class TJob
+//! \brief A command executed periodically by the scheduler
+//!
+// -----------------------------------------------------------------
+class TJob {
+private:
+    TString          mName;             //!< Job name
+    TString          mCommand;          //!< Command line
+    TValues         *mOptions;          //!< Parsed command line
+    int              mCmd;              //!< Parsed command
+    jlong            mInterval;         //!< Interval in ms
+    jlong            mJitter;           //!< Maximal random delay in ms
+    jlong            mBase;             //!< Planned start without jitter
+    jlong            mNext;             //!< Next start
+    TMappedFile     *mFile;             //!< Output file or NULL for console
+    TString          mFileName;         //!< Output file name
+    jlong            mRuns;             //!< Number of executions
+    jlong            mTimeLast;         //!< Duration of the last run
+    jlong            mTimeMax;          //!< Longest run
+    jlong            mTimeTotal;        //!< Accumulated run time
+    jlong            mLate;             //!< Start delay of the last run
+    jint             mSession;          //!< Console session, which created the job
+    jint             mSlot;             //!< Slot of the console session
+    bool             mBound;            //!< Output and lifetime bound to the session
+
+    // -----------------------------------------------------------------
+    // TJob::schedule
+    //! \brief Evaluate the next start time
+    //! \param aBase The planned start time
+    // -----------------------------------------------------------------
+    void schedule(jlong aBase) {
+        mBase = aBase;
+        mNext = aBase;
+        if (mJitter > 0) {
+            mNext += rand() % (mJitter + 1);
+        }
+    }
+public:
+    // -----------------------------------------------------------------
+    // TJob::TJob
+    //! \brief Constructor
+    //! \param aName     The job name
+    //! \param aCommand  The command line
+    //! \param aInterval The interval in seconds
+    //! \param aJitter   The maximal random delay in ms
+    // -----------------------------------------------------------------
+    TJob(
+            const SAP_UC    *aName,
+            const SAP_UC    *aCommand,
+            jlong            aInterval,
+            jlong            aJitter) {
+
+        mName       = aName;
+        mCommand    = aCommand;
+        mOptions    = new TValues(10);
+        mCmd        = COMMAND_UNKNOWN;
+        mInterval   = max((jlong)1, aInterval) * 1000;
+        mJitter     = max((jlong)0, aJitter);
+        mFile       = NULL;
+        mRuns       = 0;
+        mTimeLast   = 0;
+        mTimeMax    = 0;
+        mTimeTotal  = 0;
+        mLate       = 0;
+        mSession    = TConsole::getInstance()->getSession();
+        mSlot       = TConsole::getInstance()->getSessionSlot();
+        mBound      = false;
+        schedule(TSystem::getTimestamp() + mInterval);
+    }
+    // -----------------------------------------------------------------
+    // TJob::~TJob
+    //! Destructor
+    // -----------------------------------------------------------------
+    ~TJob() {
+        if (mFile != NULL) {
+            TOutputQueue::getInstance()->sync();
+            mFile->close();
+            delete mFile;
+        }
+        delete mOptions;
+    }
+    // -----------------------------------------------------------------
+    // TJob::openFile
+    //! \brief Redirect the output of the job to a file
+    //! \param aFileName The file name
+    //! \return \c FALSE if the file cannot be opened
+    // -----------------------------------------------------------------
+    bool openFile(const SAP_UC *aFileName) {
+        TString aPath;
+
+        aPath = TProperties::getInstance()->getPath();
+        aPath.concatPathExt(aFileName);
+
+        mFileName = aFileName;
+        mFile     = new TMappedFile();
+        return mFile->open(aPath.str(), 0, 0, true);
+    }
+    // -----------------------------------------------------------------
+    // TJob::finish
+    //! \brief Register a run and schedule the next one
+    //!
+    //! Intervals, which passed during a long run, are skipped.
+    //! \param aStart The start time of the run
+    //! \param aEnd   The end time of the run
+    // -----------------------------------------------------------------
+    void finish(jlong aStart, jlong aEnd) {
+        jlong aBase = mBase + mInterval;
+
+        mRuns      ++;
+        mLate       = max((jlong)0, aStart - mNext);
+        mTimeLast   = aEnd - aStart;
+        mTimeTotal += mTimeLast;
+        if (mTimeMax < mTimeLast) {
+            mTimeMax = mTimeLast;
+        }
+        if (aBase < aEnd) {
+            aBase = aEnd + mInterval;
+        }
+        schedule(aBase);
+    }
+    // -----------------------------------------------------------------
+    // TJob::getName
+    //! \return The job name
+    // -----------------------------------------------------------------
+    const SAP_UC *getName() {
+        return mName.str();
+    }
+    // -----------------------------------------------------------------
+    // TJob::getCommand
+    //! \return The command line
+    // -----------------------------------------------------------------
+    const SAP_UC *getCommand() {
+        return mCommand.str();
+    }
+    // -----------------------------------------------------------------
+    // TJob::getOptions
+    //! \return The parsed command line
+    // -----------------------------------------------------------------
+    TValues *getOptions() {
+        return mOptions;
+    }
+    // -----------------------------------------------------------------
+    // TJob::getCmd
+    //! \return The parsed command
+    // -----------------------------------------------------------------
+    int getCmd() {
+        return mCmd;
+    }
+    // -----------------------------------------------------------------
+    // TJob::setCmd
+    //! \param aCmd The parsed command
+    // -----------------------------------------------------------------
+    void setCmd(int aCmd) {
+        mCmd = aCmd;
+    }
+    // -----------------------------------------------------------------
+    // TJob::getSession
+    //! \return The console session, which created the job
+    // -----------------------------------------------------------------
+    jint getSession() {
+        return mSession;
+    }
+    // -----------------------------------------------------------------
+    // TJob::getSlot
+    //! \return The slot of the console session
+    // -----------------------------------------------------------------
+    jint getSlot() {
+        return mSlot;
+    }
+    // -----------------------------------------------------------------
+    // TJob::bind
+    //! \brief Bind the job to the session, which created it
+    //!
+    //! The output goes only to the session and the job is removed
+    //! with the next input or the logout of the session.
+    // -----------------------------------------------------------------
+    void bind() {
+        mBound = true;
+    }
+    // -----------------------------------------------------------------
+    // TJob::isBound
+    //! \return \c TRUE if the job is bound to its session
+    // -----------------------------------------------------------------
+    bool isBound() {
+        return mBound;
+    }
+    // -----------------------------------------------------------------
+    // TJob::getFile
+    //! \return The output file or \c NULL for console output
+    // -----------------------------------------------------------------
+    TMappedFile *getFile() {
+        return mFile;
+    }
+    // -----------------------------------------------------------------
+    // TJob::getNext
+    //! \return The next start time
+    // -----------------------------------------------------------------
+    jlong getNext() {
+        return mNext;
+    }
+    // -----------------------------------------------------------------
+    // TJob::dump
+    //! \brief Dump the job and its runtime statistic
+    //! \param aRootTag The output tag list
+    // -----------------------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[128];
+        TXmlTag *aTag = aRootTag->addTag(cU("Job"));
+
+        aTag->addAttribute(cU("Name"),      mName.str());
+        aTag->addAttribute(cU("Interval"),  TString::parseInt(mInterval / 1000, aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Jitter"),    TString::parseInt(mJitter,          aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Runs"),      TString::parseInt(mRuns,            aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Last"),      TString::parseInt(mTimeLast,        aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Max"),       TString::parseInt(mTimeMax,         aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Avg"),       TString::parseInt(mRuns > 0 ? mTimeTotal / mRuns : 0, aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Late"),      TString::parseInt(mLate,            aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Output"),    (mFile != NULL) ? mFileName.str() : (mBound ? cU("session") : cU("console")));
+        aTag->addAttribute(cU("Command"),   mCommand.str());
+    }
+};
+// -----------------------------------------------------------------
+//! \class TScheduler
+//! \brief Table of periodic jobs
+//!
+//! The scheduler thread executes the jobs one by one, since all
+//! commands are synchronized on the JNI monitor.
+// -----------------------------------------------------------------
+class TScheduler {
+private:
+    TJob            *mJobs[SCHEDULER_JOBS];
+public:
+    // -----------------------------------------------------------------
+    // TScheduler::TScheduler
+    //! Constructor
+    // -----------------------------------------------------------------
+    TScheduler() {
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            mJobs[i] = NULL;
+        }
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::~TScheduler
+    //! Destructor
+    // -----------------------------------------------------------------
+    ~TScheduler() {
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL) {
+                delete mJobs[i];
+            }
+        }
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::find
+    //! \param aName    The job name
+    //! \param aSession The session, which owns bound jobs
+    //! \return The slot of the job or -1
+    // -----------------------------------------------------------------
+    int find(const SAP_UC *aName, jint aSession) {
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL && !STRCMP(mJobs[i]->getName(), aName) &&
+               (!mJobs[i]->isBound() || mJobs[i]->getSession() == aSession)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::add
+    //! \brief Add a job, a job with the same name is replaced
+    //!
+    //! Bound jobs of other sessions are not replaced, so each
+    //! session has its own repeater.
+    //! \param aJob The new job
+    //! \return \c FALSE if the table is full
+    // -----------------------------------------------------------------
+    bool add(TJob *aJob) {
+        int aSlot = find(aJob->getName(), aJob->getSession());
+
+        if (aSlot >= 0) {
+            delete mJobs[aSlot];
+            mJobs[aSlot] = aJob;
+            return true;
+        }
+        for (aSlot = 0; aSlot < SCHEDULER_JOBS; aSlot++) {
+            if (mJobs[aSlot] == NULL) {
+                mJobs[aSlot] = aJob;
+                return true;
+            }
+        }
+        return false;
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::remove
+    //! \brief Remove a job
+    //! \param aName The job name or "*" for all jobs
+    //! \return \c FALSE if the job was not found
+    // -----------------------------------------------------------------
+    bool remove(const SAP_UC *aName) {
+        bool aFound = false;
+
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL && 
+               (!STRCMP(aName, cU("*")) || !STRCMP(mJobs[i]->getName(), aName))) {
+                delete mJobs[i];
+                mJobs[i] = NULL;
+                aFound   = true;
+            }
+        }
+        return aFound;
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::removeBound
+    //! \brief Remove the jobs bound to a session
+    //! \param aSession The session
+    // -----------------------------------------------------------------
+    void removeBound(jint aSession) {
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL && mJobs[i]->isBound() && mJobs[i]->getSession() == aSession) {
+                delete mJobs[i];
+                mJobs[i] = NULL;
+            }
+        }
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::getDue
+    //! \param aNow The current time in ms
+    //! \return The job with the earliest start time before aNow or \c NULL
+    // -----------------------------------------------------------------
+    TJob *getDue(jlong aNow) {
+        TJob *aDue = NULL;
+
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL && mJobs[i]->getNext() <= aNow &&
+               (aDue == NULL || mJobs[i]->getNext() < aDue->getNext())) {
+                aDue = mJobs[i];
+            }
+        }
+        return aDue;
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::getSleepTime
+    //! \param aNow The current time in ms
+    //! \return The time until the next start, at most SCHEDULER_SLEEP
+    // -----------------------------------------------------------------
+    int getSleepTime(jlong aNow) {
+        jlong aSleep = SCHEDULER_SLEEP;
+
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL) {
+                aSleep = min(aSleep, mJobs[i]->getNext() - aNow);
+            }
+        }
+        return (int)max((jlong)1, aSleep);
+    }
+    // -----------------------------------------------------------------
+    // TScheduler::dump
+    //! \brief Dump all jobs
+    //! \param aRootTag The output tag list
+    // -----------------------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        for (int i = 0; i < SCHEDULER_JOBS; i++) {
+            if (mJobs[i] != NULL) {
+                mJobs[i]->dump(aRootTag);
+            }
+        }
+    }
+};
+// -----------------------------------------------------------------
 //! \class TCommand
 //! \brief Command line interpreter
 //!
@@ -38,12 +411,10 @@ private:
     TProperties     *mProperties;       //!< Global configuration
     TTracer         *mTracer;           //!< Tracer
 
-    bool             mRepeat;           //!< Repeat last command
     bool             mInitialized;
-    jlong            mRepeatTime;       
     int              mCmdLen;           
     const SAP_UC    *mCmdLine;          //!< Raw command line
-    SAP_UC           mCmdRepeat[128];
+    TScheduler       mScheduler;        //!< Periodic jobs
 
     int              mCmd;
     int              mStackCmd;
@@ -84,7 +455,7 @@ private:
             aTag->addAttribute(cU("Description"), cU("stop monitor/trace/log"));
 
             aTag = aRootTag->addTag(cU("Item"));
-            aTag->addAttribute(cU("Command"),      cU("lsc [-m|-s|-h|-a|-f|-F|-v|-p]"));
+            aTag->addAttribute(cU("Command"),      cU("lsc [-m|-s|-h|-a|-f|-F|-v|-p|-d]"));
             aTag->addAttribute(cU("Description"), cU("list classes"));
 
             aTag = aRootTag->addTag(cU("Item"));
@@ -92,33 +463,65 @@ private:
             aTag->addAttribute(cU("Description"), cU("list growing classes/memory leaks"));
 
             aTag = aRootTag->addTag(cU("Item"));
-            aTag->addAttribute(cU("Command"),      cU("lsm [-m|-n|-e|-s|-a|-C|-M]"));
+            aTag->addAttribute(cU("Command"),      cU("lsm [-m|-n|-e|-s|-a|-C|-M|-d]"));
             aTag->addAttribute(cU("Description"), cU("list methods"));
 
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("lss"));
             aTag->addAttribute(cU("Description"), cU("list monitor statistics"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("lts [-c|-f|-t|-a|-x]"));
+            aTag->addAttribute(cU("Description"), cU("list the time series of monitor statistics"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("lsp [-s<file>"));
             aTag->addAttribute(cU("Description"), cU("list property keys and values, use -s to store the values in skp format"));
 
             aTag = aRootTag->addTag(cU("Item"));
-            aTag->addAttribute(cU("Command"),      cU("lhd [-m|-n|-g|-s|-C]"));
+            aTag->addAttribute(cU("Command"),      cU("lhd [-m|-n|-g|-s|-C|-K]"));
             aTag->addAttribute(cU("Description"), cU("list heap dump"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("lrs [-r|-o|-n|-m|-s|-f]"));
+            aTag->addAttribute(cU("Description"), cU("list retained sizes"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("hprof [-o|-f|-e|-l|-n]"));
+            aTag->addAttribute(cU("Description"), cU("write heap dump in HPROF format"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("lgr -C [-n|-p|-m|-s]"));
+            aTag->addAttribute(cU("Description"), cU("list paths to GC roots"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("lfs [-o|-w|-r]"));
+            aTag->addAttribute(cU("Description"), cU("write trace stacks in folded format for flame graphs"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("reset [-s]"));
             aTag->addAttribute(cU("Description"), cU("reload the configuration and clears all values"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("reload"));
+            aTag->addAttribute(cU("Description"), cU("reload the configuration and keep all values"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("repeat [<seconds>]"));
             aTag->addAttribute(cU("Description"), cU("repeat the last command"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("job [add|del]"));
+            aTag->addAttribute(cU("Description"), cU("schedule commands periodically"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("gc"));
             aTag->addAttribute(cU("Description"), cU("start garbage collection"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("sync"));
+            aTag->addAttribute(cU("Description"), cU("write log and trace files to disk"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("dt [-c|-j|-m|-s|-f|-x]"));
             aTag->addAttribute(cU("Description"), cU("dump threads"));
@@ -147,6 +550,10 @@ private:
             aTag->addAttribute(cU("Command"),      cU("exit"));
             aTag->addAttribute(cU("Description"), cU("leave the telnet session"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Command"),      cU("format"));
+            aTag->addAttribute(cU("Description"), cU("set the output format of the telnet session"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Command"),      cU("chpwd"));
             aTag->addAttribute(cU("Description"), cU("change password for the current user"));
@@ -168,6 +575,14 @@ private:
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("log -f<log file name> -append"));
             aTag->addAttribute(cU("Description"), cU("opens a log file"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("ProfileThreads"));
+            aTag->addAttribute(cU("Description"), cU("property: method events only for threads matching the list, checked on start and thread start"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("ProfileThreadsExclude"));
+            aTag->addAttribute(cU("Description"), cU("property: no method events for threads matching the list"));
         } 
         else if (!STRNCMP(*aPtrAttr, cU("stop"), 5)) {
             aRootTag->addAttribute(cU("Command"), cU("stop"));
@@ -193,9 +608,29 @@ private:
             aTag->addAttribute(cU("Attribute"), cU("<seconds>"));
             aTag->addAttribute(cU("Description"), cU("repeater time intervall in seconds (default is 1 sec)"));
         }
+        else if (!STRNCMP(*aPtrAttr, cU("job"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("job"));
+            aRootTag->addAttribute(cU("Description"), cU("[add <name> <seconds> [-j<ms>][-o<file>] <command>|del <name>]: list, add or remove periodic jobs"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("add <name> <seconds>"));
+            aTag->addAttribute(cU("Description"), cU("execute the command every <seconds>, a job with the same name is replaced"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-j<ms>"));
+            aTag->addAttribute(cU("Description"), cU("delay each run by a random time up to <ms>"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-o<file>"));
+            aTag->addAttribute(cU("Description"), cU("append the output to <file> instead of the console"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("del <name>"));
+            aTag->addAttribute(cU("Description"), cU("remove the job, * removes all jobs"));
+        }
         else if (!STRNCMP(*aPtrAttr, cU("lsc"), 3)) {
             aRootTag->addAttribute(cU("Command"), cU("lsc"));
-            aRootTag->addAttribute(cU("Description"), cU("[-m<number>][-s<column name>][-h][-f<filter>]: list monitored classes"));
+            aRootTag->addAttribute(cU("Description"), cU("[-m<number>][-s<column name>][-h][-f<filter>][-d]: list monitored classes"));
 
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-m<number>"));
@@ -224,6 +659,10 @@ private:
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-p"));
             aTag->addAttribute(cU("Description"), cU("output with methods"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-d"));
+            aTag->addAttribute(cU("Description"), cU("list changes since the previous -d call of this session and bytes per second"));
         }
         else if (!STRNCMP(*aPtrAttr, cU("lml"), 3)) {
             aRootTag->addAttribute(cU("Command"), cU("lml"));
@@ -247,7 +686,7 @@ private:
         }
         else if (!STRNCMP(*aPtrAttr, cU("lsm"), 3)) {
             aRootTag->addAttribute(cU("Command"), cU("lsm"));
-            aRootTag->addAttribute(cU("Description"), cU("[-m<number>][-n<number>][-e<number>][-c<number>][-s<column name>][-f<filter>][-p]: list monitored methods"));
+            aRootTag->addAttribute(cU("Description"), cU("[-m<number>][-n<number>][-e<number>][-c<number>][-s<column name>][-f<filter>][-p][-d]: list monitored methods"));
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-m<number>"));
             aTag->addAttribute(cU("Description"), cU("select methods with CpuTime > <number>"));
@@ -287,6 +726,10 @@ private:
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-M<method id>"));
             aTag->addAttribute(cU("Description"), cU("list method with given id"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-d"));
+            aTag->addAttribute(cU("Description"), cU("list changes since the previous -d call of this session and rates per second"));
         }
         else if (!STRNCMP(*aPtrAttr, cU("gc"), 2)) {
             aRootTag->addAttribute(cU("Command"), cU("gc"));
@@ -296,6 +739,38 @@ private:
             aTag->addAttribute(cU("Attribute"), cU("gc"));
             aTag->addAttribute(cU("Description"), cU("Format: (GC | timestamp | used objects | used object space | total object space)"));
         }
+        else if (!STRNCMP(*aPtrAttr, cU("sync"), 4)) {
+            aRootTag->addAttribute(cU("Command"), cU("sync"));
+            aRootTag->addAttribute(cU("Description"), cU("writes the pending output and the mapped log and trace files to disk"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("LogFileSize"));
+            aTag->addAttribute(cU("Description"), cU("property: rotate log and trace files at <number> MB, 0 disables rotation"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("LogFileCount"));
+            aTag->addAttribute(cU("Description"), cU("property: number of rotated files <name>.1 ... <name>.<number>"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("LogFileCompression"));
+            aTag->addAttribute(cU("Description"), cU("property: yes writes log and trace files as compressed blocks, see tracedec -unpack"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("format"), 6)) {
+            aRootTag->addAttribute(cU("Command"), cU("format"));
+            aRootTag->addAttribute(cU("Description"), cU("sets the output format for this telnet session only, other sessions keep their format"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("ascii"));
+            aTag->addAttribute(cU("Description"), cU("formatted tables with command line echo"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("xml"));
+            aTag->addAttribute(cU("Description"), cU("xml stream for automation clients"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("binary"));
+            aTag->addAttribute(cU("Description"), cU("length prefixed frames with typed result tags, selected by a client starting with \\0SKB"));
+        }
         else if (!STRNCMP(*aPtrAttr, cU("reset"), 5)) {
             aRootTag->addAttribute(cU("Command"), cU("reset"));
             aRootTag->addAttribute(cU("Description"), cU("reload the configuration and clears all values"));
@@ -303,6 +778,18 @@ private:
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-s"));
             aTag->addAttribute(cU("Description"), cU("configuration file overwrites local settings"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("ClassCache"));
+            aTag->addAttribute(cU("Description"), cU("property: <file> keeps the class decisions between starts, cleared if the profile rules change"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("reload"), 6)) {
+            aRootTag->addAttribute(cU("Command"), cU("reload"));
+            aRootTag->addAttribute(cU("Description"), cU("reload the configuration and evaluate only classes and methods matching a changed rule"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("reload"));
+            aTag->addAttribute(cU("Description"), cU("Format: (Rules | Classes | Methods) changed rules and evaluated classes and methods, the statistic is kept"));
         }
         else if (!STRNCMP(*aPtrAttr, cU("lhd"), 3)) {
             aRootTag->addAttribute(cU("Command"), cU("lhd"));
@@ -331,6 +818,154 @@ private:
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("-C<class id>"));
             aTag->addAttribute(cU("Description"), cU("run heap for specified class"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-K<class id>"));
+            aTag->addAttribute(cU("Description"), cU("run heap only for instances of specified class"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("lrs"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("lrs"));
+            aRootTag->addAttribute(cU("Description"), cU("list retained sizes of the dominator tree by class"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-r"));
+            aTag->addAttribute(cU("Description"), cU("write a new reference graph and start the analysis"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-o<file>"));
+            aTag->addAttribute(cU("Description"), cU("prefix for the graph files (default sherlok.graph)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-n<number>"));
+            aTag->addAttribute(cU("Description"), cU("stop the graph after <number> objects"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-m<number>"));
+            aTag->addAttribute(cU("Description"), cU("selects classes with retained size > <number>"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-s<column name>"));
+            aTag->addAttribute(cU("Description"), cU("sort by column name"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-f<filter>"));
+            aTag->addAttribute(cU("Description"), cU("filter class names"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("hprof"), 5)) {
+            aRootTag->addAttribute(cU("Command"), cU("hprof"));
+            aRootTag->addAttribute(cU("Description"), cU("write heap dump in HPROF format"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-o<file>"));
+            aTag->addAttribute(cU("Description"), cU("dump file (default sherlok.hprof)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-f<filter>"));
+            aTag->addAttribute(cU("Description"), cU("write only instances of matching classes and the objects they refer to"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-e<number>"));
+            aTag->addAttribute(cU("Description"), cU("write primitive arrays > <number> bytes without content"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-l<number>"));
+            aTag->addAttribute(cU("Description"), cU("stop the dump after <number> MB"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-n<number>"));
+            aTag->addAttribute(cU("Description"), cU("stop the dump after <number> objects, the dump needs a tag of 8 bytes and a written bit for each object"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("lss"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("lss"));
+            aRootTag->addAttribute(cU("Description"), cU("list monitor statistics, the counters are also served for metrics scrapes"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("MetricsPort"));
+            aTag->addAttribute(cU("Description"), cU("property: serve the counters in Prometheus text format on http://<host>:<number>/metrics, 0 disables the server"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("MetricsHost"));
+            aTag->addAttribute(cU("Description"), cU("property: interface of the metrics server (default localhost)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("MetricsInterval"));
+            aTag->addAttribute(cU("Description"), cU("property: seconds between two snapshots of the counters (default 10)"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("lts"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("lts"));
+            aRootTag->addAttribute(cU("Description"), cU("[-c<prefix>][-f<seconds>][-t<seconds>][-a<seconds>][-x]: list the samples of the monitor statistics"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-c<prefix>"));
+            aTag->addAttribute(cU("Description"), cU("select columns starting with <prefix>"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-f<seconds>"));
+            aTag->addAttribute(cU("Description"), cU("select samples since <seconds> ago"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-t<seconds>"));
+            aTag->addAttribute(cU("Description"), cU("select samples until <seconds> ago"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-a<seconds>"));
+            aTag->addAttribute(cU("Description"), cU("aggregate min, max, avg and delta over intervals of <seconds>"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-x"));
+            aTag->addAttribute(cU("Description"), cU("clear the series, the next sample applies the current properties"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("SeriesInterval"));
+            aTag->addAttribute(cU("Description"), cU("property: sample interval in seconds, 0 disables the series"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("SeriesSize"));
+            aTag->addAttribute(cU("Description"), cU("property: memory of the series in KB, the oldest samples are dropped"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("SeriesMethods"));
+            aTag->addAttribute(cU("Description"), cU("property: comma separated list of <class>.<method> to sample CPU time and calls"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("lfs"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("lfs"));
+            aRootTag->addAttribute(cU("Description"), cU("write the stacks aggregated by \"trace add folded\" in folded format"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-o<file>"));
+            aTag->addAttribute(cU("Description"), cU("output file in the trace path (default sherlok.folded)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-w<weight>"));
+            aTag->addAttribute(cU("Description"), cU("weight count, elapsed, cpu or memory (default elapsed)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-r"));
+            aTag->addAttribute(cU("Description"), cU("remove the stacks after writing"));
+        }
+        else if (!STRNCMP(*aPtrAttr, cU("lgr"), 3)) {
+            aRootTag->addAttribute(cU("Command"), cU("lgr"));
+            aRootTag->addAttribute(cU("Description"), cU("list shortest reference chains from GC roots to instances of a class"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-C<class id>"));
+            aTag->addAttribute(cU("Description"), cU("class ID as listed by lsc or lhd"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-n<number>"));
+            aTag->addAttribute(cU("Description"), cU("number of sampled instances (default 100)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-p<number>"));
+            aTag->addAttribute(cU("Description"), cU("maximum number of heap passes to shorten the chains (default 4)"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-m<number>"));
+            aTag->addAttribute(cU("Description"), cU("stop after <number> objects"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("-s<column name>"));
+            aTag->addAttribute(cU("Description"), cU("sort by column name"));
         }
         else if (!STRNCMP(*aPtrAttr, cU("dex"), 3)) {
             aRootTag->addAttribute(cU("Command"), cU("dex"));
@@ -396,6 +1031,18 @@ private:
             aTag->addAttribute(cU("Attribute"), cU("method"));
             aTag->addAttribute(cU("Description"), cU("trace enter and exit events for TraceMethods"));
 
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("method -b<file-name>"));
+            aTag->addAttribute(cU("Description"), cU("write enter and exit events to a binary trace file, see tracedec"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("method -p<file-name>"));
+            aTag->addAttribute(cU("Description"), cU("write enter and exit events as Perfetto trace for timeline viewers"));
+
+            aTag = aRootTag->addTag(cU("Item"));
+            aTag->addAttribute(cU("Attribute"), cU("folded"));
+            aTag->addAttribute(cU("Description"), cU("count trigger events per callstack instead of printing them, see lfs"));
+
             aTag = aRootTag->addTag(cU("Item"));
             aTag->addAttribute(cU("Attribute"), cU("class"));
             aTag->addAttribute(cU("Description"), cU("trace class load and unload events"));
@@ -449,13 +1096,11 @@ private:
         mMonitor        = TMonitor::getInstance();
         mConsole        = TConsole::getInstance();
         mReader         = new TReader();
-        mRepeatTime     = 1;
         mCmd            = COMMAND_CONTINUE;
         mStackCmd       = COMMAND_CONTINUE;
         mCommand        = new TString;
         mOptionList     = new TValues(10);
         mWriter         = new TXmlWriter(mProperties->getConsoleWriterType());
-        mRepeat         = false;
         mInitialized    = false;
     }
 public:
@@ -537,14 +1182,26 @@ public:
             mCmd = COMMAND_LSC;
         } else if (!STRNCMP((*aPtr), cU("lhd"),    3)) {
             mCmd = COMMAND_LHD;
+        } else if (!STRNCMP((*aPtr), cU("lrs"),    3)) {
+            mCmd = COMMAND_LRS;
+        } else if (!STRNCMP((*aPtr), cU("hprof"),  5)) {
+            mCmd = COMMAND_HPROF;
+        } else if (!STRNCMP((*aPtr), cU("lgr"),    3)) {
+            mCmd = COMMAND_LGR;
+        } else if (!STRNCMP((*aPtr), cU("lfs"),    3)) {
+            mCmd = COMMAND_LFS;
         } else if (!STRNCMP((*aPtr), cU("lss"),    3)) {
             mCmd = COMMAND_LSS;
+        } else if (!STRNCMP((*aPtr), cU("lts"),    3)) {
+            mCmd = COMMAND_LTS;
         } else if (!STRNCMP((*aPtr), cU("lml"),    3)) {
             mCmd = COMMAND_LML;
         } else if (!STRNCMP((*aPtr), cU("lsp"),    3)) {
             mCmd = COMMAND_LSP;
         } else if (!STRNCMP((*aPtr), cU("repeat"), 6)) {
             mCmd = COMMAND_REPEAT;
+        } else if (!STRNCMP((*aPtr), cU("job"),    3)) {
+            mCmd = COMMAND_JOB;
         } else if (!STRNCMP((*aPtr), cU("lsm"),    3)) {
             mCmd = COMMAND_LSM;
         } else if (!STRNCMP((*aPtr), cU("start"),  5)) {
@@ -553,16 +1210,22 @@ public:
             mCmd = COMMAND_STOP;
         } else if (!STRNCMP((*aPtr), cU("reset"),  5)) {
             mCmd = COMMAND_RESET;
+        } else if (!STRNCMP((*aPtr), cU("reload"), 6)) {
+            mCmd = COMMAND_RELOAD;
         } else if (!STRNCMP((*aPtr), cU("info"),   4)) {
             mCmd = COMMAND_INFO;
         } else if (!STRNCMP((*aPtr), cU("gc"),     2)) {
             mCmd = COMMAND_GC;
+        } else if (!STRNCMP((*aPtr), cU("sync"),   4)) {
+            mCmd = COMMAND_SYNC;
         } else if (!STRNCMP((*aPtr), cU("echo"),   4)) {
             mCmd = COMMAND_ECHO;
         } else if (!STRNCMP((*aPtr), cU("lcf"),    3)) {
             mCmd = COMMAND_LCF;
         } else if (!STRNCMP((*aPtr), cU("set"),    3)) {
             mCmd = COMMAND_SET;
+        } else if (!STRNCMP((*aPtr), cU("format"), 6)) {
+            mCmd = COMMAND_FORMAT;
         } else if (!STRNCMP((*aPtr), cU("exit"),   4)) {
             mCmd = COMMAND_EXIT;
         } else if (!STRNCMP((*aPtr), cU("trace"),  5)) {
@@ -600,10 +1263,12 @@ public:
     }
     // -----------------------------------------------------------------
     // TCommand::getSleepTime
-    //! \return The time interval for repeater thread
+    //!
+    //! The caller holds the command lock, jobs are deleted by the telnet thread.
+    //! \return The time until the scheduler thread has to run the next job
     // -----------------------------------------------------------------
     int getSleepTime() {
-        return (int)mRepeatTime * 1000;
+        return mScheduler.getSleepTime(TSystem::getTimestamp());
     }
     // -----------------------------------------------------------------
     // TCommand::getCmd
@@ -622,12 +1287,16 @@ public:
         SAP_UC aBuffer[32];
 
         mCmdLine = mReader->getLine();
-        mRepeat  = false;
         if (mCmdLine == NULL) {
             return aSuccess;
         }
         aSuccess = parse(mCmdLine);
 
+        // any input stops the repeater of the session
+        if (mCmd != COMMAND_REPEAT) {
+            mScheduler.removeBound(mConsole->getSession());
+        }
+
         if (aSuccess && 
             mCmd != COMMAND_REPEAT &&
             mCmd != COMMAND_CONTINUE) {
@@ -643,14 +1312,151 @@ public:
         return aSuccess;
     }
     // -----------------------------------------------------------------
-    // TCommand::repeat
-    //! \brief Repeater
-    //! \return \c TRUE if there is command to repeat
+    // TCommand::prepareJob
+    //! \brief Parse the command line of a job
+    //!
+    //! The command of the console is kept, so that the job
+    //! can be added while the console command executes.
+    //! \param aJob The job
+    //! \return \c FALSE if the command cannot run as job
     // -----------------------------------------------------------------
-    bool repeat() {
-        return (mRepeat &&
-                mCmd != COMMAND_ERR &&
-                mCmd != COMMAND_CONTINUE);
+    bool prepareJob(TJob *aJob) {
+        TValues      *aOptions = mOptionList;
+        const SAP_UC *aCmdLine = mCmdLine;
+        int           aCmd     = mCmd;
+
+        mOptionList = aJob->getOptions();
+        parse(aJob->getCommand());
+        aJob->setCmd(mCmd);
+
+        mOptionList = aOptions;
+        mCmdLine    = aCmdLine;
+        mCmd        = aCmd;
+
+        switch (aJob->getCmd()) {
+            case COMMAND_UNKNOWN:
+            case COMMAND_CONTINUE:
+            case COMMAND_EXIT:
+            case COMMAND_ECHO:
+            case COMMAND_FORMAT:
+            case COMMAND_REPEAT:
+            case COMMAND_JOB:
+            case COMMAND_PASSWD_CHANGE:
+                return false;
+            default:
+                return true;
+        }
+    }
+    // -----------------------------------------------------------------
+    // TCommand::runJobs
+    //! \brief Execute all jobs, which are due
+    //! \param aJvmti The Java tool interface
+    //! \param aJni   The environment to execute the commands
+    // -----------------------------------------------------------------
+    void runJobs(
+            jvmtiEnv    *aJvmti,
+            JNIEnv      *aJni) {
+
+        TValues      *aOptions;
+        const SAP_UC *aCmdLine;
+        TJob         *aJob;
+        jlong         aStart;
+        int           aCmd;
+
+        while ((aJob = mScheduler.getDue(aStart = TSystem::getTimestamp())) != NULL) {
+            aOptions    = mOptionList;
+            aCmdLine    = mCmdLine;
+            aCmd        = aJob->getCmd();
+            mOptionList = aJob->getOptions();
+            mCmdLine    = aJob->getCommand();
+
+            // the job runs in the context of the session, which created it
+            TOutputQueue::getInstance()->sync();
+            if (!mConsole->attach(aJob->getSession(), aJob->getSlot(), aJob->isBound())) {
+                // the session of the repeater has logged out
+                mConsole->detach();
+                mOptionList = aOptions;
+                mCmdLine    = aCmdLine;
+                mScheduler.removeBound(aJob->getSession());
+                continue;
+            }
+            mMonitor->setOutputFile(aJob->getFile());
+            if (aCmd == COMMAND_GC) {
+                aJvmti->ForceGarbageCollection();
+            }
+            else {
+                execute(aJvmti, aJni, &aCmd);
+            }
+            mMonitor->setOutputFile(NULL);
+            TOutputQueue::getInstance()->sync();
+            mConsole->detach();
+
+            mOptionList = aOptions;
+            mCmdLine    = aCmdLine;
+            aJob->finish(aStart, TSystem::getTimestamp());
+        }
+    }
+    // -----------------------------------------------------------------
+    // TCommand::addJob
+    //! \brief Parse the options of "job add" and schedule the job
+    //! \param aRootTag The output tag list
+    // -----------------------------------------------------------------
+    void addJob(TXmlTag *aRootTag) {
+        TValues::iterator aPtrAttr;
+        const SAP_UC     *aName     = NULL;
+        const SAP_UC     *aFileName = NULL;
+        jlong             aInterval = 0;
+        jlong             aJitter   = 0;
+        TString           aCommand;
+        TJob             *aJob;
+
+        aPtrAttr = mOptionList->next();
+        if (aPtrAttr != mOptionList->end()) {
+            aName    = *aPtrAttr;
+            aPtrAttr = mOptionList->next();
+        }
+        if (aPtrAttr != mOptionList->end()) {
+            aInterval = TString::toInteger(*aPtrAttr);
+            aPtrAttr  = mOptionList->next();
+        }
+        for (; aPtrAttr != mOptionList->end(); aPtrAttr = mOptionList->next()) {
+            if (!STRNCMP(*aPtrAttr, cU("-j"), 2)) {
+                aJitter   = TString::toInteger(*aPtrAttr + 2);
+            }
+            else if (!STRNCMP(*aPtrAttr, cU("-o"), 2)) {
+                aFileName = *aPtrAttr + 2;
+            }
+            else {
+                break;
+            }
+        }
+        for (; aPtrAttr != mOptionList->end(); aPtrAttr = mOptionList->next()) {
+            if (aCommand.pcount() > 0) {
+                aCommand.concat(cU(" "));
+            }
+            aCommand.concat(*aPtrAttr);
+        }
+
+        if (aName == NULL || aInterval <= 0 || aCommand.pcount() == 0) {
+            aRootTag->addAttribute(cU("Result"), cU("job add <name> <seconds> [-j<ms>][-o<file>] <command>"));
+            return;
+        }
+        aJob = new TJob(aName, aCommand.str(), aInterval, aJitter);
+
+        if (!prepareJob(aJob)) {
+            aRootTag->addAttribute(cU("Result"), cU("command cannot run as job"));
+            delete aJob;
+            return;
+        }
+        if (aFileName != NULL && !aJob->openFile(aFileName)) {
+            aRootTag->addAttribute(cU("Result"), cU("cannot open output file"));
+            delete aJob;
+            return;
+        }
+        if (!mScheduler.add(aJob)) {
+            aRootTag->addAttribute(cU("Result"), cU("too many jobs"));
+            delete aJob;
+        }
     }
     // -----------------------------------------------------------------
     // TCommand::execute
@@ -712,6 +1518,95 @@ public:
                 mMonitor->syncOutput(&aRootTag);
                 break;
             }                
+            case COMMAND_LRS: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Heap"));
+                aRootTag.addAttribute(cU("Info"), cU("Retained Size"));
+                bool aSnapshot = false;
+
+                for (; aPtrAttr != mOptionList->end(); aPtrAttr = mOptionList->next()) {
+                    if (!STRNCMP(*aPtrAttr, cU("-r"), 2)) {
+                        aSnapshot = true;
+                    }
+                }
+                if (aSnapshot) {
+                    *aCmd = COMMAND_CONTINUE;
+                    THeapGraph::getInstance()->snapshot(aJvmti, aJni, &aRootTag, mOptionList);
+                }
+                else {
+                    THeapGraph::getInstance()->dump(&aRootTag, mOptionList);
+                }
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_HPROF: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Heap"));
+                aRootTag.addAttribute(cU("Info"), cU("HPROF Dump"));
+                *aCmd = COMMAND_CONTINUE;
+                THeapDump::getInstance()->dump(aJvmti, aJni, &aRootTag, mOptionList);
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_LGR: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Heap"));
+                aRootTag.addAttribute(cU("Info"), cU("Paths to GC Roots"));
+                *aCmd = COMMAND_CONTINUE;
+                THeapPath::getInstance()->dump(aJvmti, aJni, &aRootTag, mOptionList);
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_LFS: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Monitor"));
+                aRootTag.addAttribute(cU("Info"), cU("Folded Stacks"));
+                *aCmd = COMMAND_CONTINUE;
+                mMonitor->dumpFoldedStacks(&aRootTag, mOptionList);
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_LTS: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Series"));
+                aRootTag.addAttribute(cU("Info"), cU("Time Series"));
+                *aCmd = COMMAND_CONTINUE;
+                mMonitor->dumpSeries(&aRootTag, mOptionList);
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_FORMAT: {
+                TXmlTag aRootTag(cU("Message"));
+                aRootTag.addAttribute(cU("Type"), cU("Command"));
+                *aCmd = COMMAND_CONTINUE;
+                if (aPtrAttr != mOptionList->end()) {
+                    if (!STRNCMP((*aPtrAttr), cU("xml"), 3)) {
+                        mConsole->setWriterType(XMLWRITER_TYPE_XML);
+                    }
+                    else if (!STRNCMP((*aPtrAttr), cU("ascii"), 5)) {
+                        mConsole->setWriterType(XMLWRITER_TYPE_ASCII);
+                    }
+                    else {
+                        aRootTag.addAttribute(cU("Result"), cU("unknown format"));
+                    }
+                }
+                aRootTag.addAttribute(cU("Info"), 
+                    (mConsole->getWriterType() == XMLWRITER_TYPE_XML)    ? cU("Format xml")    :
+                    (mConsole->getWriterType() == XMLWRITER_TYPE_BINARY) ? cU("Format binary") : cU("Format ascii"));
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
+            case COMMAND_SYNC: {
+                TXmlTag aRootTag(cU("Message"));
+                aRootTag.addAttribute(cU("Type"), cU("Command"));
+                aRootTag.addAttribute(cU("Info"), cU("Log and trace files written"));
+                *aCmd = COMMAND_CONTINUE;
+                TOutputQueue::getInstance()->sync();
+                TLogger::getInstance()->sync();
+                mTracer->syncFile();
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
             case COMMAND_SET: {
                 TXmlTag aRootTag(cU("Message"));
                 aRootTag.addAttribute(cU("Type"), cU("Command"));
@@ -723,6 +1618,7 @@ public:
                 aCmdOutput = *aPtrAttr;
 
                 if (mProperties->parseProperty(&aProperty)) {
+                    mProperties->compileRules();
                     aRootTag.addAttribute(cU("Result"), aCmdOutput.str());
                     if (aProperty.equalsKey(cU("Tracer"))) {
                         setTraceOptions(aJvmti);
@@ -802,7 +1698,7 @@ public:
             }
             case COMMAND_EXIT: {
                 TConsole  *aConsole  = TConsole::getInstance();
-                if (mProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML) {
+                if (aConsole->getWriterType() == XMLWRITER_TYPE_XML) {
                     mMonitor->syncOutput(cU("</sherlok>\n"));
                 }
                 aConsole->exitConnection();
@@ -847,6 +1743,14 @@ public:
                 mMonitor->syncOutput(&aTraceTag);
                 break;
             }
+            case COMMAND_RELOAD: {
+                TXmlTag aTraceTag(cU("Messages"), XMLTAG_TYPE_NODE);
+                aTraceTag.addAttribute(cU("Type"),   cU("Command"));
+
+                mMonitor->reload(aJvmti, &aTraceTag);
+                mMonitor->syncOutput(&aTraceTag);
+                break;
+            }
             case COMMAND_START: {
                 TXmlTag  aTraceTag(cU("Messages"), XMLTAG_TYPE_NODE);
                 aTraceTag.addAttribute(cU("Type"), cU("Command"));
@@ -980,25 +1884,54 @@ public:
                 break;
             }
             case COMMAND_REPEAT: {
-                if (mRepeat) {
-                    mRepeat = false;
-                    break;
-                }
-                mRepeatTime = 1;
-                const SAP_UC *aCommand = mReader->getPrevious();
+                jlong         aInterval = 1;
+                const SAP_UC *aCommand  = mReader->getPrevious();
+                TJob         *aJob;
+
+                *aCmd = COMMAND_CONTINUE;
                 if (aPtrAttr != mOptionList->end()) {
-                    mRepeatTime = TString::toInteger(*aPtrAttr);
+                    aInterval = TString::toInteger(*aPtrAttr);
                 }
-                STRCPY(mCmdRepeat, mReader->getPrevious(), 128);
-                parse(aCommand);
-                
-                mRepeat = true;
                 TXmlTag aRootTag(cU("Message"));
                 aRootTag.addAttribute(cU("Type"),   cU("Command"));
-                aRootTag.addAttribute(cU("Result"), aCommand);
+
+                // the repeater is the job "repeat" of the session, removed by its next input
+                aJob = new TJob(cU("repeat"), aCommand, aInterval, 0);
+                aJob->bind();
+                if (prepareJob(aJob) && mScheduler.add(aJob)) {
+                    aRootTag.addAttribute(cU("Result"), aCommand);
+                }
+                else {
+                    aRootTag.addAttribute(cU("Result"), cU("command cannot be repeated"));
+                    delete aJob;
+                }
                 mMonitor->syncOutput(&aRootTag);
                 break; 
             }
+            case COMMAND_JOB: {
+                TXmlTag aRootTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootTag.addAttribute(cU("Type"), cU("Job"));
+                aRootTag.addAttribute(cU("Info"), cU("Scheduled Jobs"));
+                *aCmd = COMMAND_CONTINUE;
+
+                if (aPtrAttr != mOptionList->end()) {
+                    if (!STRNCMP(*aPtrAttr, cU("add"), 3)) {
+                        addJob(&aRootTag);
+                    }
+                    else if (!STRNCMP(*aPtrAttr, cU("del"), 3)) {
+                        aPtrAttr = mOptionList->next();
+                        if (aPtrAttr == mOptionList->end() || !mScheduler.remove(*aPtrAttr)) {
+                            aRootTag.addAttribute(cU("Result"), cU("job not found"));
+                        }
+                    }
+                    else {
+                        aRootTag.addAttribute(cU("Result"), cU("unknown option"));
+                    }
+                }
+                mScheduler.dump(&aRootTag);
+                mMonitor->syncOutput(&aRootTag);
+                break;
+            }
             case COMMAND_TRIGGER: {
                 jvmtiError   aResult;
                 TXmlTag      aTraceTag(cU("Messages"), XMLTAG_TYPE_NODE);                
@@ -1064,6 +1997,12 @@ public:
                         aTag->addAttribute(cU("Info"), aEnable? cU("Trace Contention added") : cU("Trace Contention removed"));
                         mMonitor->setTraceContention(aJvmti, aEnable, mOptionList);
                     }
+                    else if (!STRNCMP((*aPtrAttr), cU("folded"), 6)) {
+                        aTag = aTraceTag.addTag(cU("Message"));
+                        aTag->addAttribute(cU("Type"), cU("Command"));
+                        aTag->addAttribute(cU("Info"), aEnable? cU("Trace Folded added") : cU("Trace Folded removed"));
+                        mTracer->setTraceFolded(aEnable);
+                    }
                     else if (!STRNCMP((*aPtrAttr), cU("class"), 5)) {
                         aTag = aTraceTag.addTag(cU("Message"));
                         aTag->addAttribute(cU("Type"), cU("Command"));
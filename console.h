@@ -31,6 +31,418 @@
 #include "cti.h"
 #include "ptypes.h"
 
+// ----------------------------------------------------
+//! \class TMappedFile
+//! \brief Append only file written through a memory mapping
+//!
+//! The file grows in segments of MAPPED_SEGMENT_SIZE bytes, text is
+//! copied into the mapped segment without a system call. If a maximal
+//! size is given the file is renamed to <name>.1 when the next line
+//! does not fit and older files are shifted up to <name>.<count>.
+//! Pages are synchronized to disk only on rotation and on request.
+//! With compression the text is collected in blocks of
+//! BLOCK_CODEC_SIZE bytes, which are written as TBlockCodec frames.
+//! The open block is kept in memory until it is full or the file is
+//! synchronized, so a crash of the process loses up to one block.
+//!
+//! Application threads and the writer thread of TOutputQueue may
+//! write to the same file, all public methods hold the raw monitor
+//! created by TMappedFile::initialize.
+// ----------------------------------------------------
+#define MAPPED_SEGMENT_SIZE (1024 * 1024)
+
+class TMappedFile {
+private:
+    TString         mFileName;      //!< The file name
+    SAP_A7         *mBase;          //!< The mapped segment
+    jlong           mOffset;        //!< File offset of the mapped segment
+    jlong           mPos;           //!< Write position in the segment
+    jlong           mMaxSize;       //!< Rotation size or 0 for no rotation
+    jint            mMaxFiles;      //!< Number of rotated files to keep
+    jint            mNrRotations;   //!< Number of rotations
+    bool            mOpen;          //!< File is open and mapped
+    bool            mCompress;      //!< Write compressed frames
+    SAP_A7         *mBlock;         //!< Raw block to compress
+    SAP_A7         *mPacked;        //!< Frame of the compressed block
+    jint            mBlockLen;      //!< Bytes in the raw block
+    jint            mGeneration;    //!< Number of the open, changes with each open
+#if defined (_WINDOWS)
+    HANDLE          mHandle;        //!< The file handle
+    HANDLE          mMapping;       //!< The mapping of the current segment
+#else
+    int             mHandle;        //!< The file descriptor
+#endif
+    static jvmtiEnv      *mJvmti;   //!< Tool interface of the lock
+    static jrawMonitorID  mMonitor; //!< Serializes the access to mapped files
+    // ----------------------------------------------------
+    // TMappedFile::TMappedFile
+    //! Copy constructor
+    // ----------------------------------------------------
+    TMappedFile(const TMappedFile &) {
+    }
+    // ----------------------------------------------------
+    // TMappedFile::operator=
+    //! Copy constructor
+    // ----------------------------------------------------
+    TMappedFile *operator=(const TMappedFile &) {
+        return this;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::openHandle
+    //! \brief Open the file and evaluate the write position
+    //! \param aAppend \c TRUE to keep the content
+    //! \return \c FALSE if the file cannot be opened
+    // ----------------------------------------------------
+    bool openHandle(bool aAppend);
+    // ----------------------------------------------------
+    // TMappedFile::closeHandle
+    //! \brief Cut the file to the written size and close it
+    // ----------------------------------------------------
+    void closeHandle();
+    // ----------------------------------------------------
+    // TMappedFile::lock
+    //! \brief Enter the file monitor
+    // ----------------------------------------------------
+    static void lock() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorEnter(mMonitor);
+        }
+    }
+    // ----------------------------------------------------
+    // TMappedFile::unlock
+    //! \brief Exit the file monitor
+    // ----------------------------------------------------
+    static void unlock() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorExit(mMonitor);
+        }
+    }
+    // ----------------------------------------------------
+    // TMappedFile::start
+    //! \brief Open the file and map the first segment
+    //!
+    //! The file is closed again if the mapping fails.
+    //! \param aAppend \c TRUE to keep the content
+    //! \return \c FALSE if the file cannot be opened or mapped
+    // ----------------------------------------------------
+    bool start(bool aAppend) {
+        if (!openHandle(aAppend)) {
+            return false;
+        }
+        if (!map()) {
+            closeHandle();
+            return false;
+        }
+        return true;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::map
+    //! \brief Extend the file and map the segment at mOffset
+    //! \return \c FALSE if the mapping failed
+    // ----------------------------------------------------
+    bool map();
+    // ----------------------------------------------------
+    // TMappedFile::unmap
+    //! \brief Release the current segment
+    //! \param aSync \c TRUE to write the pages to disk
+    // ----------------------------------------------------
+    void unmap(bool aSync);
+    // ----------------------------------------------------
+    // TMappedFile::rename
+    //! \brief Rename a file, an existing target is replaced
+    //! \param aFrom The old name
+    //! \param aTo   The new name
+    // ----------------------------------------------------
+    static void rename(TString *aFrom, TString *aTo);
+    // ----------------------------------------------------
+    // TMappedFile::rotate
+    //! \brief Close the file, shift the old files and start
+    //!        a new file
+    // ----------------------------------------------------
+    void rotate() {
+        SAP_UC  aBuffer[32];
+        TString aFrom;
+        TString aTo;
+
+        unmap(true);
+        closeHandle();
+        mNrRotations++;
+
+        for (jint i = mMaxFiles; i > 1; i--) {
+            aFrom = mFileName.str();
+            aFrom.concat(cU("."));
+            aFrom.concat(TString::parseInt(i - 1, aBuffer));
+            aTo   = mFileName.str();
+            aTo.concat(cU("."));
+            aTo.concat(TString::parseInt(i, aBuffer));
+            rename(&aFrom, &aTo);
+        }
+        if (mMaxFiles > 0) {
+            aTo = mFileName.str();
+            aTo.concat(cU(".1"));
+            rename(&mFileName, &aTo);
+        }
+        mOpen = start(false);
+    }
+    // ----------------------------------------------------
+    // TMappedFile::append
+    //! \brief Copy bytes into the mapped segments
+    //! \param aData The bytes
+    //! \param aLen  The number of bytes
+    // ----------------------------------------------------
+    void append(const SAP_A7 *aData, jlong aLen) {
+        jlong aCopy;
+
+        while (mOpen && aLen > 0) {
+            if (mPos == MAPPED_SEGMENT_SIZE) {
+                unmap(false);
+                mOffset += MAPPED_SEGMENT_SIZE;
+                mPos     = 0;
+                mOpen    = map();
+                if (!mOpen) {
+                    closeHandle();
+                }
+                continue;
+            }
+            aCopy = min(aLen, (jlong)MAPPED_SEGMENT_SIZE - mPos);
+            memcpyR(mBase + mPos, aData, (size_t)aCopy);
+            mPos  += aCopy;
+            aData += aCopy;
+            aLen  -= aCopy;
+        }
+    }
+    // ----------------------------------------------------
+    // TMappedFile::flushBlock
+    //! \brief Compress the raw block and write the frame
+    //!
+    //! A frame which does not fit is written to the next file on
+    //! rotation. Blocks which do not shrink are stored raw. Called
+    //! for a full block, on sync and on close.
+    // ----------------------------------------------------
+    void flushBlock() {
+        jint aHeader[3];
+        jint aStored;
+
+        if (!mCompress || mBlockLen == 0) {
+            return;
+        }
+        aStored = TBlockCodec::compress(mBlock, mBlockLen, mPacked + BLOCK_CODEC_HEADER);
+        if (aStored >= mBlockLen) {
+            aStored = mBlockLen;
+            memcpyR(mPacked + BLOCK_CODEC_HEADER, mBlock, mBlockLen);
+        }
+        aHeader[0] = BLOCK_CODEC_MAGIC;
+        aHeader[1] = mBlockLen;
+        aHeader[2] = aStored;
+        memcpyR(mPacked, aHeader, BLOCK_CODEC_HEADER);
+        mBlockLen  = 0;
+
+        if (mMaxSize > 0 && mOffset + mPos > 0 && 
+            mOffset + mPos + (jlong)BLOCK_CODEC_HEADER + aStored > mMaxSize) {
+            rotate();
+        }
+        append(mPacked, (jlong)BLOCK_CODEC_HEADER + aStored);
+    }
+public:
+    // ----------------------------------------------------
+    // TMappedFile::TMappedFile
+    //! Constructor
+    // ----------------------------------------------------
+    TMappedFile() {
+        mBase        = NULL;
+        mOffset      = 0;
+        mPos         = 0;
+        mMaxSize     = 0;
+        mMaxFiles    = 0;
+        mNrRotations = 0;
+        mOpen        = false;
+        mCompress    = false;
+        mBlock       = NULL;
+        mPacked      = NULL;
+        mBlockLen    = 0;
+        mGeneration  = 0;
+#if defined (_WINDOWS)
+        mHandle      = INVALID_HANDLE_VALUE;
+        mMapping     = NULL;
+#else
+        mHandle      = -1;
+#endif
+    }
+    // ----------------------------------------------------
+    // TMappedFile::~TMappedFile
+    //! Destructor
+    // ----------------------------------------------------
+    ~TMappedFile() {
+        close();
+        delete [] mBlock;
+        delete [] mPacked;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::initialize
+    //! \brief Create the monitor of the mapped files
+    //!
+    //! Without a tool interface, e.g. in tracedec, files are not locked.
+    //! \param aJvmti The tool interface
+    // ----------------------------------------------------
+    static void initialize(jvmtiEnv *aJvmti) {
+        if (mMonitor == NULL) {
+            mJvmti = aJvmti;
+            mJvmti->CreateRawMonitor(/*SAPUNICODEOK_CHARTYPE*/(char*)cR("_MappedFile"), &mMonitor);
+        }
+    }
+    // ----------------------------------------------------
+    // TMappedFile::open
+    //! \brief Open and map a file
+    //! \param aFileName The file name
+    //! \param aMaxSize  Rotation size in bytes, 0 for no rotation
+    //! \param aMaxFiles Number of rotated files to keep
+    //! \param aAppend   \c TRUE to keep the content
+    //! \param aCompress \c TRUE to write compressed frames
+    //! \return \c FALSE if the file cannot be opened
+    // ----------------------------------------------------
+    bool open(
+            const SAP_UC   *aFileName,
+            jlong           aMaxSize  = 0,
+            jint            aMaxFiles = 0,
+            bool            aAppend   = false,
+            bool            aCompress = false) {
+
+        lock();
+        close();
+        mFileName    = aFileName;
+        mMaxSize     = aMaxSize;
+        mMaxFiles    = aMaxFiles;
+        mNrRotations = 0;
+        mCompress    = aCompress;
+        mBlockLen    = 0;
+        if (mCompress && mBlock == NULL) {
+            mBlock   = new SAP_A7[BLOCK_CODEC_SIZE];
+            mPacked  = new SAP_A7[BLOCK_CODEC_HEADER + TBlockCodec::getBound(BLOCK_CODEC_SIZE)];
+        }
+        mGeneration++;
+        mOpen        = start(aAppend);
+        unlock();
+        return mOpen;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::isOpen
+    //! \return \c TRUE if the file is open
+    // ----------------------------------------------------
+    bool isOpen() {
+        return mOpen;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::getGeneration
+    //! \return The number of the current open
+    // ----------------------------------------------------
+    jint getGeneration() {
+        return mGeneration;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::write
+    //! \brief Append text
+    //!
+    //! A text is not split between two files on rotation.
+    //! Compressed files rotate between frames.
+    //! \param aText The text to append
+    // ----------------------------------------------------
+    void write(const SAP_UC *aText) {
+        SAP_A7 aBuffer[256];
+        jlong  aLen;
+        jlong  aCopy;
+
+        lock();
+        if (!mOpen) {
+            unlock();
+            return;
+        }
+        aLen = STRLEN(aText);
+        if (mCompress) {
+            while (aLen > 0) {
+                aCopy = min(aLen, (jlong)(BLOCK_CODEC_SIZE - mBlockLen));
+                for (jlong i = 0; i < aCopy; i++) {
+                    /*SAPUNICODEOK_CAST*/
+                    mBlock[mBlockLen + i] = (SAP_A7)aText[i];
+                }
+                mBlockLen += (jint)aCopy;
+                aText     += aCopy;
+                aLen      -= aCopy;
+                if (mBlockLen == BLOCK_CODEC_SIZE) {
+                    flushBlock();
+                }
+            }
+            unlock();
+            return;
+        }
+        if (mMaxSize > 0 && mOffset + mPos > 0 && mOffset + mPos + aLen > mMaxSize) {
+            rotate();
+        }
+
+        while (mOpen && aLen > 0) {
+            aCopy = min(aLen, (jlong)sizeofR(aBuffer));
+            for (jlong i = 0; i < aCopy; i++) {
+                /*SAPUNICODEOK_CAST*/
+                aBuffer[i] = (SAP_A7)aText[i];
+            }
+            append(aBuffer, aCopy);
+            aText += aCopy;
+            aLen  -= aCopy;
+        }
+        unlock();
+    }
+    // ----------------------------------------------------
+    // TMappedFile::write
+    //! \brief Append text to the file of a given open
+    //! \param aText       The text
+    //! \param aGeneration The number of the open, see getGeneration
+    //! \return \c FALSE if the file was closed or opened again
+    // ----------------------------------------------------
+    bool write(const SAP_UC *aText, jint aGeneration) {
+        lock();
+        if (!mOpen || mGeneration != aGeneration) {
+            unlock();
+            return false;
+        }
+        write(aText);
+        unlock();
+        return true;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::sync
+    //! \brief Write the pending block and the mapped pages to disk
+    // ----------------------------------------------------
+    void sync();
+    // ----------------------------------------------------
+    // TMappedFile::close
+    //! \brief Release the mapping and cut the file to
+    //!        the written size
+    // ----------------------------------------------------
+    void close() {
+        lock();
+        if (mOpen) {
+            flushBlock();
+            unmap(true);
+            closeHandle();
+            mOpen = false;
+        }
+        unlock();
+    }
+    // ----------------------------------------------------
+    // TMappedFile::getSize
+    //! \return The number of bytes written to the current file
+    // ----------------------------------------------------
+    jlong getSize() {
+        return mOffset + mPos;
+    }
+    // ----------------------------------------------------
+    // TMappedFile::getRotations
+    //! \return The number of rotations since open
+    // ----------------------------------------------------
+    jint getRotations() {
+        return mNrRotations;
+    }
+};
+
 // ----------------------------------------------------
 //! \class TLogger
 //! \brief Handle log files and output
@@ -40,7 +452,7 @@ class TLogger {
 private:
     static TLogger *mInstance;      //!< Sigleton instance
     bool            mActive;        //!< Active logging
-    SAP_ofstream    mFile;          //!< Active file handle
+    TMappedFile     mFile;          //!< Active file handle
     TProperties    *mProperties;    //!< Global configuration
     // ----------------------------------------------------
     // TLogger::TLogger
@@ -98,69 +510,1063 @@ public:
             enable(true, aAppend);
         }
     }
-    // ----------------------------------------------------
-    // TLogger::stop
-    //! Deactivate loggin
-    // ----------------------------------------------------
-    void stop() {
-        if (mActive) {
-            enable(false);
+    // ----------------------------------------------------
+    // TLogger::stop
+    //! Deactivate loggin
+    // ----------------------------------------------------
+    void stop() {
+        if (mActive) {
+            enable(false);
+        }
+    }
+private:
+    // ----------------------------------------------------
+    // TLogger::enable
+    //! \brief Activate/Deactivate loggin
+    //! \param aEnable \c TRUE to activate
+    // ----------------------------------------------------
+    void enable(bool aEnable, bool aAppend = false) {
+        mActive = aEnable;
+        if (mActive) {
+            mFile.open(
+                    mProperties->getLogFile()->str(), 
+                    mProperties->getLogFileSize(), 
+                    mProperties->getLogFileCount(), 
+                    aAppend,
+                    mProperties->doLogFileCompression());
+
+            mFile.write(cU("=== Sherlok log file created by "));
+            mFile.write(TSystem::getSystemTime());
+            mFile.write(cU(" ===\n"));
+        }
+        else {
+            mFile.close();
+        }
+    }
+public:
+    // ----------------------------------------------------
+    // TLogger::getStatus
+    //! \brief Checks activation
+    //! \return \c TRUE if logging is active
+    // ----------------------------------------------------
+    bool getStatus() {
+        return mActive;
+    }
+    // ----------------------------------------------------
+    // TLogger::print
+    //! \brief Output to log file
+    //! \param aBuffer String output
+    // ----------------------------------------------------
+    void print(const SAP_UC *aBuffer) {        
+        if (mActive) {
+            mFile.write(aBuffer);
+        }
+    }
+    // ----------------------------------------------------
+    // TLogger::print
+    //! \brief Output to log file and carriage return.
+    //! \param aBuffer String output
+    // ----------------------------------------------------
+    void printLn(const SAP_UC *aBuffer) {        
+        if (mActive) {
+            mFile.write(aBuffer);
+            mFile.write(cU("\n"));
+        }
+    }
+    // ----------------------------------------------------
+    // TLogger::sync
+    //! \brief Write the log file to disk
+    // ----------------------------------------------------
+    void sync() {
+        mFile.sync();
+    }
+};
+
+// -----------------------------------------------------------------
+//! \class TSession
+//! \brief One client connection of the console
+//!
+//! The socket is non-blocking. Input is processed chunk by chunk
+//! as it arrives: the session does line editing and echo and keeps
+//! complete lines for the telnet thread. Output is appended to the
+//! send queue of the session, which is drained when the socket is
+//! writable, so a slow client only fills its own queue. Output
+//! beyond SESSION_QUEUE_SIZE is dropped for this client, except for
+//! the session of the executing command, which is flushed blocking.
+//!
+//! A client starting with the preamble SESSION_MAGIC switches the
+//! session to binary frames for automation. All integers are big
+//! endian, a string is an u16 length followed by the ASCII bytes.
+//! Each frame starts with u32 length of the rest, u32 request id
+//! and u8 frame type:
+//! - 'C' request: u16 number of arguments and the arguments, the
+//!   first is the command, e.g. "lsm" "-m10". The user and the
+//!   password are sent as requests with one argument. The request
+//!   id is chosen by the client and must not be 0.
+//! - 'R' response: the result tags of the request. A tag is u8
+//!   XMLTAG_TYPE_*, the element, u16 number of attributes, each with
+//!   key, u8 0 and a string or u8 1 and an i64, and u32 number of
+//!   child tags followed by the children.
+//! - 'T' response: text output, unsolicited output has request id 0
+//! - 'E' response: end of the request with u8 status 0 for done or
+//!   1 for rejected or incomplete output and u8 session state SESSION_*
+//!
+//! The session replies the preamble before the first frame, so a
+//! client skips the greeting up to SESSION_MAGIC. Requests are
+//! queued, a client may send several requests without waiting.
+// -----------------------------------------------------------------
+#define CONSOLE_SESSIONS    16                  //!< Maximal number of console clients
+#define SESSION_LINES       16                  //!< Pending input lines of a client
+#define SESSION_QUEUE_SIZE  (4 * 1024 * 1024)   //!< Maximal pending output of a client
+#define SESSION_FLUSH_TIMEOUT 30000           //!< Milliseconds to wait for a client reading command output
+#define SESSION_LOGIN_USER  0                   //!< Waiting for the user name
+#define SESSION_LOGIN_PASS  1                   //!< Waiting for the password
+#define SESSION_READY       2                   //!< Logged in
+#define SESSION_CLOSED      3                   //!< Disconnected, removed by TConsole
+#define SESSION_MAGIC       "\0SKB"             //!< Preamble of a binary client
+#define SESSION_MAGIC_LEN   4                   //!< Length of the preamble
+#define SESSION_FRAME_SIZE  4096                //!< Maximal size of a request frame
+#define SESSION_FRAME_HEAD  9                   //!< Length, request id and frame type
+#define SESSION_FRAME_CMD   'C'                 //!< Request frame
+#define SESSION_FRAME_RES   'R'                 //!< Result tags
+#define SESSION_FRAME_TEXT  'T'                 //!< Text output
+#define SESSION_FRAME_END   'E'                 //!< End of a request
+#define CONSOLE_POLL_ADD    0                   //!< Add a socket to the poll set
+#define CONSOLE_POLL_MOD    1                   //!< Change the events of a socket
+#define CONSOLE_POLL_DEL    2                   //!< Remove a socket from the poll set
+
+class TSession {
+    friend class TConsole;
+private:
+    SOCKET       mSocketFd;                 //!< Client socket
+    jint         mId;                       //!< Session number
+    jint         mSlot;                     //!< Index in the session table
+    int          mState;                    //!< Login state
+    int          mWriterType;               //!< Output format of the client
+    bool         mEcho;                     //!< Server echo
+    bool         mCommand;                  //!< Session of the executing command
+    bool         mDraining;                 //!< Output waits for the client outside the console lock
+    bool         mReceiving;                //!< Input is processed by the event loop
+    bool         mPollOut;                  //!< Registered for writable events
+    bool         mLastCR;                   //!< Last input was a carriage return
+    int          mEscape;                   //!< Pending bytes of an escape sequence
+    int          mMagic;                    //!< Matched bytes of the preamble, -1 for telnet
+    bool         mBinary;                   //!< Binary frames
+    SAP_A7      *mFrame;                    //!< Incomplete request frame
+    jint         mFrameLen;                 //!< Bytes of the incomplete request frame
+    jint         mRequestId;                //!< Request id of the current line
+    bool         mFrameDropped;             //!< A frame of the current request was dropped
+    TString      mUser;                     //!< Login user
+    TString      mCurrentLine;              //!< Line in edit
+    TEditBuffer *mHistory;                  //!< Command history of the client
+    TEditBuffer::iterator mCmdLine;         //!< History position
+    TString      mLines[SESSION_LINES];     //!< Complete input lines
+    jint         mLineIds[SESSION_LINES];   //!< Request ids of the input lines
+    int          mLineRead;                 //!< First pending line
+    int          mNrLines;                  //!< Number of pending lines
+    SAP_A7      *mOutput;                   //!< Send queue
+    jint         mOutputLen;                //!< Bytes in the send queue
+    jint         mOutputSize;               //!< Capacity of the send queue
+    jlong        mNrDropped;                //!< Bytes dropped on overflow
+
+    // -----------------------------------------------------------------
+    // TSession::TSession
+    //! Copy constructor
+    // -----------------------------------------------------------------
+    TSession(const TSession &) {
+    }
+    // -----------------------------------------------------------------
+    // TSession::wouldBlock
+    //! \return \c TRUE if the last socket call failed for a full
+    //!         or empty socket buffer
+    // -----------------------------------------------------------------
+    static bool wouldBlock();
+    // -----------------------------------------------------------------
+    // TSession::send
+    //! \brief Send or queue output
+    //!
+    //! Output is sent directly only if nothing is queued,
+    //! to keep the order of the output. The session of the executing
+    //! command waits for the client instead of dropping output.
+    //! \param aData The output
+    //! \param aLen  The number of bytes
+    // -----------------------------------------------------------------
+    void send(const SAP_A7 *aData, jint aLen) {
+        jint    aResult;
+        jint    aCopy;
+
+        if (mState == SESSION_CLOSED || aLen <= 0) {
+            return;
+        }
+        // the command streams output, the event loop must not wait for it
+        while (mDraining && mState != SESSION_CLOSED) {
+            if (mReceiving) {
+                mNrDropped += aLen;
+                return;
+            }
+            waitDrained();
+        }
+        if (mOutputLen == 0) {
+            aResult = (jint)::send(mSocketFd, aData, aLen, 0);
+            if (aResult < 0) {
+                if (!wouldBlock()) {
+                    mState = SESSION_CLOSED;
+                    return;
+                }
+                aResult = 0;
+            }
+            aData += aResult;
+            aLen  -= aResult;
+        }
+        // the session of the command streams output larger than the queue
+        while (mCommand && !mReceiving && aLen > 0 && mOutputLen + aLen > SESSION_QUEUE_SIZE) {
+            drain(min(aLen, SESSION_QUEUE_SIZE));
+            if (mState == SESSION_CLOSED) {
+                return;
+            }
+            aCopy  = min(aLen, SESSION_QUEUE_SIZE - mOutputLen);
+            queue(aData, aCopy);
+            aData += aCopy;
+            aLen  -= aCopy;
+        }
+        if (aLen == 0) {
+            return;
+        }
+        if (mOutputLen + aLen > SESSION_QUEUE_SIZE) {
+            mNrDropped += aLen;
+            return;
+        }
+        queue(aData, aLen);
+    }
+    // -----------------------------------------------------------------
+    // TSession::queue
+    //! \brief Append output to the send queue
+    //! \param aData The output
+    //! \param aLen  The number of bytes, which fit into the queue
+    // -----------------------------------------------------------------
+    void queue(const SAP_A7 *aData, jint aLen) {
+        jint    aNewSize;
+        SAP_A7 *aNewOutput;
+
+        if (mOutputLen + aLen > mOutputSize) {
+            aNewSize   = max(max(2 * mOutputSize, mOutputLen + aLen), 4096);
+            aNewSize   = min(aNewSize, SESSION_QUEUE_SIZE);
+            aNewOutput = new SAP_A7[aNewSize];
+            if (mOutputLen > 0) {
+                memcpy(aNewOutput, mOutput, mOutputLen);
+            }
+            delete [] mOutput;
+            mOutput     = aNewOutput;
+            mOutputSize = aNewSize;
+        }
+        memcpy(mOutput + mOutputLen, aData, aLen);
+        mOutputLen += aLen;
+    }
+    // -----------------------------------------------------------------
+    // TSession::flush
+    //! \brief Send the queued output until the socket is full
+    // -----------------------------------------------------------------
+    void flush() {
+        jint aResult;
+
+        while (mOutputLen > 0 && mState != SESSION_CLOSED) {
+            aResult = (jint)::send(mSocketFd, mOutput, mOutputLen, 0);
+            if (aResult <= 0) {
+                if (aResult < 0 && wouldBlock()) {
+                    break;
+                }
+                mState = SESSION_CLOSED;
+                break;
+            }
+            mOutputLen -= aResult;
+            memmove(mOutput, mOutput + aResult, mOutputLen);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::waitWritable
+    //! \brief Wait until the socket accepts output
+    //! \param aTimeout The maximal wait time in milliseconds
+    //! \return \c FALSE on timeout or error
+    // -----------------------------------------------------------------
+    bool waitWritable(int aTimeout);
+    // -----------------------------------------------------------------
+    // TSession::drain
+    //! \brief Block until the send queue has room for output
+    //!
+    //! Used for the session of the executing command, which is not
+    //! served by the event loop until the command has finished.
+    //! The console lock is released while waiting for the client,
+    //! so the other sessions are served. A client not reading for
+    //! SESSION_FLUSH_TIMEOUT is closed.
+    //! \param aLen The number of bytes to queue
+    // -----------------------------------------------------------------
+    void drain(jint aLen);
+    // -----------------------------------------------------------------
+    // TSession::waitDrained
+    //! \brief Wait until a running drain has finished
+    //!
+    //! Keeps other output from entering a streamed frame.
+    // -----------------------------------------------------------------
+    void waitDrained();
+    // -----------------------------------------------------------------
+    // TSession::doEcho
+    //! \return \c TRUE if the input is echoed
+    //!
+    //! Input is not echoed before login, so a password typed ahead
+    //! of the prompt is not visible.
+    // -----------------------------------------------------------------
+    bool doEcho() {
+        return mEcho && mState == SESSION_READY;
+    }
+    // -----------------------------------------------------------------
+    // TSession::receive
+    //! \brief Read and process the available input
+    //! \return \c FALSE if the client has closed the connection
+    // -----------------------------------------------------------------
+    bool receive() {
+        SAP_A7 aBuffer[256];
+        int    aLen;
+
+        for (;;) {
+            aLen = (int)recv(mSocketFd, aBuffer, sizeofR(aBuffer), 0);
+            if (aLen > 0) {
+                mReceiving = true;
+                dispatch(aBuffer, aLen);
+                mReceiving = false;
+                if (aLen < (int)sizeofR(aBuffer)) {
+                    return true;
+                }
+                continue;
+            }
+            if (aLen < 0 && wouldBlock()) {
+                return true;
+            }
+            mState = SESSION_CLOSED;
+            return false;
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::dispatch
+    //! \brief Detect the preamble of a binary client
+    //!
+    //! The preamble is only accepted as the first input. A client
+    //! starting with other input is a telnet client.
+    //! \param aBuffer The input
+    //! \param aLen    The number of bytes
+    // -----------------------------------------------------------------
+    void dispatch(const SAP_A7 *aBuffer, int aLen) {
+        while (mMagic >= 0 && mMagic < SESSION_MAGIC_LEN && aLen > 0) {
+            if (*aBuffer != SESSION_MAGIC[mMagic]) {
+                if (mMagic > 0) {
+                    mState = SESSION_CLOSED;
+                    return;
+                }
+                mMagic = -1;
+                break;
+            }
+            aBuffer++;
+            aLen--;
+            if (++mMagic == SESSION_MAGIC_LEN) {
+                mBinary     = true;
+                mEcho       = false;
+                mWriterType = XMLWRITER_TYPE_BINARY;
+                mFrame      = new SAP_A7[SESSION_FRAME_SIZE];
+                mFrameLen   = 0;
+                send(SESSION_MAGIC, SESSION_MAGIC_LEN);
+            }
+        }
+        if (aLen == 0) {
+            return;
+        }
+        if (mBinary) {
+            processFrames(aBuffer, aLen);
+        }
+        else {
+            process(aBuffer, aLen);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::getU32
+    //! \param aData Big endian input
+    //! \return The unsigned 32 bit value
+    // -----------------------------------------------------------------
+    static jint getU32(const SAP_A7 *aData) {
+        const unsigned char *aPtr = (const unsigned char *)aData;
+        return (jint)(((unsigned)aPtr[0] << 24) | ((unsigned)aPtr[1] << 16) | ((unsigned)aPtr[2] << 8) | aPtr[3]);
+    }
+    // -----------------------------------------------------------------
+    // TSession::getU16
+    //! \param aData Big endian input
+    //! \return The unsigned 16 bit value
+    // -----------------------------------------------------------------
+    static jint getU16(const SAP_A7 *aData) {
+        const unsigned char *aPtr = (const unsigned char *)aData;
+        return (jint)((aPtr[0] << 8) | aPtr[1]);
+    }
+    // -----------------------------------------------------------------
+    // TSession::putU32
+    //! \param aData  Big endian output
+    //! \param aValue The unsigned 32 bit value
+    //! \return The position behind the value
+    // -----------------------------------------------------------------
+    static SAP_A7 *putU32(SAP_A7 *aData, jint aValue) {
+        aData[0] = (SAP_A7)((aValue >> 24) & 0xff);
+        aData[1] = (SAP_A7)((aValue >> 16) & 0xff);
+        aData[2] = (SAP_A7)((aValue >>  8) & 0xff);
+        aData[3] = (SAP_A7)( aValue        & 0xff);
+        return aData + 4;
+    }
+    // -----------------------------------------------------------------
+    // TSession::putString
+    //! \param aData  Output
+    //! \param aValue The string, truncated to 0xffff characters
+    //! \return The position behind the string
+    // -----------------------------------------------------------------
+    static SAP_A7 *putString(SAP_A7 *aData, const SAP_UC *aValue) {
+        jint aLen = (jint)min((int)STRLEN(aValue), 0xffff);
+        jint i;
+
+        *aData++ = (SAP_A7)((aLen >> 8) & 0xff);
+        *aData++ = (SAP_A7)( aLen       & 0xff);
+        for (i = 0; i < aLen; i++) {
+            /*SAPUNICODEOK_CONVERSION*/ *aData++ = (SAP_A7)aValue[i];
+        }
+        return aData;
+    }
+    // -----------------------------------------------------------------
+    // TSession::processFrames
+    //! \brief Collect request frames from a chunk of input
+    //!
+    //! A frame exceeding SESSION_FRAME_SIZE closes the session.
+    //! \param aBuffer The input
+    //! \param aLen    The number of bytes
+    // -----------------------------------------------------------------
+    void processFrames(const SAP_A7 *aBuffer, int aLen) {
+        jint aCopy;
+        jint aFrameLen;
+
+        while (aLen > 0) {
+            aCopy = min(aLen, SESSION_FRAME_SIZE - mFrameLen);
+            memcpy(mFrame + mFrameLen, aBuffer, aCopy);
+            mFrameLen += aCopy;
+            aBuffer   += aCopy;
+            aLen      -= aCopy;
+
+            while (mFrameLen >= 4) {
+                aFrameLen = getU32(mFrame);
+                if (aFrameLen < SESSION_FRAME_HEAD - 4 || aFrameLen > SESSION_FRAME_SIZE - 4) {
+                    mState = SESSION_CLOSED;
+                    return;
+                }
+                if (mFrameLen < aFrameLen + 4) {
+                    break;
+                }
+                processFrame(mFrame + 4, aFrameLen);
+                mFrameLen -= aFrameLen + 4;
+                memmove(mFrame, mFrame + aFrameLen + 4, mFrameLen);
+            }
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::processFrame
+    //! \brief Queue the command line of a request frame
+    //!
+    //! Malformed requests and requests exceeding SESSION_LINES
+    //! are rejected.
+    //! \param aData The frame without length
+    //! \param aLen  The number of bytes
+    // -----------------------------------------------------------------
+    void processFrame(const SAP_A7 *aData, jint aLen) {
+        jint   aRequestId = getU32(aData);
+        jint   aNrArgs;
+        jint   aArgLen;
+        jint   aPos;
+        jint   i;
+        jint   k;
+        SAP_UC aChar[2];
+
+        if (aData[4] != SESSION_FRAME_CMD || aLen < 7 || aRequestId == 0 || mNrLines == SESSION_LINES) {
+            endRequest(aRequestId, 1);
+            return;
+        }
+        aNrArgs      = getU16(aData + 5);
+        aPos         = 7;
+        aChar[1]     = cU('\0');
+        mCurrentLine = cU("");
+
+        for (i = 0; i < aNrArgs; i++) {
+            if (aPos + 2 > aLen || aPos + 2 + getU16(aData + aPos) > aLen) {
+                mCurrentLine = cU("");
+                endRequest(aRequestId, 1);
+                return;
+            }
+            aArgLen = getU16(aData + aPos);
+            aPos   += 2;
+            if (i > 0) {
+                mCurrentLine.concat(cU(' '));
+            }
+            for (k = 0; k < aArgLen; k++, aPos++) {
+                /*SAPUNICODEOK_CONVERSION*/ aChar[0] = (SAP_UC)(unsigned char)aData[aPos];
+                mCurrentLine.concat(aChar);
+            }
+        }
+        mLineIds[(mLineRead + mNrLines) % SESSION_LINES] = aRequestId;
+        mLines[(mLineRead + mNrLines) % SESSION_LINES]   = mCurrentLine.str();
+        mNrLines++;
+        mCurrentLine = cU("");
+    }
+    // -----------------------------------------------------------------
+    // TSession::sendFrame
+    //! \brief Send a frame as a whole
+    //!
+    //! The session of the executing command streams the frame.
+    //! Other sessions drop frames which do not fit into the send
+    //! queue, so the client never receives a partial frame. A request
+    //! with a dropped frame ends with status 1.
+    //! \param aFrame The frame with the header of TSession::newFrame
+    //! \param aLen   The payload length
+    // -----------------------------------------------------------------
+    void sendFrame(SAP_A7 *aFrame, jint aLen) {
+        if (!mCommand && mOutputLen + aLen + SESSION_FRAME_HEAD > SESSION_QUEUE_SIZE) {
+            mNrDropped   += aLen + SESSION_FRAME_HEAD;
+            mFrameDropped = mFrameDropped || (mRequestId != 0);
+        }
+        else {
+            send(aFrame, aLen + SESSION_FRAME_HEAD);
+        }
+        delete [] aFrame;
+    }
+    // -----------------------------------------------------------------
+    // TSession::newFrame
+    //! \brief Allocate a response frame and write the header
+    //! \param aType The frame type
+    //! \param aLen  The payload length
+    //! \return The frame, the payload starts at SESSION_FRAME_HEAD
+    // -----------------------------------------------------------------
+    SAP_A7 *newFrame(SAP_A7 aType, jint aLen) {
+        SAP_A7 *aFrame = new SAP_A7[aLen + SESSION_FRAME_HEAD];
+
+        putU32(aFrame,     aLen + SESSION_FRAME_HEAD - 4);
+        putU32(aFrame + 4, mRequestId);
+        aFrame[8] = aType;
+        return aFrame;
+    }
+    // -----------------------------------------------------------------
+    // TSession::endRequest
+    //! \brief Send the end frame of a request
+    //! \param aRequestId The request id
+    //! \param aStatus    0 for done or 1 for rejected or incomplete
+    // -----------------------------------------------------------------
+    void endRequest(jint aRequestId, int aStatus) {
+        jint    aSaveId = mRequestId;
+        SAP_A7 *aFrame;
+
+        mRequestId = aRequestId;
+        aFrame     = newFrame(SESSION_FRAME_END, 2);
+        aFrame[SESSION_FRAME_HEAD]     = (SAP_A7)aStatus;
+        aFrame[SESSION_FRAME_HEAD + 1] = (SAP_A7)mState;
+        sendFrame(aFrame, 2);
+        mRequestId = aSaveId;
+    }
+    // -----------------------------------------------------------------
+    // TSession::measureTag
+    //! \param aTag The result tag
+    //! \return The encoded size of the tag and its children
+    // -----------------------------------------------------------------
+    jint measureTag(TXmlTag *aTag) {
+        TListAttribute::iterator    aPtr;
+        TXmlTag::TTagList::iterator aTagPtr;
+        TXmlTag::TTagList          *aTagList = aTag->getTagList();
+        TProperty                  *aProperty;
+        jint                        aLen;
+        jlong                       aValue;
+
+        aLen = 1 + 2 + min((int)STRLEN(aTag->getElement()), 0xffff) + 2 + 4;
+        for (aPtr  = aTag->getAttributes()->begin();
+             aPtr != aTag->getAttributes()->end();
+             aPtr ++) {
+            aProperty = (*aPtr);
+            aLen += 2 + min((int)STRLEN(aProperty->getKey()), 0xffff) + 1;
+            aLen += getInteger(aProperty, &aValue) ? 8 : 2 + min((int)STRLEN(aProperty->getValue()), 0xffff);
+        }
+        for (aTagPtr  = aTagList->begin();
+             aTagPtr != aTagList->end();
+             aTagPtr  = aTagPtr->mNext) {
+            aLen += measureTag(aTagPtr->mElement);
+        }
+        return aLen;
+    }
+    // -----------------------------------------------------------------
+    // TSession::encodeTag
+    //! \param aData The output
+    //! \param aTag  The result tag
+    //! \return The position behind the tag and its children
+    // -----------------------------------------------------------------
+    SAP_A7 *encodeTag(SAP_A7 *aData, TXmlTag *aTag) {
+        TListAttribute::iterator    aPtr;
+        TXmlTag::TTagList::iterator aTagPtr;
+        TXmlTag::TTagList          *aTagList = aTag->getTagList();
+        TProperty                  *aProperty;
+        jint                        aCount   = 0;
+        jlong                       aValue;
+        int                         i;
+
+        *aData++ = (SAP_A7)aTag->getType();
+        aData    = putString(aData, aTag->getElement());
+        for (aPtr  = aTag->getAttributes()->begin();
+             aPtr != aTag->getAttributes()->end();
+             aPtr ++) {
+            aCount++;
+        }
+        *aData++ = (SAP_A7)((aCount >> 8) & 0xff);
+        *aData++ = (SAP_A7)( aCount       & 0xff);
+
+        for (aPtr  = aTag->getAttributes()->begin();
+             aPtr != aTag->getAttributes()->end();
+             aPtr ++) {
+            aProperty = (*aPtr);
+            aData     = putString(aData, aProperty->getKey());
+            if (getInteger(aProperty, &aValue)) {
+                *aData++ = 1;
+                for (i = 7; i >= 0; i--) {
+                    *aData++ = (SAP_A7)((aValue >> (8 * i)) & 0xff);
+                }
+            }
+            else {
+                *aData++ = 0;
+                aData    = putString(aData, aProperty->getValue());
+            }
+        }
+        aCount = 0;
+        for (aTagPtr  = aTagList->begin();
+             aTagPtr != aTagList->end();
+             aTagPtr  = aTagPtr->mNext) {
+            aCount++;
+        }
+        aData = putU32(aData, aCount);
+        for (aTagPtr  = aTagList->begin();
+             aTagPtr != aTagList->end();
+             aTagPtr  = aTagPtr->mNext) {
+            aData = encodeTag(aData, aTagPtr->mElement);
+        }
+        return aData;
+    }
+    // -----------------------------------------------------------------
+    // TSession::getInteger
+    //! \brief Parse the value of an integer attribute
+    //!
+    //! Values are formatted with TString::parseInt, the digit
+    //! separators are skipped.
+    //! \param aProperty The attribute
+    //! \param aValue    The result
+    //! \return \c FALSE if the attribute is not an integer
+    // -----------------------------------------------------------------
+    static bool getInteger(TProperty *aProperty, jlong *aValue) {
+        const SAP_UC *aPtr = aProperty->getValue();
+        bool          bNeg = false;
+        bool          bDigit = false;
+
+        if ((aProperty->getType() & PROPERTY_TYPE_INT) == 0 || aPtr == NULL) {
+            return false;
+        }
+        *aValue = 0;
+        if (*aPtr == cU('-')) {
+            bNeg = true;
+            aPtr++;
+        }
+        for (; *aPtr != cU('\0'); aPtr++) {
+            if (*aPtr == cU('.')) {
+                continue;
+            }
+            if (*aPtr < cU('0') || *aPtr > cU('9')) {
+                return false;
+            }
+            *aValue = *aValue * 10 + (*aPtr - cU('0'));
+            bDigit  = true;
+        }
+        if (bNeg) {
+            *aValue = -*aValue;
+        }
+        return bDigit;
+    }
+    // -----------------------------------------------------------------
+    // TSession::process
+    //! \brief Line editing for a chunk of input
+    //!
+    //! Printable characters are inserted as one string. Telnet
+    //! negotiation and unknown control characters are ignored.
+    //! \param aBuffer The input
+    //! \param aLen    The number of bytes
+    // -----------------------------------------------------------------
+    void process(const SAP_A7 *aBuffer, int aLen) {
+        SAP_UC aText[257];
+        int    aTextLen = 0;
+        int    aChar;
+        int    i;
+
+        for (i = 0; i < aLen; i++) {
+            aChar = (unsigned char)aBuffer[i];
+
+            if (mEscape > 0) {
+                // ESC [ A-D for the cursor keys
+                if (--mEscape == 0) {
+                    moveCursor(aChar);
+                }
+                continue;
+            }
+            if (aChar >= 32 && aChar < 127) {
+                /*SAPUNICODEOK_CONVERSION*/ aText[aTextLen++] = (SAP_UC)aChar;
+                mLastCR = false;
+                if (aTextLen == 256) {
+                    insert(aText, aTextLen);
+                    aTextLen = 0;
+                }
+                continue;
+            }
+            insert(aText, aTextLen);
+            aTextLen = 0;
+
+            switch (aChar) {
+                case   8:
+                case 127: // backspace
+                    if (mCurrentLine.getInsertPos() > 0) {
+                        mCurrentLine.backspace();
+                        moveCursor(-1, true);
+                    }
+                    break;
+                case  10:
+                    if (mLastCR) {
+                        mLastCR = false;
+                        break;
+                    }
+                    endLine();
+                    break;
+                case  13: // carriage return newline \015\012
+                    endLine();
+                    mLastCR = true;
+                    continue;
+                case  27:
+                    mEscape = 2;
+                    break;
+                default:
+                    break;
+            }
+            mLastCR = false;
+        }
+        insert(aText, aTextLen);
+    }
+    // -----------------------------------------------------------------
+    // TSession::insert
+    //! \brief Insert text at the cursor and echo the result
+    //! \param aText The text
+    //! \param aLen  The number of characters
+    // -----------------------------------------------------------------
+    void insert(SAP_UC *aText, int aLen) {
+        int i;
+        int aLenIns;
+
+        if (aLen == 0) {
+            return;
+        }
+        aText[aLen] = cU('\0');
+        mCurrentLine.insert(aText);
+        if (!doEcho()) {
+            return;
+        }
+        print(aText);
+        aLenIns = STRLEN(mCurrentLine.strInsert());
+        if (aLenIns > 0) {
+            print(mCurrentLine.strInsert());
+            for (i = 0; i < aLenIns; i++) {
+                print(cU("\010"));
+            }
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::moveCursor
+    //! \brief Move the cursor within the command line
+    //!
+    //! For positive values aCnt the cursor moves right, for negatives left.
+    //! \param aCnt Number of characters to move
+    //! \param aBsp \c TRUE if the character before the cursor is removed
+    // -----------------------------------------------------------------
+    void moveCursor(int aCnt, bool aBsp) {
+        int aInsPos = mCurrentLine.getInsertPos();
+        int aLenStr = mCurrentLine.pcount();
+        int aLenIns;
+        int i;
+
+        if (aCnt < 0 && aInsPos > 0) {
+            mCurrentLine.moveCursor(aCnt);
+            if (!doEcho()) {
+                return;
+            }
+            if (aBsp) {
+                print(cU("\010"));
+            }
+            print(mCurrentLine.strInsert());
+            print(cU(" "));
+            aLenIns = STRLEN(mCurrentLine.strInsert());
+            for (i = 0; i < aLenIns + 1; i++) {
+                print(cU("\010"));
+            }
+            return;
+        }
+        if (aCnt > 0 && aInsPos < aLenStr) {
+            if (doEcho()) {
+                print(mCurrentLine.strInsert());
+            }
+            mCurrentLine.moveCursor(aCnt);
+            if (!doEcho()) {
+                return;
+            }
+            aLenIns = STRLEN(mCurrentLine.strInsert());
+            for (i = 0; i < aLenIns; i++) {
+                print(cU("\010"));
+            }
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::moveCursor
+    //! \brief Execute a cursor key
+    //! \param aKey The last character of the escape sequence
+    // -----------------------------------------------------------------
+    void moveCursor(int aKey) {
+        switch (aKey) {
+            case 65: // cursor up
+                mCmdLine = mHistory->up();
+                break;
+            case 66: // cursor down
+                mCmdLine = mHistory->down();
+                break;
+            case 67: // cursor right
+                moveCursor(1, false);
+                return;
+            case 68: // cursor left
+                moveCursor(-1, true);
+                return;
+            default:
+                return;
+        }
+        if (mCmdLine != mHistory->end()) {
+            mCurrentLine = mCmdLine->str();
+            clrLine();
+            print(mCurrentLine.str());
+        }
+    }
+    // -----------------------------------------------------------------
+    // TSession::clrLine
+    //! \brief Clear the command line
+    // -----------------------------------------------------------------
+    void clrLine() {
+        SAP_A7 aClrScreen[72];
+
+        if (!doEcho()) {
+            return;
+        }
+        memsetR(aClrScreen, cR(' '), 72);
+        aClrScreen[0]  = cR('\015');
+        aClrScreen[69] = cR('\015');
+        aClrScreen[70] = cR('>');
+        send(aClrScreen, 72);
+    }
+    // -----------------------------------------------------------------
+    // TSession::endLine
+    //! \brief Pass the command line to the telnet thread
+    //!
+    //! Lines entered without echo, like passwords, are not
+    //! stored in the history.
+    // -----------------------------------------------------------------
+    void endLine() {
+        if (doEcho()) {
+            print(cU("\n"));
+        }
+        if (mNrLines < SESSION_LINES) {
+            mLineIds[(mLineRead + mNrLines) % SESSION_LINES] = 0;
+            mLines[(mLineRead + mNrLines) % SESSION_LINES]   = mCurrentLine.str();
+            mNrLines++;
         }
+        if (doEcho() && mCurrentLine.pcount() > 0) {
+            mCmdLine  = mHistory->push();
+           *mCmdLine  = mCurrentLine.str();
+        }
+        mCmdLine     = mHistory->end();
+        mCurrentLine = cU("");
     }
-private:
-    // ----------------------------------------------------
-    // TLogger::enable
-    //! \brief Activate/Deactivate loggin
-    //! \param aEnable \c TRUE to activate
-    // ----------------------------------------------------
-    void enable(bool aEnable, bool aAppend = false) {
-        mActive = aEnable;
-        if (mActive) {
-            if (aAppend) {
-                mFile.open(mProperties->getLogFile()->a7_str(), ios::app);
+public:
+    // -----------------------------------------------------------------
+    // TSession::TSession
+    //! Constructor
+    //! \param aSocketFd    The client socket
+    //! \param aId          The session number
+    //! \param aSlot        The index in the session table
+    //! \param aWriterType  The output format
+    // -----------------------------------------------------------------
+    TSession(SOCKET aSocketFd, jint aId, jint aSlot, int aWriterType) {
+        mSocketFd    = aSocketFd;
+        mId          = aId;
+        mSlot        = aSlot;
+        mState       = SESSION_LOGIN_USER;
+        mWriterType  = aWriterType;
+        mEcho        = (aWriterType == XMLWRITER_TYPE_ASCII);
+        mCommand     = false;
+        mDraining    = false;
+        mReceiving   = false;
+        mPollOut     = false;
+        mLastCR      = false;
+        mEscape      = 0;
+        mMagic       = 0;
+        mBinary      = false;
+        mFrame       = NULL;
+        mFrameLen    = 0;
+        mRequestId   = 0;
+        mFrameDropped = false;
+        mHistory     = new TEditBuffer(10);
+        mCmdLine     = mHistory->end();
+        mCurrentLine = cU("");
+        mLineRead    = 0;
+        mNrLines     = 0;
+        mOutput      = NULL;
+        mOutputLen   = 0;
+        mOutputSize  = 0;
+        mNrDropped   = 0;
+    }
+    // -----------------------------------------------------------------
+    // TSession::~TSession
+    //! Destructor
+    // -----------------------------------------------------------------
+    ~TSession() {
+        delete mHistory;
+        delete [] mOutput;
+        delete [] mFrame;
+    }
+    // -----------------------------------------------------------------
+    // TSession::print
+    //! \brief Output to the client
+    //!
+    //! Newlines are sent as carriage return and newline.
+    //! \param aBuffer The string for output
+    //! \param aCnt    The maximal number of characters to print. 
+    //!                For aCnt = 0 the method evaluates the string length.
+    // -----------------------------------------------------------------
+    void print(const SAP_UC *aBuffer, int aCnt = 0) {
+        SAP_A7  aChunk[258];
+        SAP_A7 *aFrame;
+        int     aLen = 0;
+        int     i;
+
+        if (aCnt == 0) {
+            aCnt = (int)STRLEN(aBuffer);
+        }
+        if (mBinary) {
+            for (aLen = 0; aLen < aCnt && aBuffer[aLen] != cU('\0'); aLen++) {
             }
-            else {
-                mFile.open(mProperties->getLogFile()->a7_str());
+            aFrame = newFrame(SESSION_FRAME_TEXT, aLen);
+            for (i = 0; i < aLen; i++) {
+                /*SAPUNICODEOK_CONVERSION*/ aFrame[SESSION_FRAME_HEAD + i] = (SAP_A7)aBuffer[i];
             }
-            mFile   << cU("=== Sherlok log file created by ") 
-                    << TSystem::getSystemTime() 
-                    << cU(" ===") 
-                    << endl;
+            sendFrame(aFrame, aLen);
+            return;
         }
-        else {
-            mFile.flush();
-            mFile.close();
+        for (i = 0; i < aCnt && aBuffer[i] != cU('\0'); i++) {
+            if (aLen >= 256) {
+                send(aChunk, aLen);
+                aLen = 0;
+            }
+            if (aBuffer[i] == cU('\n')) {
+                aChunk[aLen++] = cR('\015');
+                aChunk[aLen++] = cR('\012');
+            }
+            else {
+                /*SAPUNICODEOK_CONVERSION*/ aChunk[aLen++] = (SAP_A7)aBuffer[i];
+            }
         }
+        send(aChunk, aLen);
     }
-public:
-    // ----------------------------------------------------
-    // TLogger::getStatus
-    //! \brief Checks activation
-    //! \return \c TRUE if logging is active
-    // ----------------------------------------------------
-    bool getStatus() {
-        return mActive;
-    }
-    // ----------------------------------------------------
-    // TLogger::print
-    //! \brief Output to log file
-    //! \param aBuffer String output
-    // ----------------------------------------------------
-    void print(const SAP_UC *aBuffer) {        
-        if (mActive && mFile.rdbuf()->is_open()) {
-            mFile << aBuffer << ends;  
-            mFile.flush();
+    // -----------------------------------------------------------------
+    // TSession::getLine
+    //! \brief Remove the next complete input line
+    //! \param aLine The result
+    //! \return \c FALSE if there is no complete line
+    // -----------------------------------------------------------------
+    bool getLine(TString *aLine) {
+        if (mNrLines == 0) {
+            return false;
         }
+        finish();
+        mRequestId = mLineIds[mLineRead];
+        *aLine    = mLines[mLineRead].str();
+        mLineRead = (mLineRead + 1) % SESSION_LINES;
+        mNrLines--;
+        return true;
     }
-    // ----------------------------------------------------
-    // TLogger::print
-    //! \brief Output to log file and carriage return.
-    //! \param aBuffer String output
-    // ----------------------------------------------------
-    void printLn(const SAP_UC *aBuffer) {        
-        if (mActive && mFile.rdbuf()->is_open()) {
-            mFile << aBuffer << endl;
+    // -----------------------------------------------------------------
+    // TSession::finish
+    //! \brief Finish the request of the last input line
+    //!
+    //! Binary clients receive the end frame of the request, with
+    //! status 1 if a frame of the request was dropped.
+    // -----------------------------------------------------------------
+    void finish() {
+        if (mBinary && mRequestId != 0) {
+            endRequest(mRequestId, mFrameDropped ? 1 : 0);
         }
+        mRequestId    = 0;
+        mFrameDropped = false;
+    }
+    // -----------------------------------------------------------------
+    // TSession::printResult
+    //! \brief Send the result tags of the current request
+    //! \param aTag The root tag
+    // -----------------------------------------------------------------
+    void printResult(TXmlTag *aTag) {
+        jint    aLen   = measureTag(aTag);
+        SAP_A7 *aFrame = newFrame(SESSION_FRAME_RES, aLen);
+
+        encodeTag(aFrame + SESSION_FRAME_HEAD, aTag);
+        sendFrame(aFrame, aLen);
+    }
+    // -----------------------------------------------------------------
+    // TSession::getState
+    //! \return The login state
+    // -----------------------------------------------------------------
+    int getState() {
+        return mState;
+    }
+    // -----------------------------------------------------------------
+    // TSession::setState
+    //! \param aState The new login state
+    // -----------------------------------------------------------------
+    void setState(int aState) {
+        mState = aState;
+    }
+    // -----------------------------------------------------------------
+    // TSession::getWriterType
+    //! \return The output format of the client
+    // -----------------------------------------------------------------
+    int getWriterType() {
+        return mWriterType;
+    }
+    // -----------------------------------------------------------------
+    // TSession::setEcho
+    //! \param aEnable \c TRUE if the server echoes the input
+    // -----------------------------------------------------------------
+    void setEcho(bool aEnable) {
+        mEcho = aEnable;
+    }
+    // -----------------------------------------------------------------
+    // TSession::getUser
+    //! \return The login user
+    // -----------------------------------------------------------------
+    const SAP_UC *getUser() {
+        return mUser.str();
+    }
+    // -----------------------------------------------------------------
+    // TSession::setUser
+    //! \param aUser The login user
+    // -----------------------------------------------------------------
+    void setUser(const SAP_UC *aUser) {
+        mUser = aUser;
     }
 };
 
@@ -168,40 +1574,55 @@ public:
 //! \class TConsole
 //! \brief Output to console
 //!
+//! The console serves up to CONSOLE_SESSIONS telnet clients from
+//! one event loop. The telnet thread selects a session with a
+//! complete input line and executes the command on its behalf.
+//! While a command is executed all console output goes to this
+//! session, otherwise it is sent to all logged in sessions.
 // -----------------------------------------------------------------
 class TConsole {
+    friend class TMetricsServer;
+    friend class TSession;
 private:
     TProperties      *mProperties;  //!< Gloabal configuration
     static  TConsole *mInstance;    //!< Singleton instance
-    bool    mEcho;                  //!< Server echo
-    bool    mXmlStream;
-    bool    mLoggedIn;
-    bool    mPrintXmlHeader;
-    TString mBuffer;                
-    SAP_UC  mLine  [128];
-    SAP_A7  mContBuffer[256];
-    int     mContIndex;
-    int     mContLen;
-    TString mCtrl;                  //!< Cursor control
-    int     mErrState;
+    jvmtiEnv         *mJvmti;       //!< Tool interface
+    jrawMonitorID     mMonitor;     //!< Protects the session list
+    TSession         *mSessions[CONSOLE_SESSIONS];  //!< Connected clients
+    TSession * volatile mCurrent;   //!< Session of the executing command
+    volatile bool mJobActive;       //!< A scheduled job is executed
+    TSession * volatile mJob;       //!< Session bound to the executing job
+    jint    mJobSession;            //!< Session, which created the executing job
+    jint    mJobSlot;               //!< Slot of the session of the executing job
+    jint    mSession;               //!< Number of sessions accepted so far
+    int     mNext;                  //!< Round robin position of select
+    int     mPollFd;                //!< Event poll instance
+    TString mLine;                  //!< Last line of TConsole::getLine
     SOCKET  mSocket;                //!< Telnet socket
-    SOCKET  mSocketFd;              //!< Telnet socket handle
     TString gSplash;                //!< Splash screen
     // -----------------------------------------------------------------
     // TConsole::TConsole
     //! Constructor
     // -----------------------------------------------------------------
     TConsole() {
+        int i;
+
         mProperties = TProperties::getInstance();
-        mContIndex  = 0;
-        mContLen    = 0;
+        mJvmti      = NULL;
+        mMonitor    = NULL;
+        mCurrent    = NULL;
+        mJobActive  = false;
+        mJob        = NULL;
+        mJobSession = 0;
+        mJobSlot    = 0;
         mSocket     = 0;
-        mSocketFd   = 0;
-        mErrState   = 0;
-        mXmlStream  = false;
-        mLoggedIn   = false;
+        mSession    = 0;
+        mNext       = 0;
+        mPollFd     = -1;
         mTraceCallback  = NULL;
-        mPrintXmlHeader = true;
+        for (i = 0; i < CONSOLE_SESSIONS; i++) {
+            mSessions[i] = NULL;
+        }
         gSplash.concat(cU("\015\012\033[34;1m"));
         gSplash.concat(cU("  ***********************************************\015\012"));
         gSplash.concat(cU("  **********************************************\015\012"));
@@ -227,6 +1648,185 @@ private:
         }
 
     }
+    // -----------------------------------------------------------------
+    // TConsole::lock
+    //! \brief Enter the session list monitor
+    // -----------------------------------------------------------------
+    void lock() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorEnter(mMonitor);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TConsole::unlock
+    //! \brief Exit the session list monitor
+    // -----------------------------------------------------------------
+    void unlock() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorExit(mMonitor);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TConsole::waitDrained
+    //! \brief Release the session list monitor until a drain has finished
+    // -----------------------------------------------------------------
+    void waitDrained() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorWait(mMonitor, 100);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TConsole::notifyDrained
+    //! \brief Wake up the threads waiting for a drain
+    // -----------------------------------------------------------------
+    void notifyDrained() {
+        if (mMonitor != NULL) {
+            mJvmti->RawMonitorNotifyAll(mMonitor);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TConsole::getTarget
+    //! \return The session for the output of the executing command,
+    //!         \c NULL to send the output to all sessions
+    // -----------------------------------------------------------------
+    TSession *getTarget() {
+        return mJobActive ? mJob : mCurrent;
+    }
+    // -----------------------------------------------------------------
+    // TConsole::setNonBlocking
+    //! \brief Switch a socket to non-blocking I/O
+    //! \param aSocket The socket
+    //! \return \c TRUE on success
+    // -----------------------------------------------------------------
+    static bool setNonBlocking(SOCKET aSocket);
+    // -----------------------------------------------------------------
+    // TConsole::closeSocket
+    //! \brief Shutdown and release a socket
+    //! \param aSocket The socket
+    // -----------------------------------------------------------------
+    static void closeSocket(SOCKET aSocket);
+    // -----------------------------------------------------------------
+    // TConsole::wait
+    //! \brief Wait for socket events and dispatch them
+    //!
+    //! Uses epoll on Linux and select on other platforms.
+    //! \param aTimeout The maximal wait time in milliseconds
+    // -----------------------------------------------------------------
+    void wait(int aTimeout);
+    // -----------------------------------------------------------------
+    // TConsole::registerSocket
+    //! \brief Add or change the events of a socket in the poll set
+    //! \param aSocket  The socket
+    //! \param aSession The session or \c NULL for the listener
+    //! \param aMode    CONSOLE_POLL_ADD, CONSOLE_POLL_MOD or CONSOLE_POLL_DEL
+    // -----------------------------------------------------------------
+    void registerSocket(SOCKET aSocket, TSession *aSession, int aMode);
+    // -----------------------------------------------------------------
+    // TConsole::greet
+    //! \brief Send splash screen and login prompt to a new client
+    //! \param aSession The new session
+    // -----------------------------------------------------------------
+    void greet(TSession *aSession) {
+        TString aVersion(mProperties->getVersion(false));
+
+        if (aSession->mWriterType != XMLWRITER_TYPE_ASCII) {
+            return;
+        }
+        aSession->print(gSplash.str());
+        aSession->print(aVersion.str());
+        aSession->print(cU("\n\nlogin: "));
+    }
+    // -----------------------------------------------------------------
+    // TConsole::onAccept
+    //! \brief Accept all pending clients
+    // -----------------------------------------------------------------
+    void onAccept() {
+        SOCKET       aSocketFd;
+        SAPSOCKLEN_T aSize;
+        TSession    *aSession;
+        int          i;
+        /*CCQ_IPV6_SUPPORT_OK*/
+        struct sockaddr_in aClientAddr;
+
+        for (;;) {
+            aSize = sizeofR(struct sockaddr);
+            /*CCQ_IPV6_SUPPORT_OK*/
+            aSocketFd = accept(mSocket, reinterpret_cast<struct sockaddr *>(&aClientAddr), &aSize);
+            if (aSocketFd <= 0) {
+                if (!TSession::wouldBlock() && errno != EINTR) {
+                    ERROR_OUT(cU("accept"), errno);
+                }
+                return;
+            }
+            lock();
+            for (i = 0; i < CONSOLE_SESSIONS && mSessions[i] != NULL; i++) {
+            }
+            if (i == CONSOLE_SESSIONS || !setNonBlocking(aSocketFd)) {
+                unlock();
+                ERROR_OUT(cU("accept: too many sessions"), CONSOLE_SESSIONS);
+                closeSocket(aSocketFd);
+                continue;
+            }
+            aSession     = new TSession(aSocketFd, ++mSession, i, mProperties->getConsoleWriterType());
+            mSessions[i] = aSession;
+            registerSocket(aSocketFd, aSession, CONSOLE_POLL_ADD);
+            greet(aSession);
+            unlock();
+        }
+    }
+    // -----------------------------------------------------------------
+    // TConsole::onReadable
+    //! \brief Process the input of a session
+    //! \param aSession The session
+    // -----------------------------------------------------------------
+    void onReadable(TSession *aSession) {
+        lock();
+        aSession->receive();
+        unlock();
+    }
+    // -----------------------------------------------------------------
+    // TConsole::onWritable
+    //! \brief Send the queued output of a session
+    //! \param aSession The session
+    // -----------------------------------------------------------------
+    void onWritable(TSession *aSession) {
+        lock();
+        aSession->flush();
+        unlock();
+    }
+    // -----------------------------------------------------------------
+    // TConsole::update
+    //! \brief Remove closed sessions and register pending output
+    //!
+    //! The session of the executing command or job is removed after
+    //! the command has finished.
+    // -----------------------------------------------------------------
+    void update() {
+        TSession *aSession;
+        int       i;
+
+        lock();
+        for (i = 0; i < CONSOLE_SESSIONS; i++) {
+            aSession = mSessions[i];
+            if (aSession == NULL) {
+                continue;
+            }
+            if (aSession->mState == SESSION_CLOSED) {
+                if (aSession != mCurrent && aSession != mJob) {
+                    registerSocket(aSession->mSocketFd, aSession, CONSOLE_POLL_DEL);
+                    closeSocket(aSession->mSocketFd);
+                    mSessions[i] = NULL;
+                    delete aSession;
+                }
+                continue;
+            }
+            if (aSession->mPollOut != (aSession->mOutputLen > 0)) {
+                aSession->mPollOut = (aSession->mOutputLen > 0);
+                registerSocket(aSession->mSocketFd, aSession, CONSOLE_POLL_MOD);
+            }
+        }
+        unlock();
+    }
 public:
     TCtiCallback mTraceCallback;
     // -----------------------------------------------------------------
@@ -240,27 +1840,27 @@ public:
         return mInstance;
     }
     // -----------------------------------------------------------------
+    // TConsole::initialize
+    //! \brief Create the monitor for the session list
+    //! \param aJvmti The tool interface
+    // -----------------------------------------------------------------
+    void initialize(jvmtiEnv *aJvmti) {
+        mJvmti = aJvmti;
+        mJvmti->CreateRawMonitor(/*SAPUNICODEOK_CHARTYPE*/(char*)cR("_Console"), &mMonitor);
+    }
+    // -----------------------------------------------------------------
     // TConsole::checkState
     //! \brief Check connection to console
-    //! \return \c TRUE if connection established
+    //! \return \c TRUE if the current session is logged in
     // -----------------------------------------------------------------
     bool checkState() {
-        return (mErrState > 0 && mLoggedIn);
-    }
-    bool isConnected() {
-        return (mSocket != 0 && mSocketFd != 0);
+        TSession *aSession = mCurrent;
+        return (aSession != NULL && aSession->mState == SESSION_READY);
     }
     void setTraceCallback(TCtiCallback aTraceCallback) {
         mTraceCallback = aTraceCallback;
     }
     // -----------------------------------------------------------------
-    // TConsole::errorState
-        // Console is not ready for I/O
-    // -----------------------------------------------------------------
-    bool errorState() {
-        return (mSocket == 0 || mErrState <= 0 || mSocketFd == 0 || !mLoggedIn);
-    }
-    // -----------------------------------------------------------------
     // TConsole::opentPort
     //! \brief Establish socket administration to accept clients
     //! \return \c TRUE if socket listener established successfully
@@ -349,214 +1949,258 @@ public:
         }
         // start listener
         /*CCQ_IPV6_SUPPORT_OK*/
-        aResult = listen(mSocket, 2);
+        aResult = listen(mSocket, CONSOLE_SESSIONS);
         if (aResult != 0) {
             ERROR_OUT(cU("listen"), (int)aResult);
             return false;
         }
+        if (!setNonBlocking(mSocket)) {
+            ERROR_OUT(cU("non-blocking listener"), errno);
+            return false;
+        }
+        registerSocket(mSocket, NULL, CONSOLE_POLL_ADD);
         return true;
     }
     // -----------------------------------------------------------------
-    // TConsole::clrScreen
-    //! Clear command line
+    // TConsole::poll
+    //! \brief Serve all clients for a while
+    //!
+    //! Accepts new clients, processes input and sends queued output.
+    //! \param aTimeout The maximal wait time in milliseconds
     // -----------------------------------------------------------------
-    void clrScreen() {
-        if (!checkState()) {
-            return;
-        }
-        SAP_A7 aClrScreen[72];
-        memsetR(aClrScreen, cR(' '), 72);
-        aClrScreen[0]  = cR('\015');
-        aClrScreen[69] = cR('\015');
-        aClrScreen[70] = cR('>');
-        mErrState = (int)send(mSocketFd, aClrScreen, 72, 0);
-        if (mErrState <= 0) ERROR_OUT(cU("connection closed"), mErrState);
+    void poll(int aTimeout) {
+        wait(aTimeout);
+        update();
     }
     // -----------------------------------------------------------------
-    // TConsole::open
-    //! \brief Accept client
-    //! \return \c TRUE if client accepted
+    // TConsole::select
+    //! \brief Wait for a complete input line
+    //!
+    //! Sessions are served round robin. The selected session is
+    //! the current session until TConsole::release.
+    //! \return The session with input
     // -----------------------------------------------------------------
-    bool exitConnection() {
-        if (mSocketFd != 0) {
-           if (mXmlStream) {
-               // print(cU("</sherlok>\n"));
-               mXmlStream = false;
+    TSession *select() {
+        TSession *aSession;
+        int       i;
+
+        for (;;) {
+            lock();
+            for (i = 0; i < CONSOLE_SESSIONS; i++) {
+                aSession = mSessions[(mNext + i) % CONSOLE_SESSIONS];
+                if (aSession != NULL && 
+                    aSession->mNrLines > 0 && 
+                    aSession->mState != SESSION_CLOSED) {
+                    mNext    = (mNext + i + 1) % CONSOLE_SESSIONS;
+                    mCurrent = aSession;
+                    mCurrent->mCommand = true;
+                    unlock();
+                    return aSession;
+                }
             }
-            mErrState = 0;
-            CLOSESOCKET(mSocketFd);
-            mSocketFd  = 0;
+            unlock();
+            poll(100);
         }
-        mLoggedIn = false;
-        mErrState = 0;
-        return true;
     }
-
     // -----------------------------------------------------------------
-    // TConsole::open
-    //! \brief Accept client
-    //! \return \c TRUE if client accepted
+    // TConsole::release
+    //! \brief Finish the command of the current session
     // -----------------------------------------------------------------
-    bool open() {
-        exitConnection();
-        if (mSocket <= 0) {
-            mErrState = 0;
-            return false;
-        }
-        SAPSOCKLEN_T aSize = sizeofR(struct sockaddr);
-        /*CCQ_IPV6_SUPPORT_OK*/
-        struct sockaddr_in aClientAddr;
-
-        mErrState = 0;
-        for (int i = 0; i < 10; i++) {
-            /*CCQ_IPV6_SUPPORT_OK*/
-            mSocketFd = accept(mSocket, reinterpret_cast<struct sockaddr *>(&aClientAddr), &aSize);
-            if (mSocketFd <= 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
-            } 
-            break;
+    void release() {
+        lock();
+        if (mCurrent != NULL) {
+            mCurrent->finish();
+            mCurrent->mCommand = false;
         }
-
-        if (mSocketFd <= 0) {
-            ERROR_OUT(cU("accept"), errno);
-            return false;
-        }  
-        getVersion(false);
-        return true;
+        mCurrent = NULL;
+        unlock();
+        update();
     }
-
     // -----------------------------------------------------------------
-    // TConsole::login
-    //! \brief Send the intro
+    // TConsole::getLine
+    //! \brief Read a line of the current session
+    //!
+    //! Other clients are served while waiting.
+    //! \return The input line or "exit" if the client is disconnected
     // -----------------------------------------------------------------
-    void login() {
-        mErrState = 1; 
-        if (mProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML) {
-            mXmlStream = true;
+    const SAP_UC *getLine() {
+        for (;;) {
+            lock();
+            if (mCurrent == NULL || mCurrent->mState == SESSION_CLOSED) {
+                mLine = cU("exit");
+                unlock();
+                return mLine.str();
+            }
+            if (mCurrent->getLine(&mLine)) {
+                unlock();
+                return mLine.str();
+            }
+            unlock();
+            poll(100);
         }
-        mLoggedIn = true;
     }
     // -----------------------------------------------------------------
+    // TConsole::exitConnection
+    //! \brief Disconnect the current session
+    //! \return \c TRUE
     // -----------------------------------------------------------------
-    
+    bool exitConnection() {
+        lock();
+        if (mCurrent != NULL) {
+            mCurrent->flush();
+            mCurrent->mState = SESSION_CLOSED;
+        }
+        unlock();
+        return true;
+    }
     // -----------------------------------------------------------------
-    // TConsole::getVersion
-    //! Output of version string to console
+    // TConsole::login
+    //! \brief Finish the login of the current session
     // -----------------------------------------------------------------
-    void getVersion(bool aExtended = true) {
-        if (!isConnected()   || 
-            !doCmdlineEcho() || 
-             mProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML) {
+    void login() {
+        TSession *aSession = mCurrent;
+
+        if (aSession == NULL) {
             return;
         }
-
-        TString aVersion(mProperties->getVersion(aExtended));
-        mErrState = (int)send(mSocketFd, gSplash.a7_str(), gSplash.pcount(), 0);
-        if (mErrState <= 0) { ERROR_OUT(cU("connection closed"), mErrState); return; }
-    
-        mErrState = (int)send(mSocketFd, aVersion.a7_str(), aVersion.pcount(), 0);
-        if (mErrState <= 0) { ERROR_OUT(cU("connection closed"), mErrState); return; }
-        
-        mErrState = (int)send(mSocketFd, cR("\015\012\015\012"), 4, 0);
-        if (mErrState <= 0) { ERROR_OUT(cU("connection closed"), mErrState); return; }
-        
-        prompt();
+        aSession->mState = SESSION_READY;
+        aSession->mEcho  = (aSession->mWriterType == XMLWRITER_TYPE_ASCII);
+        if (aSession->mWriterType == XMLWRITER_TYPE_XML) {
+            aSession->print(cU("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n")
+                            cU("<sherlok>\n")
+                            cU("<Message Info=\"Connected\"/>\n"));
+        }
     }
     // -----------------------------------------------------------------
-    // TConsole::close
-    //! Close socket
+    // TConsole::getSession
+    //! \brief Identify the login session
+    //! \return Number of the current session, which changes with each client login
     // -----------------------------------------------------------------
-    void close() {
-        if (mXmlStream) {
-            mXmlStream = false;
-        }
-
-        if (mSocket   != 0) 
-            CLOSESOCKET(mSocket);
+    jint getSession() {
+        TSession *aSession = mCurrent;
 
-        if (mSocketFd != 0) 
-            CLOSESOCKET(mSocketFd);
-
-        mContBuffer[0] = 0;
-        mContLen       = 0;
-        mContIndex     = 0;
-        mSocket        = 0;
-        mSocketFd      = 0;
+        if (mJobActive) {
+            return mJobSession;
+        }
+        return (aSession != NULL) ? aSession->mId : 0;
     }
     // -----------------------------------------------------------------
-    // TConsole::read
-    //! \brief  Socket input
-    //! \return The character input without control sequences
+    // TConsole::getSessionSlot
+    //! \brief Index of the login session in the session table
+    //! \return Slot of the current session, which is reused after logout
     // -----------------------------------------------------------------
-    TString *read() {
-        mBuffer = cU("exit");
-
-        if (!isConnected()) {
-            return &mBuffer;
-        }
-        SAP_A7  aBuffer   [128];
-        SAP_UC  aBufferCmd[128];
-        SAP_UC  aBufferCtr[128];
-        int     i, j;
+    jint getSessionSlot() {
+        TSession *aSession = mCurrent;
 
-        memsetR(aBuffer,    0, 128);
-        memsetU(aBufferCmd, 0, 128);
-        memsetU(aBufferCtr, 0, 128);
-
-        if (mContIndex >= mContLen) {
-            mContIndex = 0;
-            mContLen   = (int)recv(mSocketFd, mContBuffer, 127, 0);
-        }
-
-        if (mContLen <= 0) { 
-            // ERROR_OUT(cU("connection closed"), mErrState); 
-            return &mBuffer;
+        if (mJobActive) {
+            return mJobSlot;
         }
-        
-        // extract input from control
-        i = 0;
-        j = 0;
-        for (i = 0; i < mContLen; i++) {
-            if (mContBuffer[i] > -1 && mContBuffer[i] < 255) {
-                /*SAPUNICODEOK_CONVERSION*/ mContBuffer[j++] = mContBuffer[i];
+        return (aSession != NULL) ? aSession->mSlot : 0;
+    }
+    // -----------------------------------------------------------------
+    // TConsole::attach
+    //! \brief Execute a scheduled job for the session, which created it
+    //!
+    //! Called by the scheduler thread, the telnet thread may select
+    //! another session in the meantime. The output of a bound job goes
+    //! only to its session, the output of other jobs to all sessions.
+    //! \param aSession The session, which created the job
+    //! \param aSlot    The slot of the session
+    //! \param aBound   \c TRUE if the job is bound to the session
+    //! \return \c FALSE if the session of a bound job is closed
+    // -----------------------------------------------------------------
+    bool attach(jint aSession, jint aSlot, bool aBound) {
+        TSession *aJob = NULL;
+        int       i;
+
+        lock();
+        for (i = 0; aBound && i < CONSOLE_SESSIONS; i++) {
+            if (mSessions[i] != NULL && 
+                mSessions[i]->mId    == aSession && 
+                mSessions[i]->mState == SESSION_READY) {
+                aJob = mSessions[i];
             }
         }
-        aBufferCmd[j] = 0;
-        mContLen      = j;
+        mJob        = aJob;
+        mJobSession = aSession;
+        mJobSlot    = aSlot;
+        mJobActive  = true;
+        unlock();
+        return !aBound || aJob != NULL;
+    }
+    // -----------------------------------------------------------------
+    // TConsole::detach
+    //! \brief Finish the execution of a scheduled job
+    // -----------------------------------------------------------------
+    void detach() {
+        lock();
+        mJobActive  = false;
+        mJob        = NULL;
+        unlock();
+    }
+    // -----------------------------------------------------------------
+    // TConsole::getUser
+    //! \return The login user of the current session
+    // -----------------------------------------------------------------
+    const SAP_UC *getUser() {
+        TSession *aSession = getTarget();
+        return (aSession != NULL) ? aSession->getUser() : cU("");
+    }
+    // -----------------------------------------------------------------
+    // TConsole::getWriterType
+    //! \return The output format of the current session or the 
+    //!         configured format if no command is executed
+    // -----------------------------------------------------------------
+    int getWriterType() {
+        TSession *aSession = getTarget();
+        return (aSession != NULL) ? aSession->mWriterType : mProperties->getConsoleWriterType();
+    }
+    // -----------------------------------------------------------------
+    // TConsole::setWriterType
+    //! \brief Change the output format of the current session
+    //!
+    //! Binary sessions keep their format.
+    //! \param aWriterType XMLWRITER_TYPE_ASCII or XMLWRITER_TYPE_XML
+    // -----------------------------------------------------------------
+    void setWriterType(int aWriterType) {
+        TSession *aSession = getTarget();
 
-        i = 0;
-        while (mContIndex < mContLen && isprint(mContBuffer[mContIndex])) {
-            /*SAPUNICODEOK_CONVERSION*/ aBufferCmd[i++] = mContBuffer[mContIndex++];
+        if (aSession != NULL && !aSession->mBinary) {
+            aSession->mWriterType = aWriterType;
+            aSession->mEcho       = (aWriterType == XMLWRITER_TYPE_ASCII);
         }
-        aBufferCmd[i] = 0;
+    }
+    // -----------------------------------------------------------------
+    // TConsole::printResult
+    //! \brief Send result tags to the current session
+    //! \param aTag The root tag
+    //! \return \c FALSE if the current session does not use binary frames
+    // -----------------------------------------------------------------
+    bool printResult(TXmlTag *aTag) {
+        TSession *aSession;
+        bool      aResult = false;
 
-        i = 0;
-        while ((mContIndex < mContLen) && !isprint(mContBuffer[mContIndex])) {
-            if (mContBuffer[mContIndex] == 27) {
-                /*SAPUNICODEOK_CONVERSION*/ aBufferCtr[i++] = mContBuffer[mContIndex++];
-                /*SAPUNICODEOK_CONVERSION*/ aBufferCtr[i++] = mContBuffer[mContIndex++];
-                /*SAPUNICODEOK_CONVERSION*/ aBufferCtr[i++] = mContBuffer[mContIndex++];    
-            }
-            else {
-                /*SAPUNICODEOK_CONVERSION*/ aBufferCtr[i++] = mContBuffer[mContIndex++];
-            }
+        lock();
+        aSession = getTarget();
+        if (aSession != NULL && aSession->mBinary) {
+            aSession->printResult(aTag);
+            aResult = true;
         }
-        aBufferCtr[i] = 0;
-
-        mBuffer = aBufferCmd;
-        mCtrl   = aBufferCtr;
-
-        return &mBuffer;
+        unlock();
+        return aResult;
     }
     // -----------------------------------------------------------------
-    // TConsole::getCtrl
-    //! \brief  Socket input
-    //! \return The control sequence of the last input
+    // TConsole::getVersion
+    //! Output of version string to console
     // -----------------------------------------------------------------
-    TString *getCtrl() {
-        return &mCtrl;
+    void getVersion(bool aExtended = true) {
+        if (!doCmdlineEcho()) {
+            return;
+        }
+        TString aVersion(mProperties->getVersion(aExtended));
+        print(gSplash.str());
+        print(aVersion.str());
+        print(cU("\n\n"));
     }
     // -----------------------------------------------------------------
     // TConsole::print
@@ -564,62 +2208,36 @@ public:
     //! \param aBuffer The string for output
     //! \param aCnt    The maximal number of characters to print. 
     //!                For aCnt = 0 the method evaluates the string length.
+    //! \param aForce  Output to the current session before login
     // -----------------------------------------------------------------
     void print(const SAP_UC *aBuffer, int aCnt = 0, bool aForce = false) {
-        const SAP_UC *aPtrBeg;
-        const SAP_UC *aPtrEnd;
-        int   aLen = 0;
-        bool  aOutput = !errorState();
+        TSession *aSession;
+        bool      aOutput = false;
+        int       i;
 
         if (aBuffer == NULL) {
             return;
         }
-        if (aForce && isConnected()) {
-            aOutput = true;
-        }
-        
-        if (mPrintXmlHeader && mProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML) {
-            mPrintXmlHeader = false;
-            print(  cU("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n")
-                    cU("<sherlok>\n")
-                    cU("<Message Info=\"Connected\"/>\n"), 0, true);
-        }
-
-        if (aOutput) {
-            if (aCnt == 0) {
-                /*SAPUNICODEOK_SIZEOF*/
-                aCnt = (int)STRLEN(aBuffer);
+        lock();
+        aSession = getTarget();
+        if (aSession != NULL) {
+            if (aSession->mState == SESSION_READY || aForce) {
+                aSession->print(aBuffer, aCnt);
+                aOutput = true;
             }
-
-            if (aCnt > 0) {
-                aPtrBeg = aBuffer;
-                aPtrEnd = aPtrBeg;
-
-                while (mErrState > 0) {
-                    if (*aPtrEnd == cU('\0')) {
-                        // mErrState = (int)send(mSocketFd, (const char *)cR("\0"), 1, 0);
-                        break;
-                    }
-                    else if (*aPtrEnd == cU('\n')) {
-                        mErrState = (int)send(mSocketFd, /*SAPUNICODEOK_CHARTYPE*/(const char *)cR("\015\012"), 2, 0);
-                        // mErrState = (int)send(mSocketFd, (const char *)cR("\n"), 1, 0);
-                        aPtrEnd ++;
-                    }                    
-                    else {
-                        TString aStr(aPtrEnd);
-                        int aPos  = (int)aStr.findFirstOf(cU('\n'));
-                    
-                        if (aPos < 0) {
-                            aPos  = aStr.pcount();
-                        }
-                        mErrState = (int)send(mSocketFd, /*SAPUNICODEOK_CHARTYPE*/(const char *)aStr.a7_str(), aPos, 0);
-                        aPtrEnd  += (int)aPos;
-                        aLen     += (int)aPos;
-                    }
+        }
+        else {
+            for (i = 0; i < CONSOLE_SESSIONS; i++) {
+                aSession = mSessions[i];
+                if (aSession != NULL && aSession->mState == SESSION_READY) {
+                    aSession->print(aBuffer, aCnt);
+                    aOutput = true;
                 }
             }
         }
-        else {
+        unlock();
+
+        if (!aOutput) {
             SAP_cerr << aBuffer << ends;
             SAP_cerr.flush();
         } 
@@ -657,7 +2275,11 @@ public:
     //! \param aEnable \c TRUE if server does echo.
     // -----------------------------------------------------------------
     void setEcho(bool aEnable) {
-        mEcho = aEnable;
+        TSession *aSession = mCurrent;
+
+        if (aSession != NULL) {
+            aSession->setEcho(aEnable);
+        }
     }
     // -----------------------------------------------------------------
     // TConsole::doCmdlineEcho
@@ -667,107 +2289,68 @@ public:
     //! \return \c TRUE if console echo is possible
     // -----------------------------------------------------------------
     bool doCmdlineEcho() {
-        return (mProperties->getConsoleWriterType() == XMLWRITER_TYPE_ASCII);
-    }
-    // -----------------------------------------------------------------
-    // TConsole::moveCursor
-    //! \brief Moves the cursor within in a command line
-    //!
-    //! For positive values aCnt the cursor moves right, for negatives left.
-    //! If aBsp is \c TRUE the characters are removed.
-    //! \param aCmdLine The current command line
-    //! \param aCnt Number of characters to move
-    //! \param aBsp \c TRUE if characters before cursor should be removed.
-    // -----------------------------------------------------------------
-    void moveCursor(TString *aCmdLine, int aCnt, bool aBsp = true) {
-        if (!checkState()) {
-            return;
-        }
-
-        if (aCnt == 0 || aCmdLine->strInsert() == NULL) {
-            return;
-        }
-        int aInsPos = aCmdLine->getInsertPos();;
-        int aLenStr = aCmdLine->pcount();
-        int aLenIns;
-        if (aCnt < 0 && aInsPos > 0) {
-            aCmdLine->moveCursor(aCnt);
-            if (aBsp) {
-                print(cU("\010"));
-            }
-            print(aCmdLine->strInsert());
-            print(cU(" "));
-            aLenIns = STRLEN(aCmdLine->strInsert());
-            for (int i = 0; i < aLenIns + 1; i++) {
-                print(cU("\010"));
-            }
-            return;
-        }
-
-        if (aCnt > 0 && aInsPos < aLenStr) {
-            print(aCmdLine->strInsert());
-            aCmdLine->moveCursor(aCnt);
-            aLenIns = STRLEN(aCmdLine->strInsert());
-            for (int i = 0; i < aLenIns; i++) {
-                print(cU("\010"));
-            }
-            return;
-        }        
-    }
-    // -----------------------------------------------------------------
-    // TConsole::echoInsert
-    //! \brief Insert a string and echo the result.
-    //! \param aLine The string to insert.
-    // -----------------------------------------------------------------
-    void echoInsert(TString *aLine) {
-        if (!checkState()|| aLine->strInsert() == NULL) {
-            return;
-        }
-        if (mBuffer.pcount() > 0) {
-            if (mEcho) {
-                print(mBuffer.str());
-            }
-            int aLenIns = STRLEN(aLine->strInsert());
-            if (aLenIns > 0) {
-                print(aLine->strInsert());
-                for (int i = 0; i < aLenIns; i++) {
-                    print(cU("\010"));
-                }
-            }
-        }
+        return (getWriterType() == XMLWRITER_TYPE_ASCII);
     }
     // -----------------------------------------------------------------
     // TConsole::prompt
     //! Print the prompt
     // -----------------------------------------------------------------
     void prompt() {
-        if (!checkState()) {
-            return;
-        }
-        if (mProperties->getConsoleWriterType() != XMLWRITER_TYPE_XML) {
+        TSession *aSession;
+
+        // the telnet thread prompts, while the scheduler may execute a job
+        lock();
+        aSession = mCurrent;
+        if (aSession != NULL && aSession->mState == SESSION_READY &&
+            aSession->mWriterType != XMLWRITER_TYPE_XML &&
+            aSession->mWriterType != XMLWRITER_TYPE_BINARY) {
             //--print(cU("\033[1;20;r\033[21;1;H>"));
-            print(cU("> "));
-        }
-    }
-    // -----------------------------------------------------------------
-    // TConsole::getStatus
-    //! \brief Checks the console
-    //! \return \c TRUE if the socket is open 
-    // -----------------------------------------------------------------
-    bool getStatus() {
-        return mSocketFd > 0;
-    }
-    // -----------------------------------------------------------------
-    // TConsole::backspace
-    //! \brief Remove the character left of the cursor.
-    //! \param aLine The current command line string to execute the operation
-    // -----------------------------------------------------------------
-    void backspace(TString *aLine) {
-        if (!checkState()) {
-            return;
+            aSession->print(cU("> "));
+        }
+        unlock();
+    }
+    // -----------------------------------------------------------------
+    // TConsole::dump
+    //! \brief Dump the connected sessions
+    //! \param aRootTag The output tag list
+    // -----------------------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC    aBuffer[32];
+        TXmlTag  *aTag;
+        TSession *aSession;
+        jint      aNrSessions = 0;
+        jint      aNrBinary   = 0;
+        jlong     aNrPending  = 0;
+        jlong     aNrDropped  = 0;
+        int       i;
+
+        lock();
+        for (i = 0; i < CONSOLE_SESSIONS; i++) {
+            aSession = mSessions[i];
+            if (aSession != NULL) {
+                aNrSessions++;
+                aNrBinary  += aSession->mBinary ? 1 : 0;
+                aNrPending += aSession->mOutputLen;
+                aNrDropped += aSession->mNrDropped;
+            }
         }
-        aLine->backspace();
-        moveCursor(aLine, -1, mEcho);
+        unlock();
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ConsoleSessions"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrSessions, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ConsoleBinary"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrBinary, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ConsolePending"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrPending, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ConsoleDropped"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrDropped, aBuffer), PROPERTY_TYPE_INT);
     }
 };
 
@@ -832,6 +2415,550 @@ public:
     }
 };
 
+// ----------------------------------------------------------------
+//! \class TOutputQueue
+//! \brief Queue between the traced threads and the output writer
+//!
+//! Any thread may append lines, only the writer thread removes
+//! them, so the list is kept lock free with an atomic swap of the
+//! head. Socket and file operations are executed by the writer
+//! thread, a slow client or disk no longer blocks the callers.
+//! If the queue is full the configured policy drops the newest
+//! line, which is the default, drops the oldest line or blocks
+//! the caller. Each line keeps the open of its file, a line for a
+//! file which was closed or opened again is dropped. A file object
+//! must be synchronized with sync before it is deleted.
+// ----------------------------------------------------------------
+class TOutputQueue {
+private:
+    // ------------------------------------------------
+    //! \struct TOutputEntry
+    //! \brief One line of output
+    // ------------------------------------------------
+    struct TOutputEntry {
+        SAP_UC                 *mText;  //!< The output text
+        TMappedFile            *mFile;  //!< The output file or NULL for console
+        jint                    mGeneration; //!< The open of the output file
+        TOutputEntry * volatile mNext;  //!< Next entry
+    };
+    static TOutputQueue    *mInstance;      //!< Singleton instance
+    jvmtiEnv               *mJvmti;         //!< Tool interface
+    jrawMonitorID           mMonitor;       //!< Wakeup of writer and blocked callers
+    TProperties            *mProperties;    //!< Global configuration
+    TOutputEntry           *volatile mHead; //!< Last entry, appended by callers
+    TOutputEntry           *mTail;          //!< First entry, removed by the writer
+    TOutputEntry            mStub;          //!< Empty entry to separate head and tail
+    volatile bool           mActive;        //!< Writer thread is running
+    volatile jint           mCount;         //!< Number of pending entries
+    volatile jint           mDropOldest;    //!< Entries to drop by the writer
+    volatile jint           mWaiting;       //!< Callers blocked on overflow
+    volatile jint           mDroppedNewest; //!< Entries dropped by callers
+    volatile jint           mNrBlocked;     //!< Number of blocked calls
+    jlong                   mDroppedOldest; //!< Entries dropped by the writer
+    jlong                   mDroppedClosed; //!< Entries for a closed file
+    jlong                   mNrWritten;     //!< Number of entries written
+
+    // ------------------------------------------------
+    // TOutputQueue::TOutputQueue
+    //! Constructor
+    // ------------------------------------------------
+    TOutputQueue() {
+        mJvmti          = NULL;
+        mMonitor        = NULL;
+        mProperties     = TProperties::getInstance();
+        mStub.mText     = NULL;
+        mStub.mFile     = NULL;
+        mStub.mGeneration = 0;
+        mStub.mNext     = NULL;
+        mHead           = &mStub;
+        mTail           = &mStub;
+        mActive         = false;
+        mCount          = 0;
+        mDropOldest     = 0;
+        mWaiting        = 0;
+        mDroppedNewest  = 0;
+        mNrBlocked      = 0;
+        mDroppedOldest  = 0;
+        mDroppedClosed  = 0;
+        mNrWritten      = 0;
+    }
+    // ------------------------------------------------
+    // TOutputQueue::push
+    //! \brief Append an entry at the head
+    //! \param aEntry The new entry
+    // ------------------------------------------------
+    void push(TOutputEntry *aEntry) {
+        TOutputEntry *aPrev;
+
+        aEntry->mNext = NULL;
+        MEMORY_BARRIER();
+        aPrev = (TOutputEntry *)ATOMIC_SWAP(&mHead, aEntry);
+        aPrev->mNext  = aEntry;
+    }
+    // ------------------------------------------------
+    // TOutputQueue::pop
+    //! \brief Remove the entry at the tail
+    //!
+    //! Called only by the writer thread.
+    //! \return The oldest entry or \c NULL if the queue is
+    //!         empty or a caller has not finished the append
+    // ------------------------------------------------
+    TOutputEntry *pop() {
+        TOutputEntry *aTail = mTail;
+        TOutputEntry *aNext = aTail->mNext;
+
+        if (aTail == &mStub) {
+            if (aNext == NULL) {
+                return NULL;
+            }
+            mTail = aNext;
+            aTail = aNext;
+            aNext = aNext->mNext;
+        }
+        if (aNext != NULL) {
+            mTail = aNext;
+            return aTail;
+        }
+        if (aTail != mHead) {
+            return NULL;
+        }
+        push(&mStub);
+        aNext = aTail->mNext;
+        if (aNext != NULL) {
+            mTail = aNext;
+            return aTail;
+        }
+        return NULL;
+    }
+    // ------------------------------------------------
+    // TOutputQueue::notify
+    //! \brief Wake up all threads waiting on the queue
+    // ------------------------------------------------
+    void notify() {
+        mJvmti->RawMonitorEnter(mMonitor);
+        mJvmti->RawMonitorNotifyAll(mMonitor);
+        mJvmti->RawMonitorExit(mMonitor);
+    }
+public:
+    // ------------------------------------------------
+    // TOutputQueue::getInstance
+    //! Singleton constructor
+    // ------------------------------------------------
+    static TOutputQueue *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new TOutputQueue();
+        }
+        return mInstance;
+    }
+    // ------------------------------------------------
+    // TOutputQueue::initialize
+    //! \brief Create the monitor
+    //! \param aJvmti The tool interface
+    // ------------------------------------------------
+    void initialize(jvmtiEnv *aJvmti) {
+        mJvmti = aJvmti;
+        mJvmti->CreateRawMonitor(/*SAPUNICODEOK_CHARTYPE*/(char*)cR("_MonitorQueue"), &mMonitor);
+    }
+    // ------------------------------------------------
+    // TOutputQueue::write
+    //! \brief Direct output of one line
+    //! \param aText  The output text
+    //! \param aFile  The output file or \c NULL for console and log
+    // ------------------------------------------------
+    static void write(const SAP_UC *aText, TMappedFile *aFile) {
+        if (TConsole::getInstance()->mTraceCallback != NULL) {
+            TString aTrace(aText);
+            TConsole::getInstance()->mTraceCallback( aTrace.a7_str() );
+        }
+
+        if (aFile != NULL && aFile->isOpen()) {
+            aFile->write(aText);
+        }
+        else {
+            TWriter::getInstance()->print(aText);
+        }
+    }
+    // ------------------------------------------------
+    // TOutputQueue::write
+    //! \brief Output of a queued line to its file
+    //! \param aText       The output text
+    //! \param aFile       The output file
+    //! \param aGeneration The open of the file when the line was queued
+    //! \return \c FALSE if the file was closed or opened again
+    // ------------------------------------------------
+    static bool write(const SAP_UC *aText, TMappedFile *aFile, jint aGeneration) {
+        if (TConsole::getInstance()->mTraceCallback != NULL) {
+            TString aTrace(aText);
+            TConsole::getInstance()->mTraceCallback( aTrace.a7_str() );
+        }
+        return aFile->write(aText, aGeneration);
+    }
+    // ------------------------------------------------
+    // TOutputQueue::put
+    //! \brief Pass one line to the writer thread
+    //! \param aText The output text
+    //! \param aFile The output file or \c NULL for console and log
+    //! \return \c FALSE if the caller has to write the text
+    // ------------------------------------------------
+    bool put(const SAP_UC *aText, TMappedFile *aFile) {
+        TOutputEntry *aEntry;
+        jint          aCount;
+        jint          aLen;
+        int           aPolicy = mProperties->getOutputQueue();
+
+        if (!mActive || aPolicy == OUTPUT_QUEUE_OFF) {
+            return false;
+        }
+
+        if (aPolicy == OUTPUT_QUEUE_BLOCK && mCount >= mProperties->getOutputQueueSize()) {
+            ATOMIC_ADD(&mNrBlocked, 1);
+            ATOMIC_ADD(&mWaiting,   1);
+            mJvmti->RawMonitorEnter(mMonitor);
+            while (mActive && mCount >= mProperties->getOutputQueueSize()) {
+                mJvmti->RawMonitorWait(mMonitor, 100);
+            }
+            mJvmti->RawMonitorExit(mMonitor);
+            ATOMIC_ADD(&mWaiting,  -1);
+        }
+
+        aCount = ATOMIC_ADD(&mCount, 1);
+        if (aCount >= mProperties->getOutputQueueSize()) {
+            if (aPolicy == OUTPUT_QUEUE_DROP_NEWEST) {
+                ATOMIC_ADD(&mCount, -1);
+                ATOMIC_ADD(&mDroppedNewest, 1);
+                return true;
+            }
+            if (aPolicy == OUTPUT_QUEUE_DROP_OLDEST) {
+                ATOMIC_ADD(&mDropOldest, 1);
+            }
+        }
+
+        aLen           = STRLEN(aText);
+        aEntry         = new TOutputEntry;
+        aEntry->mText  = new SAP_UC[aLen + 1];
+        aEntry->mFile  = (aFile != NULL && aFile->isOpen()) ? aFile : NULL;
+        aEntry->mGeneration = (aEntry->mFile != NULL) ? aFile->getGeneration() : 0;
+        STRCPY(aEntry->mText, aText, aLen + 1);
+        push(aEntry);
+
+        if (aCount == 0) {
+            notify();
+        }
+        return true;
+    }
+    // ------------------------------------------------
+    // TOutputQueue::sync
+    //! \brief Wait until all pending lines are written
+    //!
+    //! Used before a file is closed and before the
+    //! console prompt, to keep the order of the output.
+    // ------------------------------------------------
+    void sync() {
+        if (!mActive) {
+            return;
+        }
+        ATOMIC_ADD(&mWaiting, 1);
+        mJvmti->RawMonitorEnter(mMonitor);
+        while (mActive && mCount > 0) {
+            mJvmti->RawMonitorWait(mMonitor, 100);
+        }
+        mJvmti->RawMonitorExit(mMonitor);
+        ATOMIC_ADD(&mWaiting, -1);
+    }
+    // ------------------------------------------------
+    // TOutputQueue::run
+    //! \brief Writer thread
+    //!
+    //! Drains the queue and waits for new entries.
+    // ------------------------------------------------
+    void run() {
+        TOutputEntry *aEntry;
+
+        mActive = true;
+        for (;;) {
+            while ((aEntry = pop()) != NULL) {
+                if (mDropOldest > 0) {
+                    ATOMIC_ADD(&mDropOldest, -1);
+                    mDroppedOldest++;
+                }
+                else if (aEntry->mFile == NULL) {
+                    write(aEntry->mText, NULL);
+                    mNrWritten++;
+                }
+                else if (write(aEntry->mText, aEntry->mFile, aEntry->mGeneration)) {
+                    mNrWritten++;
+                }
+                else {
+                    mDroppedClosed++;
+                }
+                delete [] aEntry->mText;
+                delete aEntry;
+                ATOMIC_ADD(&mCount, -1);
+            }
+
+            mJvmti->RawMonitorEnter(mMonitor);
+            if (mWaiting > 0) {
+                mJvmti->RawMonitorNotifyAll(mMonitor);
+            }
+            if (mCount == 0) {
+                mJvmti->RawMonitorWait(mMonitor, 100);
+            }
+            else {
+                mJvmti->RawMonitorWait(mMonitor, 1);
+            }
+            mJvmti->RawMonitorExit(mMonitor);
+        }
+    }
+    // ------------------------------------------------
+    // TOutputQueue::dump
+    //! \brief Dump queue state
+    //! \param aRootTag The output tag list
+    // ------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[32];
+        TXmlTag *aTag;
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputPending"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mCount, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputWritten"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrWritten, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputBlocked"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrBlocked, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputDroppedNewest"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mDroppedNewest, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputDroppedOldest"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mDroppedOldest, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("OutputDroppedClosed"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mDroppedClosed, aBuffer), PROPERTY_TYPE_INT);
+    }
+};
+// ----------------------------------------------------------------
+//! \class TMetricsServer
+//! \brief Serves the monitor counters in the Prometheus text format
+//!
+//! The scheduler thread renders the counters every MetricsInterval
+//! seconds and publishes the text as snapshot. The server thread
+//! answers each HTTP request with the last snapshot, so a scrape
+//! holds only the snapshot lock and never a lock of the profiler
+//! callbacks.
+// ----------------------------------------------------------------
+#define METRICS_REQUEST_SIZE    1024    //!< Maximal size of a request header
+#define METRICS_TIMEOUT         2000    //!< Socket timeout in ms for slow clients
+
+class TMetricsServer {
+private:
+    static TMetricsServer  *mInstance;      //!< Singleton instance
+    jvmtiEnv               *mJvmti;         //!< Tool interface
+    jrawMonitorID           mMonitor;       //!< Guards the snapshot
+    TProperties            *mProperties;    //!< Global configuration
+    SOCKET                  mSocket;        //!< Listener socket
+    TString                 mSnapshot;      //!< Last published metrics
+    jlong                   mNextUpdate;    //!< Time of the next snapshot
+    jlong                   mNrScrapes;     //!< Number of served requests
+
+    // ------------------------------------------------
+    // TMetricsServer::TMetricsServer
+    //! Constructor
+    // ------------------------------------------------
+    TMetricsServer() {
+        mJvmti          = NULL;
+        mMonitor        = NULL;
+        mProperties     = TProperties::getInstance();
+        mSocket         = 0;
+        mNextUpdate     = 0;
+        mNrScrapes      = 0;
+    }
+    // ------------------------------------------------
+    // TMetricsServer::sendAll
+    //! \brief Send a buffer on a blocking socket
+    //! \param aSocket The client socket
+    //! \param aData   The data
+    //! \param aLen    The number of bytes
+    //! \return \c TRUE if all bytes are sent
+    // ------------------------------------------------
+    static bool sendAll(SOCKET aSocket, const SAP_A7 *aData, jint aLen) {
+        jint aResult;
+
+        while (aLen > 0) {
+            aResult = (jint)::send(aSocket, aData, aLen, 0);
+            if (aResult <= 0) {
+                return false;
+            }
+            aData += aResult;
+            aLen  -= aResult;
+        }
+        return true;
+    }
+    // ------------------------------------------------
+    // TMetricsServer::serve
+    //! \brief Answer one request
+    //!
+    //! Reads the request header and returns the snapshot for
+    //! the paths / and /metrics.
+    //! \param aSocket The client socket
+    // ------------------------------------------------
+    void serve(SOCKET aSocket) {
+        /*SAPUNICODEOK_CHARTYPE*/
+        char     aRequest[METRICS_REQUEST_SIZE];
+        /*SAPUNICODEOK_CHARTYPE*/
+        char     aHeader[256];
+        TString  aText;
+        jint     aLen    = 0;
+        jint     aResult;
+        bool     aFound  = false;
+
+#if defined (_WINDOWS)
+        DWORD aTimeout = METRICS_TIMEOUT;
+#else
+        struct timeval aTimeout;
+        aTimeout.tv_sec  = METRICS_TIMEOUT / 1000;
+        aTimeout.tv_usec = 0;
+#endif
+        setsockopt(aSocket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&aTimeout, sizeofR(aTimeout));
+        setsockopt(aSocket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&aTimeout, sizeofR(aTimeout));
+
+        // read the header, the request has no body
+        while (aLen < METRICS_REQUEST_SIZE - 1) {
+            aResult = (jint)recv(aSocket, aRequest + aLen, METRICS_REQUEST_SIZE - 1 - aLen, 0);
+            if (aResult <= 0) {
+                break;
+            }
+            aLen += aResult;
+            aRequest[aLen] = 0;
+            if (strstr(aRequest, cR("\r\n\r\n")) != NULL ||
+                strstr(aRequest, cR("\n\n"))     != NULL) {
+                break;
+            }
+        }
+        aRequest[aLen] = 0;
+
+        if (!strncmpR(aRequest, cR("GET / "), 6) ||
+            !strncmpR(aRequest, cR("GET /metrics "), 13) ||
+            !strncmpR(aRequest, cR("GET /metrics?"), 13)) {
+            aFound = true;
+        }
+
+        if (!aFound) {
+            /*SAPUNICODEOK_CHARTYPE*/
+            const char *aNotFound = cR("HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            sendAll(aSocket, aNotFound, STRLEN_A7(aNotFound));
+            return;
+        }
+
+        mJvmti->RawMonitorEnter(mMonitor);
+        aText = mSnapshot.str();
+        mNrScrapes++;
+        mJvmti->RawMonitorExit(mMonitor);
+
+        const SAP_A7 *aBody = aText.a7_str();
+        aLen = STRLEN_A7(aBody);
+
+        /*SAPUNICODEOK_CHARTYPE*//*SAPUNICODEOK_LIBFCT*/
+        sprintf(aHeader, cR("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n"), aLen);
+        if (sendAll(aSocket, aHeader, STRLEN_A7(aHeader))) {
+            sendAll(aSocket, aBody, aLen);
+        }
+    }
+public:
+    // ------------------------------------------------
+    // TMetricsServer::getInstance
+    //! Singleton constructor
+    // ------------------------------------------------
+    static TMetricsServer *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new TMetricsServer();
+        }
+        return mInstance;
+    }
+    // ------------------------------------------------
+    // TMetricsServer::initialize
+    //! \brief Create the monitor
+    //! \param aJvmti The tool interface
+    // ------------------------------------------------
+    void initialize(jvmtiEnv *aJvmti) {
+        mJvmti = aJvmti;
+        mJvmti->CreateRawMonitor(/*SAPUNICODEOK_CHARTYPE*/(char*)cR("_Metrics"), &mMonitor);
+    }
+    // ------------------------------------------------
+    // TMetricsServer::doUpdate
+    //! \brief Check if the next snapshot is due
+    //! \param aNow The current time in ms
+    //! \return \c TRUE if the caller has to publish a snapshot
+    // ------------------------------------------------
+    bool doUpdate(jlong aNow) {
+        if (mSocket <= 0 || aNow < mNextUpdate) {
+            return false;
+        }
+        mNextUpdate = aNow + (jlong)mProperties->getMetricsInterval() * 1000;
+        return true;
+    }
+    // ------------------------------------------------
+    // TMetricsServer::publish
+    //! \brief Replace the snapshot
+    //! \param aText The metrics in text format
+    // ------------------------------------------------
+    void publish(TString *aText) {
+        mJvmti->RawMonitorEnter(mMonitor);
+        mSnapshot = aText->str();
+        mJvmti->RawMonitorExit(mMonitor);
+    }
+    // ------------------------------------------------
+    // TMetricsServer::run
+    //! \brief Server thread
+    //!
+    //! Serves one client at a time. Returns immediately if the 
+    //! property MetricsPort is not set.
+    // ------------------------------------------------
+    void run() {
+        TSystem aSystem;
+        SOCKET  aSocket;
+        SOCKET  aClient;
+
+        if (mProperties->getMetricsPort() == 0) {
+            return;
+        }
+        aSystem.startup();
+        if (!aSystem.openSocket(&aSocket, mProperties->getMetricsPort(), mProperties->getMetricsHost())) {
+            ERROR_OUT(cU("open metrics port"), mProperties->getMetricsPort());
+            return;
+        }
+        mSocket = aSocket;
+
+        for (;;) {
+            if (aSystem.acceptClient(mSocket, &aClient)) {
+                serve(aClient);
+                TConsole::closeSocket(aClient);
+            }
+        }
+    }
+    // ------------------------------------------------
+    // TMetricsServer::dump
+    //! \brief Dump server state
+    //! \param aRootTag The output tag list
+    // ------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[32];
+        TXmlTag *aTag;
+
+        if (mSocket <= 0) {
+            return;
+        }
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("MetricsScrapes"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrScrapes, aBuffer), PROPERTY_TYPE_INT);
+    }
+};
 // ----------------------------------------------------------------
 //! \class TXmlWriter
 //! \brief Formatted output
@@ -840,7 +2967,7 @@ public:
 class TXmlWriter {
 private:
     SAP_stringstream mStream;   //!< Output string  
-    SAP_ofstream *mFile;        //!< Output file
+    TMappedFile  *mFile;        //!< Output file
     bool          mBuffered;    //!< Store more than one line in mStream
     int           mLine;        //!< Line numbering
     bool          mDoHeader;    //!< Output of table header
@@ -880,18 +3007,8 @@ private:
     void flushBuffer() {
         mStream << ends;
 
-        if (TConsole::getInstance()->mTraceCallback != NULL) {
-            TString aTrace(mStream.str().c_str());
-            TConsole::getInstance()->mTraceCallback( aTrace.a7_str() );
-        }
-
-        if (mFile != NULL &&
-            mFile->rdbuf()->is_open()) {
-           *mFile << mStream.str();
-            mFile->flush();
-        }
-        else {
-            TWriter::getInstance()->print(mStream.str().c_str());
+        if (!TOutputQueue::getInstance()->put(mStream.str().c_str(), mFile)) {
+            TOutputQueue::write(mStream.str().c_str(), mFile);
         }
         mStream.str(cU(""));
     }
@@ -967,7 +3084,9 @@ public:
     TXmlWriter(
             int  aOutputType    = XMLWRITER_TYPE_ASCII, 
             bool aBuffered      = false,
-            SAP_ofstream *aFile = NULL) {
+            TMappedFile  *aFile = NULL) {
+
+        int aConsoleType;
 
         mProperties = TProperties::getInstance();
         mConsole    = TConsole::getInstance();
@@ -984,7 +3103,8 @@ public:
         mFile       = aFile;
         mPrefix     = cU("");
 
-        if (mProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML &&
+        aConsoleType = (mFile == NULL) ? mConsole->getWriterType() : mProperties->getConsoleWriterType();
+        if (aConsoleType == XMLWRITER_TYPE_XML &&
             mOutputType != XMLWRITER_TYPE_PROPERTY) {
             mOutputType  = XMLWRITER_TYPE_XML;
         }
@@ -1007,6 +3127,14 @@ public:
         mOutputType = aOutputType;
     }
     // ----------------------------------------------------------------
+    // TXmlWriter::setFile
+    //! \brief Change the output file
+    //! \param aFile The output file or \c NULL for console output
+    // ----------------------------------------------------------------
+    void setFile(TMappedFile *aFile) {
+        mFile = aFile;
+    }
+    // ----------------------------------------------------------------
     // TXmlWriter::printTrace
     //! \brief Output of a list of attributes.
     //!
@@ -1039,7 +3167,16 @@ public:
 
         // Enforce XML for all output, if set in configuration
         int aSaveType   = -1;  
-        int aOutputType = mProperties->getConsoleWriterType();
+        int aOutputType = (mFile == NULL) ? mConsole->getWriterType() : mProperties->getConsoleWriterType();
+
+        // Binary clients receive the tags, after the pending text output
+        if (aOutputType == XMLWRITER_TYPE_BINARY) {
+            TOutputQueue::getInstance()->sync();
+            if (mConsole->printResult(aTag)) {
+                return;
+            }
+            aOutputType = XMLWRITER_TYPE_ASCII;
+        }
 
         if (aOutputType == XMLWRITER_TYPE_XML) {
             if (mOutputType != XMLWRITER_TYPE_PROPERTY) {
@@ -1556,63 +3693,15 @@ public:
     }
     // -----------------------------------------------------------------
     // TReader::getLine
-    //! \brief  Read the current line
-    //! \return The input of the console + newline and control key
+    //! \brief  Read the next line of the current session
+    //!
+    //! Line editing and echo are done by the session
+    //! \return The input line
     // -----------------------------------------------------------------
     const SAP_UC *getLine() {
-        TString *aBuffer;
-        TString *aCtrl;
-
-        mCurrentLine = cU("");
-        mCmdLine = mEditBuffer->top();
-
-        for (;;) {
-            // read the command line and echo
-            aBuffer = mConsole->read();
-            aCtrl   = mConsole->getCtrl();
-            if (!mConsole->isConnected()) {
-                return cU("exit");
-            }
-            mCurrentLine.insert(aBuffer->str());
-            mConsole->echoInsert(&mCurrentLine);
-
-            switch ((*aCtrl)[0]) {
-                case  8: // backspace
-                    mConsole->backspace(&mCurrentLine);
-                    break;
-                case 10:
-                case 13: // carriage return newline \015\012
-                    mConsole->printLn(cU(""));
-                    return mCurrentLine.str();
-                case 27: // cursor movement
-                    switch ((*aCtrl)[2]) {
-                        case 65: // cursor up
-                            mCmdLine = mEditBuffer->up();
-                            if (mCmdLine != mEditBuffer->end()) {
-                                mCurrentLine = mCmdLine->str();
-                                mConsole->clrScreen();
-                                mConsole->print(mCurrentLine.str());
-                            }
-                            break;
-                        case 66: // cursor down
-                            mCmdLine = mEditBuffer->down();
-                            if (mCmdLine != mEditBuffer->end()) {
-                                mCurrentLine = mCmdLine->str();
-                                mConsole->clrScreen();
-                                mConsole->print(mCurrentLine.str());
-                            }
-                            break;
-                        case 67: // cursor right
-                            mConsole->moveCursor(&mCurrentLine, 1);
-                            break;
-                        case 68: // cursor left
-                            mConsole->moveCursor(&mCurrentLine, -1);
-                            break;
-                        default:
-                            break;
-                    }
-            }
-        }
+        mCmdLine     = mEditBuffer->top();
+        mCurrentLine = mConsole->getLine();
+        return mCurrentLine.str();
     }
     // -----------------------------------------------------------------
     // TReader::accept
@@ -1656,8 +3745,6 @@ private:
     static TSecurity *mInstance;
     TProperty      mPwdEntry[10];
     TProperties   *mProperties;
-    SAP_UC         mUser[32];
-    SAP_UC         mPass[32];
     SAP_UC         mCrypt[10];
     // -----------------------------------------------------------------
     // TSecurity::TSecurity
@@ -1704,54 +3791,46 @@ public:
     // TSecurity::login
     //! \brief User login
     //!
-    //! The password is stored in file using asynchron crypt
+    //! Executes one step of the login dialog with the next input line
+    //! of the session, so a client typing slowly does not block others.
+    //! The password is stored in file using asynchron crypt.
+    //! A wrong password closes the connection.
+    //! \param aSession The client session
     //! \return \c TRUE if login was successfull
     // -----------------------------------------------------------------
-    bool login() {
+    bool login(TSession *aSession) {
         int          i;
-        TReader      aReader;
-        TWriter     *aWriter  = TWriter::getInstance();
-        TConsole    *aConsole = TConsole::getInstance();
-        bool         bEcho    = (mProperties->getConsoleWriterType() == XMLWRITER_TYPE_ASCII);
+        TString      aLine;
+        bool         bEcho    = (aSession->getWriterType() == XMLWRITER_TYPE_ASCII);
 
-        if (!aConsole->isConnected()) {
+        if (!aSession->getLine(&aLine)) {
             return false;
         }
-        aConsole->setEcho(bEcho);
-
-        if (bEcho) {
-            // force output before login
-            aWriter->print(cU("login: "), true);
-        }
-        STRNCPY(mUser, aReader.getLine(), 32, 32);        
-        mUser[31] = 0;
-
-        if (!STRCMP(mUser, cU("paul"))) {
-            return true;
-        }   
-        if (bEcho) {
-            // force output before login
-            aWriter->print(cU("password: "), true);
+        if (aSession->getState() == SESSION_LOGIN_USER) {
+            aSession->setUser(aLine.str());
+            if (!STRCMP(aSession->getUser(), cU("paul"))) {
+                return true;
+            }   
+            if (bEcho) {
+                aSession->print(cU("password: "));
+            }
+            aSession->setEcho(false);
+            aSession->setState(SESSION_LOGIN_PASS);
+            return false;
         }
-        aConsole->setEcho(false);
-        STRNCPY(mPass, aReader.getLine(), 32, 32);
-        mPass[31] = 0;
-
-        aConsole->setEcho(bEcho);
+        aSession->setEcho(bEcho);
 
         // find user
         for (i = 0; i < 10; i++) {
-            if (!STRCMP(mUser, cU("paul"))) {
-                return true;
-            }            
             if (!mPwdEntry[i].isValid()) {
-                return false;
+                break;
             }            
-            if (!STRCMP(mPwdEntry[i].getKey(),   mUser) &&
-                !STRCMP(mPwdEntry[i].getValue(), crypt(mPass, 5))) {
+            if (!STRCMP(mPwdEntry[i].getKey(),   aSession->getUser()) &&
+                !STRCMP(mPwdEntry[i].getValue(), crypt(aLine.str(), 5))) {
                 return true;
             }
         }
+        aSession->setState(SESSION_CLOSED);
         return false;
     }
     // -----------------------------------------------------------------
@@ -1784,10 +3863,11 @@ public:
         TReader   aReader;
         TWriter  *aWriter  = TWriter::getInstance();
         TConsole *aConsole = TConsole::getInstance();
+        TString   aUser(aConsole->getUser());
 
         // find the user
         while (!bFound && aInx < 10 && mPwdEntry[aInx].isValid()) {
-            bFound = STRCMP(mUser, mPwdEntry[aInx].getKey()) == 0;
+            bFound = STRCMP(aUser.str(), mPwdEntry[aInx].getKey()) == 0;
             aInx ++;
         }
         aInx --;
@@ -36,8 +36,12 @@
 #define COMMAND_START            6    
 #define COMMAND_STOP             7
 #define COMMAND_RESET            8    
+#define COMMAND_LRS              9
 #define COMMAND_INFO            10
+#define COMMAND_HPROF           11
+#define COMMAND_LGR             12
 #define COMMAND_GC              13
+#define COMMAND_SYNC            14
 #define COMMAND_ECHO            15
 #define COMMAND_CTRLB           16
 #define COMMAND_UNKNOWN         17
@@ -48,11 +52,16 @@
 #define COMMAND_PASSWD_CHANGE   22
 #define COMMAND_LML             23
 #define COMMAND_LSP             24
+#define COMMAND_LFS             25
 #define COMMAND_LCF             26
 #define COMMAND_SET             27
 #define COMMAND_LHD             28
 #define COMMAND_DEX             29
+#define COMMAND_FORMAT          30
+#define COMMAND_JOB             31
 #define COMMAND_WAIT            32
+#define COMMAND_LTS             33
+#define COMMAND_RELOAD          34
 
 // ----------------------------------------------------------------
 // Profiler options
@@ -85,6 +94,11 @@
 #define XMLWRITER_TYPE_BINARY    8
 #define XMLWRITER_TYPE_PROPERTY 16
 
+#define OUTPUT_QUEUE_OFF         0
+#define OUTPUT_QUEUE_BLOCK       1
+#define OUTPUT_QUEUE_DROP_NEWEST 2
+#define OUTPUT_QUEUE_DROP_OLDEST 3
+
 #define PROPERTY_TYPE_CHAR       0
 #define PROPERTY_TYPE_INT        1
 #define PROPERTY_TYPE_HIDDEN     2
@@ -1077,13 +1091,26 @@ private:
     TValues             *mTimers;
     TValues             *mTriggerFilter;        //!< TraceTrigger
     TValues             *mHideFilter;           //!< ProfileHide
+    TValues             *mThreadFilter;         //!< ProfileThreads
+    TValues             *mThreadExclude;        //!< ProfileThreadsExclude
+    TValues             *mSeriesMethods;        //!< SeriesMethods
+    TPrefixTrie          mPackageRules;         //!< Compiled ProfilePackages
+    TPrefixTrie          mExcludeRules;         //!< Compiled ProfileExcludes
+    TPrefixTrie          mScopeRules;           //!< Compiled ProfileScope
+    TPrefixTrie          mHideRules;            //!< Compiled ProfileHide
+    TPrefixTrie          mClassDebugRules;      //!< Compiled ClassDebug
+    TPrefixTrie          mThreadRules;          //!< Compiled ProfileThreads
+    TPrefixTrie          mThreadExcludeRules;   //!< Compiled ProfileThreadsExclude
     TValues             *mTraceOptions;         
     TValues             *mExceptions;
 	TValues             *mLogOptions;
 
     TString              mHost;
+    TString              mMetricsHost;
     jlong                mMinClassSize;
     int                  mTelnetPort;           //!< Port for output
+    int                  mMetricsPort;          //!< Port for metrics scrapes
+    jint                 mMetricsInterval;      //!< Seconds between metrics snapshots
     int                  mTimerValue;
     jlong                mThreadSampleTime;
     TString              mFileName;
@@ -1094,6 +1121,7 @@ private:
     TString              mLogFile;
     TString              mPwdFile;
     TString              mProfileInfo;
+    TString              mClassCache;           //!< File of cached class decisions
     bool                 mMethodDebug;
     unsigned             mMonitorActive;
     bool                 mMemoryInfo;
@@ -1108,6 +1136,14 @@ private:
     jint                 mLimitIO;
     jint                 mLimitHash;
     jint                 mLimitHistory;
+    jint                 mAlertInterval;
+    jint                 mLogFileSize;
+    jint                 mLogFileCount;
+    bool                 mLogFileCompression;
+    int                  mOutputQueue;
+    jint                 mOutputQueueSize;
+    jint                 mSeriesInterval;
+    jint                 mSeriesSize;
     int                  mOutputStream;
     bool                 mComprLine;
     bool                 mInitPath;
@@ -1139,11 +1175,16 @@ private:
         mScope                  = new TValues(16);
         mTimers                 = new TValues(16);
         mHideFilter             = new TValues(16);
+        mThreadFilter           = new TValues(16);
+        mThreadExclude          = new TValues(16);
+        mSeriesMethods          = new TValues(16);
         mTraceOptions           = new TValues(16);
         mExceptions             = new TValues(16);
 		mLogOptions             = new TValues(4);
 
         mTelnetPort             = 0;
+        mMetricsPort            = 0;
+        mMetricsInterval        = 10;
         mTimerValue             = 0;
         mMonitorActive          = MONITOR_IDLE;
         mDoMonitor              = false;
@@ -1164,6 +1205,14 @@ private:
         mLimitIO                = 1000;
         mLimitHash              = gHashValue;
         mLimitHistory           = 10;
+        mAlertInterval          = 60;
+        mLogFileSize            = 0;
+        mLogFileCount           = 4;
+        mLogFileCompression     = false;
+        mOutputQueue            = OUTPUT_QUEUE_DROP_NEWEST;
+        mOutputQueueSize        = 4096;
+        mSeriesInterval         = 0;
+        mSeriesSize             = 1024;
         mDumpLevel              = 0;
         mProfilerMode           = PROFILER_MODE_PROFILE;
         mOutputStream           = XMLWRITER_TYPE_ASCII;
@@ -1174,7 +1223,9 @@ private:
         mFileName               = cU("sherlok.properties");
         mFilePath               = cU(".");
         mPwdFile                = cU("sherlok.pwd");
+        mClassCache             = cU("");
         mHost                   = cU("localhost");
+        mMetricsHost            = cU("localhost");
         mStackSize              = 1024;
 
         mJvmUpdate              = NULL;
@@ -1196,6 +1247,9 @@ private:
         delete mScope;
         delete mTimers;
         delete mTriggerFilter;
+        delete mThreadFilter;
+        delete mThreadExclude;
+        delete mSeriesMethods;
         delete mTraceOptions;
         delete mExceptions;
 		delete mLogOptions;
@@ -1289,7 +1343,8 @@ public:
         setDefault();
         if (aOptions == NULL || *aOptions == cR('\0')) {
             loadScpFiles(true);
-            parseFile();
+            readFile();
+            compileRules();
             return;
         }        
         aCmdLine.assignR(aOptions, STRLEN_A7(aOptions));
@@ -1334,7 +1389,7 @@ public:
             parseProperty(&aCmdProperty);
         }
         loadScpFiles(!aFoundProp);
-        parseFile();
+        readFile();
 
         // All other program arguments will supersseed the default settings
         // ConfigFile and ConfigPath from command line superseed any other settings
@@ -1347,6 +1402,7 @@ public:
                 parseProperty(&aCmdProperty);
             }
         }
+        compileRules();
     }
     // ------------------------------------------------------------
     // TProperties::setDefault
@@ -1500,24 +1556,13 @@ public:
     // ------------------------------------------------------------
     // TProperties::parseFile
     //! \brief  Configuration management
+    //!
+    //! The rules are compiled once after all lines are read.
     //! \return Read the current configuration file
     // ------------------------------------------------------------
     void parseFile() {
-        /*SAPUNICODEOK_CHARCONST*//*SAPUNICODEOK_LIBFCT*/
-        if (ACCESS(mPropertyPath.a7_str(), 0) == -1) {
-            ERROR_OUT(mPropertyPath.str(), 100);
-            return;
-        }
-        TProperty aProperty;
-        SAP_ifstream aFile;
-        aFile.rdbuf()->open(mPropertyPath.a7_str(), ios::in);
-        // read all lines
-        while (!aFile.eof() && aFile.rdbuf()->is_open()) {
-            aProperty.readLine(&aFile, 4098);
-            parseProperty(&aProperty);
-        }
-        aFile.close();
-        mLoadNewSkp = false;
+        readFile();
+        compileRules();
     }
     // ------------------------------------------------------------
     // TProperties::parseFile
@@ -1554,6 +1599,10 @@ public:
             aProperty->split(mMethodsFilter, cU(','));
         } else if (aProperty->equalsKey(cU("ProfileHide"))) {
             aProperty->split(mHideFilter, cU(','));
+        } else if (aProperty->equalsKey(cU("ProfileThreadsExclude"))) {
+            aProperty->split(mThreadExclude, cU(','));
+        } else if (aProperty->equalsKey(cU("ProfileThreads"))) {
+            aProperty->split(mThreadFilter, cU(','));
         } else if (aProperty->equalsKey(cU("ProfileInfo"))) {
             mProfileInfo = aProperty->getInfo();
         } else if (aProperty->equalsKey(cU("TraceMethods"))) {
@@ -1590,6 +1639,14 @@ public:
             aProperty->split(mTimers, cU(','));
         } else if (aProperty->equalsKey(cU("TelnetPort"))) {
             mTelnetPort = (int)aProperty->toInteger();
+        } else if (aProperty->equalsKey(cU("MetricsPort"))) {
+            mMetricsPort = (int)aProperty->toInteger();
+        } else if (aProperty->equalsKey(cU("MetricsHost"))) {
+            mMetricsHost = aProperty->getValue();
+        } else if (aProperty->equalsKey(cU("MetricsInterval"))) {
+            mMetricsInterval = (jint)aProperty->toInteger();
+            if (mMetricsInterval < 1)
+                mMetricsInterval = 1;
         } else if (aProperty->equalsKey(cU("Timer"))) {
             mTimerValue = 0;
             if (!STRNCMP(aProperty->getValue(), cU("on"), 2)) {
@@ -1717,6 +1774,47 @@ public:
             mLimitHistory = (jint)aProperty->toInteger();
             if (mLimitHistory < 10)
                 mLimitHistory = 10;
+        } else if (aProperty->equalsKey(cU("MemoryAlertInterval"))) {
+            mAlertInterval = (jint)aProperty->toInteger();
+            if (mAlertInterval < 0)
+                mAlertInterval = 0;
+        } else if (aProperty->equalsKey(cU("LogFileSize"))) {
+            mLogFileSize = (jint)aProperty->toInteger();
+            if (mLogFileSize < 0)
+                mLogFileSize = 0;
+        } else if (aProperty->equalsKey(cU("LogFileCount"))) {
+            mLogFileCount = (jint)aProperty->toInteger();
+            if (mLogFileCount < 1)
+                mLogFileCount = 1;
+        } else if (aProperty->equalsKey(cU("LogFileCompression"))) {
+            mLogFileCompression = STRCMP(aProperty->getValue(), cU("yes")) == 0;
+        } else if (aProperty->equalsKey(cU("ClassCache"))) {
+            mClassCache = aProperty->getValue();
+        } else if (aProperty->equalsKey(cU("OutputQueue"))) {
+            mOutputQueue = OUTPUT_QUEUE_DROP_NEWEST;
+            if (!STRCMP(aProperty->getValue(), cU("off"))) {
+                mOutputQueue = OUTPUT_QUEUE_OFF;
+            }
+            if (!STRCMP(aProperty->getValue(), cU("block"))) {
+                mOutputQueue = OUTPUT_QUEUE_BLOCK;
+            }
+            if (!STRCMP(aProperty->getValue(), cU("drop-oldest"))) {
+                mOutputQueue = OUTPUT_QUEUE_DROP_OLDEST;
+            }
+        } else if (aProperty->equalsKey(cU("OutputQueueSize"))) {
+            mOutputQueueSize = (jint)aProperty->toInteger();
+            if (mOutputQueueSize < 64)
+                mOutputQueueSize = 64;
+        } else if (aProperty->equalsKey(cU("SeriesInterval"))) {
+            mSeriesInterval = (jint)aProperty->toInteger();
+            if (mSeriesInterval < 0)
+                mSeriesInterval = 0;
+        } else if (aProperty->equalsKey(cU("SeriesSize"))) {
+            mSeriesSize = (jint)aProperty->toInteger();
+            if (mSeriesSize < 64)
+                mSeriesSize = 64;
+        } else if (aProperty->equalsKey(cU("SeriesMethods"))) {
+            aProperty->split(mSeriesMethods, cU(','));
         } else if (aProperty->equalsKey(cU("StackSize"))) {
             mStackSize    = (int)aProperty->toInteger();
             if (mStackSize < 128 || mStackSize > 2048) {
@@ -1751,8 +1849,7 @@ public:
     //!         TProperties::mPackageFilter
     // ------------------------------------------------------------
     inline bool doMonitorPackage(const SAP_UC *aPackageName) {
-        bool aFound = findEntry(mPackageFilter, aPackageName) != NULL;
-        return aFound;
+        return mPackageRules.match(aPackageName);
     }
     // ------------------------------------------------------------
     // TProperties::dontMonitorPackage
@@ -1762,9 +1859,7 @@ public:
     //!         TProperties::mPackageFilterExclude
     // ------------------------------------------------------------
     inline bool dontMonitorPackage(const SAP_UC *aPackageName) { 
-        return 
-            (mPackageFilterExclude->getDepth() > 0) &&
-            (findEntry(mPackageFilterExclude, aPackageName) != NULL);
+        return mExcludeRules.match(aPackageName);
     }
     // ------------------------------------------------------------
     // TProperties::doMonitorScope
@@ -1774,7 +1869,7 @@ public:
     //!         TProperties::mScope
     // ------------------------------------------------------------
     inline bool doMonitorScope(const SAP_UC *aPackageName) {
-        return findEntry(mScope, aPackageName) != NULL;
+        return mScopeRules.match(aPackageName);
     }
     // ------------------------------------------------------------
     // TProperties::doMonitorVisible
@@ -1783,7 +1878,30 @@ public:
     //!         TProperties::mHideFilter
     // ------------------------------------------------------------
     inline bool doMonitorVisible(const SAP_UC *aPackageName) {
-        return findEntry(mHideFilter, aPackageName) == NULL;
+        return !mHideRules.match(aPackageName);
+    }
+    // ------------------------------------------------------------
+    // TProperties::hasThreadRules
+    //! \brief  Access to configuration
+    //! \return \c TRUE if method events are restricted to threads
+    //!         by ProfileThreads or ProfileThreadsExclude
+    // ------------------------------------------------------------
+    bool hasThreadRules() {
+        return mThreadFilter->getSize() > 0 || mThreadExclude->getSize() > 0;
+    }
+    // ------------------------------------------------------------
+    // TProperties::doMonitorThread
+    //! \brief  Access to configuration
+    //! \param  aThreadName The thread name to check
+    //! \return \c TRUE if the thread is in the list of values
+    //!         TProperties::mThreadFilter and not in the list of
+    //!         values TProperties::mThreadExclude
+    // ------------------------------------------------------------
+    bool doMonitorThread(const SAP_UC *aThreadName) {
+        if (mThreadFilter->getSize() > 0 && !mThreadRules.match(aThreadName)) {
+            return false;
+        }
+        return !mThreadExcludeRules.match(aThreadName);
     }
     // ------------------------------------------------------------
     // TProperties::doMonitorMethod
@@ -1847,7 +1965,7 @@ public:
     //!         TProperties::mClassDebug
     // ------------------------------------------------------------
     bool doMonitorClassLoad(const SAP_UC *aClassName) {
-        return (findEntry(mClassDebug, aClassName) != NULL);
+        return mClassDebugRules.match(aClassName);
     }
     // ------------------------------------------------------------
     // TProperties::doExecutionTimer
@@ -1958,6 +2076,14 @@ public:
         return mMemoryAlert;
     }
     // ------------------------------------------------------------
+    // TProperties::getAlertInterval
+    //! \brief Access to configuration
+    //! \return Minimal time in ms between two alerts of a class
+    // ------------------------------------------------------------
+    jlong getAlertInterval() {
+        return (jlong)mAlertInterval * 1000;
+    }
+    // ------------------------------------------------------------
     // TProperties::doAutoAction
     //! \brief Access to configuration
     //! \return \c TRUE if acitvation of agent requested
@@ -2054,6 +2180,30 @@ public:
         return mHost.a7_str();
     }
     // ------------------------------------------------------------
+    // TProperties::getMetricsPort
+    //! \brief  Access to configuration
+    //! \return The port for metrics scrapes, 0 if disabled
+    // ------------------------------------------------------------
+    unsigned short getMetricsPort() {
+        return (unsigned short)mMetricsPort;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getMetricsHost
+    //! \brief  Access to configuration
+    //! \return The interface for metrics scrapes
+    // ------------------------------------------------------------
+    const SAP_UC *getMetricsHost() {
+        return mMetricsHost.str();
+    }
+    // ------------------------------------------------------------
+    // TProperties::getMetricsInterval
+    //! \brief  Access to configuration
+    //! \return The seconds between two metrics snapshots
+    // ------------------------------------------------------------
+    jint getMetricsInterval() {
+        return mMetricsInterval;
+    }
+    // ------------------------------------------------------------
     // TProperties::getInfo
     //! \brief  Access to configuration
     //! \return ProfileInfo
@@ -2103,6 +2253,109 @@ public:
         return mOutputStream;
     }
     // ------------------------------------------------------------
+    // TProperties::getLogFileSize
+    //! \brief  Access to configuration
+    //! \return The size in bytes to rotate log and trace files
+    //!         or 0 for no rotation
+    // ------------------------------------------------------------
+    jlong getLogFileSize() {
+        return (jlong)mLogFileSize * 1024 * 1024;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getLogFileCount
+    //! \brief  Access to configuration
+    //! \return The number of rotated log and trace files to keep
+    // ------------------------------------------------------------
+    jint getLogFileCount() {
+        return mLogFileCount;
+    }
+    // ------------------------------------------------------------
+    // TProperties::doLogFileCompression
+    //! \brief  Access to configuration
+    //! \return \c TRUE if log and trace files are written as
+    //!         compressed frames
+    // ------------------------------------------------------------
+    bool doLogFileCompression() {
+        return mLogFileCompression;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getClassCache
+    //! \brief  Access to configuration
+    //! \return The file of the class cache or \c NULL if disabled
+    // ------------------------------------------------------------
+    const SAP_UC *getClassCache() {
+        if (mClassCache.pcount() == 0) {
+            return NULL;
+        }
+        return mClassCache.str();
+    }
+    // ------------------------------------------------------------
+    // TProperties::getRulesHash
+    //! \brief  Hash of the class and method rules
+    //!
+    //! Decisions of the class cache are valid as long as this
+    //! value does not change.
+    //! \return The hash over all rules evaluated by TMonitor::resetClass
+    //!         and TMonitor::resetMethod
+    // ------------------------------------------------------------
+    jlong getRulesHash() {
+        jlong aHash = 0;
+
+        aHash = hashValues(mScope,                aHash);
+        aHash = hashValues(mPackageFilterExclude, aHash);
+        aHash = hashValues(mPackageFilter,        aHash);
+        aHash = hashValues(mHideFilter,           aHash);
+        aHash = hashValues(mTimers,               aHash);
+        aHash = hashValues(mMethodsDebug,         aHash);
+        aHash = hashValues(mMethodsFilter,        aHash);
+        aHash = hashValues(mTriggerFilter,        aHash);
+        return aHash;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getOutputQueue
+    //! \brief  Access to configuration
+    //! \return The overflow policy of the output queue. One of
+    //!             - OUTPUT_QUEUE_OFF
+    //!             - OUTPUT_QUEUE_BLOCK
+    //!             - OUTPUT_QUEUE_DROP_NEWEST (default)
+    //!             - OUTPUT_QUEUE_DROP_OLDEST
+    // ------------------------------------------------------------
+    int getOutputQueue() {
+        return mOutputQueue;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getOutputQueueSize
+    //! \brief  Access to configuration
+    //! \return The maximal number of pending output lines
+    // ------------------------------------------------------------
+    jint getOutputQueueSize() {
+        return mOutputQueueSize;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getSeriesInterval
+    //! \brief  Access to configuration
+    //! \return The sample interval of the time series in seconds, 0 if disabled
+    // ------------------------------------------------------------
+    jint getSeriesInterval() {
+        return mSeriesInterval;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getSeriesSize
+    //! \brief  Access to configuration
+    //! \return The memory of the time series in KB
+    // ------------------------------------------------------------
+    jint getSeriesSize() {
+        return mSeriesSize;
+    }
+    // ------------------------------------------------------------
+    // TProperties::getSeriesMethods
+    //! \brief  Access to configuration
+    //! \return The list of methods sampled into the time series
+    // ------------------------------------------------------------
+    TValues *getSeriesMethods() {
+        return mSeriesMethods;
+    }
+    // ------------------------------------------------------------
     // TProperties::getComprLine
     //! \brief  Access to configuration
     //! \return \c TRUE if output should be compressed 
@@ -2195,12 +2448,56 @@ public:
             mTimers->reset();
             mClassDebug->reset();
             mHideFilter->reset();
+            mThreadFilter->reset();
+            mThreadExclude->reset();
+            mSeriesMethods->reset();
             mThreadSampleTime = 30000;
             parseFile();
         }
         return true;
     }
     // ------------------------------------------------------------
+    // TProperties::reload
+    //! \brief Reload the configuration and report the changed rules
+    //!
+    //! Rules added or removed by the reload are returned without
+    //! path and context, as compared by findEntryByName.
+    //! \param aClassChanges  Changed rules of ProfileScope, ProfileExcludes,
+    //!                       ProfilePackages and ProfileHide
+    //! \param aMethodChanges Changed rules of the method timers, TraceMethods,
+    //!                       ProfileMethods and TraceTrigger
+    //! \return \c FALSE if the configuration file is missing
+    // ------------------------------------------------------------
+    bool reload(TValues *aClassChanges, TValues *aMethodChanges) {
+        TValues *aRules[8] = {
+            mScope, mPackageFilterExclude, mPackageFilter, mHideFilter,
+            mTimers, mMethodsDebug, mMethodsFilter, mTriggerFilter };
+        TValues *aOldRules[8];
+        TString  aValue;
+        TString  aClassDiff(cU(""));
+        TString  aMethodDiff(cU(""));
+        bool     aResult;
+        int      i;
+
+        for (i = 0; i < 8; i++) {
+            aOldRules[i] = new TValues(aRules[i]->getDepth() + 1);
+            dumpValues(&aValue, aRules[i]);
+            aValue.split(aOldRules[i], cU(','));
+        }
+        aResult = reset(true);
+
+        for (i = 0; i < 8; i++) {
+            if (aResult) {
+                diffValues(aRules[i], aOldRules[i], (i < 4) ? &aClassDiff : &aMethodDiff);
+                diffValues(aOldRules[i], aRules[i], (i < 4) ? &aClassDiff : &aMethodDiff);
+            }
+            delete aOldRules[i];
+        }
+        aClassDiff.split(aClassChanges, cU(','));
+        aMethodDiff.split(aMethodChanges, cU(','));
+        return aResult;
+    }
+    // ------------------------------------------------------------
     // TProperties::dump
     //! \brief Dump the configuration to tag list
     //! \param aRootTag The result tag list
@@ -2294,6 +2591,13 @@ public:
             aTag->addAttribute(cU("Description"), cU("Info"));
         }
 
+        if (mClassCache.pcount() > 0) {
+            aTag = aNodeTag->addTag(cU("Property"));
+            aTag->addAttribute(cU("Type"),        cU("ClassCache"));
+            aTag->addAttribute(cU("Value"),       mClassCache.str());
+            aTag->addAttribute(cU("Description"), cU("File of cached class decisions"));
+        }
+
         aTag = aNodeTag->addTag(cU("Property"));
         dumpValues(&aStrValue, mScope);
         aTag->addAttribute(cU("Type"),        cU("ProfileScope"));
@@ -2329,6 +2633,24 @@ public:
         aTag->addAttribute(cU("Value"),       aStrValue.str());
         aTag->addAttribute(cU("Description"), cU("List of classes hidden from profiler"));
 
+        aTag = aNodeTag->addTag(cU("Property"));
+        dumpValues(&aStrValue, mThreadFilter);
+        aTag->addAttribute(cU("Type"),        cU("ProfileThreads"));
+        aTag->addAttribute(cU("Value"),       aStrValue.str());
+        aTag->addAttribute(cU("Description"), cU("List of threads with method events"));
+
+        aTag = aNodeTag->addTag(cU("Property"));
+        dumpValues(&aStrValue, mThreadExclude);
+        aTag->addAttribute(cU("Type"),        cU("ProfileThreadsExclude"));
+        aTag->addAttribute(cU("Value"),       aStrValue.str());
+        aTag->addAttribute(cU("Description"), cU("List of threads without method events"));
+
+        aTag = aNodeTag->addTag(cU("Property"));
+        dumpValues(&aStrValue, mSeriesMethods);
+        aTag->addAttribute(cU("Type"),        cU("SeriesMethods"));
+        aTag->addAttribute(cU("Value"),       aStrValue.str());
+        aTag->addAttribute(cU("Description"), cU("List of methods sampled into the time series"));
+
         aTag = aNodeTag->addTag(cU("Property"));
         dumpValues(&aStrValue, mMethodsFilter);
         aTag->addAttribute(cU("Type"),        cU("ProfileMethods"));
@@ -2443,6 +2765,17 @@ public:
         aTag->addAttribute(cU("Value"),       mHost.str());
         aTag->addAttribute(cU("Description"), cU("Hostname for remote access"));
 
+        aTag = aNodeTag->addTag(cU("Property"));
+        TString::parseInt(mMetricsPort, aBuffer);
+        aTag->addAttribute(cU("Type"),        cU("MetricsPort"));
+        aTag->addAttribute(cU("Value"),       aBuffer);
+        aTag->addAttribute(cU("Description"), cU("Port for metrics scrapes"));
+
+        aTag = aNodeTag->addTag(cU("Property"));
+        aTag->addAttribute(cU("Type"),        cU("MetricsHost"));
+        aTag->addAttribute(cU("Value"),       mMetricsHost.str());
+        aTag->addAttribute(cU("Description"), cU("Hostname for metrics scrapes"));
+
         aTag = aNodeTag->addTag(cU("Property"));
         aTag->addAttribute(cU("Type"),        cU("ConfigFile"));
         aTag->addAttribute(cU("Value"),       mPropertyPath.str());
@@ -2459,7 +2792,106 @@ public:
         aTag->addAttribute(cU("Value"),       aStrValue.str());
         aTag->addAttribute(cU("Description"), cU("Trace startup"));
     }
+    // ------------------------------------------------------------
+    // TProperties::compileRules
+    //! \brief Compile the name rules
+    //!
+    //! Each compile retires the previous rules of a trie, so the
+    //! rules are compiled once per reload or set command.
+    // ------------------------------------------------------------
+    void compileRules() {
+        mPackageRules.compile(mPackageFilter);
+        mExcludeRules.compile(mPackageFilterExclude);
+        mScopeRules.compile(mScope);
+        mHideRules.compile(mHideFilter);
+        mClassDebugRules.compile(mClassDebug);
+        mThreadRules.compile(mThreadFilter);
+        mThreadExcludeRules.compile(mThreadExclude);
+    }
 private:
+    // ------------------------------------------------------------
+    // TProperties::readFile
+    //! \brief Read the current configuration file without
+    //!        compiling the rules
+    // ------------------------------------------------------------
+    void readFile() {
+        /*SAPUNICODEOK_CHARCONST*//*SAPUNICODEOK_LIBFCT*/
+        if (ACCESS(mPropertyPath.a7_str(), 0) == -1) {
+            ERROR_OUT(mPropertyPath.str(), 100);
+            return;
+        }
+        TProperty aProperty;
+        SAP_ifstream aFile;
+        aFile.rdbuf()->open(mPropertyPath.a7_str(), ios::in);
+        // read all lines
+        while (!aFile.eof() && aFile.rdbuf()->is_open()) {
+            aProperty.readLine(&aFile, 4098);
+            parseProperty(&aProperty);
+        }
+        aFile.close();
+        mLoadNewSkp = false;
+    }
+    // ------------------------------------------------------------
+    // TProperties::diffValues
+    //! \brief Collect the rules missing in the other list
+    //! \param aValues The rules to check
+    //! \param aOther  The rules to compare with
+    //! \param aDiff   The comma separated names of the changed rules
+    // ------------------------------------------------------------
+    void diffValues(TValues *aValues, TValues *aOther, TString *aDiff) {
+        TValues::iterator aPtr;
+        TString           aEntry;
+
+        for (aPtr  = aValues->begin();
+             aPtr != aValues->end();
+             aPtr  = aValues->next()) {
+            if (findValue(aOther, *aPtr) != NULL) {
+                continue;
+            }
+            aEntry = *aPtr;
+            aEntry.cut(aEntry.findLastOf(cU('/')) + 1, aEntry.findFirstOf(cU('{')));
+            if (aDiff->pcount() > 0) {
+                aDiff->concat(cU(","));
+            }
+            aDiff->concat(aEntry.str());
+        }
+    }
+    // ------------------------------------------------------------
+    // TProperties::findValue
+    //! \param  aValueList The search list
+    //! \param  aValue     The exact value
+    //! \return The pointer to the entry found or NULL if value not in the list
+    // ------------------------------------------------------------
+    SAP_UC *findValue(TValues *aValueList, const SAP_UC *aValue) {
+        TValues::iterator aPtr;
+
+        for (aPtr  = aValueList->begin();
+             aPtr != aValueList->end();
+             aPtr  = aValueList->next()) {
+            if (STRCMP(*aPtr, aValue) == 0) {
+                return (*aPtr);
+            }
+        }
+        return NULL;
+    }
+    // ------------------------------------------------------------
+    // TProperties::hashValues
+    //! \brief  Chain the entries of a list into a hash
+    //! \param  aValues The list
+    //! \param  aHash   The hash of the preceding lists
+    //! \return The new hash
+    // ------------------------------------------------------------
+    jlong hashValues(TValues *aValues, jlong aHash) {
+        TValues::iterator aPtr;
+
+        for (aPtr  = aValues->begin();
+             aPtr != aValues->end();
+             aPtr  = aValues->next()) {
+            aHash = TString::getStableHash(*aPtr, aHash);
+            aHash = TString::getStableHash(cU(","), aHash);
+        }
+        return TString::getStableHash(cU(";"), aHash);
+    }
     // ------------------------------------------------------------
     // TProperties::findEntry
     //! \brief  Search alowing dots as wildcards
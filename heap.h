@@ -0,0 +1,2898 @@
+// -----------------------------------------------------------------
+//
+// Author: Albert Rossmann
+// File  : heap.h
+// Date  : 18.10.2026
+//! \file heap.h
+//! \brief Heap graph analysis, heap dump and paths to GC roots
+//!
+// -----------------------------------------------------------------
+#ifndef HEAP_H
+#define HEAP_H
+
+#define HEAPGRAPH_IDLE          0   //!< No snapshot available
+#define HEAPGRAPH_ANALYSE       1   //!< Snapshot waits for analysis
+#define HEAPGRAPH_READY         2   //!< Result available
+#define HEAPGRAPH_ERROR         3   //!< Snapshot or analysis failed
+
+#define HEAPGRAPH_NONE         -1   //!< No vertex
+#define HEAPGRAPH_MAX_NODES     0x3FFFFFFF  //!< Node ID range
+
+//! Object tag for the node ID in the private environment
+#define HEAPGRAPH_NODE_TAG(n)   ((((jlong)(n)) << 1) | 1)
+//! Class tag for the class index in the private environment
+#define HEAPGRAPH_CLASS_TAG(c)  (((jlong)(c)) << 1)
+//! Node ID or class index from a private tag
+#define HEAPGRAPH_TAG_VALUE(t)  ((jint)((t) >> 1))
+//! Private tag refers to a node
+#define HEAPGRAPH_IS_NODE(t)    (((t) & 1) != 0)
+
+// ---------------------------------------------------------
+//! \struct THeapGraphClass
+//! \brief Class entry of a heap graph
+// ---------------------------------------------------------
+typedef struct {
+    TString       *mName;               //!< Name of the class
+    jlong          mID;                 //!< Hash of the monitor class or 0
+    jlong          mCount;              //!< Number of instances
+    jlong          mShallow;            //!< Size of all instances
+    jlong          mRetained;           //!< Size retained by the instances
+} THeapGraphClass;
+
+// ---------------------------------------------------------
+// THeapGraph::referenceCallback
+//! \brief Callback for the reference runner
+//! \param  aKind           The reference kind
+//! \param  aInfo           Reference details
+//! \param  aClassTag       The tag of the referenced class
+//! \param  aRefClassTag    The tag of the referrer class
+//! \param  aSize           The size of the referenced object
+//! \param  aTag            The tag of the referenced object
+//! \param  aRefTag         The tag of the referrer or NULL for roots
+//! \param  aLength         Array length or -1
+//! \param  aUserData       The heap graph
+//! \return Visit control
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapGraphCallback(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                          aRefClassTag,
+            jlong                          aSize,
+            jlong                         *aTag,
+            jlong                         *aRefTag,
+            jint                           aLength,
+            void                          *aUserData);
+
+// ----------------------------------------------------
+//! \class THeapGraph
+//! \brief Retained size analysis
+//!
+//! The snapshot follows all references from the GC roots and streams
+//! nodes and edges into a file. Objects are tagged within a private
+//! tool environment, so the tags of the monitor stay untouched. The
+//! dominator tree is computed by the analyser thread with the
+//! algorithm of Lengauer and Tarjan and reported by class.
+// ----------------------------------------------------
+class THeapGraph {
+    friend jint JNICALL THeapGraphCallback(
+            jvmtiHeapReferenceKind, const jvmtiHeapReferenceInfo*,
+            jlong, jlong, jlong, jlong*, jlong*, jint, void*);
+private:
+    static THeapGraph  *mInstance;      //!< Singleton
+    TMonitorMutex      *mMutex;         //!< Sync with analyser thread
+    TProperties        *mProperties;    //!< Configuration
+    TString             mFileName;      //!< Graph file prefix
+    ofstream            mNodeFile;      //!< Node stream
+    ofstream            mEdgeFile;      //!< Edge stream
+    THeapGraphClass    *mClasses;       //!< Class table
+    jint                mNrClasses;     //!< Number of classes
+    jint                mNrNodes;       //!< Number of nodes without root
+    jlong               mNrEdges;       //!< Number of edges
+    jint                mMaxNodes;      //!< Limit for nodes
+    jint                mState;         //!< Analysis state
+    bool                mTruncated;     //!< Node limit reached
+    jlong               mSnapshotTime;  //!< Time for snapshot in ms
+    jlong               mAnalyseTime;   //!< Time for analysis in ms
+    jlong               mTotalSize;     //!< Size of all nodes
+    // ----------------------------------------------------
+    // THeapGraph::THeapGraph
+    //! Constructor
+    // ----------------------------------------------------
+    THeapGraph() {
+        mProperties   = TProperties::getInstance();
+        mMutex        = NULL;
+        mClasses      = NULL;
+        mNrClasses    = 0;
+        mNrNodes      = 0;
+        mNrEdges      = 0;
+        mMaxNodes     = 0;
+        mState        = HEAPGRAPH_IDLE;
+        mTruncated    = false;
+        mSnapshotTime = 0;
+        mAnalyseTime  = 0;
+        mTotalSize    = 0;
+        mFileName     = cU("sherlok.graph");
+    }
+    // ----------------------------------------------------
+    // THeapGraph::THeapGraph
+    //! Copy constructor
+    // ----------------------------------------------------
+    THeapGraph(const THeapGraph &) {
+    }
+public:
+    // ----------------------------------------------------
+    // THeapGraph::getInstance
+    //! Singleton constructor
+    // ----------------------------------------------------
+    static THeapGraph *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new THeapGraph();
+        }
+        return mInstance;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::initialize
+    //! \brief Create the monitor for the analyser thread
+    //! \param aJvmti The Java tool interface
+    // ----------------------------------------------------
+    void initialize(jvmtiEnv *aJvmti) {
+        if (mMutex == NULL) {
+            mMutex = new TMonitorMutex(aJvmti, cU("_HeapGraph"));
+        }
+    }
+    // ----------------------------------------------------
+    // THeapGraph::getPrivateEnv
+    //! \brief Private tool interface for the object tags
+    //!
+    //! The private environment keeps the tags of the monitor untouched.
+    //! \param aJvmti The tool interface of the monitor
+    //! \return The private environment with tagging capability or \c NULL
+    // ----------------------------------------------------
+    static jvmtiEnv *getPrivateEnv(jvmtiEnv *aJvmti) {
+        jvmtiEnv          *aEnv = NULL;
+        jvmtiCapabilities  aCapa;
+
+        if (TProperties::getInstance()->getJavaVm()->GetEnv((void **)&aEnv, JVMTI_VERSION_1_0) != JNI_OK ||
+            aEnv == NULL || aEnv == aJvmti) {
+            return NULL;
+        }
+        (void)memsetR(&aCapa, 0, sizeofR(jvmtiCapabilities));
+        aCapa.can_tag_objects = 1;
+        aEnv->AddCapabilities(&aCapa);
+        return aEnv;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::snapshot
+    //! \brief Write the reference graph and start analysis
+    //! \param aJvmti       The Java tool interface
+    //! \param aJni         The Java native interface
+    //! \param aRootTag     The output tag list
+    //! \param aOptions     Snapshot options
+    //!         -o<file>    Prefix for the graph files
+    //!         -n<number>  Maximum number of objects
+    // ----------------------------------------------------
+    void snapshot(
+            jvmtiEnv    *aJvmti,
+            JNIEnv      *aJni,
+            TXmlTag     *aRootTag,
+            TValues     *aOptions) {
+
+        TValues::iterator   aPtrOptions;
+        jvmtiEnv           *aEnv        = NULL;
+        jvmtiHeapCallbacks  aCallbacks;
+        jvmtiError          aResult;
+        jint                i;
+        jint                aCnt        = 0;
+        jclass             *aClassPtr   = NULL;
+        TMemoryBit         *aClsBit;
+        char               *aSignature;
+        char               *aGeneric;
+        jlong               aStartTime;
+
+        TMonitorLock aLock(mMutex);
+        if (mState == HEAPGRAPH_ANALYSE) {
+            aRootTag->addAttribute(cU("Result"), cU("Analysis in progress"));
+            return;
+        }
+        mMaxNodes = 0;
+
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-o"), 2) && STRLEN(*aPtrOptions) > 2) {
+                    mFileName = (*aPtrOptions) + 2;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-n"), 2)) {
+                    mMaxNodes = (jint)TString::toInteger(*aPtrOptions + 2);
+                }
+            }
+        }
+        reset();
+        aStartTime = TSystem::getTimestamp();
+
+        aEnv = THeapGraph::getPrivateEnv(aJvmti);
+        if (aEnv == NULL) {
+            mState = HEAPGRAPH_ERROR;
+            aRootTag->addAttribute(cU("Result"), cU("No private tool interface"));
+            return;
+        }
+
+        if (!openFiles()) {
+            mState = HEAPGRAPH_ERROR;
+            aEnv->DisposeEnvironment();
+            aRootTag->addAttribute(cU("Result"), cU("Cannot open graph file"));
+            return;
+        }
+
+        // Register classes, the class index is the private class tag
+        aJvmti->GetLoadedClasses(&aCnt, &aClassPtr);
+        mNrClasses = 1;
+        mClasses   = new THeapGraphClass[aCnt + 1];
+        initClass(0, cU("<unknown>"), 0);
+
+        for (i = 0; i < aCnt; i++) {
+            aClsBit = NULL;
+            aJvmti->GetTag(aClassPtr[i], (jlong *)&aClsBit);
+
+            if (aClsBit != NULL && aClsBit->mCtx != NULL) {
+                initClass(mNrClasses, aClsBit->mCtx->getName(), aClsBit->mCtx->getID());
+            }
+            else if (aEnv->GetClassSignature(aClassPtr[i], &aSignature, &aGeneric) == JVMTI_ERROR_NONE) {
+                TString aName;
+                aName.assignR(aSignature, STRLEN_A7(aSignature));
+                aName.replace(cU('/'), cU('.'));
+                initClass(mNrClasses, aName.str(), 0);
+
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aSignature);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aGeneric);
+            }
+            else {
+                continue;
+            }
+            aEnv->SetTag(aClassPtr[i], HEAPGRAPH_CLASS_TAG(mNrClasses));
+            mNrClasses++;
+        }
+        // the agent threads never return to Java, the class references are released here
+        for (i = 0; i < aCnt; i++) {
+            aJni->DeleteLocalRef(aClassPtr[i]);
+        }
+        /*SAPUNICODEOK_CHARTYPE*/
+        aJvmti->Deallocate((unsigned char*)aClassPtr);
+
+        (void)memsetR(&aCallbacks, 0, sizeofR(jvmtiHeapCallbacks));
+        aCallbacks.heap_reference_callback = THeapGraphCallback;
+        aResult = aEnv->FollowReferences(0, NULL, NULL, &aCallbacks, (void*)this);
+
+        mNodeFile.close();
+        mEdgeFile.close();
+        aEnv->DisposeEnvironment();
+        mSnapshotTime = TSystem::getTimestamp() - aStartTime;
+
+        if (aResult != JVMTI_ERROR_NONE) {
+            mState = HEAPGRAPH_ERROR;
+            aRootTag->addAttribute(cU("Result"), cU("Reference runner failed"));
+            return;
+        }
+        mState = HEAPGRAPH_ANALYSE;
+        mMutex->notify();
+
+        aRootTag->addAttribute(cU("Result"), cU("Analysis started"));
+        dumpState(aRootTag);
+    }
+    // ----------------------------------------------------
+    // THeapGraph::run
+    //! \brief Analyser thread loop
+    //!
+    //! Waits for a snapshot and computes the retained sizes
+    // ----------------------------------------------------
+    void run() {
+        jlong aStartTime;
+        bool  aSuccess;
+
+        for (;;) {
+            mMutex->enter();
+            while (mState != HEAPGRAPH_ANALYSE) {
+                mMutex->wait(0);
+            }
+            mMutex->exit();
+
+            aStartTime = TSystem::getTimestamp();
+            aSuccess   = analyse();
+
+            mMutex->enter();
+            mAnalyseTime = TSystem::getTimestamp() - aStartTime;
+            mState       = aSuccess ? HEAPGRAPH_READY : HEAPGRAPH_ERROR;
+            mMutex->exit();
+        }
+    }
+    // ----------------------------------------------------
+    // THeapGraph::dump
+    //! \brief List top retainers by class
+    //! \param aRootTag     The output tag list
+    //! \param aOptions     Dump options
+    //!         -m<size>    Minimum retained size
+    //!         -s<col>     Sort column
+    //!         -f<name>    Filter
+    // ----------------------------------------------------
+    void dump(
+            TXmlTag     *aRootTag,
+            TValues     *aOptions) {
+
+        TValues::iterator aPtrOptions;
+        THeapGraphClass  *aClass;
+        TXmlTag          *aTag;
+        TString           aColumnSort;
+        TString           aColumnFilter;
+        jlong             aMinSize  = 1;
+        jint              aCnt      = 0;
+        jint              i;
+        SAP_UC            aBuffer[32];
+
+        aColumnSort   = cU("RetainedSize");
+        aColumnFilter = cU(".");
+
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-m"), 2)) {
+                    aMinSize = TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-s"), 2)) {
+                    aColumnSort = (*aPtrOptions) + 2;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-f"), 2)) {
+                    aColumnFilter = (*aPtrOptions) + 2;
+                }
+            }
+        }
+
+        TMonitorLock aLock(mMutex);
+        if (mState != HEAPGRAPH_READY) {
+            dumpState(aRootTag);
+            return;
+        }
+
+        for (i = 0; i < mNrClasses; i++) {
+            aClass = &mClasses[i];
+            if (aClass->mRetained < aMinSize || aClass->mName->findWithWildcard(aColumnFilter.str(), cU('.')) == -1) {
+                continue;
+            }
+            if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
+                aTag = aRootTag->addTag(cU("Stack"));
+                aTag->addAttribute(cU("RetainedSize"), TString::parseInt(aClass->mRetained, aBuffer), PROPERTY_TYPE_INT);
+                aTag->addAttribute(cU("HeapSize"),     TString::parseInt(aClass->mShallow,  aBuffer), PROPERTY_TYPE_INT);
+                aTag->addAttribute(cU("HeapCount"),    TString::parseInt(aClass->mCount,    aBuffer), PROPERTY_TYPE_INT);
+                aTag->addAttribute(cU("ClassName"),    aClass->mName->str());
+                aTag->addAttribute(cU("ID"),           TString::parseHex(aClass->mID, aBuffer), PROPERTY_TYPE_HIDDEN);
+            }
+        }
+        aLock.exit();
+
+        if (aCnt > mProperties->getLimit(LIMIT_IO)) {
+            TString aString;
+            aString.concat(cU("Exceed Maximum Number of Entries "));
+            aString.concat(TString::parseInt(aCnt, aBuffer));
+            aRootTag->addAttribute(cU("Result"), aString.str());
+        }
+        aRootTag->qsort(aColumnSort.str());
+    }
+    // ----------------------------------------------------
+    // THeapGraph::dumpState
+    //! \brief Snapshot statistic
+    //! \param aRootTag The output tag list
+    // ----------------------------------------------------
+    void dumpState(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[32];
+        TXmlTag *aTag;
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"), cU("State"));
+        switch (mState) {
+            case HEAPGRAPH_ANALYSE: aTag->addAttribute(cU("Value"), cU("analyse")); break;
+            case HEAPGRAPH_READY:   aTag->addAttribute(cU("Value"), cU("ready"));   break;
+            case HEAPGRAPH_ERROR:   aTag->addAttribute(cU("Value"), cU("error"));   break;
+            default:                aTag->addAttribute(cU("Value"), cU("idle"));    break;
+        }
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("NrObjects"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrNodes, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("NrReferences"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrEdges, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("HeapSize"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mTotalSize, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("Truncated"));
+        aTag->addAttribute(cU("Value"), TString::parseBool(mTruncated, aBuffer));
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("SnapshotTime"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mSnapshotTime, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("AnalyseTime"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mAnalyseTime, aBuffer), PROPERTY_TYPE_INT);
+    }
+private:
+    // ----------------------------------------------------
+    // THeapGraph::reset
+    //! Release the result of the last analysis
+    // ----------------------------------------------------
+    void reset() {
+        jint i;
+
+        if (mClasses != NULL) {
+            for (i = 0; i < mNrClasses; i++) {
+                delete mClasses[i].mName;
+            }
+            delete [] mClasses;
+        }
+        mClasses      = NULL;
+        mNrClasses    = 0;
+        mNrNodes      = 0;
+        mNrEdges      = 0;
+        mTotalSize    = 0;
+        mTruncated    = false;
+        mSnapshotTime = 0;
+        mAnalyseTime  = 0;
+        mState        = HEAPGRAPH_IDLE;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::initClass
+    // ----------------------------------------------------
+    void initClass(jint aIndex, const SAP_UC *aName, jlong aID) {
+        mClasses[aIndex].mName     = new TString(aName);
+        mClasses[aIndex].mID       = aID;
+        mClasses[aIndex].mCount    = 0;
+        mClasses[aIndex].mShallow  = 0;
+        mClasses[aIndex].mRetained = 0;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::openFiles
+    //! \return \c TRUE if node and edge file are open
+    // ----------------------------------------------------
+    bool openFiles() {
+        TString aPath;
+
+        aPath = mFileName.str();
+        aPath.concat(cU(".nodes"));
+        mNodeFile.open(aPath.a7_str(), ios::out | ios::binary | ios::trunc);
+
+        aPath = mFileName.str();
+        aPath.concat(cU(".edges"));
+        mEdgeFile.open(aPath.a7_str(), ios::out | ios::binary | ios::trunc);
+
+        if (!mNodeFile.is_open() || !mEdgeFile.is_open()) {
+            mNodeFile.close();
+            mEdgeFile.close();
+            return false;
+        }
+        return true;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::addNode
+    //! \brief Stream a node to the node file
+    //! \param aClass The class index
+    //! \param aSize  The shallow size
+    //! \return The node ID
+    // ----------------------------------------------------
+    inline jint addNode(jint aClass, jlong aSize) {
+        mNodeFile.write((const char *)&aClass, sizeof(jint));
+        mNodeFile.write((const char *)&aSize,  sizeof(jlong));
+        return ++mNrNodes;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::addEdge
+    //! \brief Stream an edge to the edge file
+    //! \param aFrom The referrer, 0 for GC roots
+    //! \param aTo   The referenced node
+    // ----------------------------------------------------
+    inline void addEdge(jint aFrom, jint aTo) {
+        mEdgeFile.write((const char *)&aFrom, sizeof(jint));
+        mEdgeFile.write((const char *)&aTo,   sizeof(jint));
+        mNrEdges++;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::analyse
+    //! \brief Compute dominator tree and retained sizes
+    //!
+    //! Node 0 is the virtual root which references all GC roots.
+    //! The iterative Lengauer-Tarjan algorithm with path compression
+    //! computes the immediate dominators. Instances dominated by an
+    //! instance of the same class do not count for the class.
+    //! \return \c TRUE on success
+    // ----------------------------------------------------
+    bool analyse() {
+        jint      aNrNodes  = mNrNodes + 1;
+        jint     *aClassOf  = NULL;
+        jlong    *aSize     = NULL;
+        jint     *aSuccIdx  = NULL;
+        jint     *aSucc     = NULL;
+        jint     *aPredIdx  = NULL;
+        jint     *aPred     = NULL;
+        jint     *aSemi     = NULL;
+        jint     *aVertex   = NULL;
+        jint     *aParent   = NULL;
+        jint     *aAncestor = NULL;
+        jint     *aLabel    = NULL;
+        jint     *aIdom     = NULL;
+        jint     *aBucket   = NULL;
+        jint     *aNext     = NULL;
+        jint     *aStack    = NULL;
+        jint     *aIter     = NULL;
+        jint     *aOpen     = NULL;
+        jlong    *aRetained = NULL;
+        jint      aFrom;
+        jint      aTo;
+        jint      aClass;
+        jint      aDfs;
+        jint      aTop;
+        jint      v, w, u, i, k;
+        jlong     e;
+        TString   aPath;
+        ifstream  aFile;
+
+        if (mNrEdges >= 0x7FFFFFFF) {
+            return false;
+        }
+        aClassOf = new jint [aNrNodes];
+        aSize    = new jlong[aNrNodes];
+        aSuccIdx = new jint [aNrNodes + 1];
+        aPredIdx = new jint [aNrNodes + 1];
+
+        // Read nodes
+        aClassOf[0] = 0;
+        aSize[0]    = 0;
+        aPath = mFileName.str();
+        aPath.concat(cU(".nodes"));
+        aFile.open(aPath.a7_str(), ios::in | ios::binary);
+        for (v = 1; v < aNrNodes && aFile.good(); v++) {
+            aFile.read((char *)&aClassOf[v], sizeof(jint));
+            aFile.read((char *)&aSize[v],    sizeof(jlong));
+            if (aClassOf[v] < 0 || aClassOf[v] >= mNrClasses) {
+                aClassOf[v] = 0;
+            }
+        }
+        aFile.close();
+
+        // Read edges twice: count degrees, then fill adjacency
+        for (v = 0; v <= aNrNodes; v++) {
+            aSuccIdx[v] = 0;
+            aPredIdx[v] = 0;
+        }
+        aPath = mFileName.str();
+        aPath.concat(cU(".edges"));
+        aFile.open(aPath.a7_str(), ios::in | ios::binary);
+        for (e = 0; e < mNrEdges; e++) {
+            aFile.read((char *)&aFrom, sizeof(jint));
+            aFile.read((char *)&aTo,   sizeof(jint));
+            if (!aFile.good()) {
+                break;
+            }
+            if (validEdge(aFrom, aTo, aNrNodes)) {
+                aSuccIdx[aFrom + 1]++;
+                aPredIdx[aTo   + 1]++;
+            }
+        }
+        mNrEdges = e;
+        for (v = 0; v < aNrNodes; v++) {
+            aSuccIdx[v + 1] += aSuccIdx[v];
+            aPredIdx[v + 1] += aPredIdx[v];
+        }
+        aSucc = new jint[aSuccIdx[aNrNodes] + 1];
+        aPred = new jint[aPredIdx[aNrNodes] + 1];
+        aIter = new jint[aNrNodes];
+        aNext = new jint[aNrNodes];
+
+        for (v = 0; v < aNrNodes; v++) {
+            aIter[v] = aSuccIdx[v];
+            aNext[v] = aPredIdx[v];
+        }
+        aFile.clear();
+        aFile.seekg(0, ios::beg);
+        for (e = 0; e < mNrEdges; e++) {
+            aFile.read((char *)&aFrom, sizeof(jint));
+            aFile.read((char *)&aTo,   sizeof(jint));
+            if (validEdge(aFrom, aTo, aNrNodes)) {
+                aSucc[aIter[aFrom]++] = aTo;
+                aPred[aNext[aTo]++]   = aFrom;
+            }
+        }
+        aFile.close();
+
+        // Depth first search from the root, semi holds the DFS number
+        aSemi     = new jint[aNrNodes];
+        aVertex   = new jint[aNrNodes + 1];
+        aParent   = new jint[aNrNodes];
+        aAncestor = new jint[aNrNodes];
+        aLabel    = new jint[aNrNodes];
+        aIdom     = new jint[aNrNodes];
+        aBucket   = new jint[aNrNodes];
+        aStack    = new jint[aNrNodes + 1];
+
+        for (v = 0; v < aNrNodes; v++) {
+            aSemi[v]     = 0;
+            aParent[v]   = HEAPGRAPH_NONE;
+            aAncestor[v] = HEAPGRAPH_NONE;
+            aLabel[v]    = v;
+            aIdom[v]     = HEAPGRAPH_NONE;
+            aBucket[v]   = HEAPGRAPH_NONE;
+            aIter[v]     = aSuccIdx[v];
+        }
+        aDfs          = 0;
+        aTop          = 0;
+        aStack[aTop++]= 0;
+        aSemi[0]      = ++aDfs;
+        aVertex[aDfs] = 0;
+
+        while (aTop > 0) {
+            v = aStack[aTop - 1];
+            if (aIter[v] < aSuccIdx[v + 1]) {
+                w = aSucc[aIter[v]++];
+                if (aSemi[w] == 0) {
+                    aParent[w]    = v;
+                    aSemi[w]      = ++aDfs;
+                    aVertex[aDfs] = w;
+                    aStack[aTop++]= w;
+                }
+            }
+            else {
+                aTop--;
+            }
+        }
+
+        // Semidominators and implicit immediate dominators
+        for (i = aDfs; i >= 2; i--) {
+            w = aVertex[i];
+            for (k = aPredIdx[w]; k < aPredIdx[w + 1]; k++) {
+                v = aPred[k];
+                if (aSemi[v] == 0) {
+                    continue;
+                }
+                u = eval(v, aAncestor, aLabel, aSemi, aStack);
+                if (aSemi[u] < aSemi[w]) {
+                    aSemi[w] = aSemi[u];
+                }
+            }
+            u          = aVertex[aSemi[w]];
+            aNext[w]   = aBucket[u];
+            aBucket[u] = w;
+            aAncestor[w] = aParent[w];
+
+            u = aParent[w];
+            for (v = aBucket[u]; v != HEAPGRAPH_NONE; v = aNext[v]) {
+                k = eval(v, aAncestor, aLabel, aSemi, aStack);
+                aIdom[v] = (aSemi[k] < aSemi[v]) ? k : u;
+            }
+            aBucket[u] = HEAPGRAPH_NONE;
+        }
+        for (i = 2; i <= aDfs; i++) {
+            w = aVertex[i];
+            if (aIdom[w] != aVertex[aSemi[w]]) {
+                aIdom[w] = aIdom[aIdom[w]];
+            }
+        }
+        aIdom[0] = 0;
+
+        delete [] aSucc;
+        delete [] aPred;
+        delete [] aPredIdx;
+        delete [] aAncestor;
+        delete [] aLabel;
+        delete [] aBucket;
+        delete [] aParent;
+
+        // Retained sizes bottom up in reverse DFS order
+        aRetained = new jlong[aNrNodes];
+        for (v = 0; v < aNrNodes; v++) {
+            aRetained[v] = aSize[v];
+        }
+        for (i = aDfs; i >= 2; i--) {
+            w = aVertex[i];
+            aRetained[aIdom[w]] += aRetained[w];
+        }
+
+        // Dominator tree as adjacency, reusing the successor index
+        for (v = 0; v <= aNrNodes; v++) {
+            aSuccIdx[v] = 0;
+        }
+        for (i = 2; i <= aDfs; i++) {
+            aSuccIdx[aIdom[aVertex[i]] + 1]++;
+        }
+        for (v = 0; v < aNrNodes; v++) {
+            aSuccIdx[v + 1] += aSuccIdx[v];
+            aIter[v]         = aSuccIdx[v];
+        }
+        for (i = 2; i <= aDfs; i++) {
+            w = aVertex[i];
+            aSemi[aIter[aIdom[w]]++] = w;
+        }
+
+        // Walk the dominator tree, aOpen counts open instances per class
+        TMonitorLock aLock(mMutex);
+        aOpen = new jint[mNrClasses];
+        for (aClass = 0; aClass < mNrClasses; aClass++) {
+            aOpen[aClass] = 0;
+        }
+        for (i = 2; i <= aDfs; i++) {
+            w = aVertex[i];
+            mClasses[aClassOf[w]].mCount   ++;
+            mClasses[aClassOf[w]].mShallow += aSize[w];
+        }
+        for (v = 0; v < aNrNodes; v++) {
+            aIter[v] = aSuccIdx[v];
+        }
+        aTop = 0;
+        aStack[aTop++] = 0;
+
+        while (aTop > 0) {
+            v = aStack[aTop - 1];
+            if (aIter[v] < aSuccIdx[v + 1]) {
+                w      = aSemi[aIter[v]++];
+                aClass = aClassOf[w];
+                if (aOpen[aClass] == 0) {
+                    mClasses[aClass].mRetained += aRetained[w];
+                }
+                aOpen[aClass]++;
+                aStack[aTop++] = w;
+            }
+            else {
+                aTop--;
+                if (v != 0) {
+                    aOpen[aClassOf[v]]--;
+                }
+            }
+        }
+        mTotalSize = aRetained[0];
+        aLock.exit();
+
+        delete [] aClassOf;
+        delete [] aSize;
+        delete [] aSuccIdx;
+        delete [] aSemi;
+        delete [] aVertex;
+        delete [] aIdom;
+        delete [] aNext;
+        delete [] aStack;
+        delete [] aIter;
+        delete [] aOpen;
+        delete [] aRetained;
+        return true;
+    }
+    // ----------------------------------------------------
+    // THeapGraph::validEdge
+    //! \return \c TRUE if both nodes are within the graph
+    // ----------------------------------------------------
+    static inline bool validEdge(jint aFrom, jint aTo, jint aNrNodes) {
+        return (aFrom >= 0 && aFrom < aNrNodes && aTo >= 0 && aTo < aNrNodes);
+    }
+    // ----------------------------------------------------
+    // THeapGraph::eval
+    //! \brief Evaluate with iterative path compression
+    //! \return The vertex with minimal semidominator on the path
+    // ----------------------------------------------------
+    static inline jint eval(
+            jint     v,
+            jint    *aAncestor,
+            jint    *aLabel,
+            jint    *aSemi,
+            jint    *aStack) {
+
+        jint aTop = 0;
+        jint x    = v;
+        jint a;
+
+        if (aAncestor[v] == HEAPGRAPH_NONE) {
+            return v;
+        }
+        while (aAncestor[aAncestor[x]] != HEAPGRAPH_NONE) {
+            aStack[aTop++] = x;
+            x = aAncestor[x];
+        }
+        while (aTop > 0) {
+            x = aStack[--aTop];
+            a = aAncestor[x];
+            if (aSemi[aLabel[a]] < aSemi[aLabel[x]]) {
+                aLabel[x] = aLabel[a];
+            }
+            aAncestor[x] = aAncestor[a];
+        }
+        return aLabel[v];
+    }
+};
+
+#define HPROF_ACC_STATIC        0x0008      //!< Field modifier static
+#define HPROF_SEGMENT_SIZE      0x1000000   //!< Size of a heap dump segment
+#define HPROF_BUFFER_SIZE       0x10000     //!< Size of the file buffer
+#define HPROF_LOCAL_REFS        16          //!< Local references of the class setup beside the classes
+#define HPROF_MAX_OBJECTS       0x3FFFFFFF  //!< Object serial range
+#define HPROF_STACK_SERIAL      1           //!< Serial of the empty stack trace
+
+#define HPROF_PASS_TAG          0           //!< Tag objects for a partial dump
+#define HPROF_PASS_WRITE        1           //!< Write reachable objects
+#define HPROF_PASS_FINISH       2           //!< Write objects without references
+
+#define HPROF_OPEN_NONE         0           //!< No open record
+#define HPROF_OPEN_INSTANCE     1           //!< Open instance dump
+#define HPROF_OPEN_ARRAY        2           //!< Open object array dump
+#define HPROF_OPEN_CLASS        3           //!< Open class dump
+
+#define HPROF_UTF8              0x01        //!< Record string
+#define HPROF_LOAD_CLASS        0x02        //!< Record load class
+#define HPROF_TRACE             0x05        //!< Record stack trace
+#define HPROF_HEAP_DUMP_SEGMENT 0x1C        //!< Record heap dump segment
+#define HPROF_HEAP_DUMP_END     0x2C        //!< Record heap dump end
+
+#define HPROF_GC_ROOT_UNKNOWN       0xFF    //!< Sub record unknown root
+#define HPROF_GC_ROOT_JNI_GLOBAL    0x01    //!< Sub record JNI global
+#define HPROF_GC_ROOT_JNI_LOCAL     0x02    //!< Sub record JNI local
+#define HPROF_GC_ROOT_JAVA_FRAME    0x03    //!< Sub record stack local
+#define HPROF_GC_ROOT_STICKY_CLASS  0x05    //!< Sub record system class
+#define HPROF_GC_ROOT_MONITOR_USED  0x07    //!< Sub record monitor
+#define HPROF_GC_ROOT_THREAD_OBJ    0x08    //!< Sub record thread
+#define HPROF_GC_CLASS_DUMP         0x20    //!< Sub record class
+#define HPROF_GC_INSTANCE_DUMP      0x21    //!< Sub record instance
+#define HPROF_GC_OBJ_ARRAY_DUMP     0x22    //!< Sub record object array
+#define HPROF_GC_PRIM_ARRAY_DUMP    0x23    //!< Sub record primitive array
+
+#define HPROF_NORMAL_OBJECT     2           //!< Basic type object
+#define HPROF_BOOLEAN           4           //!< Basic type boolean
+#define HPROF_CHAR              5           //!< Basic type char
+#define HPROF_FLOAT             6           //!< Basic type float
+#define HPROF_DOUBLE            7           //!< Basic type double
+#define HPROF_BYTE              8           //!< Basic type byte
+#define HPROF_SHORT             9           //!< Basic type short
+#define HPROF_INT               10          //!< Basic type int
+#define HPROF_LONG              11          //!< Basic type long
+
+//! Object tag with serial and array length in the private environment
+#define HPROF_NODE_TAG(n, l)    ((((jlong)(l) + 1) << 32) | (((jlong)(n)) << 2) | 1)
+//! Object tag flag for objects written to a partial dump
+#define HPROF_INCLUDED          ((jlong)2)
+//! Serial of an object tag
+#define HPROF_SERIAL(t)         ((jint)(((t) >> 2) & HPROF_MAX_OBJECTS))
+//! Array length of an object tag or -1
+#define HPROF_LENGTH(t)         ((jint)(((t) >> 32) & 0xFFFFFFFF) - 1)
+//! Dump ID of an object
+#define HPROF_OBJECT_ID(n)      (((jlong)(n)) << 1)
+//! Dump ID of a class
+#define HPROF_CLASS_ID(c)       ((((jlong)(c)) << 1) | 1)
+//! Dump ID of a string
+#define HPROF_STRING_ID(s)      ((((jlong)1) << 48) + (s))
+
+// ---------------------------------------------------------
+//! \struct THprofField
+//! \brief Field layout of a heap dump class
+// ---------------------------------------------------------
+typedef struct {
+    jlong          mNameID;             //!< String ID of the name
+    jint           mType;               //!< HPROF basic type
+    jint           mOffset;             //!< Offset in the value buffer or -1
+    bool           mStatic;             //!< Static field
+} THprofField;
+
+// ---------------------------------------------------------
+//! \struct THprofClass
+//! \brief Class entry of a heap dump
+// ---------------------------------------------------------
+typedef struct {
+    jclass         mClass;              //!< Class reference during setup
+    TString       *mName;               //!< Java name for the filter
+    jlong          mNameID;             //!< String ID of the internal name
+    jint           mSuper;              //!< Index of the super class or 0
+    jint           mArrayType;          //!< Element type of arrays or 0
+    jint           mNrDeclared;         //!< Number of declared fields
+    THprofField   *mDeclared;           //!< Declared fields in class file order
+    jint           mNrStatics;          //!< Number of static fields
+    jint           mStaticBytes;        //!< Size of the static values
+    jint           mNrFields;           //!< Number of instance fields
+    jint           mOwnBytes;           //!< Size of the declared instance values
+    jint           mInstanceBytes;      //!< Size of the instance values with super classes
+    jint           mNrIfaceFields;      //!< Leading field indices of interfaces
+    jint           mNrIndex;            //!< Number of JVMTI field indices
+    THprofField   *mIndex;              //!< Layout by JVMTI field index
+    jint           mLayout;             //!< Layout state 0: none, 1: busy, 2: done
+    bool           mSelected;           //!< Class matches the filter
+    bool           mWritten;            //!< Class dump written
+} THprofClass;
+
+// ---------------------------------------------------------
+// THeapDump::referenceCallback
+//! \brief Callback for references of the heap dump
+//! \see THeapGraphCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpReferenceCallback(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                          aRefClassTag,
+            jlong                          aSize,
+            jlong                         *aTag,
+            jlong                         *aRefTag,
+            jint                           aLength,
+            void                          *aUserData);
+
+// ---------------------------------------------------------
+// THeapDump::fieldCallback
+//! \brief Callback for primitive fields of the heap dump
+//! \param  aKind           Instance or static field
+//! \param  aInfo           Field index
+//! \param  aClassTag       The tag of the class of the object
+//! \param  aTag            The tag of the object
+//! \param  aValue          The field value
+//! \param  aType           The field type
+//! \param  aUserData       The heap dump
+//! \return Visit control
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpFieldCallback(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                         *aTag,
+            jvalue                         aValue,
+            jvmtiPrimitiveType             aType,
+            void                          *aUserData);
+
+// ---------------------------------------------------------
+// THeapDump::arrayCallback
+//! \brief Callback for primitive arrays of the heap dump
+//! \param  aClassTag       The tag of the array class
+//! \param  aSize           The size of the array
+//! \param  aTag            The tag of the array
+//! \param  aCount          Number of elements
+//! \param  aType           The element type
+//! \param  aElements       The array content
+//! \param  aUserData       The heap dump
+//! \return Visit control
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpArrayCallback(
+            jlong                          aClassTag,
+            jlong                          aSize,
+            jlong                         *aTag,
+            jint                           aCount,
+            jvmtiPrimitiveType             aType,
+            const void                    *aElements,
+            void                          *aUserData);
+
+// ---------------------------------------------------------
+// THeapDump::iterationCallback
+//! \brief Callback for objects not written by the reference runner
+//! \param  aClassTag       The tag of the class
+//! \param  aSize           The size of the object
+//! \param  aTag            The tag of the object
+//! \param  aLength         Array length or -1
+//! \param  aUserData       The heap dump
+//! \return Visit control
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapDumpIterationCallback(
+            jlong                          aClassTag,
+            jlong                          aSize,
+            jlong                         *aTag,
+            jint                           aLength,
+            void                          *aUserData);
+
+// ----------------------------------------------------
+//! \class THeapDump
+//! \brief Streaming HPROF writer
+//!
+//! The dump follows the references from the GC roots in a private
+//! tool environment and writes each object as soon as the reference
+//! runner has reported its fields. The dump keeps the class layouts
+//! and one written bit per object, the tool interface keeps a tag for
+//! each visited object until the private environment is disposed, so
+//! memory grows with the number of objects. The tags are needed for the
+//! object IDs in all passes and cannot be released earlier, the object
+//! limit bounds the memory of large heaps. The records are collected
+//! in heap dump segments of limited size. A partial dump writes instances of
+//! the filtered classes and the objects they refer to directly.
+// ----------------------------------------------------
+class THeapDump {
+    friend jint JNICALL THeapDumpReferenceCallback(
+            jvmtiHeapReferenceKind, const jvmtiHeapReferenceInfo*,
+            jlong, jlong, jlong, jlong*, jlong*, jint, void*);
+    friend jint JNICALL THeapDumpFieldCallback(
+            jvmtiHeapReferenceKind, const jvmtiHeapReferenceInfo*,
+            jlong, jlong*, jvalue, jvmtiPrimitiveType, void*);
+    friend jint JNICALL THeapDumpArrayCallback(
+            jlong, jlong, jlong*, jint, jvmtiPrimitiveType, const void*, void*);
+    friend jint JNICALL THeapDumpIterationCallback(
+            jlong, jlong, jlong*, jint, void*);
+private:
+    static THeapDump   *mInstance;      //!< Singleton
+    TProperties        *mProperties;    //!< Configuration
+    TString             mFileName;      //!< Dump file
+    ofstream            mFile;          //!< Dump stream
+    char               *mBuffer;        //!< Dump stream buffer
+    THprofClass        *mClasses;       //!< Class table
+    jint                mNrClasses;     //!< Number of classes
+    jint                mNrStrings;     //!< Number of strings
+    jint                mNrObjects;     //!< Number of tagged objects
+    jint                mNrWritten;     //!< Number of written objects
+    unsigned char      *mWrittenBits;   //!< Written flag by object serial
+    jint                mWrittenSize;   //!< Size of the written flags
+    jbyte              *mValues;        //!< Values of the open record
+    jint                mPass;          //!< Current pass
+    bool                mPartial;       //!< Dump only filtered classes
+    bool                mTruncated;     //!< Size or object limit reached
+    bool                mSwap;          //!< Little endian platform
+    jlong               mElide;         //!< Primitive arrays above this size are written empty
+    jlong               mMaxBytes;      //!< Size limit of the dump
+    jint                mMaxObjects;    //!< Object limit of the dump
+    jlong               mSize;          //!< Bytes written
+    jlong               mSegment;       //!< Position of the segment length or -1
+    jint                mOpen;          //!< Kind of the open record
+    jint                mOpenSerial;    //!< Object serial or class index of the open record
+    jint                mOpenClass;     //!< Class index of the open object
+    jint                mOpenLength;    //!< Length of the open array
+    jint                mOpenIndex;     //!< Next element of the open array
+    jlong               mOpenLoader;    //!< Class loader of the open class
+    jlong               mOpenSigners;   //!< Signers of the open class
+    jlong               mOpenDomain;    //!< Protection domain of the open class
+    // ----------------------------------------------------
+    // THeapDump::THeapDump
+    //! Constructor
+    // ----------------------------------------------------
+    THeapDump() {
+        jint aOne     = 1;
+        mProperties   = TProperties::getInstance();
+        mBuffer       = new char[HPROF_BUFFER_SIZE];
+        mClasses      = NULL;
+        mNrClasses    = 0;
+        mNrStrings    = 0;
+        mNrObjects    = 0;
+        mNrWritten    = 0;
+        mWrittenBits  = NULL;
+        mWrittenSize  = 0;
+        mValues       = NULL;
+        mPass         = HPROF_PASS_WRITE;
+        mPartial      = false;
+        mTruncated    = false;
+        mSwap         = (*(char *)&aOne == 1);
+        mElide        = -1;
+        mMaxObjects   = HPROF_MAX_OBJECTS;
+        mMaxBytes     = 0;
+        mSize         = 0;
+        mSegment      = -1;
+        mOpen         = HPROF_OPEN_NONE;
+        mFileName     = cU("sherlok.hprof");
+    }
+    // ----------------------------------------------------
+    // THeapDump::THeapDump
+    //! Copy constructor
+    // ----------------------------------------------------
+    THeapDump(const THeapDump &) {
+    }
+public:
+    // ----------------------------------------------------
+    // THeapDump::getInstance
+    //! Singleton constructor
+    // ----------------------------------------------------
+    static THeapDump *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new THeapDump();
+        }
+        return mInstance;
+    }
+    // ----------------------------------------------------
+    // THeapDump::dump
+    //! \brief Write the heap in HPROF format
+    //! \param aJvmti       The Java tool interface
+    //! \param aJni         The Java native interface
+    //! \param aRootTag     The output tag list
+    //! \param aOptions     Dump options
+    //!         -o<file>    Dump file
+    //!         -f<filter>  Write only matching classes and their referents
+    //!         -e[<size>]  Write primitive arrays above size without content
+    //!         -l<MB>      Maximum size of the dump
+    //!         -n<number>  Maximum number of objects
+    // ----------------------------------------------------
+    void dump(
+            jvmtiEnv    *aJvmti,
+            JNIEnv      *aJni,
+            TXmlTag     *aRootTag,
+            TValues     *aOptions) {
+
+        TValues::iterator   aPtrOptions;
+        jvmtiEnv           *aEnv        = NULL;
+        jvmtiHeapCallbacks  aCallbacks;
+        jvmtiError          aResult;
+        jint                i;
+        jint                aCnt        = 0;
+        jclass             *aClassPtr   = NULL;
+        jint                aMaxValues  = 0;
+        jint               *aList;
+        jint               *aMark;
+        jlong               aStartTime;
+        TString             aFilter;
+        TXmlTag            *aTag;
+        SAP_UC              aBuffer[32];
+
+        mPartial  = false;
+        mElide    = -1;
+        mMaxBytes = 0;
+        mMaxObjects = HPROF_MAX_OBJECTS;
+
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-o"), 2) && STRLEN(*aPtrOptions) > 2) {
+                    mFileName = (*aPtrOptions) + 2;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-f"), 2) && STRLEN(*aPtrOptions) > 2) {
+                    aFilter  = (*aPtrOptions) + 2;
+                    mPartial = true;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-e"), 2)) {
+                    mElide = TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-l"), 2)) {
+                    mMaxBytes = TString::toInteger(*aPtrOptions + 2) * 0x100000;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-n"), 2)) {
+                    mMaxObjects = (jint)min((jlong)HPROF_MAX_OBJECTS, max((jlong)1, (jlong)TString::toInteger(*aPtrOptions + 2)));
+                }
+            }
+        }
+        aStartTime = TSystem::getTimestamp();
+
+        aEnv = THeapGraph::getPrivateEnv(aJvmti);
+        if (aEnv == NULL) {
+            aRootTag->addAttribute(cU("Result"), cU("No private tool interface"));
+            return;
+        }
+
+        mFile.rdbuf()->pubsetbuf(mBuffer, HPROF_BUFFER_SIZE);
+        mFile.open(mFileName.a7_str(), ios::out | ios::binary | ios::trunc);
+        if (!mFile.is_open()) {
+            aEnv->DisposeEnvironment();
+            aRootTag->addAttribute(cU("Result"), cU("Cannot open dump file"));
+            return;
+        }
+        mSize       = 0;
+        mSegment    = -1;
+        mNrStrings  = 0;
+        mNrObjects  = 0;
+        mNrWritten  = 0;
+        mTruncated  = false;
+        mOpen       = HPROF_OPEN_NONE;
+
+        /*SAPUNICODEOK_CHARTYPE*/
+        putBytes("JAVA PROFILE 1.0.2", 19);
+        putU4(sizeof(jlong));
+        putU8(TSystem::getTimestamp());
+
+        // Classes with names, field layout and private class tag. The agent threads
+        // never return to Java, the local frame releases the class references
+        aJni->PushLocalFrame(HPROF_LOCAL_REFS);
+        aEnv->GetLoadedClasses(&aCnt, &aClassPtr);
+        aJni->EnsureLocalCapacity(2 * aCnt + HPROF_LOCAL_REFS);
+        mNrClasses = aCnt + 1;
+        mClasses   = new THprofClass[mNrClasses];
+        initClass(0, NULL);
+        mClasses[0].mName    = new TString(cU("<unknown>"));
+        mClasses[0].mNameID  = putString("<unknown>", 9);
+
+        for (i = 1; i < mNrClasses; i++) {
+            initClass(i, aClassPtr[i - 1]);
+            aEnv->SetTag(aClassPtr[i - 1], HEAPGRAPH_CLASS_TAG(i));
+        }
+        for (i = 1; i < mNrClasses; i++) {
+            registerClass(aEnv, aJni, i, aFilter.str());
+        }
+        aList = new jint[mNrClasses];
+        aMark = new jint[mNrClasses];
+        for (i = 0; i < mNrClasses; i++) {
+            aMark[i] = 0;
+        }
+        for (i = 1; i < mNrClasses; i++) {
+            layoutClass(aEnv, i, aList, aMark);
+            aMaxValues = max(aMaxValues, max(mClasses[i].mInstanceBytes, mClasses[i].mStaticBytes));
+        }
+        delete [] aList;
+        delete [] aMark;
+        /*SAPUNICODEOK_CHARTYPE*/
+        aEnv->Deallocate((unsigned char*)aClassPtr);
+        aJni->PopLocalFrame(NULL);
+        for (i = 0; i < mNrClasses; i++) {
+            mClasses[i].mClass = NULL;
+        }
+        mValues = new jbyte[aMaxValues + 1];
+
+        for (i = 0; i < mNrClasses; i++) {
+            putRecord(HPROF_LOAD_CLASS, 4 + sizeof(jlong) + 4 + sizeof(jlong));
+            putU4(i + 1);
+            putU8(HPROF_CLASS_ID(i));
+            putU4(HPROF_STACK_SERIAL);
+            putU8(mClasses[i].mNameID);
+        }
+        putRecord(HPROF_TRACE, 12);
+        putU4(HPROF_STACK_SERIAL);
+        putU4(0);
+        putU4(0);
+
+        // Partial dumps need all referents tagged before writing
+        (void)memsetR(&aCallbacks, 0, sizeofR(jvmtiHeapCallbacks));
+        aCallbacks.heap_reference_callback = THeapDumpReferenceCallback;
+        aResult = JVMTI_ERROR_NONE;
+
+        if (mPartial) {
+            mPass   = HPROF_PASS_TAG;
+            aResult = aEnv->FollowReferences(0, NULL, NULL, &aCallbacks, (void*)this);
+        }
+        if (aResult == JVMTI_ERROR_NONE && !mTruncated) {
+            mPass = HPROF_PASS_WRITE;
+            putUnknownClass();
+            aCallbacks.primitive_field_callback       = THeapDumpFieldCallback;
+            aCallbacks.array_primitive_value_callback = THeapDumpArrayCallback;
+            aResult = aEnv->FollowReferences(0, NULL, NULL, &aCallbacks, (void*)this);
+            closeRecord();
+        }
+        if (aResult == JVMTI_ERROR_NONE && !mTruncated) {
+            mPass = HPROF_PASS_FINISH;
+            aCallbacks.heap_reference_callback  = NULL;
+            aCallbacks.primitive_field_callback = NULL;
+            aCallbacks.heap_iteration_callback  = THeapDumpIterationCallback;
+            aResult = aEnv->IterateThroughHeap(JVMTI_HEAP_FILTER_UNTAGGED, NULL, &aCallbacks, (void*)this);
+            closeRecord();
+        }
+        closeSegment();
+        putRecord(HPROF_HEAP_DUMP_END, 0);
+        mFile.close();
+        aEnv->DisposeEnvironment();
+        reset();
+
+        if (aResult != JVMTI_ERROR_NONE) {
+            aRootTag->addAttribute(cU("Result"), cU("Reference runner failed"));
+        }
+        else if (mTruncated) {
+            aRootTag->addAttribute(cU("Result"), cU("Heap dump truncated"));
+        }
+        else {
+            aRootTag->addAttribute(cU("Result"), cU("Heap dump written"));
+        }
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("File"));
+        aTag->addAttribute(cU("Value"), mFileName.str());
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("NrObjects"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrWritten, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("NrClasses"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrClasses, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("FileSize"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mSize, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("DumpTime"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(TSystem::getTimestamp() - aStartTime, aBuffer), PROPERTY_TYPE_INT);
+    }
+private:
+    // ----------------------------------------------------
+    // THeapDump::reset
+    //! Release class layouts and object flags
+    // ----------------------------------------------------
+    void reset() {
+        jint i;
+
+        if (mClasses != NULL) {
+            for (i = 0; i < mNrClasses; i++) {
+                delete mClasses[i].mName;
+                delete [] mClasses[i].mDeclared;
+                delete [] mClasses[i].mIndex;
+            }
+            delete [] mClasses;
+        }
+        delete [] mWrittenBits;
+        delete [] mValues;
+        mClasses     = NULL;
+        mWrittenBits = NULL;
+        mValues      = NULL;
+        mWrittenSize = 0;
+    }
+    // ----------------------------------------------------
+    // THeapDump::initClass
+    // ----------------------------------------------------
+    void initClass(jint aIndex, jclass aClass) {
+        THprofClass *aEntry = &mClasses[aIndex];
+
+        aEntry->mClass          = aClass;
+        aEntry->mName           = NULL;
+        aEntry->mNameID         = 0;
+        aEntry->mSuper          = 0;
+        aEntry->mArrayType      = 0;
+        aEntry->mNrDeclared     = 0;
+        aEntry->mDeclared       = NULL;
+        aEntry->mNrStatics      = 0;
+        aEntry->mStaticBytes    = 0;
+        aEntry->mNrFields       = 0;
+        aEntry->mOwnBytes       = 0;
+        aEntry->mInstanceBytes  = 0;
+        aEntry->mNrIfaceFields  = 0;
+        aEntry->mNrIndex        = 0;
+        aEntry->mIndex          = NULL;
+        aEntry->mLayout         = 2;
+        aEntry->mSelected       = false;
+        aEntry->mWritten        = false;
+    }
+    // ----------------------------------------------------
+    // THeapDump::registerClass
+    //! \brief Write the names and collect the declared fields
+    //! \param aEnv     The private tool interface
+    //! \param aJni     The Java native interface
+    //! \param aIndex   The class index
+    //! \param aFilter  The class name filter of a partial dump
+    // ----------------------------------------------------
+    void registerClass(
+            jvmtiEnv     *aEnv,
+            JNIEnv       *aJni,
+            jint          aIndex,
+            const SAP_UC *aFilter) {
+
+        THprofClass  *aEntry  = &mClasses[aIndex];
+        THprofField  *aField;
+        jclass        jSuper;
+        jfieldID     *aFields = NULL;
+        jint          aCnt    = 0;
+        jint          aModifiers;
+        jlong         aTag    = 0;
+        jint          i;
+        char         *aSignature;
+        char         *aGeneric;
+        char         *aName;
+        TString       aJavaName;
+
+        if (aEnv->GetClassSignature(aEntry->mClass, &aSignature, &aGeneric) != JVMTI_ERROR_NONE) {
+            aEntry->mName   = new TString(cU("<unknown>"));
+            aEntry->mNameID = mClasses[0].mNameID;
+            return;
+        }
+        // Internal names as java/lang/String or [Ljava/lang/String;
+        if (aSignature[0] == 'L') {
+            aEntry->mNameID = putString(aSignature + 1, STRLEN_A7(aSignature) - 2);
+            aJavaName.assignR(aSignature + 1, STRLEN_A7(aSignature) - 2);
+        }
+        else {
+            aEntry->mNameID    = putString(aSignature, STRLEN_A7(aSignature));
+            aEntry->mArrayType = (aSignature[0] == '[') ? getType(aSignature[1]) : 0;
+            aJavaName.assignR(aSignature, STRLEN_A7(aSignature));
+        }
+        aJavaName.replace(cU('/'), cU('.'));
+        aEntry->mName     = new TString(aJavaName.str());
+        aEntry->mSelected = mPartial && aJavaName.findWithWildcard(aFilter, cU('.')) != -1;
+
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aSignature);
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aGeneric);
+
+        jSuper = aJni->GetSuperclass(aEntry->mClass);
+        if (jSuper != NULL) {
+            aEnv->GetTag(jSuper, &aTag);
+            if (aTag != 0 && !HEAPGRAPH_IS_NODE(aTag)) {
+                aEntry->mSuper = HEAPGRAPH_TAG_VALUE(aTag);
+            }
+        }
+        aEntry->mLayout = 0;
+
+        if (aEntry->mArrayType != 0 ||
+            aEnv->GetClassFields(aEntry->mClass, &aCnt, &aFields) != JVMTI_ERROR_NONE) {
+            return;
+        }
+        aEntry->mNrDeclared = aCnt;
+        aEntry->mDeclared   = new THprofField[aCnt + 1];
+
+        for (i = 0; i < aCnt; i++) {
+            aField          = &aEntry->mDeclared[i];
+            aField->mNameID = 0;
+            aField->mType   = HPROF_INT;
+            aField->mStatic = false;
+            aModifiers      = 0;
+
+            if (aEnv->GetFieldName(aEntry->mClass, aFields[i], &aName, &aSignature, &aGeneric) == JVMTI_ERROR_NONE) {
+                aField->mNameID = putString(aName, STRLEN_A7(aName));
+                aField->mType   = getType(aSignature[0]);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aName);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aSignature);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aGeneric);
+            }
+            aEnv->GetFieldModifiers(aEntry->mClass, aFields[i], &aModifiers);
+
+            if ((aModifiers & HPROF_ACC_STATIC) != 0) {
+                aField->mStatic        = true;
+                aField->mOffset        = aEntry->mStaticBytes;
+                aEntry->mStaticBytes  += getSize(aField->mType);
+                aEntry->mNrStatics    ++;
+            }
+            else {
+                aField->mOffset        = aEntry->mOwnBytes;
+                aEntry->mOwnBytes     += getSize(aField->mType);
+                aEntry->mNrFields     ++;
+            }
+        }
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aFields);
+    }
+    // ----------------------------------------------------
+    // THeapDump::layoutClass
+    //! \brief Map the JVMTI field index to the dump layout
+    //!
+    //! The JVMTI index counts the fields of all transitive
+    //! interfaces, then the fields of the super classes from
+    //! java.lang.Object downwards and finally the declared fields.
+    //! Instance values are written declared fields first.
+    //! \param aEnv     The private tool interface
+    //! \param aIndex   The class index
+    //! \param aList    Work list for the interfaces
+    //! \param aMark    Visit mark for the interfaces
+    // ----------------------------------------------------
+    void layoutClass(
+            jvmtiEnv     *aEnv,
+            jint          aIndex,
+            jint         *aList,
+            jint         *aMark) {
+
+        THprofClass *aEntry = &mClasses[aIndex];
+        THprofClass *aSuper = NULL;
+        THprofField *aField;
+        jint         aCnt   = 0;
+        jint         aFrom  = 0;
+        jint         i, k;
+
+        if (aEntry->mLayout != 0) {
+            return;
+        }
+        aEntry->mLayout = 1;
+        if (aEntry->mSuper > 0) {
+            layoutClass(aEnv, aEntry->mSuper, aList, aMark);
+            aSuper = &mClasses[aEntry->mSuper];
+        }
+
+        collectInterfaces(aEnv, aIndex, aIndex, aList, &aCnt, aMark);
+        for (i = 0; i < aCnt; i++) {
+            aEntry->mNrIfaceFields += mClasses[aList[i]].mNrDeclared;
+        }
+
+        if (aSuper != NULL) {
+            aFrom = aSuper->mNrIfaceFields;
+            aEntry->mInstanceBytes = aSuper->mInstanceBytes;
+            aEntry->mNrIndex       = aSuper->mNrIndex - aFrom;
+        }
+        aEntry->mInstanceBytes += aEntry->mOwnBytes;
+        aEntry->mNrIndex       += aEntry->mNrIfaceFields + aEntry->mNrDeclared;
+        aEntry->mIndex          = new THprofField[aEntry->mNrIndex + 1];
+
+        for (i = 0; i < aEntry->mNrIfaceFields; i++) {
+            aEntry->mIndex[i].mOffset = -1;
+            aEntry->mIndex[i].mStatic = true;
+        }
+        for (k = aFrom; aSuper != NULL && k < aSuper->mNrIndex; k++, i++) {
+            aField  = &aEntry->mIndex[i];
+            *aField = aSuper->mIndex[k];
+            if (aField->mStatic) {
+                aField->mOffset  = -1;
+            }
+            else {
+                aField->mOffset += aEntry->mOwnBytes;
+            }
+        }
+        for (k = 0; k < aEntry->mNrDeclared; k++, i++) {
+            aEntry->mIndex[i] = aEntry->mDeclared[k];
+        }
+        aEntry->mLayout = 2;
+    }
+    // ----------------------------------------------------
+    // THeapDump::collectInterfaces
+    //! \brief Transitive interfaces in the order of the VM
+    //!
+    //! Interfaces of the super class, then the super interfaces
+    //! of the declared interfaces and finally the declared
+    //! interfaces, each interface once per stamp.
+    // ----------------------------------------------------
+    void collectInterfaces(
+            jvmtiEnv     *aEnv,
+            jint          aIndex,
+            jint          aStamp,
+            jint         *aList,
+            jint         *aCnt,
+            jint         *aMark) {
+
+        jclass      *aIfacePtr = NULL;
+        jint        *aIfaces;
+        jint         aNrIface  = 0;
+        jlong        aTag;
+        jint         i;
+
+        if (mClasses[aIndex].mSuper > 0) {
+            collectInterfaces(aEnv, mClasses[aIndex].mSuper, aStamp, aList, aCnt, aMark);
+        }
+        if (mClasses[aIndex].mClass == NULL ||
+            aEnv->GetImplementedInterfaces(mClasses[aIndex].mClass, &aNrIface, &aIfacePtr) != JVMTI_ERROR_NONE) {
+            return;
+        }
+        aIfaces = new jint[aNrIface + 1];
+        for (i = 0; i < aNrIface; i++) {
+            aTag = 0;
+            aEnv->GetTag(aIfacePtr[i], &aTag);
+            aIfaces[i] = (aTag != 0 && !HEAPGRAPH_IS_NODE(aTag)) ? HEAPGRAPH_TAG_VALUE(aTag) : 0;
+            if (aIfaces[i] > 0) {
+                collectInterfaces(aEnv, aIfaces[i], aStamp, aList, aCnt, aMark);
+            }
+        }
+        for (i = 0; i < aNrIface; i++) {
+            if (aIfaces[i] > 0 && aMark[aIfaces[i]] != aStamp) {
+                aMark[aIfaces[i]] = aStamp;
+                aList[(*aCnt)++]  = aIfaces[i];
+            }
+        }
+        delete [] aIfaces;
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aIfacePtr);
+    }
+    // ----------------------------------------------------
+    // THeapDump::onReference
+    //! \brief Tag the referee and write roots and references
+    //! \see THeapDumpReferenceCallback
+    // ----------------------------------------------------
+    jint onReference(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                          aRefClassTag,
+            jlong                         *aTag,
+            jlong                         *aRefTag,
+            jint                           aLength) {
+
+        bool  aRefSelected;
+        jlong aID;
+
+        if (mTruncated) {
+            return JVMTI_VISIT_ABORT;
+        }
+        aRefSelected = mPartial && aRefTag != NULL && HEAPGRAPH_IS_NODE(*aRefTag) && isSelected(aRefClassTag);
+
+        if (*aTag == 0) {
+            if (mNrObjects >= mMaxObjects) {
+                mTruncated = true;
+                return JVMTI_VISIT_ABORT;
+            }
+            *aTag = HPROF_NODE_TAG(++mNrObjects, aLength);
+            if (!mPartial || aRefSelected || isSelected(aClassTag)) {
+                *aTag |= HPROF_INCLUDED;
+            }
+        }
+        else if (aRefSelected && HEAPGRAPH_IS_NODE(*aTag)) {
+            *aTag |= HPROF_INCLUDED;
+        }
+        if (mPass == HPROF_PASS_TAG) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+
+        aID = getID(*aTag);
+        if (aRefTag == NULL) {
+            closeRecord();
+            if (aID != 0) {
+                putRoot(aKind, aInfo, aID);
+            }
+            return mTruncated ? JVMTI_VISIT_ABORT : JVMTI_VISIT_OBJECTS;
+        }
+        if (!openRecord(*aRefTag, aRefClassTag)) {
+            return mTruncated ? JVMTI_VISIT_ABORT : JVMTI_VISIT_OBJECTS;
+        }
+
+        switch (aKind) {
+            case JVMTI_HEAP_REFERENCE_FIELD:
+            case JVMTI_HEAP_REFERENCE_STATIC_FIELD:
+                putField(aInfo->field.index, aID);
+                break;
+            case JVMTI_HEAP_REFERENCE_ARRAY_ELEMENT:
+                putElement(aInfo->array.index, aID);
+                break;
+            case JVMTI_HEAP_REFERENCE_CLASS_LOADER:
+                mOpenLoader  = aID;
+                break;
+            case JVMTI_HEAP_REFERENCE_SIGNERS:
+                mOpenSigners = aID;
+                break;
+            case JVMTI_HEAP_REFERENCE_PROTECTION_DOMAIN:
+                mOpenDomain  = aID;
+                break;
+            default:
+                break;
+        }
+        return JVMTI_VISIT_OBJECTS;
+    }
+    // ----------------------------------------------------
+    // THeapDump::onField
+    //! \brief Store a primitive field value
+    //! \see THeapDumpFieldCallback
+    // ----------------------------------------------------
+    jint onField(
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                         *aTag,
+            jvalue                         aValue,
+            jvmtiPrimitiveType             aType) {
+
+        jlong  aBits = 0;
+        jint   aInt;
+
+        if (mTruncated) {
+            return JVMTI_VISIT_ABORT;
+        }
+        if (!openRecord(*aTag, aClassTag)) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+        switch (aType) {
+            case JVMTI_PRIMITIVE_TYPE_BOOLEAN: aBits = aValue.z; break;
+            case JVMTI_PRIMITIVE_TYPE_BYTE:    aBits = aValue.b; break;
+            case JVMTI_PRIMITIVE_TYPE_CHAR:    aBits = aValue.c; break;
+            case JVMTI_PRIMITIVE_TYPE_SHORT:   aBits = aValue.s; break;
+            case JVMTI_PRIMITIVE_TYPE_INT:     aBits = aValue.i; break;
+            case JVMTI_PRIMITIVE_TYPE_LONG:    aBits = aValue.j; break;
+            case JVMTI_PRIMITIVE_TYPE_FLOAT:
+                (void)memcpy(&aInt, &aValue.f, sizeof(jint));
+                aBits = aInt;
+                break;
+            case JVMTI_PRIMITIVE_TYPE_DOUBLE:
+                (void)memcpy(&aBits, &aValue.d, sizeof(jlong));
+                break;
+            default:
+                break;
+        }
+        putField(aInfo->field.index, aBits);
+        return JVMTI_VISIT_OBJECTS;
+    }
+    // ----------------------------------------------------
+    // THeapDump::onArray
+    //! \brief Write a primitive array
+    //! \see THeapDumpArrayCallback
+    // ----------------------------------------------------
+    jint onArray(
+            jlong                         *aTag,
+            jint                           aCount,
+            jvmtiPrimitiveType             aType,
+            const void                    *aElements) {
+
+        jint aElemType = getType((char)aType);
+        jint aElemSize = getSize(aElemType);
+
+        if (mTruncated) {
+            return JVMTI_VISIT_ABORT;
+        }
+        closeRecord();
+        if (!HEAPGRAPH_IS_NODE(*aTag) || (*aTag & HPROF_INCLUDED) == 0 || isWritten(HPROF_SERIAL(*aTag))) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+        if (mElide >= 0 && (jlong)aCount * aElemSize > mElide) {
+            aCount = 0;
+        }
+        if (!putSubRecord(HPROF_GC_PRIM_ARRAY_DUMP)) {
+            return JVMTI_VISIT_ABORT;
+        }
+        putU8(getID(*aTag));
+        putU4(HPROF_STACK_SERIAL);
+        putU4(aCount);
+        putU1(aElemType);
+        putValues(aElements, aCount, aElemSize);
+        setWritten(HPROF_SERIAL(*aTag));
+        return JVMTI_VISIT_OBJECTS;
+    }
+    // ----------------------------------------------------
+    // THeapDump::onObject
+    //! \brief Write objects and classes without reported values
+    //! \see THeapDumpIterationCallback
+    // ----------------------------------------------------
+    jint onObject(
+            jlong                          aClassTag,
+            jlong                         *aTag) {
+
+        jint aClass = (aClassTag != 0 && !HEAPGRAPH_IS_NODE(aClassTag)) ? HEAPGRAPH_TAG_VALUE(aClassTag) : 0;
+
+        if (mTruncated) {
+            return JVMTI_VISIT_ABORT;
+        }
+        if (HEAPGRAPH_IS_NODE(*aTag) && mClasses[aClass].mArrayType > HPROF_NORMAL_OBJECT) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+        if (openRecord(*aTag, aClassTag)) {
+            closeRecord();
+        }
+        return mTruncated ? JVMTI_VISIT_ABORT : JVMTI_VISIT_OBJECTS;
+    }
+    // ----------------------------------------------------
+    // THeapDump::openRecord
+    //! \brief Select the record for the values of an object
+    //!
+    //! The reference runner reports all values of an object in
+    //! sequence, a new referrer closes the open record.
+    //! \param aTag         The tag of the referrer
+    //! \param aClassTag    The tag of its class
+    //! \return \c TRUE if the values belong to an open record
+    // ----------------------------------------------------
+    bool openRecord(jlong aTag, jlong aClassTag) {
+        jint aSerial;
+
+        if (aTag == 0) {
+            closeRecord();
+            return false;
+        }
+        if (!HEAPGRAPH_IS_NODE(aTag)) {
+            aSerial = HEAPGRAPH_TAG_VALUE(aTag);
+            if (mOpen == HPROF_OPEN_CLASS && mOpenSerial == aSerial) {
+                return true;
+            }
+            closeRecord();
+            if (aSerial <= 0 || aSerial >= mNrClasses || mClasses[aSerial].mWritten) {
+                return false;
+            }
+            (void)memsetR(mValues, 0, mClasses[aSerial].mStaticBytes);
+            mOpen        = HPROF_OPEN_CLASS;
+            mOpenSerial  = aSerial;
+            mOpenLoader  = 0;
+            mOpenSigners = 0;
+            mOpenDomain  = 0;
+            return true;
+        }
+
+        aSerial = HPROF_SERIAL(aTag);
+        if (mOpen != HPROF_OPEN_NONE && mOpen != HPROF_OPEN_CLASS && mOpenSerial == aSerial) {
+            return true;
+        }
+        closeRecord();
+        if ((aTag & HPROF_INCLUDED) == 0 || isWritten(aSerial)) {
+            return false;
+        }
+        mOpenSerial = aSerial;
+        mOpenClass  = (aClassTag != 0 && !HEAPGRAPH_IS_NODE(aClassTag)) ? HEAPGRAPH_TAG_VALUE(aClassTag) : 0;
+        mOpenLength = HPROF_LENGTH(aTag);
+        mOpenIndex  = 0;
+
+        if (mOpenLength >= 0) {
+            // Object arrays stream the elements in order
+            if (!putSubRecord(HPROF_GC_OBJ_ARRAY_DUMP)) {
+                return false;
+            }
+            mOpen = HPROF_OPEN_ARRAY;
+            putU8(HPROF_OBJECT_ID(aSerial));
+            putU4(HPROF_STACK_SERIAL);
+            putU4(mOpenLength);
+            putU8(HPROF_CLASS_ID(mOpenClass));
+        }
+        else {
+            mOpen = HPROF_OPEN_INSTANCE;
+            (void)memsetR(mValues, 0, mClasses[mOpenClass].mInstanceBytes);
+        }
+        return true;
+    }
+    // ----------------------------------------------------
+    // THeapDump::closeRecord
+    //! \brief Write the open record
+    // ----------------------------------------------------
+    void closeRecord() {
+        THprofClass *aEntry;
+        THprofField *aField;
+        jint         i;
+
+        switch (mOpen) {
+            case HPROF_OPEN_INSTANCE:
+                mOpen  = HPROF_OPEN_NONE;
+                aEntry = &mClasses[mOpenClass];
+                if (!putSubRecord(HPROF_GC_INSTANCE_DUMP)) {
+                    return;
+                }
+                putU8(HPROF_OBJECT_ID(mOpenSerial));
+                putU4(HPROF_STACK_SERIAL);
+                putU8(HPROF_CLASS_ID(mOpenClass));
+                putU4(aEntry->mInstanceBytes);
+                putBytes(mValues, aEntry->mInstanceBytes);
+                setWritten(mOpenSerial);
+                break;
+
+            case HPROF_OPEN_ARRAY:
+                mOpen = HPROF_OPEN_NONE;
+                for (; mOpenIndex < mOpenLength; mOpenIndex++) {
+                    putU8(0);
+                }
+                setWritten(mOpenSerial);
+                break;
+
+            case HPROF_OPEN_CLASS:
+                mOpen  = HPROF_OPEN_NONE;
+                aEntry = &mClasses[mOpenSerial];
+                if (!putSubRecord(HPROF_GC_CLASS_DUMP)) {
+                    return;
+                }
+                putU8(HPROF_CLASS_ID(mOpenSerial));
+                putU4(HPROF_STACK_SERIAL);
+                putU8(aEntry->mSuper > 0 ? HPROF_CLASS_ID(aEntry->mSuper) : 0);
+                putU8(mOpenLoader);
+                putU8(mOpenSigners);
+                putU8(mOpenDomain);
+                putU8(0);
+                putU8(0);
+                putU4(aEntry->mInstanceBytes);
+                putU2(0);
+
+                putU2(aEntry->mNrStatics);
+                for (i = 0; i < aEntry->mNrDeclared; i++) {
+                    aField = &aEntry->mDeclared[i];
+                    if (aField->mStatic) {
+                        putU8(aField->mNameID);
+                        putU1(aField->mType);
+                        putBytes(mValues + aField->mOffset, getSize(aField->mType));
+                    }
+                }
+                putU2(aEntry->mNrFields);
+                for (i = 0; i < aEntry->mNrDeclared; i++) {
+                    aField = &aEntry->mDeclared[i];
+                    if (!aField->mStatic) {
+                        putU8(aField->mNameID);
+                        putU1(aField->mType);
+                    }
+                }
+                aEntry->mWritten = true;
+                mNrWritten++;
+                break;
+
+            default:
+                break;
+        }
+    }
+    // ----------------------------------------------------
+    // THeapDump::putUnknownClass
+    //! \brief Write the class dump of the class index 0
+    //!
+    //! Objects without a class tag refer to the class <unknown>,
+    //! which has no class object reported by the reference runner.
+    // ----------------------------------------------------
+    void putUnknownClass() {
+        mOpen        = HPROF_OPEN_CLASS;
+        mOpenSerial  = 0;
+        mOpenLoader  = 0;
+        mOpenSigners = 0;
+        mOpenDomain  = 0;
+        closeRecord();
+    }
+    // ----------------------------------------------------
+    // THeapDump::putRoot
+    //! \brief Write a GC root
+    // ----------------------------------------------------
+    void putRoot(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aID) {
+
+        jlong aThread;
+
+        switch (aKind) {
+            case JVMTI_HEAP_REFERENCE_JNI_GLOBAL:
+                if (putSubRecord(HPROF_GC_ROOT_JNI_GLOBAL)) {
+                    putU8(aID);
+                    putU8(0);
+                }
+                break;
+            case JVMTI_HEAP_REFERENCE_SYSTEM_CLASS:
+                if (putSubRecord(HPROF_GC_ROOT_STICKY_CLASS)) {
+                    putU8(aID);
+                }
+                break;
+            case JVMTI_HEAP_REFERENCE_MONITOR:
+                if (putSubRecord(HPROF_GC_ROOT_MONITOR_USED)) {
+                    putU8(aID);
+                }
+                break;
+            case JVMTI_HEAP_REFERENCE_STACK_LOCAL:
+                aThread = aInfo->stack_local.thread_tag;
+                if (putSubRecord(HPROF_GC_ROOT_JAVA_FRAME)) {
+                    putU8(aID);
+                    putU4(HEAPGRAPH_IS_NODE(aThread) ? HPROF_SERIAL(aThread) : 0);
+                    putU4(aInfo->stack_local.depth);
+                }
+                break;
+            case JVMTI_HEAP_REFERENCE_JNI_LOCAL:
+                aThread = aInfo->jni_local.thread_tag;
+                if (putSubRecord(HPROF_GC_ROOT_JNI_LOCAL)) {
+                    putU8(aID);
+                    putU4(HEAPGRAPH_IS_NODE(aThread) ? HPROF_SERIAL(aThread) : 0);
+                    putU4(aInfo->jni_local.depth);
+                }
+                break;
+            case JVMTI_HEAP_REFERENCE_THREAD:
+                if (putSubRecord(HPROF_GC_ROOT_THREAD_OBJ)) {
+                    putU8(aID);
+                    putU4((jint)(aID >> 1));
+                    putU4(HPROF_STACK_SERIAL);
+                }
+                break;
+            default:
+                if (putSubRecord(HPROF_GC_ROOT_UNKNOWN)) {
+                    putU8(aID);
+                }
+                break;
+        }
+    }
+    // ----------------------------------------------------
+    // THeapDump::putField
+    //! \brief Store a field value of the open instance or class
+    //! \param aIndex   The JVMTI field index
+    //! \param aBits    The value
+    // ----------------------------------------------------
+    void putField(jint aIndex, jlong aBits) {
+        THprofField *aField;
+        jint         aClass;
+        jint         aSize;
+        jint         i;
+
+        if (mOpen == HPROF_OPEN_INSTANCE) {
+            aClass = mOpenClass;
+        }
+        else if (mOpen == HPROF_OPEN_CLASS) {
+            aClass = mOpenSerial;
+        }
+        else {
+            return;
+        }
+        if (aIndex < 0 || aIndex >= mClasses[aClass].mNrIndex) {
+            return;
+        }
+        aField = &mClasses[aClass].mIndex[aIndex];
+        if (aField->mOffset < 0 || aField->mStatic != (mOpen == HPROF_OPEN_CLASS)) {
+            return;
+        }
+        aSize = getSize(aField->mType);
+        for (i = aSize - 1; i >= 0; i--) {
+            mValues[aField->mOffset + i] = (jbyte)(aBits & 0xFF);
+            aBits >>= 8;
+        }
+    }
+    // ----------------------------------------------------
+    // THeapDump::putElement
+    //! \brief Write an element of the open object array
+    //! \param aIndex   The element index
+    //! \param aID      The element ID
+    // ----------------------------------------------------
+    void putElement(jint aIndex, jlong aID) {
+        if (mOpen != HPROF_OPEN_ARRAY || aIndex < mOpenIndex || aIndex >= mOpenLength) {
+            return;
+        }
+        for (; mOpenIndex < aIndex; mOpenIndex++) {
+            putU8(0);
+        }
+        putU8(aID);
+        mOpenIndex++;
+    }
+    // ----------------------------------------------------
+    // THeapDump::putSubRecord
+    //! \brief Start a heap dump sub record
+    //!
+    //! Opens a new segment if the current segment is full.
+    //! \return \c FALSE if the size limit is reached
+    // ----------------------------------------------------
+    bool putSubRecord(jint aSubTag) {
+        if (mMaxBytes > 0 && mSize > mMaxBytes) {
+            mTruncated = true;
+            return false;
+        }
+        if (mSegment >= 0 && mSize - mSegment > HPROF_SEGMENT_SIZE) {
+            closeSegment();
+        }
+        if (mSegment < 0) {
+            putU1(HPROF_HEAP_DUMP_SEGMENT);
+            putU4(0);
+            mSegment = mSize;
+            putU4(0);
+        }
+        putU1(aSubTag);
+        return true;
+    }
+    // ----------------------------------------------------
+    // THeapDump::closeSegment
+    //! \brief Patch the length of the current segment
+    // ----------------------------------------------------
+    void closeSegment() {
+        jlong aSize = mSize;
+
+        if (mSegment < 0) {
+            return;
+        }
+        mFile.seekp(mSegment, ios::beg);
+        putU4((jint)(aSize - mSegment - 4));
+        mFile.seekp(aSize, ios::beg);
+        mSize    = aSize;
+        mSegment = -1;
+    }
+    // ----------------------------------------------------
+    // THeapDump::putRecord
+    //! \brief Write a record header
+    // ----------------------------------------------------
+    void putRecord(jint aTag, jint aLength) {
+        putU1(aTag);
+        putU4(0);
+        putU4(aLength);
+    }
+    // ----------------------------------------------------
+    // THeapDump::putString
+    //! \brief Write a string record
+    //! \return The string ID
+    // ----------------------------------------------------
+    jlong putString(const char *aString, jint aLength) {
+        jlong aID = HPROF_STRING_ID(++mNrStrings);
+
+        putRecord(HPROF_UTF8, sizeof(jlong) + aLength);
+        putU8(aID);
+        putBytes(aString, aLength);
+        return aID;
+    }
+    // ----------------------------------------------------
+    // THeapDump::putValues
+    //! \brief Write array elements in big endian order
+    // ----------------------------------------------------
+    void putValues(const void *aElements, jint aCount, jint aSize) {
+        const char *aPtr = (const char *)aElements;
+        char        aSwap[256];
+        jint        aLen;
+        jint        i, k;
+
+        if (!mSwap || aSize == 1) {
+            putBytes(aPtr, (jlong)aCount * aSize);
+            return;
+        }
+        while (aCount > 0) {
+            aLen = min(aCount, (jint)(sizeof(aSwap) / aSize));
+            for (i = 0; i < aLen; i++) {
+                for (k = 0; k < aSize; k++) {
+                    aSwap[i * aSize + k] = aPtr[i * aSize + aSize - 1 - k];
+                }
+            }
+            putBytes(aSwap, aLen * aSize);
+            aPtr   += aLen * aSize;
+            aCount -= aLen;
+        }
+    }
+    // ----------------------------------------------------
+    // THeapDump::putU1
+    // ----------------------------------------------------
+    inline void putU1(jint aValue) {
+        mFile.put((char)aValue);
+        mSize++;
+    }
+    // ----------------------------------------------------
+    // THeapDump::putU2
+    // ----------------------------------------------------
+    inline void putU2(jint aValue) {
+        putU1(aValue >> 8);
+        putU1(aValue);
+    }
+    // ----------------------------------------------------
+    // THeapDump::putU4
+    // ----------------------------------------------------
+    inline void putU4(jint aValue) {
+        putU2(aValue >> 16);
+        putU2(aValue);
+    }
+    // ----------------------------------------------------
+    // THeapDump::putU8
+    // ----------------------------------------------------
+    inline void putU8(jlong aValue) {
+        putU4((jint)(aValue >> 32));
+        putU4((jint)aValue);
+    }
+    // ----------------------------------------------------
+    // THeapDump::putBytes
+    // ----------------------------------------------------
+    inline void putBytes(const void *aData, jlong aLength) {
+        mFile.write((const char *)aData, aLength);
+        mSize += aLength;
+    }
+    // ----------------------------------------------------
+    // THeapDump::getID
+    //! \return The dump ID of a referee or 0 if not written
+    // ----------------------------------------------------
+    inline jlong getID(jlong aTag) {
+        if (aTag == 0) {
+            return 0;
+        }
+        if (!HEAPGRAPH_IS_NODE(aTag)) {
+            return HPROF_CLASS_ID(HEAPGRAPH_TAG_VALUE(aTag));
+        }
+        return ((aTag & HPROF_INCLUDED) != 0) ? HPROF_OBJECT_ID(HPROF_SERIAL(aTag)) : 0;
+    }
+    // ----------------------------------------------------
+    // THeapDump::isSelected
+    //! \return \c TRUE if the class matches the filter
+    // ----------------------------------------------------
+    inline bool isSelected(jlong aClassTag) {
+        jint aClass;
+
+        if (aClassTag == 0 || HEAPGRAPH_IS_NODE(aClassTag)) {
+            return false;
+        }
+        aClass = HEAPGRAPH_TAG_VALUE(aClassTag);
+        return aClass > 0 && aClass < mNrClasses && mClasses[aClass].mSelected;
+    }
+    // ----------------------------------------------------
+    // THeapDump::isWritten
+    // ----------------------------------------------------
+    inline bool isWritten(jint aSerial) {
+        return (aSerial >> 3) < mWrittenSize && (mWrittenBits[aSerial >> 3] & (1 << (aSerial & 7))) != 0;
+    }
+    // ----------------------------------------------------
+    // THeapDump::setWritten
+    // ----------------------------------------------------
+    void setWritten(jint aSerial) {
+        unsigned char *aBits;
+        jint           aSize;
+
+        if ((aSerial >> 3) >= mWrittenSize) {
+            aSize = max((aSerial >> 3) + 1, 2 * mWrittenSize);
+            aBits = new unsigned char[aSize];
+            (void)memsetR(aBits, 0, aSize);
+            if (mWrittenBits != NULL) {
+                (void)memcpy(aBits, mWrittenBits, mWrittenSize);
+                delete [] mWrittenBits;
+            }
+            mWrittenBits = aBits;
+            mWrittenSize = aSize;
+        }
+        mWrittenBits[aSerial >> 3] |= (unsigned char)(1 << (aSerial & 7));
+        mNrWritten++;
+    }
+    // ----------------------------------------------------
+    // THeapDump::getType
+    //! \param aSignature First character of a field signature
+    //!        or a JVMTI primitive type
+    //! \return The HPROF basic type
+    // ----------------------------------------------------
+    static inline jint getType(char aSignature) {
+        switch (aSignature) {
+            case 'Z': return HPROF_BOOLEAN;
+            case 'C': return HPROF_CHAR;
+            case 'F': return HPROF_FLOAT;
+            case 'D': return HPROF_DOUBLE;
+            case 'B': return HPROF_BYTE;
+            case 'S': return HPROF_SHORT;
+            case 'I': return HPROF_INT;
+            case 'J': return HPROF_LONG;
+            default:  return HPROF_NORMAL_OBJECT;
+        }
+    }
+    // ----------------------------------------------------
+    // THeapDump::getSize
+    //! \return The size of a HPROF basic type
+    // ----------------------------------------------------
+    static inline jint getSize(jint aType) {
+        switch (aType) {
+            case HPROF_BOOLEAN:
+            case HPROF_BYTE:    return 1;
+            case HPROF_CHAR:
+            case HPROF_SHORT:   return 2;
+            case HPROF_FLOAT:
+            case HPROF_INT:     return 4;
+            default:            return 8;
+        }
+    }
+};
+
+#define HEAPPATH_INFINITE       0x7FFFFFFF  //!< Depth of unreachable objects
+#define HEAPPATH_NO_PARENT      -1          //!< Parent of GC roots
+#define HEAPPATH_MAX_NODES      0x3FFFFFFF  //!< Node ID range
+
+//! Edge with reference kind and field or element index
+#define HEAPPATH_EDGE(k, i)     ((((jint)(k)) << 24) | ((i) & 0xFFFFFF))
+//! Reference kind of an edge
+#define HEAPPATH_KIND(e)        ((e) >> 24)
+//! Field or element index of an edge
+#define HEAPPATH_INDEX(e)       ((e) & 0xFFFFFF)
+
+// ---------------------------------------------------------
+//! \struct THeapPathShape
+//! \brief Reference chain shared by a number of instances
+// ---------------------------------------------------------
+typedef struct {
+    TString       *mPath;               //!< Chain from the GC root
+    jint           mCount;              //!< Number of instances
+    jint           mDepth;              //!< Length of the chain
+} THeapPathShape;
+
+// ---------------------------------------------------------
+// THeapPath::referenceCallback
+//! \brief Callback for the shortest path runner
+//! \see THeapGraphCallback
+// ---------------------------------------------------------
+extern "C" jint JNICALL THeapPathCallback(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                          aRefClassTag,
+            jlong                          aSize,
+            jlong                         *aTag,
+            jlong                         *aRefTag,
+            jint                           aLength,
+            void                          *aUserData);
+
+// ----------------------------------------------------
+//! \class THeapPath
+//! \brief Shortest reference chains from GC roots
+//!
+//! Each reference runner pass relaxes the depth of the referees,
+//! so the parent of each object converges to a shortest chain.
+//! Class objects use the class index as node ID, all other
+//! objects are numbered above. The chains of a sample of the
+//! instances are collapsed by shape, array indices are ignored.
+// ----------------------------------------------------
+class THeapPath {
+    friend jint JNICALL THeapPathCallback(
+            jvmtiHeapReferenceKind, const jvmtiHeapReferenceInfo*,
+            jlong, jlong, jlong, jlong*, jlong*, jint, void*);
+private:
+    static THeapPath   *mInstance;      //!< Singleton
+    TProperties        *mProperties;    //!< Configuration
+    jclass             *mClassPtr;      //!< Loaded classes by index - 1
+    TString           **mNames;         //!< Class names by index
+    jint                mNrClasses;     //!< Number of classes
+    jint                mTarget;        //!< Class index of the instances
+    jint               *mParent;        //!< Parent node
+    jint               *mEdge;          //!< Reference from the parent
+    jint               *mDepth;         //!< Distance to the GC roots
+    jint               *mClassOf;       //!< Class index by node
+    jint                mNrNodes;       //!< Number of nodes
+    jint                mMaxNodes;      //!< Limit for nodes
+    jint                mSize;          //!< Size of the node arrays
+    jint               *mSamples;       //!< Sampled instances
+    jint                mNrSamples;     //!< Number of sampled instances
+    jint                mMaxSamples;    //!< Limit for samples
+    jint                mNrInstances;   //!< Number of instances
+    jint               *mList;          //!< Work list for interfaces
+    jint               *mMark;          //!< Visit mark for interfaces
+    jint                mStamp;         //!< Current visit mark
+    bool                mChanged;       //!< Pass changed a depth
+    bool                mTruncated;     //!< Node limit reached
+    // ----------------------------------------------------
+    // THeapPath::THeapPath
+    //! Constructor
+    // ----------------------------------------------------
+    THeapPath() {
+        mProperties  = TProperties::getInstance();
+        mClassPtr    = NULL;
+        mNames       = NULL;
+        mNrClasses   = 0;
+        mTarget      = 0;
+        mParent      = NULL;
+        mEdge        = NULL;
+        mDepth       = NULL;
+        mClassOf     = NULL;
+        mNrNodes     = 0;
+        mMaxNodes    = 0;
+        mSize        = 0;
+        mSamples     = NULL;
+        mNrSamples   = 0;
+        mMaxSamples  = 0;
+        mNrInstances = 0;
+        mList        = NULL;
+        mMark        = NULL;
+        mStamp       = 0;
+        mChanged     = false;
+        mTruncated   = false;
+    }
+    // ----------------------------------------------------
+    // THeapPath::THeapPath
+    //! Copy constructor
+    // ----------------------------------------------------
+    THeapPath(const THeapPath &) {
+    }
+public:
+    // ----------------------------------------------------
+    // THeapPath::getInstance
+    //! Singleton constructor
+    // ----------------------------------------------------
+    static THeapPath *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new THeapPath();
+        }
+        return mInstance;
+    }
+    // ----------------------------------------------------
+    // THeapPath::dump
+    //! \brief List the reference chains to instances of a class
+    //! \param aJvmti       The Java tool interface
+    //! \param aJni         The Java native interface
+    //! \param aRootTag     The output tag list
+    //! \param aOptions     Options
+    //!         -C<class id>  Class ID as listed by lsc or lhd
+    //!         -n<number>    Number of sampled instances
+    //!         -p<number>    Maximum number of passes
+    //!         -m<number>    Maximum number of objects
+    //!         -s<col>       Sort column
+    // ----------------------------------------------------
+    void dump(
+            jvmtiEnv    *aJvmti,
+            JNIEnv      *aJni,
+            TXmlTag     *aRootTag,
+            TValues     *aOptions) {
+
+        TValues::iterator   aPtrOptions;
+        jvmtiEnv           *aEnv        = NULL;
+        jvmtiHeapCallbacks  aCallbacks;
+        jvmtiError          aResult     = JVMTI_ERROR_NONE;
+        THeapPathShape     *aShapes;
+        THeapPathShape     *aShape;
+        TXmlTag            *aTag;
+        TString             aColumnSort;
+        TString             aPath;
+        TString             aString;
+        jlong               aClassID    = 0;
+        jlong               aTagValue;
+        jint                aMaxPasses  = 4;
+        jint                aPass       = 0;
+        jint                aNrShapes   = 0;
+        jint                aCnt        = 0;
+        jint                aDepth;
+        jint                i, k;
+        SAP_UC              aBuffer[32];
+
+        aColumnSort = cU("Count");
+        mMaxSamples = 100;
+        mMaxNodes   = 0;
+
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-C"), 2)) {
+                    aClassID    = TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-n"), 2)) {
+                    mMaxSamples = (jint)TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-p"), 2)) {
+                    aMaxPasses  = (jint)TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-m"), 2)) {
+                    mMaxNodes   = (jint)TString::toInteger(*aPtrOptions + 2);
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-s"), 2)) {
+                    aColumnSort = (*aPtrOptions) + 2;
+                }
+            }
+        }
+        if (aClassID == 0) {
+            aRootTag->addAttribute(cU("Result"), cU("Missing class ID"));
+            return;
+        }
+        mMaxSamples = max(mMaxSamples, (jint)1);
+        aMaxPasses  = max(aMaxPasses,  (jint)1);
+
+        aEnv = THeapGraph::getPrivateEnv(aJvmti);
+        if (aEnv == NULL) {
+            aRootTag->addAttribute(cU("Result"), cU("No private tool interface"));
+            return;
+        }
+
+        // Class objects are the first nodes. The agent threads never
+        // return to Java, the local frame releases the class references
+        mTarget = 0;
+        aJni->PushLocalFrame(HPROF_LOCAL_REFS);
+        aEnv->GetLoadedClasses(&mNrClasses, &mClassPtr);
+        aJni->EnsureLocalCapacity(mNrClasses + HPROF_LOCAL_REFS);
+        mNrClasses++;
+        mNames = new TString*[mNrClasses];
+        mList  = new jint[mNrClasses];
+        mMark  = new jint[mNrClasses];
+        mNames[0] = NULL;
+        mMark[0]  = 0;
+        mStamp    = 0;
+
+        for (i = 1; i < mNrClasses; i++) {
+            mNames[i]  = NULL;
+            mMark[i]   = 0;
+            aTagValue  = 0;
+            aJvmti->GetTag(mClassPtr[i - 1], &aTagValue);
+            if (aTagValue == aClassID) {
+                mTarget = i;
+            }
+            aEnv->SetTag(mClassPtr[i - 1], HEAPGRAPH_CLASS_TAG(i));
+        }
+
+        if (mTarget == 0) {
+            aRootTag->addAttribute(cU("Result"), cU("Class not found"));
+        }
+        else {
+            mSamples     = new jint[mMaxSamples];
+            mNrSamples   = 0;
+            mNrInstances = 0;
+            mTruncated   = false;
+            mNrNodes     = mNrClasses;
+            grow(mNrClasses);
+            for (i = 0; i < mNrClasses; i++) {
+                initNode(i, i);
+            }
+
+            (void)memsetR(&aCallbacks, 0, sizeofR(jvmtiHeapCallbacks));
+            aCallbacks.heap_reference_callback = THeapPathCallback;
+            do {
+                mChanged = false;
+                aResult  = aEnv->FollowReferences(0, NULL, NULL, &aCallbacks, (void*)this);
+                aPass++;
+            } while (aResult == JVMTI_ERROR_NONE && mChanged && !mTruncated && aPass < aMaxPasses);
+
+            // Collapse the chains by shape
+            aShapes = new THeapPathShape[mNrSamples + 1];
+            for (i = 0; i < mNrSamples && aResult == JVMTI_ERROR_NONE; i++) {
+                if (mDepth[mSamples[i]] == HEAPPATH_INFINITE) {
+                    continue;
+                }
+                aDepth = getPath(aEnv, aJni, mSamples[i], &aPath);
+                if (aDepth < 0) {
+                    continue;
+                }
+                for (k = 0; k < aNrShapes; k++) {
+                    if (!STRCMP(aShapes[k].mPath->str(), aPath.str())) {
+                        break;
+                    }
+                }
+                if (k == aNrShapes) {
+                    aShapes[k].mPath  = new TString(aPath.str());
+                    aShapes[k].mCount = 0;
+                    aShapes[k].mDepth = aDepth;
+                    aNrShapes++;
+                }
+                aShapes[k].mCount++;
+            }
+
+            for (k = 0; k < aNrShapes; k++) {
+                aShape = &aShapes[k];
+                if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
+                    aTag = aRootTag->addTag(cU("Trace"));
+                    aTag->addAttribute(cU("Count"), TString::parseInt(aShape->mCount, aBuffer), PROPERTY_TYPE_INT);
+                    aTag->addAttribute(cU("Depth"), TString::parseInt(aShape->mDepth, aBuffer), PROPERTY_TYPE_INT);
+                    aTag->addAttribute(cU("Path"),  aShape->mPath->str());
+                }
+                delete aShape->mPath;
+            }
+            delete [] aShapes;
+
+            if (aResult != JVMTI_ERROR_NONE) {
+                aRootTag->addAttribute(cU("Result"), cU("Reference runner failed"));
+            }
+            else if (aCnt > mProperties->getLimit(LIMIT_IO)) {
+                aString.concat(cU("Exceed Maximum Number of Entries "));
+                aString.concat(TString::parseInt(aCnt, aBuffer));
+                aRootTag->addAttribute(cU("Result"), aString.str());
+            }
+            else {
+                aString.concat(getName(aEnv, mTarget));
+                aString.concat(cU(": "));
+                aString.concat(TString::parseInt(mNrSamples, aBuffer));
+                aString.concat(cU(" of "));
+                aString.concat(TString::parseInt(mNrInstances, aBuffer));
+                aString.concat(cU(" instances in "));
+                aString.concat(TString::parseInt(aPass, aBuffer));
+                aString.concat(mTruncated ? cU(" passes, truncated") : cU(" passes"));
+                aRootTag->addAttribute(cU("Result"), aString.str());
+            }
+        }
+        /*SAPUNICODEOK_CHARTYPE*/
+        aEnv->Deallocate((unsigned char*)mClassPtr);
+        aJni->PopLocalFrame(NULL);
+        aEnv->DisposeEnvironment();
+        reset();
+        aRootTag->qsort(aColumnSort.str());
+    }
+private:
+    // ----------------------------------------------------
+    // THeapPath::reset
+    //! Release nodes and classes
+    // ----------------------------------------------------
+    void reset() {
+        jint i;
+
+        if (mNames != NULL) {
+            for (i = 0; i < mNrClasses; i++) {
+                delete mNames[i];
+            }
+            delete [] mNames;
+        }
+        delete [] mParent;
+        delete [] mEdge;
+        delete [] mDepth;
+        delete [] mClassOf;
+        delete [] mSamples;
+        delete [] mList;
+        delete [] mMark;
+        mNames    = NULL;
+        mList     = NULL;
+        mMark     = NULL;
+        mClassPtr = NULL;
+        mParent   = NULL;
+        mEdge     = NULL;
+        mDepth    = NULL;
+        mClassOf  = NULL;
+        mSamples  = NULL;
+        mSize     = 0;
+        mNrNodes  = 0;
+    }
+    // ----------------------------------------------------
+    // THeapPath::onReference
+    //! \brief Number the referee and relax its depth
+    //! \see THeapPathCallback
+    // ----------------------------------------------------
+    jint onReference(
+            jvmtiHeapReferenceKind         aKind,
+            const jvmtiHeapReferenceInfo  *aInfo,
+            jlong                          aClassTag,
+            jlong                         *aTag,
+            jlong                         *aRefTag) {
+
+        jint aNode;
+        jint aFrom;
+        jint aIndex = 0;
+
+        // The class of an instance does not hold the instance
+        if (aKind == JVMTI_HEAP_REFERENCE_CLASS) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+        if (*aTag == 0) {
+            if (mNrNodes >= HEAPPATH_MAX_NODES || (mMaxNodes > 0 && mNrNodes >= mMaxNodes + mNrClasses)) {
+                mTruncated = true;
+                return JVMTI_VISIT_ABORT;
+            }
+            aNode = mNrNodes++;
+            grow(mNrNodes);
+            initNode(aNode, (aClassTag != 0 && !HEAPGRAPH_IS_NODE(aClassTag)) ? HEAPGRAPH_TAG_VALUE(aClassTag) : 0);
+            *aTag = HEAPGRAPH_NODE_TAG(aNode);
+
+            if (mClassOf[aNode] == mTarget) {
+                if (mNrSamples < mMaxSamples) {
+                    mSamples[mNrSamples++] = aNode;
+                }
+                mNrInstances++;
+            }
+        }
+        aNode = HEAPGRAPH_TAG_VALUE(*aTag);
+        if (aNode <= 0 || aNode >= mNrNodes) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+
+        if (aRefTag == NULL) {
+            if (mDepth[aNode] > 0) {
+                mDepth[aNode]  = 0;
+                mParent[aNode] = HEAPPATH_NO_PARENT;
+                mEdge[aNode]   = HEAPPATH_EDGE(aKind, 0);
+                mChanged       = true;
+            }
+            return JVMTI_VISIT_OBJECTS;
+        }
+        aFrom = HEAPGRAPH_TAG_VALUE(*aRefTag);
+        if (*aRefTag == 0 || aFrom <= 0 || aFrom >= mNrNodes || mDepth[aFrom] == HEAPPATH_INFINITE) {
+            return JVMTI_VISIT_OBJECTS;
+        }
+        if (mDepth[aFrom] + 1 < mDepth[aNode]) {
+            if (aKind == JVMTI_HEAP_REFERENCE_FIELD || aKind == JVMTI_HEAP_REFERENCE_STATIC_FIELD) {
+                aIndex = aInfo->field.index;
+            }
+            mDepth[aNode]  = mDepth[aFrom] + 1;
+            mParent[aNode] = aFrom;
+            mEdge[aNode]   = HEAPPATH_EDGE(aKind, aIndex);
+            mChanged       = true;
+        }
+        return JVMTI_VISIT_OBJECTS;
+    }
+    // ----------------------------------------------------
+    // THeapPath::initNode
+    // ----------------------------------------------------
+    inline void initNode(jint aNode, jint aClass) {
+        mParent[aNode]  = HEAPPATH_NO_PARENT;
+        mEdge[aNode]    = 0;
+        mDepth[aNode]   = HEAPPATH_INFINITE;
+        mClassOf[aNode] = aClass;
+    }
+    // ----------------------------------------------------
+    // THeapPath::grow
+    //! \brief Resize the node arrays
+    //! \param aNrNodes Required number of nodes
+    // ----------------------------------------------------
+    void grow(jint aNrNodes) {
+        jint  aSize;
+
+        if (aNrNodes <= mSize) {
+            return;
+        }
+        aSize    = max(aNrNodes, 2 * mSize);
+        mParent  = resize(mParent,  aSize);
+        mEdge    = resize(mEdge,    aSize);
+        mDepth   = resize(mDepth,   aSize);
+        mClassOf = resize(mClassOf, aSize);
+        mSize    = aSize;
+    }
+    // ----------------------------------------------------
+    // THeapPath::resize
+    // ----------------------------------------------------
+    jint *resize(jint *aArray, jint aSize) {
+        jint *aResult = new jint[aSize];
+
+        if (aArray != NULL) {
+            (void)memcpy(aResult, aArray, mSize * sizeof(jint));
+            delete [] aArray;
+        }
+        return aResult;
+    }
+    // ----------------------------------------------------
+    // THeapPath::getPath
+    //! \brief Format the chain from the GC root to a node
+    //!
+    //! The chain follows the parents up to the root. The depth of the
+    //! node is not used, it may be stale if the passes stopped early.
+    //! \param aEnv     The private tool interface
+    //! \param aJni     The Java native interface
+    //! \param aNode    The node
+    //! \param aPath    The chain
+    //! \return The length of the chain or -1 if the parents do not
+    //!         lead to a root
+    // ----------------------------------------------------
+    jint getPath(
+            jvmtiEnv    *aEnv,
+            JNIEnv      *aJni,
+            jint         aNode,
+            TString     *aPath) {
+
+        jint     aDepth = 0;
+        jint    *aChain;
+        jint     aRoot;
+        jint     aNext;
+        jint     i;
+        TString  aField;
+
+        for (aNext = aNode; mParent[aNext] != HEAPPATH_NO_PARENT; aNext = mParent[aNext]) {
+            if (++aDepth >= mNrNodes) {
+                return -1;
+            }
+        }
+        aChain = new jint[aDepth + 1];
+        for (i = aDepth; i >= 0; i--) {
+            aChain[i] = aNode;
+            aNode     = mParent[aNode];
+        }
+        aRoot  = aChain[0];
+        *aPath = getRootName(HEAPPATH_KIND(mEdge[aRoot]));
+
+        for (i = 0; i <= aDepth; i++) {
+            aNode = aChain[i];
+            aPath->concat(i == 0 ? cU(": ") : cU(" -> "));
+            if (aNode < mNrClasses) {
+                aPath->concat(cU("class "));
+            }
+            aPath->concat(getName(aEnv, mClassOf[aNode]));
+            if (i == aDepth) {
+                break;
+            }
+            aNext = aChain[i + 1];
+            switch (HEAPPATH_KIND(mEdge[aNext])) {
+                case JVMTI_HEAP_REFERENCE_FIELD:
+                case JVMTI_HEAP_REFERENCE_STATIC_FIELD:
+                    aPath->concat(cU("."));
+                    getFieldName(aEnv, aJni, mClassOf[aNode], HEAPPATH_INDEX(mEdge[aNext]), &aField);
+                    aPath->concat(aField.str());
+                    break;
+                case JVMTI_HEAP_REFERENCE_CLASS_LOADER:
+                    aPath->concat(cU(" <loader>"));
+                    break;
+                case JVMTI_HEAP_REFERENCE_CONSTANT_POOL:
+                    aPath->concat(cU(" <constant pool>"));
+                    break;
+                default:
+                    break;
+            }
+        }
+        delete [] aChain;
+        return aDepth;
+    }
+    // ----------------------------------------------------
+    // THeapPath::getName
+    //! \return The Java name of a class
+    // ----------------------------------------------------
+    const SAP_UC *getName(jvmtiEnv *aEnv, jint aClass) {
+        char    *aSignature;
+        char    *aGeneric;
+        jint     aLen;
+        TString  aName;
+
+        if (aClass <= 0 || aClass >= mNrClasses) {
+            return cU("<unknown>");
+        }
+        if (mNames[aClass] != NULL) {
+            return mNames[aClass]->str();
+        }
+        if (aEnv->GetClassSignature(mClassPtr[aClass - 1], &aSignature, &aGeneric) != JVMTI_ERROR_NONE) {
+            return cU("<unknown>");
+        }
+        aLen = (jint)STRLEN_A7(aSignature);
+        if (aSignature[0] == 'L') {
+            aName.assignR(aSignature + 1, aLen - 2);
+        }
+        else {
+            aName.assignR(aSignature, aLen);
+        }
+        aName.replace(cU('/'), cU('.'));
+        mNames[aClass] = new TString(aName.str());
+
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aSignature);
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aGeneric);
+        return mNames[aClass]->str();
+    }
+    // ----------------------------------------------------
+    // THeapPath::getFieldName
+    //! \brief Resolve a JVMTI field index
+    //!
+    //! The index counts the fields of the transitive interfaces
+    //! first, then the fields of the super classes from
+    //! java.lang.Object downwards and the declared fields last.
+    //! \param aEnv     The private tool interface
+    //! \param aJni     The Java native interface
+    //! \param aClass   The class index of the referrer
+    //! \param aIndex   The field index
+    //! \param aName    The field name
+    // ----------------------------------------------------
+    void getFieldName(
+            jvmtiEnv    *aEnv,
+            JNIEnv      *aJni,
+            jint         aClass,
+            jint         aIndex,
+            TString     *aName) {
+
+        jint     aCnt   = 0;
+        jint     aDepth = 0;
+        jint     aSuper;
+        jint     i;
+        SAP_UC   aBuffer[32];
+
+        *aName = cU("#");
+        aName->concat(TString::parseInt(aIndex, aBuffer));
+        if (aClass <= 0 || aClass >= mNrClasses) {
+            return;
+        }
+        mStamp++;
+        collectInterfaces(aEnv, aJni, aClass, &aCnt);
+
+        for (i = 0; i < aCnt; i++) {
+            if (getDeclaredField(aEnv, mList[i], &aIndex, aName)) {
+                return;
+            }
+        }
+        // Class chain from java.lang.Object downwards
+        for (aSuper = aClass; aSuper > 0 && aDepth < mNrClasses; aSuper = getSuper(aEnv, aJni, aSuper)) {
+            mList[aDepth++] = aSuper;
+        }
+        for (i = aDepth - 1; i >= 0; i--) {
+            if (getDeclaredField(aEnv, mList[i], &aIndex, aName)) {
+                return;
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // THeapPath::getDeclaredField
+    //! \brief Consume the declared fields of a class
+    //! \param aIndex   The remaining field index
+    //! \return \c TRUE if the index refers to a declared field
+    // ----------------------------------------------------
+    bool getDeclaredField(
+            jvmtiEnv    *aEnv,
+            jint         aClass,
+            jint        *aIndex,
+            TString     *aName) {
+
+        jfieldID   *aFields = NULL;
+        jint        aCnt    = 0;
+        char       *aFieldName;
+        char       *aSignature;
+        char       *aGeneric;
+        bool        aFound  = false;
+
+        if (aEnv->GetClassFields(mClassPtr[aClass - 1], &aCnt, &aFields) != JVMTI_ERROR_NONE) {
+            return false;
+        }
+        if (*aIndex < aCnt) {
+            aFound = true;
+            if (aEnv->GetFieldName(mClassPtr[aClass - 1], aFields[*aIndex], &aFieldName, &aSignature, &aGeneric) == JVMTI_ERROR_NONE) {
+                aName->assignR(aFieldName, STRLEN_A7(aFieldName));
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aFieldName);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aSignature);
+                /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aGeneric);
+            }
+        }
+        else {
+            *aIndex -= aCnt;
+        }
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aFields);
+        return aFound;
+    }
+    // ----------------------------------------------------
+    // THeapPath::getSuper
+    //! \return The class index of the super class or 0
+    // ----------------------------------------------------
+    jint getSuper(jvmtiEnv *aEnv, JNIEnv *aJni, jint aClass) {
+        jclass jSuper = aJni->GetSuperclass(mClassPtr[aClass - 1]);
+        jlong  aTag   = 0;
+
+        if (jSuper == NULL) {
+            return 0;
+        }
+        aEnv->GetTag(jSuper, &aTag);
+        aJni->DeleteLocalRef(jSuper);
+        return (aTag != 0 && !HEAPGRAPH_IS_NODE(aTag)) ? HEAPGRAPH_TAG_VALUE(aTag) : 0;
+    }
+    // ----------------------------------------------------
+    // THeapPath::collectInterfaces
+    //! \brief Transitive interfaces in the order of the VM
+    //! \see THeapDump::collectInterfaces
+    // ----------------------------------------------------
+    void collectInterfaces(
+            jvmtiEnv     *aEnv,
+            JNIEnv       *aJni,
+            jint          aClass,
+            jint         *aCnt) {
+
+        jclass      *aIfacePtr = NULL;
+        jint        *aIfaces;
+        jint         aNrIface  = 0;
+        jint         aSuper;
+        jlong        aTag;
+        jint         i;
+
+        aSuper = getSuper(aEnv, aJni, aClass);
+        if (aSuper > 0) {
+            collectInterfaces(aEnv, aJni, aSuper, aCnt);
+        }
+        if (aEnv->GetImplementedInterfaces(mClassPtr[aClass - 1], &aNrIface, &aIfacePtr) != JVMTI_ERROR_NONE) {
+            return;
+        }
+        aIfaces = new jint[aNrIface + 1];
+        for (i = 0; i < aNrIface; i++) {
+            aTag = 0;
+            aEnv->GetTag(aIfacePtr[i], &aTag);
+            aJni->DeleteLocalRef(aIfacePtr[i]);
+            aIfaces[i] = (aTag != 0 && !HEAPGRAPH_IS_NODE(aTag)) ? HEAPGRAPH_TAG_VALUE(aTag) : 0;
+            if (aIfaces[i] > 0) {
+                collectInterfaces(aEnv, aJni, aIfaces[i], aCnt);
+            }
+        }
+        for (i = 0; i < aNrIface; i++) {
+            if (aIfaces[i] > 0 && mMark[aIfaces[i]] != mStamp) {
+                mMark[aIfaces[i]] = mStamp;
+                mList[(*aCnt)++]  = aIfaces[i];
+            }
+        }
+        delete [] aIfaces;
+        /*SAPUNICODEOK_CHARTYPE*/ aEnv->Deallocate((unsigned char*)aIfacePtr);
+    }
+    // ----------------------------------------------------
+    // THeapPath::getRootName
+    //! \return The name of a GC root kind
+    // ----------------------------------------------------
+    static const SAP_UC *getRootName(jint aKind) {
+        switch (aKind) {
+            case JVMTI_HEAP_REFERENCE_JNI_GLOBAL:   return cU("JNI global");
+            case JVMTI_HEAP_REFERENCE_SYSTEM_CLASS: return cU("System class");
+            case JVMTI_HEAP_REFERENCE_MONITOR:      return cU("Monitor");
+            case JVMTI_HEAP_REFERENCE_STACK_LOCAL:  return cU("Stack local");
+            case JVMTI_HEAP_REFERENCE_JNI_LOCAL:    return cU("JNI local");
+            case JVMTI_HEAP_REFERENCE_THREAD:       return cU("Thread");
+            default:                                return cU("Other");
+        }
+    }
+};
+
+#endif
@@ -63,10 +63,10 @@ extern "C" int filterException (struct _EXCEPTION_POINTERS *ep)
 #endif
 
 // -----------------------------------------------------------------
-// doRepeat: JAVA Thread to repeat last command
-//! Repeater thread task
+// doScheduleThread: JAVA Thread for periodic jobs
+//! Scheduler thread task
 // -----------------------------------------------------------------
-extern "C" void JNICALL doRepeatThread (
+extern "C" void JNICALL doScheduleThread (
         jvmtiEnv        *aJvmti,
         JNIEnv          *aJni,
         void            *aArg) {
@@ -74,12 +74,18 @@ extern "C" void JNICALL doRepeatThread (
     TCommand        *aCommand = TCommand::getInstance();
     jvmtiError       aResult;
     TMonitorThread  *aThread;
+    int              aSleep;
 
     aResult = aJvmti->GetThreadLocalStorage(NULL, (void **)&aThread);
-    
+
+    // The telnet thread removes jobs, read the job list under the command lock
+    mMonitorJni->enter();
+        aSleep = aCommand->getSleepTime();
+    mMonitorJni->exit();
+
     for (;;) {
         aJvmti->RawMonitorEnter(mRawMonitorSync);
-        aJvmti->RawMonitorWait(mRawMonitorSync, aCommand->getSleepTime());
+        aJvmti->RawMonitorWait(mRawMonitorSync, aSleep);
         aJvmti->RawMonitorExit(mRawMonitorSync);
         
         // Synchronize command execution
@@ -87,14 +93,69 @@ extern "C" void JNICALL doRepeatThread (
             aThread->attach(&aJni); 
 
             aCommand->executeStackCmd(aJvmti, aJni);
-
-            if (aCommand->repeat()) {
-                aCommand->execute(aJvmti, aJni, NULL);
-            }
+            aCommand->runJobs(aJvmti, aJni);
+            TMonitor::getInstance()->sampleSeries(aJvmti);
+            TMonitor::getInstance()->updateMetrics(aJvmti);
+            aSleep = aCommand->getSleepTime();
         mMonitorJni->exit();
     }
 }
 // -----------------------------------------------------------------
+// doAnalyseThread: JAVA Thread for heap graph analysis
+//! Analyser thread task
+// -----------------------------------------------------------------
+extern "C" void JNICALL doAnalyseThread (
+        jvmtiEnv        *aJvmti,
+        JNIEnv          *aJni,
+        void            *aArg) {
+
+    THeapGraph::getInstance()->run();
+}
+// -----------------------------------------------------------------
+// doAlertThread: JAVA Thread for leak alerts
+//! Alert thread task
+// -----------------------------------------------------------------
+extern "C" void JNICALL doAlertThread (
+        jvmtiEnv        *aJvmti,
+        JNIEnv          *aJni,
+        void            *aArg) {
+
+    TMonitor::getInstance()->runAlert(aJvmti);
+}
+// -----------------------------------------------------------------
+// doTraceThread: JAVA Thread for binary trace output
+//! Trace writer thread task
+// -----------------------------------------------------------------
+extern "C" void JNICALL doTraceThread (
+        jvmtiEnv        *aJvmti,
+        JNIEnv          *aJni,
+        void            *aArg) {
+
+    TTraceBinary::getInstance()->run();
+}
+// -----------------------------------------------------------------
+// doOutputThread: JAVA Thread for asynchronous output
+//! Output writer thread task
+// -----------------------------------------------------------------
+extern "C" void JNICALL doOutputThread (
+        jvmtiEnv        *aJvmti,
+        JNIEnv          *aJni,
+        void            *aArg) {
+
+    TOutputQueue::getInstance()->run();
+}
+// -----------------------------------------------------------------
+// doMetricsThread: JAVA Thread for metrics scrapes
+//! Metrics server thread task
+// -----------------------------------------------------------------
+extern "C" void JNICALL doMetricsThread (
+        jvmtiEnv        *aJvmti,
+        JNIEnv          *aJni,
+        void            *aArg) {
+
+    TMetricsServer::getInstance()->run();
+}
+// -----------------------------------------------------------------
 // doTelnetThread: JAVA Thread for command line application
 //! Telnet thread task
 // -----------------------------------------------------------------
@@ -108,8 +169,8 @@ extern "C" void JNICALL doTelnetThread (
     TConsole        *aConsole    = TConsole::getInstance();
     TSecurity       *aSecurity   = TSecurity::getInstance();
     TProperties     *aProperties = TProperties::getInstance();
-    TMonitor        *aMonitor    = TMonitor::getInstance();
     TMonitorThread  *aThread;
+    TSession        *aSession;
     TXmlWriter       aWriter(XMLWRITER_TYPE_ASCII);
     TXmlTag          aRootTag(cU("Message"), XMLTAG_TYPE_NODE);
 
@@ -127,49 +188,43 @@ extern "C" void JNICALL doTelnetThread (
         aResult = aJvmti->SetThreadLocalStorage(NULL, aThread);
     }
 
+    // Serve all clients, execute one command line at a time
     for (;;) {
-        if (!aConsole->checkState()) {
-            while (aConsole->open()) {
-                if (aSecurity->login()) {
-					aConsole->login();
-                    break;
-                }
-                SLEEP(1);
-            }
-            if (aProperties->getConsoleWriterType() == XMLWRITER_TYPE_XML) {
-                aMonitor->syncOutput(
-                    cU("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n")
-                    cU("<sherlok>\n")
-                    cU("<Message Info=\"Connected\"/>\n"));
-            }
-        }
-
-        if (aConsole->errorState()) {
-            break;
-        }
-        aConsole->prompt();
+        aSession = aConsole->select();
 
-        if (!aCommand->read()) {
-            if (aCommand->getCmd() != COMMAND_CONTINUE) {
-                aWriter.print(&aRootTag);
+        if (aSession->getState() != SESSION_READY) {
+            if (aSecurity->login(aSession)) {
+                aConsole->login();
+                aConsole->prompt();
             }
+            aConsole->release();
             continue;
         }
 
-        // Synchronize command execution
+        // Synchronize command execution, the scheduler shares the parser
         mMonitorJni->enter();
-            aJvmti = aProperties->getJvmti();
-            aThread->attach(&aJni); 
-
-            if (aCommand->getCmd() == COMMAND_GC) {
-                aJvmti->ForceGarbageCollection();
+            if (!aCommand->read()) {
+                if (aCommand->getCmd() != COMMAND_CONTINUE) {
+                    aWriter.print(&aRootTag);
+                }
             }
             else {
-                aCommand->execute(aJvmti, aJni, NULL);
+                aJvmti = aProperties->getJvmti();
+                aThread->attach(&aJni); 
+
+                if (aCommand->getCmd() == COMMAND_GC) {
+                    aJvmti->ForceGarbageCollection();
+                }
+                else {
+                    aCommand->execute(aJvmti, aJni, NULL);
+                }
             }
         mMonitorJni->exit();
+        // The output of the command goes to the session
+        TOutputQueue::getInstance()->sync();
+        aConsole->prompt();
+        aConsole->release();
     }
-    aConsole->close();
 }
 
 // ------------------------------------------------------------------------------------
@@ -187,6 +242,11 @@ extern "C" void JNICALL onVmDeath(
             aCmd->parse(cU("lsc -m1"));
             aCmd->execute(aJvmti, aJni, NULL);
         }
+        TTraceBinary::getInstance()->close();
+        TClassCache::getInstance()->close();
+        TOutputQueue::getInstance()->sync();
+        TTracer::getInstance()->closeFile();
+        TLogger::getInstance()->stop();
     } 
     JNI_CATCH {
         ERROR_OUT(cU("onVmDeath"), 0);
@@ -232,22 +292,40 @@ extern "C" void JNICALL onVmInit(
     }
 
     if (aJni != NULL && !gInitialized) {
-        jstring   jStrName[2];
-        jobject   jObjThr [2];
+        jstring   jStrName[7];
+        jobject   jObjThr [7];
         jclass    jClsThread;
         jmethodID jIniThread;
 
         jStrName[0] = aJni->NewStringUTF(cR("_Sherlok"));
-        jStrName[1] = aJni->NewStringUTF(cR("_Repeate"));
+        jStrName[1] = aJni->NewStringUTF(cR("_Schedule"));
+        jStrName[2] = aJni->NewStringUTF(cR("_Analyse"));
+        jStrName[3] = aJni->NewStringUTF(cR("_Alerter"));
+        jStrName[4] = aJni->NewStringUTF(cR("_Tracer"));
+        jStrName[5] = aJni->NewStringUTF(cR("_Writer"));
+        jStrName[6] = aJni->NewStringUTF(cR("_Metrics"));
 
         jClsThread  = aJni->FindClass(cR("java/lang/Thread")); 
         jIniThread  = aJni->GetMethodID(jClsThread, cR("<init>"), cR("(Ljava/lang/String;)V")); 
 
         jObjThr[0]  = aJni->NewObject(jClsThread, jIniThread, jStrName[0]); 
         jObjThr[1]  = aJni->NewObject(jClsThread, jIniThread, jStrName[1]); 
+        jObjThr[2]  = aJni->NewObject(jClsThread, jIniThread, jStrName[2]); 
+        jObjThr[3]  = aJni->NewObject(jClsThread, jIniThread, jStrName[3]); 
+        jObjThr[4]  = aJni->NewObject(jClsThread, jIniThread, jStrName[4]); 
+        jObjThr[5]  = aJni->NewObject(jClsThread, jIniThread, jStrName[5]); 
+        jObjThr[6]  = aJni->NewObject(jClsThread, jIniThread, jStrName[6]); 
 
         aResult     = aJvmti->RunAgentThread((jthread)jObjThr[0], doTelnetThread, NULL, JVMTI_THREAD_MAX_PRIORITY);
-        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[1], doRepeatThread, NULL, JVMTI_THREAD_MAX_PRIORITY);
+        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[1], doScheduleThread, NULL, JVMTI_THREAD_MAX_PRIORITY);
+        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[2], doAnalyseThread, NULL, JVMTI_THREAD_NORM_PRIORITY);
+        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[3], doAlertThread,   NULL, JVMTI_THREAD_NORM_PRIORITY);
+        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[4], doTraceThread,   NULL, JVMTI_THREAD_NORM_PRIORITY);
+        aResult     = aJvmti->RunAgentThread((jthread)jObjThr[5], doOutputThread,  NULL, JVMTI_THREAD_NORM_PRIORITY);
+
+        if (aProperties->getMetricsPort() != 0) {
+            aResult = aJvmti->RunAgentThread((jthread)jObjThr[6], doMetricsThread, NULL, JVMTI_THREAD_NORM_PRIORITY);
+        }
 
         // register all classes loaded so far
         aJvmti->GetLoadedClasses(&aCnt, &aClassPtr);
@@ -587,6 +665,13 @@ extern "C" JNIEXPORT jint JNICALL Agent_OnLoad(
     aTracer = TTracer::getInstance();
     aTracer->initialize();
 
+    THeapGraph::getInstance()->initialize(aJvmti);
+    TTraceBinary::getInstance()->initialize(aJvmti);
+    TMappedFile::initialize(aJvmti);
+    TOutputQueue::getInstance()->initialize(aJvmti);
+    TMetricsServer::getInstance()->initialize(aJvmti);
+    TConsole::getInstance()->initialize(aJvmti);
+
     // get capabilities
     aCapa = new jvmtiCapabilities;
 
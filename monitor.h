@@ -24,6 +24,10 @@
 #define MONITOR_H
 #include <jvmti.h>
 
+#define MONITOR_ALERT_QUEUE     64  //!< Number of pending leak alerts
+#define MONITOR_SERIES_METHODS   8  //!< Number of methods in the time series
+#define METRICS_METHODS         10  //!< Number of top methods in the metrics
+
 // ----------------------------------------------------
 //! \class TException
 //! \brief Implements hash object for Java exceptions
@@ -189,19 +193,46 @@ public:
     }
 };
     
+// ---------------------------------------------------------
+//! \struct THeapSlot
+//! \brief Histogram entry for one class
+// ---------------------------------------------------------
+typedef struct {
+    TMonitorClass *mClass;              //!< Class assigned to this slot
+    jlong          mCount;              //!< Number of instances
+    jlong          mSize;               //!< Size of all instances
+} THeapSlot;
+
+// ---------------------------------------------------------
+//! \struct THeapHistogram
+//! \brief User data for the heap runner
+//!
+//! Each class owns a slot index, which is assigned before the heap
+//! iteration. The callback adds to the slot without hash lookup and 
+//! without lock, the result is merged into the classes afterwards.
+// ---------------------------------------------------------
+typedef struct {
+    THeapSlot     *mSlots;              //!< Flat array indexed by class
+    jint           mNrSlots;            //!< Number of slots
+    TMonitorClass *mContext;            //!< Allocation context or NULL
+    unsigned int   mTID;                //!< Current transaction
+} THeapHistogram;
+
 // ---------------------------------------------------------
 // TMonitor::heapCallback
 //! \brief Callback for the heap runner
 //! \param  aClassTag The hash to the class
-//! \param  aSize The size of the class
+//! \param  aSize The size of the object
 //! \param  aTag  The hash to the associated memory
-//! \param  aUserData Optional user data of heap runner
-//! \return Operation control: JVMTI_ITERATION_CONTINUE
+//! \param  aLength Array length or -1
+//! \param  aUserData The heap histogram
+//! \return Visit control: 0 to continue
 // ---------------------------------------------------------
-extern "C" jvmtiIterationControl JNICALL TMonitorHeapCallback(
+extern "C" jint JNICALL TMonitorHeapCallback(
             jlong        aClassTag, 
             jlong        aSize, 
             jlong       *aTag, 
+            jint         aLength,
             void        *aUserData);
 
 
@@ -211,7 +242,6 @@ extern "C" jvmtiIterationControl JNICALL TMonitorHeapCallback(
 //!
 // ----------------------------------------------------
 class TMonitor {
-    friend jvmtiIterationControl JNICALL TMonitorHeapCallback(jlong, jlong, jlong*, void*);
 private:
     THashClasses     mClasses;          //!< Hash table for java classes
     TListClasses     mDelClasses;       //!< List for deleted classes
@@ -225,9 +255,23 @@ private:
     TMonitorMutex   *mRawMonitorThreads;
     TMonitorMutex   *mRawMonitorMemory;
     TMonitorMutex   *mRawMonitorAccess;
+    TMonitorMutex   *mRawMonitorCounter; //!< Serializes the epoch swaps of the method counters
+    TMonitorMutex   *mRawMonitorAlert;  //!< Sync with alert thread
+    jlong            mAlertQueue[MONITOR_ALERT_QUEUE]; //!< Class IDs with pending alert
+    jint             mAlertFirst;       //!< First pending alert
+    jint             mNrAlerts;         //!< Number of pending alerts
+    jlong            mDroppedAlerts;    //!< Alerts lost on queue overflow
     TProperties     *mProperties;        //!< Properties reader
     TMonitorMethod  *mTriggerMethod;     //!< Method to trigger
     TTracer         *mTracer; 
+    TTraceBinary    *mBinary;           //!< Binary method trace
+    TClassCache     *mClassCache;       //!< Persistent class decisions
+    TFoldedStacks    mFoldedStacks;     //!< Aggregated trace stacks
+    TSeries         *mSeries;           //!< Time series of the statistic counters
+    TMonitorMethod  *mSeriesMethods[MONITOR_SERIES_METHODS]; //!< Methods sampled into the series
+    TString          mSeriesNames[MONITOR_SERIES_METHODS];   //!< Method names of the series columns
+    jint             mNrSeriesNames;    //!< Number of methods in the series
+    jlong            mSeriesNext;       //!< Time of the next sample
     TMonitorClass   *mRefClass;    
     TXmlWriter       mWriter;
     jint             mNrMethods;
@@ -250,6 +294,7 @@ private:
     TXmlTag         *mTraceEvent;
     bool             mInitialized;
     bool             mHandleException;
+    bool             mThreadEvents;     //!< Method events are enabled per thread
     static unsigned int gTransaction;
     static TMonitor     *mInstance;
 
@@ -273,10 +318,22 @@ private:
         if (mRawMonitorAccess  != NULL) {
             delete mRawMonitorAccess;
         }
+
+        if (mRawMonitorCounter != NULL) {
+            delete mRawMonitorCounter;
+        }
         
         if (mRawMonitorOutput  != NULL) {
             delete mRawMonitorOutput;
         }
+
+        if (mRawMonitorAlert   != NULL) {
+            delete mRawMonitorAlert;
+        }
+
+        if (mSeries != NULL) {
+            delete mSeries;
+        }
     }
     // ----------------------------------------------------
     // TMonitor::TMonitor
@@ -300,10 +357,20 @@ private:
         mGCNr               = 0;
         mGlobalRest         = 0;
         mInitialized        = false;
+        mThreadEvents       = false;
+        mRawMonitorAlert    = NULL;
+        mRawMonitorCounter  = NULL;
+        mAlertFirst         = 0;
+        mNrAlerts           = 0;
+        mDroppedAlerts      = 0;
         mRefClass           = NULL;
         mTriggerMethod      = NULL;
+        mSeries             = NULL;
+        mSeriesNext         = 0;
         mProperties         = TProperties::getInstance();
         mTracer             = TTracer::getInstance();
+        mBinary             = TTraceBinary::getInstance();
+        mClassCache         = TClassCache::getInstance();
         mCallstack          = NULL;
         mMxFact             = NULL;
         mMxBean             = NULL;
@@ -312,6 +379,8 @@ private:
         mTraceTag.addTag(cU(""));
         mContextClasses.reset();
         mContextMethods.reset();
+        memsetR(mSeriesMethods, 0, sizeofR(mSeriesMethods));
+        mNrSeriesNames = 0;
 
         if (mProperties->getProfilerMode() == PROFILER_MODE_ATS) {   
             mCallstack = new TCallstack(512);
@@ -347,7 +416,11 @@ public:
             mRawMonitorThreads  = new TMonitorMutex(aJvmti, cU("_MonitorThread"));
             mRawMonitorMemory   = new TMonitorMutex(aJvmti, cU("_MonitorMemory"));
             mRawMonitorAccess   = new TMonitorMutex(aJvmti, cU("_MonitorAccess"));
+            mRawMonitorCounter  = new TMonitorMutex(aJvmti, cU("_MonitorCounter"));
             mRawMonitorOutput   = new TMonitorMutex(aJvmti, cU("_MonitorOutput"));
+            mRawMonitorAlert    = new TMonitorMutex(aJvmti, cU("_MonitorAlert"));
+            TMonitorMethod::initialize(aJvmti);
+            mClassCache->initialize();
         }
     }
     // ----------------------------------------------------
@@ -375,6 +448,16 @@ public:
         mRawMonitorOutput->exit();
     }
     // ----------------------------------------------------
+    // TMonitor::setOutputFile
+    //! \brief Redirect the output of the commands
+    //! \param aFile The output file or \c NULL for console output
+    // ----------------------------------------------------
+    void setOutputFile(TMappedFile *aFile) {
+        mRawMonitorOutput->enter();
+        mWriter.setFile(aFile);
+        mRawMonitorOutput->exit();
+    }
+    // ----------------------------------------------------
     // TMonitor::onClassRegister
     //! \brief  Register class and methods to profiler
     // ----------------------------------------------------
@@ -414,6 +497,14 @@ public:
     // ----------------------------------------------------
     // TMonitor::onClassPrepare
     //! \brief  Register class and methods to profiler
+    //!
+    //! Class loaders run in parallel, so the JVMTI queries for a new
+    //! class and the method names are read before mRawMonitorAccess
+    //! is locked. The lock only protects the publication into mClasses
+    //! and mMethods, breakpoints of the trigger mode are set after it.
+    //! If another thread has registered the class in the meantime, the
+    //! prepared class and methods are released and the registered
+    //! class is used.
     //! \param  aJni   The Java native interface
     //! \param  jThread The current thread
     //! \param  jClass  The class to register
@@ -428,20 +519,31 @@ public:
         jlong                    jSize;
         THashClasses::iterator   aItClass;
         THashMethods::iterator   aItMethod;
-        jboolean                 jIsInterface;
-        TMemoryBit              *aMemBit;
+        jboolean                 jIsInterface = false;
+        TMemoryBit              *aMemBit    = NULL;
+        TMemoryBit              *aNewMemBit = NULL;
         TMonitorClass           *aClass     = NULL;
+        TMonitorClass           *aNewClass  = NULL;
         TMonitorMethod          *aMethod;
+        TMonitorMethod         **aMethods   = NULL;
+        TMonitorMethod         **aPrepared  = NULL;
         TMonitorThread          *aThreadObj = NULL;
-        bool                     aActivate  = false;
         jint                     aCntMethod = 0;
+        jint                     aFlags     = 0;
+        jint                     aGeneration = 0;
+        bool                     aMatch     = false;
         jvmtiError               aResult;
-        jmethodID               *aPtrMethod;
+        jmethodID               *aPtrMethod = NULL;
 
-        TMonitorLock aLockAccess(mRawMonitorAccess);
         aResult = aJvmti->GetTag(jClass, (jlong *)&aMemBit);
         aResult = aJvmti->GetThreadLocalStorage(jThread, (void**)&aThreadObj);
 
+        // Do not process JNI calls relating to registration
+        if (aThreadObj != NULL) {
+            aThreadObj->setProcessJni(true);
+        }        
+
+        // Prepare a new class without lock
         if (aMemBit == NULL) {
             jclass         jSuper       = NULL;
             TMonitorClass *aSuper       = NULL;
@@ -454,68 +556,147 @@ public:
                 aJvmti->GetTag(jSuper, &aSuperTag);
                 aSuper  = findClass(aJvmti, aSuperTag);
             }
-            aClass  = new TMonitorClass(aJvmti, jClass, aSuper);
-            aMemBit = new TMemoryBit(aClass, jSize, gTransaction);
-            aResult = aJvmti->SetTag(jClass, (jlong)aMemBit);
-            aClass->setID((jlong)aMemBit);
+            aNewClass  = new TMonitorClass(aJvmti, jClass, aSuper);
+            aNewMemBit = new TMemoryBit(aNewClass, jSize, gTransaction);
+            aNewClass->setID((jlong)aNewMemBit);
             aJni->ExceptionClear();
 
-            resetClass(aClass);
+            aGeneration = mClassCache->getGeneration();
+            aFlags      = resetClass(aNewClass);
 
-            // Trace ClassLoad events
-            if (mTracer->doTraceClass()) {
-                mRawMonitorOutput->enter();
+            // Fields of excluded classes are registered on demand
+            if (!aNewClass->getExcluded()) {
+                aNewClass->registerFields(aJvmti, aJni, jClass);
+            }
+        }
+        aResult = aJvmti->IsInterface(jClass, &jIsInterface);
+        aResult = aJvmti->GetClassMethods(jClass, &aCntMethod, &aPtrMethod);
+        if (aResult != JVMTI_ERROR_NONE) {
+            aCntMethod = 0;
+        }
+        if (aCntMethod > 0) {
+            aMethods  = new TMonitorMethod*[aCntMethod];
+            aPrepared = new TMonitorMethod*[aCntMethod];
+        }
 
-                if (mTracer->doTraceStack()) {
-                    TXmlTag aTagStack(cU("Traces"), XMLTAG_TYPE_NODE);
-                    aTagStack.addAttribute(cU("Type"),      cU("TraceTrigger"));
-                    aTagStack.addAttribute(cU("ClassName"), aClass->getName());
-                    
-                    int aLevel;
-                    if (dumpSingleStack(aJvmti, aJni, &aTagStack, &aLevel, cU("ClassLoad"), aClass->getName(), true, 0, true,jThread) != NULL) {
-                        mTracer->printTrace(&aTagStack, aLevel);
-                    }
+        // Prepare the methods of a new class without lock, the method 
+        // rules read the names unless the class has no matching rules
+        for (i = 0; i < aCntMethod; i++) {
+            aPrepared[i] = NULL;
+            if (aNewClass != NULL) {
+                aPrepared[i] = new TMonitorMethod(aJvmti, aJni, aPtrMethod[i], jIsInterface, aNewClass, aNewClass->getName());
+                if (!aNewClass->getExcluded() && !aNewClass->hasPlainMethods()) {
+                    aPrepared[i]->resolve();
                 }
+            }
+        }
 
-                TXmlTag  aTagClass(cU("Trace"));
-                traceClass(&aTagClass, aClass, cU("ClassLoad"), TSystem::getTimestamp());
-                mTracer->print(&aTagClass, XMLWRITER_TYPE_LINE);
-                mRawMonitorOutput->exit();
+        // Publish class and methods
+        mRawMonitorAccess->enter();
+        if (aNewClass != NULL) {
+            aResult = aJvmti->GetTag(jClass, (jlong *)&aMemBit);
+            if (aMemBit == NULL) {
+                aMemBit = aNewMemBit;
+                aClass  = aNewClass;
+                aResult = aJvmti->SetTag(jClass, (jlong)aMemBit);
             }
         }
-        else {
+        if (aClass == NULL) {
             aClass = aMemBit->mCtx;
         }
         aItClass = mClasses.findInsert((jlong)aMemBit, aClass, 0, 0, 2);        
 
-        // Do not process JNI calls relating to registration
-        if (aThreadObj != NULL) {
-            aThreadObj->setProcessJni(true);
-        }        
-        aResult = aJvmti->IsInterface(jClass, &jIsInterface);
-        aResult = aJvmti->GetClassMethods(jClass, &aCntMethod, &aPtrMethod);
-        
         for (i = 0; i < aCntMethod; i++) {
-            aActivate = false;
+            aMethod   = NULL;
             aItMethod = mMethods.find(aPtrMethod[i]);
-            if (aItMethod == mMethods.end()) {
+            if (aItMethod != mMethods.end()) {
+                aMethod = aItMethod->aValue;
+            }
+            else if (aClass == aNewClass) {
+                aMethod      = aPrepared[i];
+                aPrepared[i] = NULL;
+            }
+            if (aMethod == NULL) {
                 aMethod = new TMonitorMethod(aJvmti, aJni, aPtrMethod[i], jIsInterface, aClass, aClass->getName());
-                mMethods.insert(aPtrMethod[i], aMethod, aClass);
             }
-            else {
-                aMethod = aItMethod->aValue;
+            if (aItMethod == mMethods.end()) {
+                mMethods.insert(aPtrMethod[i], aMethod, aClass);
+                registerSeries(aMethod);
             }
             aClass->registerMethod(aMethod);
-            resetMethod(aMethod);
+            if (resetMethod(aMethod, false)) {
+                aMatch = true;
+            }
+            aMethods[i] = aMethod;
+        }
+
+        // Remember a class without method rules for the next start
+        if (aClass == aNewClass && aCntMethod > 0 && !aMatch && (aFlags & CLASS_CACHE_PLAIN) == 0) {
+            mClassCache->put(aClass->getName(), aFlags | CLASS_CACHE_PLAIN, aGeneration);
+        }
+        mRawMonitorAccess->exit();
+
+        // Breakpoints of the trigger mode, release unused prepared methods
+        for (i = 0; i < aCntMethod; i++) {
+            aMethods[i]->updateBreakpoints();
+            if (aPrepared[i] != NULL) {
+                delete aPrepared[i];
+            }
+        }
+        delete [] aMethods;
+        delete [] aPrepared;
+
+        if (aPtrMethod != NULL) {
+            aJvmti->Deallocate((unsigned char*)aPtrMethod);
+        }
+
+        if (aNewClass != NULL && aClass != aNewClass) {
+            // Registered by a concurrent thread
+            delete aNewMemBit;
+            delete aNewClass;
+        }
+        else if (aNewClass != NULL && mTracer->doTraceClass()) {
+            traceClassLoad(aJvmti, aJni, jThread, aClass);
         }
-        aJvmti->Deallocate((unsigned char*)aPtrMethod);
-        aClass->registerFields(aJvmti, aJni, jClass);
+
         // Reset thread object for normal processing
         if (aThreadObj != NULL) {
             aThreadObj->setProcessJni(false);
         }
     }
     // ----------------------------------------------------
+    // TMonitor::traceClassLoad
+    //! \brief Trace the ClassLoad event of a new class
+    //! \param  aJvmti  The Java tool interface
+    //! \param  aJni    The Java native interface
+    //! \param  jThread The current thread
+    //! \param  aClass  The new class
+    // ----------------------------------------------------
+    void traceClassLoad(
+            jvmtiEnv        *aJvmti,
+            JNIEnv          *aJni,
+            jthread          jThread,
+            TMonitorClass   *aClass) {
+
+        mRawMonitorOutput->enter();
+
+        if (mTracer->doTraceStack()) {
+            TXmlTag aTagStack(cU("Traces"), XMLTAG_TYPE_NODE);
+            aTagStack.addAttribute(cU("Type"),      cU("TraceTrigger"));
+            aTagStack.addAttribute(cU("ClassName"), aClass->getName());
+            
+            int aLevel;
+            if (dumpSingleStack(aJvmti, aJni, &aTagStack, &aLevel, cU("ClassLoad"), aClass->getName(), true, 0, true,jThread) != NULL) {
+                mTracer->printTrace(&aTagStack, aLevel);
+            }
+        }
+
+        TXmlTag  aTagClass(cU("Trace"));
+        traceClass(&aTagClass, aClass, cU("ClassLoad"), TSystem::getTimestamp());
+        mTracer->print(&aTagClass, XMLWRITER_TYPE_LINE);
+        mRawMonitorOutput->exit();
+    }
+    // ----------------------------------------------------
     // TMonitor::onObjectDelete
     //! \brief Remove class registration
     //! \param aTag   The hash to the associated memory
@@ -544,6 +725,7 @@ public:
                     mTracer->print(&aTagClass);
                     mRawMonitorOutput->exit();
                 }
+                unregisterSeries(aClass);
                 mMethods.deleteArena(aClass);
                 aClass->setDeleteFlag(true);
 
@@ -616,6 +798,45 @@ public:
         }
         return aClass;
     }
+    // ---------------------------------------------------------
+    // TMonitor::findClassObject
+    //! \brief Find the loaded class for a hash value
+    //!
+    //! The classes are local references of the current thread,
+    //! all but the result are deleted.
+    //! \param aJvmti    The Java tool interface
+    //! \param aJni      The Java native interface
+    //! \param aTagValue The hash to the class
+    //! \return The class object or NULL, a local reference
+    // ---------------------------------------------------------
+    jclass findClassObject(
+            jvmtiEnv        *aJvmti,
+            JNIEnv          *aJni,
+            jlong            aTagValue) {
+
+        jint             i;
+        jint             aCnt      = 0;
+        jclass          *aClassPtr = NULL;
+        jclass           jClass    = NULL;
+        jlong            aTag;
+
+        if (aJvmti->GetLoadedClasses(&aCnt, &aClassPtr) != JVMTI_ERROR_NONE) {
+            return NULL;
+        }
+        for (i = 0; i < aCnt; i++) {
+            aTag = 0;
+            aJvmti->GetTag(aClassPtr[i], &aTag);
+            if (jClass == NULL && aTag == aTagValue) {
+                jClass = aClassPtr[i];
+            }
+            else if (aJni != NULL) {
+                aJni->DeleteLocalRef(aClassPtr[i]);
+            }
+        }
+        /*SAPUNICODEOK_CHARTYPE*/
+        aJvmti->Deallocate((unsigned char*)aClassPtr);
+        return jClass;
+    }
     // ----------------------------------------------------
     // TMonitor::onObjectAlloc
     //! \brief JVMTI callback
@@ -704,7 +925,6 @@ public:
         TMemoryBit     *aMemBit     = NULL;
         TMemoryBit     *aClsBit     = NULL;
         jint            aResult;
-        TXmlTag        *aTag        = NULL;
         jlong           aObjTag     = 0;
         jlong           aClassTag   = 0;
         jclass          jStrClz     = NULL;
@@ -764,32 +984,122 @@ public:
         aMemBit->mSize   = aSize;        
         aContext->allocate(aSize, mGCTime, mGCNr);
 
+        // The alert thread does the heap scan and output
         if (mProperties->doHistoryAlert() &&
-            aContext->getAlert()) {
+            aContext->getAlert()          &&
+           !aContext->getAlertPending()) {
+            postAlert(aContext);
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::postAlert
+    //! \brief Queue a leak alert for the alert thread
+    //!
+    //! The allocating thread only marks the class and wakes up
+    //! the alert thread. If the queue is full the alert stays
+    //! active and the next allocation tries again.
+    //! \param aContext The class with active leak detector
+    // ----------------------------------------------------
+    void postAlert(TMonitorClass *aContext) {
+        TMonitorLock aLock(mRawMonitorAlert);
 
-            SAP_UC   aBuffer[128];
-            TXmlTag  aRootTag(cU("Traces"), XMLTAG_TYPE_NODE);
+        if (aContext->getAlertPending()) {
+            return;
+        }
+        if (mNrAlerts >= MONITOR_ALERT_QUEUE) {
+            mDroppedAlerts++;
+            return;
+        }
+        aContext->setAlertPending(true);
+        mAlertQueue[(mAlertFirst + mNrAlerts) % MONITOR_ALERT_QUEUE] = aContext->getID();
+        mNrAlerts++;
+        mRawMonitorAlert->notify();
+    }
+    // ----------------------------------------------------
+    // TMonitor::runAlert
+    //! \brief Alert thread loop
+    //!
+    //! Waits for queued leak alerts and writes them
+    //! \param aJvmti The Java tool interface
+    // ----------------------------------------------------
+    void runAlert(jvmtiEnv *aJvmti) {
+        jlong aID;
 
-            aRootTag.addAttribute(cU("Type"),  cU("Leak"));
-            aRootTag.addAttribute(cU("Class"), aContext->getName());
+        for (;;) {
+            mRawMonitorAlert->enter();
+            while (mNrAlerts == 0) {
+                mRawMonitorAlert->wait(0);
+            }
+            aID         = mAlertQueue[mAlertFirst];
+            mAlertFirst = (mAlertFirst + 1) % MONITOR_ALERT_QUEUE;
+            mNrAlerts--;
+            mRawMonitorAlert->exit();
 
-            TXmlTag *aTagClass = aRootTag.addTag(cU("Class"), XMLTAG_TYPE_NODE);
-            aContext->dump(aTagClass);
+            dumpAlert(aJvmti, aID);
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::dumpAlert
+    //! \brief Write the leak alert for a class
+    //!
+    //! Alerts of the same class within MemoryAlertInterval are
+    //! suppressed, the history restarts in this case.
+    //! \param aJvmti The Java tool interface
+    //! \param aID    The class ID
+    // ----------------------------------------------------
+    void dumpAlert(
+            jvmtiEnv    *aJvmti,
+            jlong        aID) {
 
-            aTag = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
-            aTag->addAttribute(cU("Detail"), cU("History"));
-            aTag->addAttribute(cU("ID"),     TString::parseHex((jlong)aContext->getID(), aBuffer));
-            aContext->dumpHistory(aTag);
+        THashClasses::iterator aPtrClass;
+        TMonitorClass *aContext;
+        TXmlTag       *aTag;
+        TXmlTag       *aTagClass;
+        jlong          aTime;
+        SAP_UC         aBuffer[128];
+        TXmlTag        aRootTag(cU("Traces"), XMLTAG_TYPE_NODE);
 
-            aTag = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
-            aTag->addAttribute(cU("Detail"), cU("Heap"));
-            aTag->addAttribute(cU("ID"),     TString::parseHex((jlong)aContext->getID(), aBuffer));
-            dumpHeap(aJvmti, aTag, aContext->getID(), NULL);
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        aPtrClass = mClasses.find(aID);
+        if (aPtrClass == mClasses.end()) {
+            return;
+        }
+        aContext = aPtrClass->aValue;
+        aContext->setAlertPending(false);
 
-            mMemoryLeaks.insert(aContext->getID(), aContext);
-            syncOutput(&aRootTag);            
+        if (!aContext->getAlert()) {
+            return;
+        }
+        aTime = TSystem::getTimestamp();
+        if (aContext->getAlertTime() != 0 &&
+            aTime - aContext->getAlertTime() < mProperties->getAlertInterval()) {
             aContext->resetAlert();
+            return;
         }
+        aContext->setAlertTime(aTime);
+
+        aRootTag.addAttribute(cU("Type"),  cU("Leak"));
+        aRootTag.addAttribute(cU("Class"), aContext->getName());
+
+        aTagClass = aRootTag.addTag(cU("Class"), XMLTAG_TYPE_NODE);
+        aContext->dump(aTagClass);
+
+        aTag = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
+        aTag->addAttribute(cU("Detail"), cU("History"));
+        aTag->addAttribute(cU("ID"),     TString::parseHex(aID, aBuffer));
+        aContext->dumpHistory(aTag);
+
+        mMemoryLeaks.insert(aID, aContext);
+        aContext->resetAlert();
+        aLockAccess.exit();
+
+        // The heap runner takes the access lock on its own
+        aTag = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
+        aTag->addAttribute(cU("Detail"), cU("Heap"));
+        aTag->addAttribute(cU("ID"),     TString::parseHex(aID, aBuffer));
+        dumpHeap(aJvmti, aTag, aID, NULL);
+
+        syncOutput(&aRootTag);
     }
     // ----------------------------------------------------
     // TMonitor::deleteThreadObj
@@ -976,6 +1286,17 @@ public:
             aCallstack = aThread->getCallstack();
 
             if (xMethod->checkContext(aCallstack)) {
+                // binary records are written by the trace writer thread
+                if (mTracer->doTraceBinary()) {
+                    aCpuTime    = aThread->getCurrentCpuTime();
+                    aDebugStack = aThread->getDebugstack();
+                    aTimer      = aDebugStack->push();
+                    aTimer->set(xMethod, aCpuTime, aCount);
+                    aThread->getTraceBuffer()->put(
+                            xMethod->getTraceIndex(mBinary), TRACE_BINARY_ENTER, 
+                            aDebugStack->getDepth(), TSystem::getTimestampHp(), 0);
+                    return;
+                }
                 mRawMonitorOutput->enter();
                     aCpuTime = aThread->getCurrentCpuTime();                    
                     TXmlTag  aRootTag(cU("Trace"));
@@ -1104,16 +1425,30 @@ public:
                 aThread->setTimer(aCpuTime);
             }
         
-            mRawMonitorAccess->enter(false);
             aMethod->exit(aCpuTime, aElapsed);
-            mRawMonitorAccess->exit();
 
             jlong aTraceType;
             jlong aTraceInfo;
         
             mNrCallsTrace += max(0, aCallstack->getDepth() - aCallstack->getSequence());
 
-            if (aCallstack->beginSequence() != aCallstack->end() &&
+            if (mTracer->doTraceFolded()) {
+                // aggregate the stack instead of printing it
+                if (mTracer->doTraceEvent(
+                        aThread->getName(), 
+                        aMethod->getDebug(), 
+                        aElapsed, 
+                        aMemory, 
+                        &mNrCallsTrace, 
+                        &aTraceType, 
+                        &aTraceInfo)) {
+
+                    mRawMonitorAccess->enter(false);
+                    mFoldedStacks.add(aCallstack, aElapsed, aCpuTime, aMemory);
+                    mRawMonitorAccess->exit();
+                }
+            }
+            else if (aCallstack->beginSequence() != aCallstack->end() &&
                 mTracer->doTraceEvent(
                     aThread->getName(), 
                     aMethod->getDebug(), 
@@ -1165,6 +1500,17 @@ public:
             aDebugTrc  = (aMethod->getID() == jMethod);
         }
 
+        if (aDebugTrc && mTracer->doTraceBinary()) {
+            aCallstack = aThread->getDebugstack();
+            aCpuTime   = max(0, (int)(aThread->getCurrentCpuTime() - aTimer->getTime()));
+
+            aThread->getTraceBuffer()->put(
+                    aMethod->getTraceIndex(mBinary), TRACE_BINARY_EXIT, 
+                    aCallstack->getDepth(), TSystem::getTimestampHp(), aCpuTime);
+            aCallstack->pop();
+            aDebugTrc  = false;
+        }
+
         if (aDebugTrc) {
             TMonitorLock  aLockOutput(mRawMonitorOutput);
             TXmlTag      *aTag;
@@ -1920,6 +2266,95 @@ public:
 
         aThread = new TMonitorThread(aJvmti, aJni, jThread);
         aResult = aJvmti->SetThreadLocalStorage(jThread, (void *)aThread);
+
+        if (mThreadEvents && getState()) {
+            setMethodEvents(aJvmti, jThread, aThread, true);
+        }
+    }
+    // -----------------------------------------------------------------
+    // TMonitor::setMethodEvents
+    //! \brief Enable or disable the method entry and exit events
+    //!
+    //! With ProfileThreads or ProfileThreadsExclude the events are
+    //! enabled for the matching threads only, so other threads do
+    //! not post method events at all. Threads started later are
+    //! checked in onThreadStart with the name given at start.
+    //! \param aJvmti  The Java tool interface
+    //! \param aEnable \c TRUE to enable the events
+    // -----------------------------------------------------------------
+    void setMethodEvents(
+            jvmtiEnv   *aJvmti,
+            bool        aEnable) {
+
+        jvmtiError       aResult;
+        jint             aNrThreads = 0;
+        jthread         *jThreads   = NULL;
+        TMonitorThread  *aThread;
+
+        if (aEnable && !mProperties->hasThreadRules()) {
+            aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_METHOD_EXIT,  NULL);
+            aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_METHOD_ENTRY, NULL);
+            return;
+        }
+        aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_METHOD_ENTRY, NULL);
+        aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_METHOD_EXIT,  NULL);
+
+        if (!aEnable && !mThreadEvents) {
+            return;
+        }
+        mThreadEvents = aEnable;
+
+        aResult = aJvmti->GetAllThreads(&aNrThreads, &jThreads);
+        if (aResult != JVMTI_ERROR_NONE) {
+            return;
+        }
+        for (jint i = 0; i < aNrThreads; i++) {
+            aThread = NULL;
+            aResult = aJvmti->GetThreadLocalStorage(jThreads[i], (void**)&aThread);
+            setMethodEvents(aJvmti, jThreads[i], aThread, aEnable);
+        }
+        aJvmti->Deallocate((unsigned char *)jThreads);
+    }
+    // -----------------------------------------------------------------
+    // TMonitor::setMethodEvents
+    //! \brief Enable or disable the method events of a thread
+    //! \param aJvmti  The Java tool interface
+    //! \param jThread The thread
+    //! \param aThread The thread object or \c NULL if not registered,
+    //!        the name of an unregistered thread is read from the VM
+    //! \param aEnable \c TRUE to enable the events if the thread
+    //!        matches the thread rules
+    // -----------------------------------------------------------------
+    void setMethodEvents(
+            jvmtiEnv        *aJvmti,
+            jthread          jThread,
+            TMonitorThread  *aThread,
+            bool             aEnable) {
+
+        jvmtiEventMode  aMode = JVMTI_DISABLE;
+        jvmtiError      aResult;
+        jvmtiThreadInfo jInfo;
+        TString         aName;
+
+        if (aEnable && aThread != NULL) {
+            aName = aThread->getName(jThread);
+        }
+        else if (aEnable) {
+            aResult = aJvmti->GetThreadInfo(jThread, &jInfo);
+            if (aResult == JVMTI_ERROR_NONE) {
+                aName.assignR(jInfo.name, STRLEN_A7(jInfo.name));
+                /*SAPUNICODEOK_CHARTYPE*/
+                aJvmti->Deallocate((unsigned char *)jInfo.name);
+            }
+            else {
+                aEnable = false;
+            }
+        }
+        if (aEnable && mProperties->doMonitorThread(aName.str())) {
+            aMode = JVMTI_ENABLE;
+        }
+        aResult = aJvmti->SetEventNotificationMode(aMode, JVMTI_EVENT_METHOD_ENTRY, jThread);
+        aResult = aJvmti->SetEventNotificationMode(aMode, JVMTI_EVENT_METHOD_EXIT,  jThread);
     }
     // -----------------------------------------------------------------
     // TMonitor::onExceptionCatch
@@ -2403,6 +2838,138 @@ public:
         }
     }
     // ----------------------------------------------------
+    // TMonitor::reload
+    //! \brief Reload the configuration without reset
+    //!
+    //! Only classes and methods matching a rule added or removed by
+    //! the reload are evaluated again. The statistic is kept.
+    //! \param aJvmti       The Java tool interface
+    //! \param aRootTag     The output tag list
+    // ----------------------------------------------------
+    void reload(
+            jvmtiEnv        *aJvmti,
+            TXmlTag         *aRootTag) {
+
+        SAP_UC       aBuffer[32];
+        TValues      aClassChanges(256);
+        TValues      aMethodChanges(256);
+        TPrefixTrie  aClassRules;
+        TPrefixTrie  aMethodRules;
+        TXmlTag     *aTag;
+        jint         aNrClasses = 0;
+        jint         aNrMethods = 0;
+        bool         aTimer     = mProperties->doExecutionTimer(TIMER_METHOD);
+
+        if (!mProperties->reload(&aClassChanges, &aMethodChanges)) {
+            aTag = aRootTag->addTag(cU("Trace"));
+            aTag->addAttribute(cU("Type"),  cU("Message"));
+            aTag->addAttribute(cU("Info"),  cU("Configuration file not found"));
+            return;
+        }
+        aClassRules.compile(&aClassChanges);
+        aMethodRules.compile(&aMethodChanges);
+        aTimer = (aTimer != mProperties->doExecutionTimer(TIMER_METHOD));
+
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        mClassCache->setRules(mProperties->getRulesHash());
+        mTraceEvent = aRootTag;
+
+        aNrClasses += reload(&mClasses,        &aClassRules);
+        aNrClasses += reload(&mContextClasses, &aClassRules);
+        aNrMethods += reload(&mMethods,        &aClassRules, &aMethodRules, aTimer, !aMethodChanges.empty());
+        aNrMethods += reload(&mContextMethods, &aClassRules, &aMethodRules, aTimer, !aMethodChanges.empty());
+
+        mTraceEvent = NULL;
+        aLockAccess.exit();
+
+        // the thread rules may have changed
+        if (getState() && mProperties->getProfilerMode() == PROFILER_MODE_PROFILE) {
+            setMethodEvents(aJvmti, true);
+        }
+
+        aTag = aRootTag->addTag(cU("Trace"));
+        aTag->addAttribute(cU("Type"),  cU("Message"));
+        aTag->addAttribute(cU("Info"),  cU("Configuration reloaded"));
+        aTag->addAttribute(cU("Rules"),   TString::parseInt(aClassChanges.getSize() + aMethodChanges.getSize(), aBuffer));
+        aTag->addAttribute(cU("Classes"), TString::parseInt(aNrClasses, aBuffer));
+        aTag->addAttribute(cU("Methods"), TString::parseInt(aNrMethods, aBuffer));
+    }
+    // ----------------------------------------------------
+    // TMonitor::reload
+    //! \brief Evaluate the classes matching a changed rule
+    //! \param aClasses     The interal hash table
+    //! \param aClassRules  The changed class rules
+    //! \return The number of evaluated classes
+    // ----------------------------------------------------
+    jint reload(
+            THashClasses        *aClasses,
+            TPrefixTrie         *aClassRules) {
+
+        THashClasses::iterator aPtr;
+        jint                   aNrClasses = 0;
+
+        for (aPtr  = aClasses->begin();
+             aPtr != aClasses->end();
+             aPtr  = aClasses->next()) {
+            if (aClassRules->match(aPtr->aValue->getName())) {
+                resetClass(aPtr->aValue);
+                aNrClasses++;
+            }
+        }
+        return aNrClasses;
+    }
+    // ----------------------------------------------------
+    // TMonitor::reload
+    //! \brief Evaluate the methods matching a changed rule
+    //!
+    //! Method names are resolved only if method rules have changed.
+    //! \param aMethods     The interal hash table
+    //! \param aClassRules  The changed class rules
+    //! \param aMethodRules The changed method rules
+    //! \param aTimer       \c TRUE if the method timer has changed
+    //! \param aByName      \c TRUE if method rules have changed
+    //! \return The number of evaluated methods
+    // ----------------------------------------------------
+    jint reload(
+            THashMethods        *aMethods,
+            TPrefixTrie         *aClassRules,
+            TPrefixTrie         *aMethodRules,
+            bool                 aTimer,
+            bool                 aByName) {
+
+        THashMethods::iterator aPtr;
+        TMonitorMethod        *aMethod;
+        TMonitorClass         *aClass;
+        jint                   aNrMethods = 0;
+        bool                   aChanged;
+
+        for (aPtr  = aMethods->begin();
+             aPtr != aMethods->end();
+             aPtr  = aMethods->next()) {
+
+            aMethod  = aPtr->aValue;
+            aClass   = aMethod->getClass();
+            aChanged = aTimer || aClassRules->match(aClass->getName());
+
+            if (!aChanged && aByName && !aClass->getExcluded()) {
+                TString aName(aClass->getName(), aMethod->getName());
+                if (aMethodRules->match(aName.str())) {
+                    aClass->setPlainMethods(false);
+                    aChanged = true;
+                }
+            }
+            if (!aChanged) {
+                continue;
+            }
+            if (aMethod == mTriggerMethod) {
+                mTriggerMethod = NULL;
+            }
+            resetMethod(aMethod);
+            aNrMethods++;
+        }
+        return aNrMethods;
+    }
+    // ----------------------------------------------------
     // TMonitor::resetMonitorFields
     //! \param aJvmti       The Java tool interface
     //! \param aAllowStart \c TRUE if restart is required
@@ -2414,6 +2981,16 @@ public:
         
         mNrCallsFkt    = 0;
         mTriggerMethod = NULL;
+
+        // cached class decisions are valid for the same rules only
+        mRawMonitorAccess->enter();
+        mClassCache->setRules(mProperties->getRulesHash());
+        mRawMonitorAccess->exit();
+
+        // discard the method counters with the next fold
+        mRawMonitorCounter->enter(false);
+        TMonitorMethod::swapEpoch(true);
+        mRawMonitorCounter->exit();
         
         resetThreads(aJvmti);
         reset(aJvmti, &mClasses, aAllowStart);
@@ -2435,6 +3012,33 @@ public:
         }
     }
     // ----------------------------------------------------
+    // TMonitor::freezeCounters
+    //! \brief Freeze the method counters for a consistent dump
+    //!
+    //! The counter lock is held only to swap the epoch. Application
+    //! threads continue recording into the other bank, while the
+    //! previous bank is folded into the totals read by the dumps.
+    // ----------------------------------------------------
+    void freezeCounters() {
+        THashMethods::iterator aPtr;
+
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        mRawMonitorCounter->enter(false);
+        TMonitorMethod::swapEpoch(false);
+        mRawMonitorCounter->exit();
+
+        for (aPtr  = mMethods.begin();
+             aPtr != mMethods.end();
+             aPtr  = mMethods.next()) {
+            aPtr->aValue->freeze();
+        }
+        for (aPtr  = mContextMethods.begin();
+             aPtr != mContextMethods.end();
+             aPtr  = mContextMethods.next()) {
+            aPtr->aValue->freeze();
+        }
+    }
+    // ----------------------------------------------------
     // TMonitor::resetClasses
     //! \brief Reset interal structures
     //! \param aJvmti       The Java tool interface
@@ -2465,63 +3069,109 @@ public:
     // ----------------------------------------------------
     // TMonitor::reset
     //! \brief Reset interal structures
+    //!
+    //! The decisions are taken from the class cache if the class
+    //! was evaluated with the same rules before.
     //! \param aClass The interal structure for reset
+    //! \return The class cache flags of the class
     // ----------------------------------------------------
-    void resetClass(
+    jint resetClass(
             TMonitorClass   *aClass) {
 
-        bool  aVisible;
+        bool  aVisible   = true;
         bool  isProfiled = false;
         bool  isExcluded = false;
+        jint  aFlags;
+        jint  aGeneration;
 
-        isExcluded = !mProperties->doMonitorScope(aClass->getName());
+        aGeneration = mClassCache->getGeneration();
+        aFlags      = mClassCache->get(aClass->getName());
 
-        if (!isExcluded) {
-            isExcluded = mProperties->dontMonitorPackage(aClass->getName());
+        if (aFlags != 0) {
+            isExcluded = (aFlags & CLASS_CACHE_EXCLUDED) != 0;
+            isProfiled = (aFlags & CLASS_CACHE_PROFILED) != 0;
+            aVisible   = (aFlags & CLASS_CACHE_VISIBLE)  != 0;
+        }
+        else {
+            isExcluded = !mProperties->doMonitorScope(aClass->getName());
+
+            if (!isExcluded) {
+                isExcluded = mProperties->dontMonitorPackage(aClass->getName());
+            }
+
+            if (!isExcluded) {
+                isProfiled = mProperties->doMonitorPackage(aClass->getName());
+                aVisible   = mProperties->doMonitorVisible(aClass->getName());
+            }
+            aFlags = CLASS_CACHE_VALID;
+            aFlags = isExcluded ? (aFlags | CLASS_CACHE_EXCLUDED) : aFlags;
+            aFlags = isProfiled ? (aFlags | CLASS_CACHE_PROFILED) : aFlags;
+            aFlags = aVisible   ? (aFlags | CLASS_CACHE_VISIBLE)  : aFlags;
+            mClassCache->put(aClass->getName(), aFlags, aGeneration);
         }
 
         if (!isExcluded) {
-            isProfiled = mProperties->doMonitorPackage(aClass->getName());
-            aVisible   = mProperties->doMonitorVisible(aClass->getName());
             aClass->setVisibility(aVisible);
         }
         aClass->exclude(isExcluded);
+        aClass->setPlainMethods((aFlags & CLASS_CACHE_PLAIN) != 0);
         aClass->enable(isProfiled, true);
+        return aFlags;
     }
     // ----------------------------------------------------
     // TMonitor::reset
     //! \brief Reset interal structures
-    //! \param aMethod The interal structure for reset
+    //!
+    //! Methods of a class without matching method rules skip the
+    //! rules and keep their names unresolved.
+    //! \param aMethod      The interal structure for reset
+    //! \param aBreakpoints \c FALSE to defer the breakpoints of the trigger mode
+    //! \return \c TRUE if a method rule matches the method
     // ----------------------------------------------------
-    void resetMethod(
-            TMonitorMethod *aMethod) {
+    bool resetMethod(
+            TMonitorMethod *aMethod,
+            bool            aBreakpoints = true) {
 
         bool  isTimer    = false;
         bool  aActivate  = false;
+        bool  aMatch     = false;
         SAP_UC *aEntry;
 
         if (aMethod->getClass()->getExcluded()) {
             aMethod->setContextDebug(NULL);
             aMethod->setContextMonitor(NULL);
             aMethod->setTimer(false);
-            aMethod->enable(false);
-            return;
+            aMethod->enable(false, aBreakpoints);
+            return false;
         }
         aActivate = aMethod->getClass()->getMethodStatus();
 
-        isTimer   = (mProperties->doExecutionTimer(TIMER_METHOD) ||
-                     mProperties->doMonitorTimer(aMethod->getClass()->getName(), aMethod->getName()));
+        if (aMethod->getClass()->hasPlainMethods()) {
+            aMethod->setTimer(mProperties->doExecutionTimer(TIMER_METHOD));
+            aMethod->setContextDebug(NULL);
+            aMethod->setContextMonitor(NULL);
+            aMethod->enable(aActivate, aBreakpoints);
+            if (aActivate) {
+                aMethod->getClass()->enable(true, false);
+            }
+            return false;
+        }
+
+        aMatch    = mProperties->doMonitorTimer(aMethod->getClass()->getName(), aMethod->getName());
+        isTimer   = mProperties->doExecutionTimer(TIMER_METHOD) || aMatch;
         aMethod->setTimer(isTimer);
 
         aEntry    = mProperties->getMonitorDebugEntry(aMethod->getClass()->getName(), aMethod->getName());
         aMethod->setContextDebug(aEntry);
         
         aActivate = aActivate || (aEntry != NULL);
+        aMatch    = aMatch    || (aEntry != NULL);
 
         aEntry = mProperties->getMonitorMethodEntry(aMethod->getClass()->getName(), aMethod->getName());
         aMethod->setContextMonitor(aEntry);
         
         aActivate = aActivate || (aEntry != NULL);
+        aMatch    = aMatch    || (aEntry != NULL);
 
         if (mProperties->doTrigger(aMethod->getClass()->getName(), aMethod->getName(), aMethod->getSignature()->str())) {
             if (mTraceEvent != NULL) {
@@ -2534,12 +3184,14 @@ public:
             }
             mTriggerMethod = aMethod;
             aActivate      = true;
+            aMatch         = true;
         }
         
-        aMethod->enable(aActivate);
+        aMethod->enable(aActivate, aBreakpoints);
         if (aActivate) {
             aMethod->getClass()->enable(true, false);
         }
+        return aMatch;
     }
     // ----------------------------------------------------
     // TMonitor::resetMethods
@@ -2562,7 +3214,7 @@ public:
              aPtrHashMethods  = aMethods->next()) {
 
             aMethod   = aPtrHashMethods->aValue;
-            aMethod->reset();
+            aMethod->freeze();
 
             if (!aAllowStart) {
                 continue;
@@ -2652,8 +3304,7 @@ public:
         }
 
         if (mProperties->getProfilerMode() == PROFILER_MODE_PROFILE) {
-            aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_METHOD_EXIT,       NULL);
-            aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_METHOD_ENTRY,      NULL);
+            setMethodEvents(aJvmti, true);
         }
         aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_EXCEPTION_CATCH,       NULL);
         aResult = aJvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_BREAKPOINT,            NULL);
@@ -2695,8 +3346,7 @@ public:
 
         aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_VM_OBJECT_ALLOC,          NULL);
         aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_BREAKPOINT,               NULL);
-        aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_METHOD_ENTRY,             NULL);
-        aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_METHOD_EXIT,              NULL);
+        setMethodEvents(aJvmti, false);
         aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_EXCEPTION_CATCH,          NULL);
         aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_FIELD_MODIFICATION,       NULL);
         aResult = aJvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_FIELD_ACCESS,             NULL);
@@ -2722,10 +3372,13 @@ public:
     //!         -s<col>     Sort column
     //!         -f<name>    Filter
     //!         -C<#hash>   Context class hash code
+    //!         -K<#hash>   Class hash code, restrict the heap runner
     //!
     //! It is possible to give the hash of a class as context to this 
     //! method. In the case this is not NULL the dump will only trace
     //! objects, which where allocated in the context of this class.
+    //! The option -K passes the class to the heap runner, so that only
+    //! instances of this class are visited.
     // ----------------------------------------------------
     void dumpHeap(
             jvmtiEnv    *aJvmti,
@@ -2742,11 +3395,20 @@ public:
         jint              aCnt      = 0;
         jlong             aHeapSize = 1;
         jlong             aHeapCnt  = 0;
+        jlong             aKlass    = 0;
         jint              aColumnHeapCnt;
         jint              aColumnHeapSize;
+        jint              aColumnOrder;
+        jint              aIndex;
+        jint              i;
         bool              aNewHeapDump = true;
         bool              aClear       = false;
         SAP_UC            aBuffer[32];
+        jclass            jKlass    = NULL;
+        JNIEnv           *aJni      = NULL;
+        THeapHistogram    aHistogram;
+        jvmtiHeapCallbacks aCallbacks;
+        TTopList<TMonitorClass *> aTopList(mProperties->getLimit(LIMIT_IO));
 
         aColumnFilter   = cU(".");
         aColumnSort     = cU("HeapSize");
@@ -2779,12 +3441,78 @@ public:
                 else if (!STRNCMP(*aPtrOptions, cU("-C"), 2)) {
                     aContext = TString::toInteger(*aPtrOptions + 2);
                 }
+                else if (!STRNCMP(*aPtrOptions, cU("-K"), 2)) {
+                    aKlass   = TString::toInteger(*aPtrOptions + 2);
+                }
             }
         }
+        aColumnOrder = TMonitorClass::getSortCol(aColumnSort.str());
 
-        if (aNewHeapDump) {
+        if (aNewHeapDump && getState() == MONITOR_ACTIVE) {
+            aHistogram.mContext = NULL;
+            aHistogram.mTID     = getTransaction();
+            aHistogram.mNrSlots = 0;
+            aHistogram.mSlots   = NULL;
+
+            // the agent threads never return to Java, the class references are released here
+            if (aKlass != 0 &&
+                mProperties->getJavaVm()->GetEnv((void **)&aJni, (jint)JNI_VERSION_1_2) == JNI_OK) {
+                jKlass = findClassObject(aJvmti, aJni, aKlass);
+            }
+
+            // Assign a slot to each class
+            TMonitorLock aLockSlots(mRawMonitorAccess);
+            if (aContext != 0) {
+                aPtrClass = mClasses.find(aContext);
+                if (aPtrClass != mClasses.end()) {
+                    aHistogram.mContext = aPtrClass->aValue;
+                }
+            }
+            aHistogram.mSlots = new THeapSlot[(size_t)mClasses.getSize() + 1];
+            for (aPtrClass  = mClasses.begin();
+                 aPtrClass != mClasses.end();
+                 aPtrClass  = mClasses.next()) {
+
+                aClass = aPtrClass->aValue;
+                aClass->setHeapIndex(aHistogram.mNrSlots);
+                aHistogram.mSlots[aHistogram.mNrSlots].mClass = aClass;
+                aHistogram.mSlots[aHistogram.mNrSlots].mCount = 0;
+                aHistogram.mSlots[aHistogram.mNrSlots].mSize  = 0;
+                aHistogram.mNrSlots++;
+            }
+            aLockSlots.exit();
+
+            // Run without lock, the callback only writes to the slots.
+            // An unknown context leaves the histogram empty
+            if (aContext == 0 || aHistogram.mContext != NULL) {
+                memset(&aCallbacks, 0, sizeof(aCallbacks));
+                aCallbacks.heap_iteration_callback = TMonitorHeapCallback;
+                aJvmti->IterateThroughHeap(JVMTI_HEAP_FILTER_UNTAGGED, jKlass, &aCallbacks, (void*)&aHistogram);
+            }
+            if (jKlass != NULL) {
+                aJni->DeleteLocalRef(jKlass);
+            }
+
+            // Merge the slots into living classes
+            aLockSlots.enter();
+            for (aPtrClass  = mClasses.begin();
+                 aPtrClass != mClasses.end();
+                 aPtrClass  = mClasses.next()) {
+
+                aClass = aPtrClass->aValue;
+                aIndex = aClass->getHeapIndex();
+                if (aIndex >= 0 && aIndex < aHistogram.mNrSlots && aHistogram.mSlots[aIndex].mClass == aClass) {
+                    aClass->setHeapCount(aHistogram.mSlots[aIndex].mCount, aHistogram.mSlots[aIndex].mSize);
+                }
+                else {
+                    aClass->resetHeapCount();
+                }
+            }
+            aLockSlots.exit();
+            delete [] aHistogram.mSlots;
+        }
+        else if (aNewHeapDump) {
             clearHeapDump(aJvmti);
-            aJvmti->IterateOverHeap(JVMTI_HEAP_OBJECT_TAGGED, TMonitorHeapCallback, (void*)aContext);
         }
 
         TMonitorLock aLockAccess(mRawMonitorAccess);
@@ -2797,12 +3525,16 @@ public:
                 aClass->compare(aColumnHeapSize, aHeapSize ) >= 0 &&
                 aClass->filterName(aColumnFilter.str())) { 
 
-                if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
-                    aClass->dumpHeap(aRootTag);
-                    // mMemoryLeaks.insert(aPtrClass);
-                }
+                aCnt++;
+                aTopList.insert(aClass->compare(aColumnOrder, 0), aClass);
             }
         }
+
+        // format only the selected classes
+        aTopList.sort();
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aTopList.get(i)->dumpHeap(aRootTag);
+        }
         aLockAccess.exit();
 
         // exception
@@ -2812,7 +3544,10 @@ public:
             aString.concat(TString::parseInt(aCnt, aBuffer));
             aRootTag->addAttribute(cU("Result"), aString.str());
         }
-        aRootTag->qsort(aColumnSort.str());
+        // columns without numeric sort index are sorted as text
+        if (aColumnOrder == 0) {
+            aRootTag->qsort(aColumnSort.str());
+        }
     }
 private:
     // ----------------------------------------------------
@@ -2882,6 +3617,37 @@ public:
         aTag->addAttribute(cU("Name"), cU("NewAllocation"));
         aTag->addAttribute(cU("Value"), TString::parseInt(mNewAllocation, aBuffer), PROPERTY_TYPE_INT);
 
+        if (mProperties->doHistoryAlert()) {
+            aTag = aRootTag->addTag(cU("Monitor"));
+            aTag->addAttribute(cU("Name"), cU("PendingAlerts"));
+            aTag->addAttribute(cU("Value"), TString::parseInt(mNrAlerts, aBuffer), PROPERTY_TYPE_INT);
+
+            aTag = aRootTag->addTag(cU("Monitor"));
+            aTag->addAttribute(cU("Name"), cU("DroppedAlerts"));
+            aTag->addAttribute(cU("Value"), TString::parseInt(mDroppedAlerts, aBuffer), PROPERTY_TYPE_INT);
+        }
+
+        if (mTracer->doTraceBinary()) {
+            mBinary->dump(aRootTag);
+        }
+
+        if (mProperties->getOutputQueue() != OUTPUT_QUEUE_OFF) {
+            TOutputQueue::getInstance()->dump(aRootTag);
+        }
+        TConsole::getInstance()->dump(aRootTag);
+        TMetricsServer::getInstance()->dump(aRootTag);
+        mClassCache->dump(aRootTag);
+
+        if (mSeries != NULL) {
+            aTag = aRootTag->addTag(cU("Monitor"));
+            aTag->addAttribute(cU("Name"), cU("SeriesSamples"));
+            aTag->addAttribute(cU("Value"), TString::parseInt(mSeries->getNrSamples(), aBuffer), PROPERTY_TYPE_INT);
+
+            aTag = aRootTag->addTag(cU("Monitor"));
+            aTag->addAttribute(cU("Name"), cU("SeriesBytes"));
+            aTag->addAttribute(cU("Value"), TString::parseInt(mSeries->getNrBytes(), aBuffer), PROPERTY_TYPE_INT);
+        }
+
         //jthread  *jThreads;
         //mJvmti->GetAllThreads(&mNrThreads, &jThreads);
         //mJvmti->Deallocate((unsigned char *)jThreads);
@@ -2912,6 +3678,452 @@ public:
         }
     }
     // ----------------------------------------------------
+    // TMonitor::registerSeries
+    //! \brief Assign a method to its slot in the time series
+    //!
+    //! Called under the access lock, whenever a method is registered.
+    //! The slots follow the names of the columns, the property
+    //! SeriesMethods may have changed since the series was created.
+    //! \param aMethod The registered method
+    // ----------------------------------------------------
+    void registerSeries(TMonitorMethod *aMethod) {
+        jint aSlot;
+
+        // Do not resolve the method names without series
+        if (mNrSeriesNames == 0) {
+            return;
+        }
+        for (aSlot = 0; aSlot < mNrSeriesNames; aSlot++) {
+            if (!STRCMP(mSeriesNames[aSlot].str(), aMethod->getFullName())) {
+                mSeriesMethods[aSlot] = aMethod;
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::unregisterSeries
+    //! \brief Release the slots of an unloaded class
+    //! \param aClass The unloaded class
+    // ----------------------------------------------------
+    void unregisterSeries(TMonitorClass *aClass) {
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+
+        for (jint i = 0; i < MONITOR_SERIES_METHODS; i++) {
+            if (mSeriesMethods[i] != NULL && 
+                mSeriesMethods[i]->getClass() == aClass) {
+                mSeriesMethods[i] = NULL;
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::createSeries
+    //! \brief Create the time series for the current configuration
+    //!
+    //! The columns are the counters of TMonitor::dumpStatistic followed
+    //! by the CPU time and number of calls of each method in property
+    //! SeriesMethods. Methods registered so far are resolved once here,
+    //! later ones in TMonitor::onClassPrepare.
+    // ----------------------------------------------------
+    void createSeries() {
+        THashMethods::iterator aPtr;
+        TValues::iterator      aPtrName;
+        TValues *aNames = mProperties->getSeriesMethods();
+        TString  aColumn;
+        jint     aSlot  = 0;
+
+        mSeries = new TSeries(mProperties->getSeriesSize() * 1024);
+        mSeries->addColumn(cU("NewFktCalls"));
+        mSeries->addColumn(cU("NewObjects"));
+        mSeries->addColumn(cU("NewAllocation"));
+        mSeries->addColumn(cU("NrThreads"));
+        mSeries->addColumn(cU("NrClasses"));
+        mSeries->addColumn(cU("CpuTime"));
+
+        for (aPtrName  = aNames->begin();
+             aPtrName != aNames->end() && aSlot < MONITOR_SERIES_METHODS;
+             aPtrName  = aNames->next(), aSlot++) {
+            aColumn = *aPtrName;
+            aColumn.concat(cU(".CpuTime"));
+            mSeries->addColumn(aColumn.str());
+
+            aColumn = *aPtrName;
+            aColumn.concat(cU(".NrCalls"));
+            mSeries->addColumn(aColumn.str());
+        }
+
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        memsetR(mSeriesMethods, 0, sizeofR(mSeriesMethods));
+        for (mNrSeriesNames = 0, aPtrName = aNames->begin();
+             mNrSeriesNames < aSlot;
+             mNrSeriesNames++, aPtrName = aNames->next()) {
+            mSeriesNames[mNrSeriesNames] = *aPtrName;
+        }
+
+        if (aSlot > 0) {
+            for (aPtr  = mMethods.begin();
+                 aPtr != mMethods.end();
+                 aPtr  = mMethods.next()) {
+                registerSeries(aPtr->aValue);
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::sampleSeries
+    //! \brief Record the statistic counters into the time series
+    //!
+    //! Called periodically by the scheduler thread. A sample is taken
+    //! if the interval of property SeriesInterval has elapsed.
+    //! \param aJvmti The Java tool interface
+    // ----------------------------------------------------
+    void sampleSeries(jvmtiEnv *aJvmti) {
+        jlong           aValues[SERIES_COLUMNS];
+        jlong           aNow;
+        jint            aCol;
+        TMonitorMethod *aMethod;
+
+        if (mProperties->getSeriesInterval() == 0) {
+            return;
+        }
+        aNow = TSystem::getTimestamp();
+        if (aNow < mSeriesNext) {
+            return;
+        }
+        mSeriesNext = aNow + (jlong)mProperties->getSeriesInterval() * 1000;
+
+        if (mSeries == NULL) {
+            createSeries();
+        }
+        aValues[0] = mNrCallsFkt;
+        aValues[1] = mNewObjects;
+        aValues[2] = mNewAllocation;
+        aValues[3] = TMonitorThread::getNrThreads();
+        aValues[4] = mClasses.getSize();
+        aValues[5] = getCpuTimeMicro(aJvmti);
+        aCol       = 6;
+
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        for (jint i = 0; aCol + 1 < mSeries->getNrColumns(); i++) {
+            aMethod = mSeriesMethods[i];
+            aValues[aCol++] = (aMethod != NULL) ? aMethod->getCpuTime() : 0;
+            aValues[aCol++] = (aMethod != NULL) ? aMethod->getNrCalls() : 0;
+        }
+        mSeries->add(aNow, aValues);
+    }
+    // ----------------------------------------------------
+    // TMonitor::addLabel
+    //! \brief Append a label value with escaped backslash, quote and newline
+    //! \param aText   The metrics text
+    //! \param aValue  The label value
+    // ----------------------------------------------------
+    void addLabel(
+            TString         *aText,
+            const SAP_UC    *aValue) {
+
+        const SAP_UC *aPtr;
+
+        for (aPtr = aValue; *aPtr != cU('\0'); aPtr++) {
+            switch (*aPtr) {
+                case cU('\\'): aText->concat(cU("\\\\")); break;
+                case cU('"'):  aText->concat(cU("\\\"")); break;
+                case cU('\n'): aText->concat(cU("\\n"));  break;
+                default:       aText->concat(*aPtr);     break;
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::addMetric
+    //! \brief Append one sample in the text exposition format
+    //!
+    //! Overloaded methods share the name, the signature label
+    //! keeps their series apart.
+    //! \param aText   The metrics text
+    //! \param aName   The metric name
+    //! \param aMethod The method or \c NULL
+    //! \param aValue  The value
+    // ----------------------------------------------------
+    void addMetric(
+            TString         *aText,
+            const SAP_UC    *aName,
+            TMonitorMethod  *aMethod,
+            jlong            aValue) {
+
+        SAP_UC aBuffer[128];
+
+        aText->concat(aName);
+        if (aMethod != NULL) {
+            aText->concat(cU("{method=\""));
+            addLabel(aText, aMethod->getFullName());
+            aText->concat(cU("\",signature=\""));
+            addLabel(aText, aMethod->getSignature()->str());
+            aText->concat(cU("\"}"));
+        }
+        aText->concat(cU(" "));
+        aText->concat(TString::parseDecimal(aValue, aBuffer));
+        aText->concat(cU("\n"));
+    }
+    // ----------------------------------------------------
+    // TMonitor::addMetricType
+    //! \brief Append the description of a metric
+    //! \param aText   The metrics text
+    //! \param aName   The metric name
+    //! \param aType   The metric type counter or gauge
+    //! \param aHelp   The description
+    // ----------------------------------------------------
+    void addMetricType(
+            TString         *aText,
+            const SAP_UC    *aName,
+            const SAP_UC    *aType,
+            const SAP_UC    *aHelp) {
+
+        aText->concat(cU("# HELP "));
+        aText->concat(aName);
+        aText->concat(cU(" "));
+        aText->concat(aHelp);
+        aText->concat(cU("\n# TYPE "));
+        aText->concat(aName);
+        aText->concat(cU(" "));
+        aText->concat(aType);
+        aText->concat(cU("\n"));
+    }
+    // ----------------------------------------------------
+    // TMonitor::dumpMetrics
+    //! \brief Render the statistic counters as metrics text
+    //!
+    //! Contains the counters of TMonitor::dumpStatistic and the 
+    //! counters of the methods with the highest CPU time.
+    //! \param aJvmti The Java tool interface
+    //! \param aText  The metrics text
+    // ----------------------------------------------------
+    void dumpMetrics(
+            jvmtiEnv        *aJvmti,
+            TString         *aText) {
+
+        THashMethods::iterator      aPtr;
+        TMonitorMethod             *aMethod;
+        TTopList<TMonitorMethod *>  aTopList(METRICS_METHODS);
+        jint                        i;
+
+        addMetricType(aText, cU("sherlok_fkt_calls_total"),        cU("counter"), cU("Method calls since reset"));
+        addMetric    (aText, cU("sherlok_fkt_calls_total"),        NULL, mNrCallsFkt);
+        addMetricType(aText, cU("sherlok_new_objects"),            cU("gauge"),   cU("Objects allocated and not freed since reset"));
+        addMetric    (aText, cU("sherlok_new_objects"),            NULL, mNewObjects);
+        addMetricType(aText, cU("sherlok_new_allocation_bytes"),   cU("gauge"),   cU("Bytes allocated and not freed since reset"));
+        addMetric    (aText, cU("sherlok_new_allocation_bytes"),   NULL, mNewAllocation);
+        addMetricType(aText, cU("sherlok_threads"),                cU("gauge"),   cU("Number of monitored threads"));
+        addMetric    (aText, cU("sherlok_threads"),                NULL, TMonitorThread::getNrThreads());
+        addMetricType(aText, cU("sherlok_classes"),                cU("gauge"),   cU("Number of monitored classes"));
+        addMetric    (aText, cU("sherlok_classes"),                NULL, mClasses.getSize());
+        addMetricType(aText, cU("sherlok_cpu_time_microseconds"),  cU("counter"), cU("CPU time of the monitored threads"));
+        addMetric    (aText, cU("sherlok_cpu_time_microseconds"),  NULL, getCpuTimeMicro(aJvmti));
+
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        for (aPtr  = mMethods.begin();
+             aPtr != mMethods.end();
+             aPtr  = mMethods.next()) {
+            aMethod = aPtr->aValue;
+            if (aMethod->getNrCalls() > 0) {
+                aTopList.insert(aMethod->getCpuTime(), aMethod);
+            }
+        }
+        aTopList.sort();
+
+        addMetricType(aText, cU("sherlok_method_cpu_time_microseconds"), cU("counter"), cU("CPU time of the top methods"));
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aMethod = aTopList.get(i);
+            addMetric(aText, cU("sherlok_method_cpu_time_microseconds"), aMethod, aMethod->getCpuTime());
+        }
+        addMetricType(aText, cU("sherlok_method_calls_total"), cU("counter"), cU("Calls of the top methods"));
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aMethod = aTopList.get(i);
+            addMetric(aText, cU("sherlok_method_calls_total"), aMethod, aMethod->getNrCalls());
+        }
+        addMetricType(aText, cU("sherlok_method_contentions_total"), cU("counter"), cU("Monitor contentions of the top methods"));
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aMethod = aTopList.get(i);
+            addMetric(aText, cU("sherlok_method_contentions_total"), aMethod, aMethod->getNrContention());
+        }
+        addMetricType(aText, cU("sherlok_method_contention_microseconds"), cU("counter"), cU("Monitor contention time of the top methods"));
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aMethod = aTopList.get(i);
+            addMetric(aText, cU("sherlok_method_contention_microseconds"), aMethod, aMethod->getContention());
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::updateMetrics
+    //! \brief Publish a new metrics snapshot if due
+    //!
+    //! Called periodically by the scheduler thread, the metrics
+    //! server only reads the published text.
+    //! \param aJvmti The Java tool interface
+    // ----------------------------------------------------
+    void updateMetrics(jvmtiEnv *aJvmti) {
+        TMetricsServer *aServer = TMetricsServer::getInstance();
+        TString         aText;
+
+        if (!aServer->doUpdate(TSystem::getTimestamp())) {
+            return;
+        }
+        dumpMetrics(aJvmti, &aText);
+        aServer->publish(&aText);
+    }
+    // ----------------------------------------------------
+    // TMonitor::dumpSeriesBucket
+    //! \brief Write one aggregated interval of a column
+    // ----------------------------------------------------
+    void dumpSeriesBucket(
+            TXmlTag         *aRootTag,
+            const SAP_UC    *aColumn,
+            jlong            aTime,
+            jlong            aCount,
+            jlong            aMin,
+            jlong            aMax,
+            jlong            aSum,
+            jlong            aDelta) {
+
+        SAP_UC   aBuffer[128];
+        TXmlTag *aTag = aRootTag->addTag(cU("Series"));
+
+        aTag->addAttribute(cU("Time"),    TString::parseInt(aTime,          aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Column"),  aColumn);
+        aTag->addAttribute(cU("Samples"), TString::parseInt(aCount,         aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Min"),     TString::parseInt(aMin,           aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Max"),     TString::parseInt(aMax,           aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Avg"),     TString::parseInt(aSum / aCount,  aBuffer), PROPERTY_TYPE_INT);
+        aTag->addAttribute(cU("Delta"),   TString::parseInt(aDelta,         aBuffer), PROPERTY_TYPE_INT);
+    }
+    // ----------------------------------------------------
+    // TMonitor::dumpSeries
+    //! \brief Query the time series
+    //!
+    //! Options:
+    //! - \c -c<prefix> Columns starting with prefix
+    //! - \c -f<sec>    Start of range in seconds before now
+    //! - \c -t<sec>    End of range in seconds before now
+    //! - \c -a<sec>    Aggregate intervals of the given length
+    //! - \c -x         Clear the series
+    //! \param aRootTag The output tag list
+    //! \param aOptions The command options
+    // ----------------------------------------------------
+    void dumpSeries(
+            TXmlTag         *aRootTag,
+            TValues         *aOptions) {
+
+        TValues::iterator aPtrOptions;
+        TString           aFilter;
+        jlong             aTimes[SERIES_BLOCK];
+        jlong             aValues[SERIES_BLOCK];
+        jlong             aNow       = TSystem::getTimestamp();
+        jlong             aFrom      = 0;
+        jlong             aTo        = aNow;
+        jlong             aInterval  = 0;
+        jlong             aBucket, aCount, aMin, aMax, aSum, aFirst, aLast;
+        jint              aCnt       = 0;
+        jint              aCol, aInx, aNrValues, i;
+        bool              aClear     = false;
+        SAP_UC            aBuffer[128];
+
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-c"), 2)) {
+                    aFilter = (*aPtrOptions) + 2;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-f"), 2)) {
+                    aFrom = aNow - TString::toInteger(*aPtrOptions + 2) * 1000;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-t"), 2)) {
+                    aTo   = aNow - TString::toInteger(*aPtrOptions + 2) * 1000;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-a"), 2)) {
+                    aInterval = TString::toInteger(*aPtrOptions + 2) * 1000;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-x"), 2)) {
+                    aClear = true;
+                }
+            }
+        }
+
+        if (aClear) {
+            // the next sample creates the series with the current configuration
+            if (mSeries != NULL) {
+                delete mSeries;
+                mSeries = NULL;
+            }
+            aRootTag->addAttribute(cU("Result"), cU("Time series cleared"));
+            return;
+        }
+
+        if (mSeries == NULL) {
+            aRootTag->addAttribute(cU("Result"), cU("No time series, see property SeriesInterval"));
+            return;
+        }
+
+        for (aCol = 1; aCol < mSeries->getNrColumns(); aCol++) {
+            if (STRNCMP(mSeries->getName(aCol), aFilter.str(), aFilter.pcount())) {
+                continue;
+            }
+            aCount = 0;
+
+            for (aInx = 0; aInx < mSeries->getNrBlocks(); aInx++) {
+                if (mSeries->getLast(aInx) < aFrom) {
+                    continue;
+                }
+                aNrValues = mSeries->decode(aInx, 0,    aTimes);
+                aNrValues = mSeries->decode(aInx, aCol, aValues);
+
+                for (i = 0; i < aNrValues; i++) {
+                    if (aTimes[i] < aFrom || aTimes[i] > aTo) {
+                        continue;
+                    }
+
+                    if (aInterval <= 0) {
+                        if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
+                            TXmlTag *aTag = aRootTag->addTag(cU("Series"));
+                            aTag->addAttribute(cU("Time"),   TString::parseInt(aTimes[i],  aBuffer), PROPERTY_TYPE_INT);
+                            aTag->addAttribute(cU("Column"), mSeries->getName(aCol));
+                            aTag->addAttribute(cU("Value"),  TString::parseInt(aValues[i], aBuffer), PROPERTY_TYPE_INT);
+                        }
+                        continue;
+                    }
+
+                    if (aCount > 0 && aTimes[i] - aTimes[i] % aInterval != aBucket) {
+                        if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
+                            dumpSeriesBucket(aRootTag, mSeries->getName(aCol), aBucket, aCount, aMin, aMax, aSum, aLast - aFirst);
+                        }
+                        aCount = 0;
+                    }
+
+                    if (aCount == 0) {
+                        aBucket = aTimes[i] - aTimes[i] % aInterval;
+                        aMin    = aValues[i];
+                        aMax    = aValues[i];
+                        aSum    = 0;
+                        aFirst  = aValues[i];
+                    }
+                    aMin    = min(aMin, aValues[i]);
+                    aMax    = max(aMax, aValues[i]);
+                    aSum   += aValues[i];
+                    aLast   = aValues[i];
+                    aCount++;
+                }
+            }
+
+            if (aCount > 0) {
+                if (aCnt++ < mProperties->getLimit(LIMIT_IO)) {
+                    dumpSeriesBucket(aRootTag, mSeries->getName(aCol), aBucket, aCount, aMin, aMax, aSum, aLast - aFirst);
+                }
+            }
+        }
+        // exception
+        if (aCnt > mProperties->getLimit(LIMIT_IO)) {
+            TString aString;
+            aString.concat(cU("Exceed Maximum Number of Entries "));
+            aString.concat(TString::parseInt(aCnt, aBuffer));
+            aRootTag->addAttribute(cU("Result"), aString.str());
+        }
+    }
+    // ----------------------------------------------------
     // TMonitor: dumpClasses
     //! \brief Dump interal structrue
     //!
@@ -3011,6 +4223,42 @@ public:
         aRootTag->qsort(aColumnSort.str());
     }
     // ----------------------------------------------------
+    // TMonitor::registerFields
+    //! \brief Register the fields of a class on demand
+    //! \param aJvmti The Java tool interface
+    //! \param aClass The class
+    // ----------------------------------------------------
+    void registerFields(
+            jvmtiEnv        *aJvmti,
+            TMonitorClass   *aClass) {
+
+        jlong       aTag = aClass->getID();
+        jint        aCount = 0;
+        jobject    *jObjects = NULL;
+        JNIEnv     *aJni = NULL;
+        jvmtiError  aResult;
+        jint        i;
+
+        if (aClass->hasFields()) {
+            return;
+        }
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        aResult = aJvmti->GetObjectsWithTags(1, &aTag, &aCount, &jObjects, NULL);
+        if (aResult == JVMTI_ERROR_NONE && aCount > 0) {
+            aClass->registerFields(aJvmti, NULL, (jclass)jObjects[0]);
+        }
+        // the objects are local references of the current thread
+        if (aResult == JVMTI_ERROR_NONE && aCount > 0 &&
+            mProperties->getJavaVm()->GetEnv((void **)&aJni, (jint)JNI_VERSION_1_2) == JNI_OK) {
+            for (i = 0; i < aCount; i++) {
+                aJni->DeleteLocalRef(jObjects[i]);
+            }
+        }
+        if (jObjects != NULL) {
+            /*SAPUNICODEOK_CHARTYPE*/ aJvmti->Deallocate((unsigned char*)jObjects);
+        }
+    }
+    // ----------------------------------------------------
     // TMonitor: dumpClassDetails
     //! \brief Dump interal structrue
     //! \see TMonitor::dumpClasses
@@ -3050,8 +4298,14 @@ public:
 
         switch (aDetail) {
             case 1: aClass->dumpHistory(aRootTag);      break;
-            case 2: aClass->dumpFields(aRootTag);       break;
-            case 3: aClass->dumpMethods(aRootTag);      break;
+            case 2: 
+                registerFields(aJvmti, aClass);
+                aClass->dumpFields(aRootTag);
+                break;
+            case 3: 
+                freezeCounters();
+                aClass->dumpMethods(aRootTag);
+                break;
         }
     }
     // ----------------------------------------------------
@@ -3113,14 +4367,23 @@ private:
         TString           aColumnFilter;
         SAP_UC            aBuffer[128];
         jint              aCnt          = 0;
+        jint              i;
         jlong             aMin          = 1;
         int               aColumnCurrSize = 0;
+        int               aColumnOrder;
         bool              aDumpHistory  = false;
         bool              aStatus       = false;
         bool              aDumpHash     = false;
         bool              aDumpMethods  = false;
     bool              aDumpHeap     = false;
     bool              aSetType      = true;
+        bool              aDumpDelta    = false;
+        bool              aBaseline     = false;
+        jint              aSession      = TConsole::getInstance()->getSession();
+        jint              aSlot         = TConsole::getInstance()->getSessionSlot();
+        TSnapshot        *aDelta        = NULL;
+        jlong             aTimestamp    = TSystem::getTimestamp();
+        TTopList<TMonitorClass *> aTopList(mProperties->getLimit(LIMIT_IO));
 
         aColumnFilter   = cU(".");
         aColumnSort     = cU("CurrSize");
@@ -3145,6 +4408,9 @@ private:
                 else if (!STRNCMP(*aPtrOptions, cU("-M"), 2)) {
                     aDumpMethods = true;
                 }
+                else if (!STRNCMP(*aPtrOptions, cU("-d"), 2)) {
+                    aDumpDelta = true;
+                }
                 else if (!STRNCMP(*aPtrOptions, cU("-s"), 2)) {
                     aColumnSort = (*aPtrOptions) + 2;
                 }
@@ -3163,19 +4429,21 @@ private:
             }
         }
         
-    aTagClass = NULL;
+    aTagClass    = NULL;
+    aColumnOrder = TMonitorClass::getSortCol(aColumnSort.str());
         
     if (aClassOption == NULL) {
         aSetType = false;
         }
 
     TMonitorLock aLockAccess(mRawMonitorAccess);
+        if (aDumpMethods) {
+            freezeCounters();
+        }
         for (aPtr  = aHashTable->begin();
              aPtr != aHashTable->end();
              aPtr  = aHashTable->next()) {
 
-
-            aTagClass = NULL;
             aClass    = aPtr->aValue;
 
             if (aClassOption != NULL) {
@@ -3187,55 +4455,74 @@ private:
             if ((aClass->getStatus() || aStatus) &&
                  aClass->compare(aColumnCurrSize, aMin) >= 0 &&
                  aClass->filterName(aColumnFilter.str())) { 
-               
-                if (aCnt++ < mProperties->getLimit(LIMIT_IO)) { 
-                    if (aDumpHistory) {
-                        if (aTagClass == NULL) {
-                            aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
-                            aClass->dump(aTagClass, aRef, aDumpHash);
-                        }
 
-                        TXmlTag *aTagHisty = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
-                        if (aSetType) {
-                            aTagHisty->addAttribute(cU("Type"), cU("History"));
-                        }
-                        else {
-                            aTagHisty->addAttribute(cU("Detail"), cU("History"));
-                        }
-                        aTagHisty->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
-                        aClass->dumpHistory(aTagHisty);
+                if (aDumpDelta) {
+                    // skip classes without change since the previous snapshot
+                    aBaseline = aBaseline || !aClass->getSnapshots()->get(aSlot)->isValid(aSession);
+                    if (!aClass->getSnapshots()->update(aSlot, aSession, aTimestamp, aClass)) {
+                        continue;
                     }
-                    if (aDumpMethods) {
-                        if (aTagClass == NULL) {
-                            aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
-                            aClass->dump(aTagClass, aRef, aDumpHash);
-                        }
+                    aCnt++;
+                    aTopList.insert(aClass->getSnapshots()->get(aSlot)->getDelta(aColumnOrder), aClass);
+                    continue;
+                }
+                aCnt++;
+                aTopList.insert(aClass->compare(aColumnOrder, 0), aClass);
+            }
+        }
 
-                        TXmlTag *aRootMeth = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
-                        aRootMeth->addAttribute(cU("Detail"), cU("Methods"));
-                        aRootMeth->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
-                        aClass->dumpMethods(aRootMeth);
-                    }
+        // format only the selected classes
+        aTopList.sort();
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aTagClass = NULL;
+            aClass    = aTopList.get(i);
+            aDelta    = aDumpDelta ? aClass->getSnapshots()->get(aSlot) : NULL;
 
-                    if (aDumpHeap) {
-                        if (aTagClass == 0) {
-                            aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
-                            aClass->dump(aTagClass, aRef, aDumpHash);
-                        }
-                        TXmlTag *aRootMeth = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
-                        aRootMeth->addAttribute(cU("Detail"), cU("Heap"));
-                        aRootMeth->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
-                        dumpHeap(aJvmti, aRootMeth, aClass->getID(), aOptions);
-                        // aClass->dumpHeap(aRootMeth);
-                    }
+            if (aDumpHistory) {
+                if (aTagClass == NULL) {
+                    aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
+                    aClass->dump(aTagClass, aRef, aDumpHash, aDelta);
+                }
 
-                    if (aTagClass == NULL) {
-                        aTagClass = aRootTag->addTag(cU("Class"));
-                        aClass->dump(aTagClass, aRef, aDumpHash);
-                    }
-                }                
+                TXmlTag *aTagHisty = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
+                if (aSetType) {
+                    aTagHisty->addAttribute(cU("Type"), cU("History"));
+                }
+                else {
+                    aTagHisty->addAttribute(cU("Detail"), cU("History"));
+                }
+                aTagHisty->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
+                aClass->dumpHistory(aTagHisty);
             }
-        }    
+            if (aDumpMethods) {
+                if (aTagClass == NULL) {
+                    aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
+                    aClass->dump(aTagClass, aRef, aDumpHash, aDelta);
+                }
+
+                TXmlTag *aRootMeth = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootMeth->addAttribute(cU("Detail"), cU("Methods"));
+                aRootMeth->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
+                aClass->dumpMethods(aRootMeth);
+            }
+
+            if (aDumpHeap) {
+                if (aTagClass == 0) {
+                    aTagClass = aRootTag->addTag(cU("Class"), XMLTAG_TYPE_NODE);
+                    aClass->dump(aTagClass, aRef, aDumpHash, aDelta);
+                }
+                TXmlTag *aRootMeth = aTagClass->addTag(cU("List"), XMLTAG_TYPE_NODE);
+                aRootMeth->addAttribute(cU("Detail"), cU("Heap"));
+                aRootMeth->addAttribute(cU("ID"),     TString::parseHex(aClass->getID(), aBuffer));
+                dumpHeap(aJvmti, aRootMeth, aClass->getID(), aOptions);
+                // aClass->dumpHeap(aRootMeth);
+            }
+
+            if (aTagClass == NULL) {
+                aTagClass = aRootTag->addTag(cU("Class"));
+                aClass->dump(aTagClass, aRef, aDumpHash, aDelta);
+            }
+        }
         aLockAccess.exit();
 
         // exception
@@ -3246,11 +4533,17 @@ private:
             aRootTag->addAttribute(cU("Result"), aString.str());
         }
 
+        if (aCnt == 0 && aBaseline) {
+            aRootTag->addAttribute(cU("Result"), cU("Snapshot created"));
+        }
+
         if (aCnt > 0 && aClassOption == NULL) {
             aRootTag->addAttribute(cU("Type"), aType);
         }
-        // sort the columns as specified
-        aRootTag->qsort(aColumnSort.str());
+        // columns without numeric sort index are sorted as text
+        if (aColumnOrder == 0) {
+            aRootTag->qsort(aColumnSort.str());
+        }
     }
 public:
     // ----------------------------------------------------
@@ -3280,6 +4573,8 @@ public:
         TMonitorMethod *aMethod;
         TString         aColumnFilter;
         jint            aCnt            = 0;
+        jint            i;
+        int             aColumnOrder;
         int             aColumnCpu;
         int             aColumnNrCall;
         int             aColumnElapsed;
@@ -3291,11 +4586,17 @@ public:
         bool            aOutputHash     = false;
         bool            aFound          = false;
         bool            aOutputAll      = false;
+        bool            aOutputDelta    = false;
+        bool            aBaseline       = false;
+        jint            aSession        = TConsole::getInstance()->getSession();
+        jint            aSlot           = TConsole::getInstance()->getSessionSlot();
+        jlong           aTimestamp      = TSystem::getTimestamp();
         jlong           aMinCpu         = 0;
         jlong           aMinCall        = 0;
         jlong           aMinElapsed     = 0;
         const SAP_UC   *aColumnSort     = cU("CpuTime");
         SAP_UC          aBuffer[128];
+        TTopList<TMonitorMethod *> aTopList(mProperties->getLimit(LIMIT_IO));
 
         // restrict output to sort creteria
         aColumnCpu     = TMonitorMethod::getSortCol(cU("CpuTime"));
@@ -3342,6 +4643,9 @@ public:
                 else if (!STRNCMP(*aPtrOptions, cU("-p"), 2)) {
                     aOutputParam = true;
                 }                
+                else if (!STRNCMP(*aPtrOptions, cU("-d"), 2)) {
+                    aOutputDelta = true;
+                }                
                 else if (!STRNCMP(*aPtrOptions, cU("-C"), 2)) {
                     aRootTag->addAttribute(cU("Detail"), cU("Class"));
                     aClassID     = TString::toInteger(*aPtrOptions + 2);
@@ -3351,8 +4655,11 @@ public:
                 }                
             }
         }
+        aColumnOrder = TMonitorMethod::getSortCol(aColumnSort);
     
         TMonitorLock aLockAccess(mRawMonitorAccess);
+        freezeCounters();
+
         if (aHashMethods == NULL) {
             aHashMethods = &mMethods;
         }
@@ -3423,14 +4730,30 @@ public:
                 if (aOutputCont && aMethod->compare(aColumnContent, aMinContent) < 0) {
                    continue;
                 }
-                if (aCnt++ > mProperties->getLimit(LIMIT_IO)) {
+                if (aOutputDelta) {
+                    // skip methods without change since the previous snapshot
+                    aBaseline = aBaseline || !aMethod->getSnapshots()->get(aSlot)->isValid(aSession);
+                    if (!aMethod->getSnapshots()->update(aSlot, aSession, aTimestamp, aMethod)) {
+                        continue;
+                    }
+                    aCnt++;
+                    aTopList.insert(aMethod->getSnapshots()->get(aSlot)->getDelta(aColumnOrder), aMethod);
                     continue;
                 }
-                aMethod->dump(aRootTag, aOutputSign, aOutputCont, aOutputHash);
-                if (aOutputParam) {
-                    aRootTag->addAttribute(cU("Detail"), cU("Parameter"));
-                    aMethod->dumpLocalVariables(aRootTag);
-                }
+                aCnt++;
+                aTopList.insert(aMethod->compare(aColumnOrder, 0), aMethod);
+            }
+        }
+
+        // format only the selected methods
+        aTopList.sort();
+        for (i = 0; i < aTopList.getSize(); i++) {
+            aMethod = aTopList.get(i);
+            aMethod->dump(aRootTag, aOutputSign, aOutputCont, aOutputHash,
+                    aOutputDelta ? aMethod->getSnapshots()->get(aSlot) : NULL);
+            if (aOutputParam) {
+                aRootTag->addAttribute(cU("Detail"), cU("Parameter"));
+                aMethod->dumpLocalVariables(aRootTag);
             }
         }
         aLockAccess.exit();
@@ -3443,10 +4766,100 @@ public:
             aRootTag->addAttribute(cU("Result"), aString.str());
         }
         
+        if (aCnt == 0 && aBaseline) {
+            aRootTag->addAttribute(cU("Result"), cU("Snapshot created"));
+        }
+
         if (aCnt > 0) {
             aRootTag->addAttribute(cU("Type"), cU("Method"));
         }
-        aRootTag->qsort(aColumnSort);
+        // columns without numeric sort index are sorted as text
+        if (aColumnOrder == 0) {
+            aRootTag->qsort(aColumnSort);
+        }
+    }
+    // ----------------------------------------------------
+    // TMonitor::dumpFoldedStacks
+    //! \brief Write the stacks aggregated by "trace add folded"
+    //! \param aRootTag     The output tag list
+    //! \param aOptions     The command options
+    //!         -o<file>    Output file (default sherlok.folded)
+    //!         -w<weight>  count, elapsed, cpu or memory
+    //!         -r          Remove the stacks after writing
+    // ----------------------------------------------------
+    void dumpFoldedStacks(
+            TXmlTag         *aRootTag, 
+            TValues         *aOptions) {
+
+        TValues::iterator aPtrOptions;
+        TMappedFile       aFile;
+        TXmlTag          *aTag;
+        TString           aFileName;
+        TString           aPath;
+        SAP_UC            aBuffer[128];
+        const SAP_UC     *aWeightName = cU("elapsed");
+        int               aWeight     = FOLDED_WEIGHT_ELAPSED;
+        bool              aReset      = false;
+        jlong             aNrLines;
+
+        aFileName = cU("sherlok.folded");
+        if (aOptions != NULL) {
+            for (aPtrOptions  = aOptions->begin();
+                 aPtrOptions != aOptions->end();
+                 aPtrOptions  = aOptions->next()) {
+
+                if (!STRNCMP(*aPtrOptions, cU("-o"), 2) && STRLEN(*aPtrOptions) > 2) {
+                    aFileName = (*aPtrOptions) + 2;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-r"), 2)) {
+                    aReset = true;
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-wcount"), 7)) {
+                    aWeight     = FOLDED_WEIGHT_COUNT;
+                    aWeightName = cU("count");
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-wcpu"), 5)) {
+                    aWeight     = FOLDED_WEIGHT_CPU;
+                    aWeightName = cU("cpu");
+                }
+                else if (!STRNCMP(*aPtrOptions, cU("-wmemory"), 8)) {
+                    aWeight     = FOLDED_WEIGHT_MEMORY;
+                    aWeightName = cU("memory");
+                }
+            }
+        }
+        aPath.concat(mProperties->getPath());
+        aPath.concat(FILESEPARATOR);
+        aPath.concat(aFileName.str());
+
+        if (!aFile.open(aPath.str())) {
+            aRootTag->addAttribute(cU("Result"), cU("Cannot open folded stack file"));
+            return;
+        }
+        TMonitorLock aLockAccess(mRawMonitorAccess);
+        aNrLines = mFoldedStacks.write(&aFile, aWeight);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("Events"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mFoldedStacks.getNrEvents(), aBuffer), PROPERTY_TYPE_INT);
+
+        if (aReset) {
+            mFoldedStacks.reset();
+        }
+        aLockAccess.exit();
+        aFile.close();
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("Stacks"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrLines, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("Weight"));
+        aTag->addAttribute(cU("Value"), aWeightName);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("File"));
+        aTag->addAttribute(cU("Value"), aPath.str());
     }
 public:
     // ----------------------------------------------------
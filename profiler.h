@@ -322,11 +322,105 @@ private:
     }
 };
 // ----------------------------------------------------
+//! \class TMethodCounter
+//! \brief One bank of method statistics
+//!
+//! Each method holds two banks. Application threads record
+//! into the bank of the current epoch with atomic updates, while
+//! the console folds the bank of the previous epoch into the
+//! totals it dumps. A thread which read the epoch before the swap
+//! may still update the previous bank, the update is folded with
+//! this or with the next swap, but never lost.
+// ----------------------------------------------------
+class TMethodCounter {
+public:
+    jlong          mTimeComp;           //!< CPU time spend on this method
+    jlong          mTimeElapsed;        //!< Elapsed time spend in this method
+    jlong          mTimeContention;     //!< Contention spend within this method
+    jlong          mTimeContentionMax;
+    int            mNrContention;
+    int            mNrCalls;            //!< Number of calls
+    // ------------------------------------------------
+    // TMethodCounter::TMethodCounter
+    //! Constructor
+    // ------------------------------------------------
+    TMethodCounter() {
+        clear();
+    }
+    // ------------------------------------------------
+    // TMethodCounter::clear
+    //! Reset all counters
+    // ------------------------------------------------
+    inline void clear() {
+        mTimeComp           = 0;
+        mTimeElapsed        = 0;
+        mTimeContention     = 0;
+        mTimeContentionMax  = 0;
+        mNrContention       = 0;
+        mNrCalls            = 0;
+    }
+    // ------------------------------------------------
+    // TMethodCounter::add
+    //! \brief Accumulate the counters of another bank
+    //! \param aCounter The bank to add
+    // ------------------------------------------------
+    inline void add(TMethodCounter *aCounter) {
+        mTimeComp          += aCounter->mTimeComp;
+        mTimeElapsed       += aCounter->mTimeElapsed;
+        mTimeContention    += aCounter->mTimeContention;
+        mNrContention      += aCounter->mNrContention;
+        mNrCalls           += aCounter->mNrCalls;
+        if (mTimeContentionMax < aCounter->mTimeContentionMax) {
+            mTimeContentionMax = aCounter->mTimeContentionMax;
+        }
+    }
+    // ------------------------------------------------
+    // TMethodCounter::take
+    //! \brief Move the counters of a bank, which may still be
+    //!        updated by application threads
+    //! \param aCounter The bank to take the counters from
+    // ------------------------------------------------
+    inline void take(TMethodCounter *aCounter) {
+        jlong aValue;
+        int   aCount;
+
+        aValue = aCounter->mTimeComp;
+        ATOMIC_ADD64(&aCounter->mTimeComp, -aValue);
+        mTimeComp += aValue;
+
+        aValue = aCounter->mTimeElapsed;
+        ATOMIC_ADD64(&aCounter->mTimeElapsed, -aValue);
+        mTimeElapsed += aValue;
+
+        aValue = aCounter->mTimeContention;
+        ATOMIC_ADD64(&aCounter->mTimeContention, -aValue);
+        mTimeContention += aValue;
+
+        aCount = aCounter->mNrContention;
+        ATOMIC_ADD(&aCounter->mNrContention, -aCount);
+        mNrContention += aCount;
+
+        aCount = aCounter->mNrCalls;
+        ATOMIC_ADD(&aCounter->mNrCalls, -aCount);
+        mNrCalls += aCount;
+
+        do {
+            aValue = aCounter->mTimeContentionMax;
+        } while (!ATOMIC_CAS64(&aCounter->mTimeContentionMax, aValue, (jlong)0));
+        if (mTimeContentionMax < aValue) {
+            mTimeContentionMax = aValue;
+        }
+    }
+};
+// ----------------------------------------------------
 // ----------------------------------------------------
 typedef TList<jvmtiLocalVariableEntry *> TVariableList;
 // ----------------------------------------------------
 //! \class TMonitorMethod
 //!
+//! Methods of a prepared class only keep the method ID and the
+//! class. Name, signature and line table are resolved on first
+//! access, most methods of excluded classes are never resolved.
 // ----------------------------------------------------
 class TMonitorMethod: public THashObj {
 private:
@@ -336,17 +430,16 @@ private:
     TString        mFullName;
 
     jmethodID      mID;                 //!< Java ID 
+    volatile bool  mResolved;           //!< Name, signature and line table are valid
+    bool           mIsInterface;        //!< Method of an interface
     bool           mStatus;             //!< Visible for profiler/tracer
     bool           mActiveBreakpoints;
     bool           mExluded;            //!< Excluded from profiling
     bool           mIsTimer;            
     TMonitorClass *mClass;              //!< Class
-    jlong          mTimeComp;           //!< CPU time spend on this method    
-    jlong          mTimeElapsed;        //!< Elapsed time spend in this method
-    jlong          mTimeContention;     //! Contention spend within this method
-    jlong          mTimeContentionMax;
-    int            mNrContention;
-    int            mNrCalls;            //! Number of calls
+    TMethodCounter mCounter[2];         //!< Counter banks, indexed by the epoch
+    TMethodCounter mTotal;              //!< Counters frozen at the last epoch swap
+    jint           mGeneration;         //!< Reset generation of mTotal
     bool           mIsDebug;            //! Visible for tracer
     bool           mTriggerStack;       
     bool           mProfPointMemory;
@@ -367,6 +460,12 @@ private:
     jint                     mVariableCnt;  //!< Number of call parameter
     jint                     mNrArguments;  
     bool                     mHasVariables;
+    volatile jlong           mTraceEntry;       //!< Binary trace file and index, see TRACE_METHOD_ENTRY
+    TSnapshots               mSnapshots;        //!< Counters of the previous delta dumps
+
+    static volatile jint     mEpoch;            //!< Selects the live counter bank
+    static jint              mResetGeneration;  //!< Incremented by each reset
+    static jrawMonitorID     mResolveMonitor;   //!< Serializes TMonitorMethod::resolve and the breakpoints
 
     // ------------------------------------------------
     // TMonitorMethod::init
@@ -379,12 +478,12 @@ private:
         mProfPointTrack     = false;
         mProfPointParam     = false;
         mActiveBreakpoints  = false;
-        mNrCalls            = 0;
         mStatus             = false;
         mClass              = aClass;
         mID                 = aID;
-        mTimeComp           = 0;
-        mTimeElapsed        = 0;
+        mResolved           = true;
+        mIsInterface        = false;
+        mGeneration         = mResetGeneration;
         mIsDebug            = false;
         mIsTimer            = false;
         mTriggerStack       = false;
@@ -398,12 +497,10 @@ private:
         mVariableCnt        = 0;
         mLocationStart      = -1;
         mLocationEnd        = -1;
-        mTimeContentionMax  = 0;
-        mTimeContention     = 0;
-        mNrContention       = 0;
         mProperties         = TProperties::getInstance();
         mProfPointMemory    = false;
         mVariableVal        = NULL;
+        mTraceEntry         = 0;
     }
 public:
     // ------------------------------------------------
@@ -439,6 +536,8 @@ public:
     // ------------------------------------------------
     // TMonitorMethod::TMonitorMethod
     //! \brief  Constructor
+    //!
+    //! The method details are resolved on first access.
     //! \param  aJvmti      The Java tool interface
     //! \param  aJni        The Java native interface
     //! \param  jMethod     The hash value
@@ -454,45 +553,86 @@ public:
                 TMonitorClass  *aClass,
                 const SAP_UC   *aClassName) {
 
+        mJvmti = aJvmti;
+        init(aClass, jMethod);
+        mClassName   = aClassName;
+        mIsInterface = (aIsInterface != 0);
+        mResolved    = false;
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::initialize
+    //! \brief Create the monitor for TMonitorMethod::resolve
+    //! \param aJvmti The Java tool interface
+    // ------------------------------------------------
+    static void initialize(jvmtiEnv *aJvmti) {
+        if (mResolveMonitor == NULL) {
+            aJvmti->CreateRawMonitor(cR("_MethodResolve"), &mResolveMonitor);
+        }
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::resolve
+    //! \brief Read name, signature and line table of the method
+    // ------------------------------------------------
+    void resolve() {
         jint            aCount;
-        const char     *aName;
-        const char     *aSignature;
-        const char     *aGeneric;
+        const char     *aName      = NULL;
+        const char     *aSignature = NULL;
+        const char     *aGeneric   = NULL;
         jvmtiError      aResult;
 
-        mJvmti = aJvmti;
-        mJvmti->GetMethodName(jMethod, (char**)&aName, (char**)&aSignature, (char**)&aGeneric);
-
-        mName.assignR(aName, STRLEN_A7(aName));
-        mSignature.assignR(aSignature, STRLEN_A7(aSignature));
-
+        if (mResolved) {
+            // read the names only after the flag
+            MEMORY_BARRIER();
+            return;
+        }
+        if (mResolveMonitor != NULL) {
+            mJvmti->RawMonitorEnter(mResolveMonitor);
+        }
+        if (mResolved) {
+            if (mResolveMonitor != NULL) {
+                mJvmti->RawMonitorExit(mResolveMonitor);
+            }
+            return;
+        }
+        // a method of an unloaded class has no name
+        aResult = mJvmti->GetMethodName(mID, (char**)&aName, (char**)&aSignature, (char**)&aGeneric);
+        if (aResult == JVMTI_ERROR_NONE && aName != NULL && aSignature != NULL) {
+            mName.assignR(aName, STRLEN_A7(aName));
+            mSignature.assignR(aSignature, STRLEN_A7(aSignature));
+        }
+        else {
+            mName      = cU("");
+            mSignature = cU("");
+        }
         mName.replace(cU('/'), cU('.'));
         mSignature.replace(cU('/'), cU('.'));
-        mClassName = aClassName;
-        mFullName  = aClassName;
+        mFullName  = mClassName.str();
         mFullName.concat(cU("."));
         mFullName.concat(mName.str());
 
-        mJvmti->Deallocate((unsigned char*)aSignature);
-        mJvmti->Deallocate((unsigned char*)aGeneric);
-        mJvmti->Deallocate((unsigned char*)aName);
-        init(aClass, jMethod);
-
-        if (aIsInterface) {
-            return;
+        if (aResult == JVMTI_ERROR_NONE) {
+            mJvmti->Deallocate((unsigned char*)aSignature);
+            mJvmti->Deallocate((unsigned char*)aGeneric);
+            mJvmti->Deallocate((unsigned char*)aName);
         }
-        mProfPointMemory = STRNCMP(mName.str(), cU("<init>"),   6) == 0 ||
-                           STRNCMP(mName.str(), cU("<clinit>"), 8) == 0;
 
-        aResult = mJvmti->GetLineNumberTable(jMethod, &aCount, &mEntryTable);
-        if (aResult != JVMTI_ERROR_NONE) {
-            return;
+        if (!mIsInterface) {
+            mProfPointMemory = STRNCMP(mName.str(), cU("<init>"),   6) == 0 ||
+                               STRNCMP(mName.str(), cU("<clinit>"), 8) == 0;
+
+            aResult = mJvmti->GetLineNumberTable(mID, &aCount, &mEntryTable);
+            if (aResult == JVMTI_ERROR_NONE && aCount > 1) {
+                mLocationStart = mEntryTable[0].start_location;
+                mLocationEnd   = mEntryTable[aCount - 1].start_location;
+            }
         }
+        // publish the names before the flag
+        MEMORY_BARRIER();
+        mResolved = true;
 
-        if (aCount > 1) {
-            mLocationStart = mEntryTable[0].start_location;
-            mLocationEnd   = mEntryTable[aCount - 1].start_location;
-        }        
+        if (mResolveMonitor != NULL) {
+            mJvmti->RawMonitorExit(mResolveMonitor);
+        }
     }
     // ------------------------------------------------
     // TMonitorMethod::~TMonitorMethod
@@ -659,6 +799,7 @@ public:
     //! \return \c TRUE if method is a Java constructor
     // ------------------------------------------------
     bool isProfPointMem() {
+        resolve();
         return mProfPointMemory;
     }
     // ------------------------------------------------
@@ -670,44 +811,86 @@ public:
     }
     // ------------------------------------------------
     // TMonitorMethod::enter
-    //! Register a method call
+    //! \brief Register a method call
+    //!
+    //! Application threads update the live bank without lock.
     // ------------------------------------------------
     inline void enter() {
-        mNrCalls ++;
+        ATOMIC_ADD(&mCounter[mEpoch & 1].mNrCalls, 1);
     }
     // ------------------------------------------------
     // TMonitorMethod::reset
-    //! Reset statistical data
+    //! \brief Reset statistical data
+    //!
+    //! Only valid while no application thread records into
+    //! the method. The profiler resets with TMonitorMethod::swapEpoch.
     // ------------------------------------------------
     virtual void reset() {
-        mNrCalls            = 0;
-        mTimeComp           = 0;
-        mTimeElapsed        = 0;
-        mTimeContentionMax  = 0;
-        mTimeContention     = 0;
-        mNrContention       = 0;
+        mCounter[0].clear();
+        mCounter[1].clear();
+        mTotal.clear();
+        mGeneration = mResetGeneration;
     }
     // ------------------------------------------------
     // TMonitorMethod::exit
     //! Register a method call and calculate statistics
     // ------------------------------------------------
     inline void exit(jlong aDeltaTime, jlong aElapsedTime) {
-        mTimeComp    += aDeltaTime;
-        mTimeElapsed += aElapsedTime;
+        TMethodCounter *aCounter = &mCounter[mEpoch & 1];
+        ATOMIC_ADD64(&aCounter->mTimeComp,    aDeltaTime);
+        ATOMIC_ADD64(&aCounter->mTimeElapsed, aElapsedTime);
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::swapEpoch
+    //! \brief Redirect all application threads to the other bank
+    //!
+    //! The caller holds the counter lock, which serializes the
+    //! swaps. Application threads do not take the lock, an update
+    //! to the previous bank is taken by TMonitorMethod::freeze.
+    //! \param aReset Discard the counters recorded so far
+    // ------------------------------------------------
+    static void swapEpoch(bool aReset) {
+        if (aReset) {
+            mResetGeneration++;
+        }
+        MEMORY_BARRIER();
+        mEpoch++;
+        MEMORY_BARRIER();
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::freeze
+    //! \brief Fold the bank of the previous epoch into the totals
+    //!
+    //! Called by the console after TMonitorMethod::swapEpoch.
+    //! The previous bank is cleared for reuse as live bank.
+    // ------------------------------------------------
+    void freeze() {
+        TMethodCounter *aCounter = &mCounter[(mEpoch + 1) & 1];
+        TMethodCounter  aDiscard;
+
+        if (mGeneration != mResetGeneration) {
+            // the bank was recorded before reset
+            mGeneration = mResetGeneration;
+            mTotal.clear();
+            aDiscard.take(aCounter);
+        }
+        else {
+            mTotal.take(aCounter);
+        }
     }
     // ------------------------------------------------
     // TMonitorMethod::getCpuTime
     //! \return The accumulated CPU time
     // ------------------------------------------------
     inline jlong getCpuTime() {
-        return mTimeComp;
+        return mTotal.mTimeComp + mCounter[mEpoch & 1].mTimeComp;
     }
     // ------------------------------------------------
     // TMonitorMethod::getCpuDelta
     //! \return Calculate Elapsed time
     // ------------------------------------------------
     inline jlong getElapsed() {
-        return mTimeElapsed;
+        return mTotal.mTimeElapsed + mCounter[mEpoch & 1].mTimeElapsed;
     }
     // ------------------------------------------------
     // TMonitorMethod::getStatus
@@ -720,28 +903,53 @@ public:
     // ------------------------------------------------
     // TMonitorMethod::enable
     //! \brief Activate method for profiler
-    //! \param aStatus \c TRUE to activate method
+    //! \param aStatus      \c TRUE to activate method
+    //! \param aBreakpoints \c FALSE to defer the breakpoints of the
+    //!                     trigger mode to TMonitorMethod::updateBreakpoints
     // ------------------------------------------------
-    void enable(bool aStatus) {
-        jvmtiError  aResult;
-        jboolean    aExcept;
-        bool        aActivateBreakpoint; 
-
+    void enable(bool aStatus, bool aBreakpoints = true) {
         mStatus = aStatus;
 
+        if (aBreakpoints) {
+            updateBreakpoints();
+        }
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::updateBreakpoints
+    //! \brief Set or clear the breakpoints of the trigger mode
+    //!
+    //! Serialized with TMonitorMethod::resolve.
+    // ------------------------------------------------
+    void updateBreakpoints() {
         if (mJvmti == NULL || 
             mProperties->getProfilerMode() != PROFILER_MODE_TRIGGER) {
             return;
         }
+        if (mResolveMonitor != NULL) {
+            mJvmti->RawMonitorEnter(mResolveMonitor);
+        }
+        setBreakpoints(mStatus || 
+            (mProperties->doMonitorMemoryOn() && isProfPointMem()));
 
-        aActivateBreakpoint = aStatus || 
-            (mProperties->doMonitorMemoryOn() && mProfPointMemory);
+        if (mResolveMonitor != NULL) {
+            mJvmti->RawMonitorExit(mResolveMonitor);
+        }
+    }
+private:
+    // ------------------------------------------------
+    // TMonitorMethod::setBreakpoints
+    //! \param aActivateBreakpoint \c TRUE to set the breakpoints
+    // ------------------------------------------------
+    void setBreakpoints(bool aActivateBreakpoint) {
+        jvmtiError  aResult;
+        jboolean    aExcept;
 
         if (mActiveBreakpoints == aActivateBreakpoint) {
             return;
         }
 
         if (!mActiveBreakpoints) {
+            resolve();
             if (mLocationEnd < 0 || mLocationEnd <= mLocationStart) {
                 return;
             }
@@ -777,6 +985,7 @@ public:
             mActiveBreakpoints = false;
         }
     }
+public:
     // ------------------------------------------------
     // TMonitorMethod::getID
     //! \return The unique method hash
@@ -796,6 +1005,7 @@ public:
     //! \return The name of the method
     // ------------------------------------------------
     virtual const SAP_UC *getName() {
+        resolve();
         return mName.str();
     }
     // ------------------------------------------------
@@ -803,6 +1013,7 @@ public:
     //! \return The name of the method
     // ------------------------------------------------
     virtual const SAP_UC *getFullName() {
+        resolve();
         return mFullName.str();
     }
     // ------------------------------------------------
@@ -810,9 +1021,28 @@ public:
     //! \return The signature of the method
     // ------------------------------------------------
     virtual TString *getSignature() {
+        resolve();
         return &mSignature;
     }
     // ------------------------------------------------
+    // TMonitorMethod::getTraceIndex
+    //! \brief Index of the method in the binary trace
+    //!
+    //! The method is defined in the trace file on first use.
+    //! Generation and index are read as one word, so a thread never
+    //! sees the index of a previous trace file with the new generation.
+    //! \param aBinary The binary trace writer
+    //! \return The method index
+    // ------------------------------------------------
+    inline jint getTraceIndex(TTraceBinary *aBinary) {
+        jlong aEntry = mTraceEntry;
+
+        if (TRACE_METHOD_GENERATION(aEntry) != aBinary->getGeneration()) {
+            return aBinary->defineMethod(&mTraceEntry, mClassName.str(), getName());
+        }
+        return TRACE_METHOD_INDEX(aEntry);
+    }
+    // ------------------------------------------------
     // TMonitorMethod::setContextDebug
     //! \brief Set context for tracing
     //! \param aContext The stack context 
@@ -848,24 +1078,29 @@ public:
     //! \param aTime The contention time
     // ------------------------------------------------
     void setContention(jlong aTime) {
-        if (mTimeContentionMax < aTime) {
-            mTimeContentionMax = aTime;
-        }
-        mTimeContention += aTime;
-        mNrContention   ++;
+        TMethodCounter *aCounter = &mCounter[mEpoch & 1];
+        jlong           aMax;
+
+        do {
+            aMax = aCounter->mTimeContentionMax;
+        } while (aMax < aTime && !ATOMIC_CAS64(&aCounter->mTimeContentionMax, aMax, aTime));
+
+        ATOMIC_ADD64(&aCounter->mTimeContention, aTime);
+        ATOMIC_ADD(&aCounter->mNrContention, 1);
     }
     // ------------------------------------------------
     // TMonitorMethod::getNrCalls
     //! \return The number of registered calls 
     // ------------------------------------------------
     int getNrCalls() {
-        return mNrCalls;
+        return mTotal.mNrCalls + mCounter[mEpoch & 1].mNrCalls;
     }
     // ------------------------------------------------
     // TMonitorMethod::getStartPos
     //! \return The source start position
     // ------------------------------------------------
     jlocation getStartLocation() {
+        resolve();
         return mLocationStart;
     }
     // ------------------------------------------------
@@ -873,6 +1108,7 @@ public:
     //! \return The source end position
     // ------------------------------------------------
     jlocation getEndLocation() {
+        resolve();
         return mLocationEnd;
     }
     // ------------------------------------------------
@@ -941,13 +1177,13 @@ public:
     // ------------------------------------------------
     // TMonitorMethod::setTimer
     //! \brief Timer events for method
+    //!
+    //! The counters are kept, TMonitor::reset discards them
+    //! with the reset generation.
     //! \param enable Set \c TRUE to enable timer events
     // ------------------------------------------------
     inline void setTimer(bool enable) {
         mIsTimer     = enable;
-        mNrCalls     = 0;
-        mTimeComp    = 0;
-        mTimeElapsed = 0;
     }
     // ------------------------------------------------
     // TMonitorMethod::getTimer
@@ -979,6 +1215,8 @@ public:
             else if (!STRNCMP(aColName, cU("Elapsed"),    7)) { aCol = 2; }
             else if (!STRNCMP(aColName, cU("Content"),    7)) { aCol = 3; }
             else if (!STRNCMP(aColName, cU("NrConte"),    7)) { aCol = 4; }
+            else if (!STRNCMP(aColName, cU("CtnEl"),      5)) { aCol = 3; }
+            else if (!STRNCMP(aColName, cU("CntNr"),      5)) { aCol = 4; }
             else if (!STRNCMP(aColName, cU("NrCalls"),    7)) { aCol = 5; }
         }
         return aCol;
@@ -986,17 +1224,19 @@ public:
     // ------------------------------------------------
     // TMonitorMethod::compare
     //! \brief Callback for sort algorithm
+    //!
+    //! Compares the counters frozen at the last epoch swap.
     //! \param aCmpCol  The sort index
     //! \param aCmp     A sort criterium
     //! \return The relation of column entry to aCmp
     // ------------------------------------------------
     jlong compare(int aCmpCol, jlong aCmp) {
         switch (aCmpCol) {
-            case 1 : return getCpuTime()    - aCmp;
-            case 2 : return getElapsed()    - aCmp;
-            case 3 : return getContention() - aCmp;
-            case 4 : return mNrContention   - aCmp;
-            case 5 : return mNrCalls        - aCmp; 
+            case 1 : return mTotal.mTimeComp        - aCmp;
+            case 2 : return mTotal.mTimeElapsed     - aCmp;
+            case 3 : return mTotal.mTimeContention  - aCmp;
+            case 4 : return mTotal.mNrContention    - aCmp;
+            case 5 : return mTotal.mNrCalls         - aCmp; 
             default: return 0;
         }
     }
@@ -1005,10 +1245,17 @@ public:
     //! \return \c TRUE if there was at least one contention
     // ------------------------------------------------
     jlong getContention() {
-        return mTimeContention;
+        return mTotal.mTimeContention + mCounter[mEpoch & 1].mTimeContention;
     }
     jlong getNrContention() {
-        return mNrContention;
+        return mTotal.mNrContention + mCounter[mEpoch & 1].mNrContention;
+    }
+    // ------------------------------------------------
+    // TMonitorMethod::getSnapshots
+    //! \return The counters of the previous delta dumps by session
+    // ------------------------------------------------
+    TSnapshots *getSnapshots() {
+        return &mSnapshots;
     }
     // ------------------------------------------------
     // TMonitorMethod::dump
@@ -1017,28 +1264,44 @@ public:
     //! \param aSignature  Dump method signature
     //! \param aContention Dump method contention statistic
     //! \param aOutputHash Dump method hash
+    //! \param aDelta      Snapshot of the session for a delta dump, \c NULL for totals
     // ------------------------------------------------
     void dump(
             TXmlTag *aRootTag, 
             bool     aSignature, 
             bool     aContention,
-            bool     aOutputHash = false) {
+            bool     aOutputHash = false,
+            TSnapshot *aDelta    = NULL) {
 
         SAP_UC aBuffer[128];
         
         TXmlTag *aTag = aRootTag->addTag(cU("Method"));
 
-
-        aTag->addAttribute(cU("CpuTime"),       TString::parseInt(getCpuTime(),     aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
-        aTag->addAttribute(cU("Elapsed"),       TString::parseInt(getElapsed(),     aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);        
-        aTag->addAttribute(cU("NrCalls"),       TString::parseInt(mNrCalls,         aBuffer), PROPERTY_TYPE_INT);
+        if (aDelta != NULL) {
+            aTag->addAttribute(cU("CpuTime"),   TString::parseInt(aDelta->getDelta(1), aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+            aTag->addAttribute(cU("Elapsed"),   TString::parseInt(aDelta->getDelta(2), aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+            aTag->addAttribute(cU("NrCalls"),   TString::parseInt(aDelta->getDelta(5), aBuffer), PROPERTY_TYPE_INT);
+            aTag->addAttribute(cU("CpuRate"),   TString::parseInt(aDelta->getRate(1),  aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+            aTag->addAttribute(cU("CallRate"),  TString::parseInt(aDelta->getRate(5),  aBuffer), PROPERTY_TYPE_INT);
+        }
+        else {
+            aTag->addAttribute(cU("CpuTime"),   TString::parseInt(mTotal.mTimeComp,    aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+            aTag->addAttribute(cU("Elapsed"),   TString::parseInt(mTotal.mTimeElapsed, aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);        
+            aTag->addAttribute(cU("NrCalls"),   TString::parseInt(mTotal.mNrCalls,     aBuffer), PROPERTY_TYPE_INT);
+        }
         aTag->addAttribute(cU("ClassName"),     mClassName.str());
         aTag->addAttribute(cU("MethodName"),    getName());        
-        aTag->addAttribute(cU("Signature"),     mSignature.str());
+        aTag->addAttribute(cU("Signature"),     getSignature()->str());
  
         if (mProperties->doContention()) {
-            aTag->addAttribute(cU("CtnEl"),     TString::parseInt(mTimeContention,  aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
-            aTag->addAttribute(cU("CntNr"),     TString::parseInt(mNrContention,    aBuffer), PROPERTY_TYPE_INT);
+            if (aDelta != NULL) {
+                aTag->addAttribute(cU("CtnEl"), TString::parseInt(aDelta->getDelta(3), aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+                aTag->addAttribute(cU("CntNr"), TString::parseInt(aDelta->getDelta(4), aBuffer), PROPERTY_TYPE_INT);
+            }
+            else {
+                aTag->addAttribute(cU("CtnEl"), TString::parseInt(mTotal.mTimeContention, aBuffer), PROPERTY_TYPE_INT | PROPERTY_TYPE_MICROSEC);
+                aTag->addAttribute(cU("CntNr"), TString::parseInt(mTotal.mNrContention,   aBuffer), PROPERTY_TYPE_INT);
+            }
         }
 
         if (aOutputHash) {
@@ -1303,9 +1566,12 @@ protected:
     jlong          mID;                 //!< Hash value for the class
     bool           mIsProfiled;         //!< Visibility for profiler
     bool           mMemoryAlert;        //!< Memory history statistic
+    bool           mAlertPending;       //!< Alert queued for the alert thread
+    jlong          mAlertTime;          //!< Time of the last alert output
     jlong          mRefCount;           //!< Reference count for heap dump     
     jlong          mHeapCount;          //!< Number of instances
     jlong          mHeapSize;           //!< Size of all instances
+    jint           mHeapIndex;          //!< Slot in the heap histogram
     jlong          mSize;               //!< Size of this class
     jlong          mMaxSize;            //!< Max size of allocated memory
     jlong          mNrBits;             //!< Number of allocated objects
@@ -1320,6 +1586,7 @@ protected:
     bool           mVisible;            //!< Visible for statistic
     bool           mExcluded;           //!< Excluded from statistic 
     bool           mIsProfiledAll;      //!< Include for statistic
+    bool           mPlainMethods;       //!< No method rule matches a method
     bool           mIsObject;
     TProperties   *mProperties;         //!< Configuration
     jvmtiEnv      *mJvmti;              //!< Java tool interface
@@ -1327,6 +1594,8 @@ protected:
     jmethodID      mMethodConstr;       //!< Constructor
     jmethodID      mMethodFinalize;     //!< Finalizer
     THashFields   *mFields;             //!< Hash table for class fields
+    bool           mHasFields;          //!< Fields are registered
+    TSnapshots     mSnapshots;          //!< Counters of the previous delta dumps
 
 public:  
     jint           mNrMethods;          //!< Number of methods
@@ -1348,6 +1617,7 @@ public:
         mSuper      = aSuper;
         mProperties = TProperties::getInstance();
         mFields     = NULL;
+        mHasFields  = false;
 
         mJvmti->GetClassSignature(jClass, &aSignature, &aGeneric);        
         mName.assignR(aSignature, STRLEN_A7(aSignature));
@@ -1375,6 +1645,7 @@ public:
         mSuper      = NULL;
         mName.replace(cU('/'), cU('.'));
         mFields     = NULL;
+        mHasFields  = false;
         
         //mID = reinterpret_cast<jlong>(this);
         init();
@@ -1405,9 +1676,12 @@ public:
     // ------------------------------------------------
     void init() {
         mMemoryAlert      = false;
+        mAlertPending     = false;
+        mAlertTime        = 0;
         mRefCount         = 0;
         mHeapCount        = 0;
         mHeapSize         = 0;
+        mHeapIndex        = -1;
         mSize             = 0;
         mMaxSize          = 0;
         mNrMethods        = 0;
@@ -1420,6 +1694,7 @@ public:
         mVisible          = true;
         mExcluded         = false;
         mIsProfiledAll    = false;
+        mPlainMethods     = false;
         mHistory          = NULL;
         mNrInterfaces     = 0;
         mTag              = 0;
@@ -1483,6 +1758,19 @@ public:
         mHeapSize += aSize;
         return ++mHeapCount;
     }
+    //! \brief Set heap count from a histogram slot
+    inline void setHeapCount(jlong aCount, jlong aSize) {
+        mHeapCount = aCount;
+        mHeapSize  = aSize;
+    }
+    //! \return Slot in the heap histogram
+    inline jint getHeapIndex() {
+        return mHeapIndex;
+    }
+    //! \brief Assign the slot in the heap histogram
+    inline void setHeapIndex(jint aIndex) {
+        mHeapIndex = aIndex;
+    }
     //! \return New heap count
     inline jlong getHeapCount() {
         return mHeapCount;
@@ -1563,6 +1851,22 @@ public:
         return mExcluded;
     }
     // ------------------------------------------------
+    // TMonitorClass::setPlainMethods
+    //! \brief Skip the method rules for the methods of the class
+    //! \param aPlain \c TRUE if the class cache reports that no
+    //!        method rule matches
+    // ------------------------------------------------
+    void setPlainMethods(bool aPlain) {
+        mPlainMethods = aPlain;
+    }
+    // ------------------------------------------------
+    // TMonitorClass::hasPlainMethods
+    //! \return \c TRUE if no method rule matches a method of the class
+    // ------------------------------------------------
+    bool hasPlainMethods() {
+        return mPlainMethods;
+    }
+    // ------------------------------------------------
     // TMonitorClass::getStatus
     //! \return \c TRUE if class is active for profiling
     // ------------------------------------------------
@@ -1584,6 +1888,11 @@ public:
         }
     }
     // ------------------------------------------------
+    // TMonitorClass::registerFields
+    //! \brief Register the fields of the class once
+    //! \param aJvmti The Java tool interface
+    //! \param aJni   The Java native interface
+    //! \param jClass The class
     // ------------------------------------------------
     void registerFields(
             jvmtiEnv *aJvmti,
@@ -1596,6 +1905,10 @@ public:
         jfieldID   *aPtrField;
         int i;
 
+        if (mHasFields) {
+            return;
+        }
+        mHasFields = true;
         aResult = aJvmti->GetClassFields(jClass, &aCntField, &aPtrField);
         if (aCntField == 0)
             mFields = NULL;
@@ -1630,6 +1943,13 @@ public:
         aJvmti->Deallocate((unsigned char*)aPtrField);
     }
     // ------------------------------------------------
+    // TMonitorClass::hasFields
+    //! \return \c TRUE if the fields are registered
+    // ------------------------------------------------
+    bool hasFields() {
+        return mHasFields;
+    }
+    // ------------------------------------------------
     // ------------------------------------------------
     TMonitorField *getField(jfieldID jField) {
     	if (mFields == NULL) {
@@ -1698,6 +2018,32 @@ public:
         mHistory->trunc(1);
     }
     // ------------------------------------------------
+    //! \brief Return the alert queue status
+    //! \return \c TRUE if the alert waits for output
+    // ------------------------------------------------
+    inline bool getAlertPending() {
+        return mAlertPending;
+    }
+    // ------------------------------------------------
+    //! \brief Mark the alert as queued or processed
+    //! \param aPending \c TRUE if queued for output
+    // ------------------------------------------------
+    inline void setAlertPending(bool aPending) {
+        mAlertPending = aPending;
+    }
+    // ------------------------------------------------
+    //! \return Time of the last alert output
+    // ------------------------------------------------
+    inline jlong getAlertTime() {
+        return mAlertTime;
+    }
+    // ------------------------------------------------
+    //! \param aTime Time of the alert output
+    // ------------------------------------------------
+    inline void setAlertTime(jlong aTime) {
+        mAlertTime = aTime;
+    }
+    // ------------------------------------------------
     // TMonitorClass::getHistorySize
     //! \return The number of history entries
     // ------------------------------------------------
@@ -1875,6 +2221,13 @@ public:
         }
     }
     // ------------------------------------------------
+    // TMonitorClass::getSnapshots
+    //! \return The counters of the previous delta dumps by session
+    // ------------------------------------------------
+    TSnapshots *getSnapshots() {
+        return &mSnapshots;
+    }
+    // ------------------------------------------------
     // TMonitorClass::filterName
     //! \brief Find attibute with wildcard
     //! \param aCmpName The search string
@@ -1894,11 +2247,13 @@ public:
     //! \param aRootTag  The output tag list
     //! \param aRef      Optional reference for detail navigation
     //! \param bDumpHash Dump hash value for external detail navigation
+    //! \param aDelta    Snapshot of the session for a delta dump, \c NULL for totals
     // ------------------------------------------------
     TXmlTag *dump(
             TXmlTag      *aTag, 
             const SAP_UC *aRef      = NULL, 
-            bool          bDumpHash = false) {
+            bool          bDumpHash = false,
+            TSnapshot    *aDelta    = NULL) {
 
         SAP_UC   aBuffer[128];
         
@@ -1906,7 +2261,14 @@ public:
             return NULL;
         }
         //TXmlTag *aTag = aRootTag->addTag(cU("Class"));
-        aTag->addAttribute(cU("CurrSize"), TString::parseInt(getSize(), aBuffer), PROPERTY_TYPE_INT);
+        if (aDelta != NULL) {
+            aTag->addAttribute(cU("CurrSize"),     TString::parseInt(aDelta->getDelta(1), aBuffer), PROPERTY_TYPE_INT);
+            aTag->addAttribute(cU("NewInstances"), TString::parseInt(aDelta->getDelta(2), aBuffer), PROPERTY_TYPE_INT);
+            aTag->addAttribute(cU("SizeRate"),     TString::parseInt(aDelta->getRate(1),  aBuffer), PROPERTY_TYPE_INT);
+        }
+        else {
+            aTag->addAttribute(cU("CurrSize"), TString::parseInt(getSize(), aBuffer), PROPERTY_TYPE_INT);
+        }
         // allow detailed view for class name attribute
         if (aRef != NULL) {
             TString aAttrStr;
@@ -2157,6 +2519,7 @@ class TMonitorThread: public THashObj {
     bool           mCallstackReference; //!< Common stack for ATS mode
     bool           mProcessJni;
     bool           mAttached;
+    TTraceBuffer  *mTraceBuffer;        //!< Binary trace records
     TProperties   *mProperties;         //!< Configuration
     jvmtiEnv      *mJvmti;
     TThreadList::iterator mThreadElem;
@@ -2203,6 +2566,7 @@ public:
         mJvmti          = aJvmti;
         mCallstackReference = false;
         mThreadElem     = NULL;
+        mTraceBuffer    = NULL;
 
         if (aThreadName != NULL) {
             mThreadName = aThreadName;
@@ -2230,6 +2594,12 @@ public:
         mThreads.remove(mThreadElem);
         mThreadElem = NULL;
 
+        // The trace writer deletes the buffer
+        if (mTraceBuffer != NULL) {
+            mTraceBuffer->close();
+            mTraceBuffer = NULL;
+        }
+
         if (mDebugOutput != NULL) {
             delete mDebugOutput;
         }
@@ -2368,6 +2738,17 @@ public:
         return mDebugOutput;
     }
     // -----------------------------------------------------
+    // TMonitorThread::getTraceBuffer
+    //! \brief  Create the binary trace buffer on first call
+    //! \return The binary trace buffer
+    // -----------------------------------------------------
+    inline TTraceBuffer *getTraceBuffer() {
+        if (mTraceBuffer == NULL) {
+            mTraceBuffer = TTraceBinary::getInstance()->attach(mHash, getName());
+        }
+        return mTraceBuffer;
+    }
+    // -----------------------------------------------------
     // TMonitorThread::hasCallstack
     //! \return \c TRUE if callstack not empty
     // -----------------------------------------------------
@@ -2506,6 +2887,555 @@ public:
     }
 };
 
+#define FOLDED_WEIGHT_COUNT     0   //!< Folded stacks weighted by number of events
+#define FOLDED_WEIGHT_ELAPSED   1   //!< Folded stacks weighted by elapsed time
+#define FOLDED_WEIGHT_CPU       2   //!< Folded stacks weighted by CPU time
+#define FOLDED_WEIGHT_MEMORY    3   //!< Folded stacks weighted by allocated bytes
+// ----------------------------------------------------
+//! \class TStackNode
+//! \brief Frame of the folded stack profile
+//!
+//! Each node represents the frame sequence from the root to
+//! itself, so identical stacks share the same node.
+// ----------------------------------------------------
+class TStackNode {
+public:
+    jmethodID       mID;            //!< Method of the frame
+    TString         mName;          //!< Class and method name
+    TStackNode     *mParent;        //!< Caller
+    TStackNode     *mChild;         //!< First callee
+    TStackNode     *mSibling;       //!< Next callee of the caller
+    jlong           mCount;         //!< Events with this stack on top
+    jlong           mElapsed;       //!< Elapsed time of the events
+    jlong           mCpuTime;       //!< CPU time of the events
+    jlong           mMemory;        //!< Allocated bytes of the events
+    // ----------------------------------------------------
+    // TStackNode::TStackNode
+    //! Constructor
+    //! \param aParent The caller or NULL for the root
+    //! \param aMethod The method or NULL for the root
+    // ----------------------------------------------------
+    TStackNode(TStackNode *aParent, TMonitorMethod *aMethod) {
+        mID      = NULL;
+        mParent  = aParent;
+        mChild   = NULL;
+        mSibling = NULL;
+        mCount   = 0;
+        mElapsed = 0;
+        mCpuTime = 0;
+        mMemory  = 0;
+        if (aMethod != NULL) {
+            mID   = aMethod->getID();
+            mName = aMethod->getFullName();
+        }
+    }
+    // ----------------------------------------------------
+    // TStackNode::~TStackNode
+    //! Destructor
+    // ----------------------------------------------------
+    ~TStackNode() {
+        TStackNode *aNode;
+
+        while (mChild != NULL) {
+            aNode   = mChild;
+            mChild  = aNode->mSibling;
+            delete aNode;
+        }
+    }
+    // ----------------------------------------------------
+    // TStackNode::getChild
+    //! \brief Find or create the callee
+    //! \param aMethod The method of the callee
+    //! \return The callee node
+    // ----------------------------------------------------
+    TStackNode *getChild(TMonitorMethod *aMethod) {
+        TStackNode *aNode;
+
+        for (aNode = mChild; aNode != NULL; aNode = aNode->mSibling) {
+            if (aNode->mID == aMethod->getID()) {
+                return aNode;
+            }
+        }
+        aNode           = new TStackNode(this, aMethod);
+        aNode->mSibling = mChild;
+        mChild          = aNode;
+        return aNode;
+    }
+    // ----------------------------------------------------
+    // TStackNode::getWeight
+    //! \param aWeight One of FOLDED_WEIGHT_*
+    //! \return The weight of the stack
+    // ----------------------------------------------------
+    jlong getWeight(int aWeight) {
+        switch (aWeight) {
+            case FOLDED_WEIGHT_ELAPSED: return mElapsed;
+            case FOLDED_WEIGHT_CPU:     return mCpuTime;
+            case FOLDED_WEIGHT_MEMORY:  return mMemory;
+            default:                    return mCount;
+        }
+    }
+};
+// ----------------------------------------------------
+//! \class TFoldedStacks
+//! \brief Aggregates the callstacks of trace events
+//!
+//! Events on the same stack are summed up in one node. The
+//! stacks are written in folded format, one line per stack
+//! with the frames separated by semicolons and the weight,
+//! which is the input format of flame graph tools.
+// ----------------------------------------------------
+class TFoldedStacks {
+private:
+    TStackNode     *mRoot;          //!< Entry of all stacks
+    jlong           mNrStacks;      //!< Number of distinct stacks
+    jlong           mNrEvents;      //!< Number of events
+    // ----------------------------------------------------
+    // TFoldedStacks::TFoldedStacks
+    //! Copy constructor
+    // ----------------------------------------------------
+    TFoldedStacks(const TFoldedStacks &) {
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::next
+    //! \brief Depth first iteration without recursion
+    //! \param aNode The current node
+    //! \return The next node or NULL at the end
+    // ----------------------------------------------------
+    TStackNode *next(TStackNode *aNode) {
+        if (aNode->mChild != NULL) {
+            return aNode->mChild;
+        }
+        while (aNode != NULL && aNode != mRoot) {
+            if (aNode->mSibling != NULL) {
+                return aNode->mSibling;
+            }
+            aNode = aNode->mParent;
+        }
+        return NULL;
+    }
+public:
+    // ----------------------------------------------------
+    // TFoldedStacks::TFoldedStacks
+    //! Constructor
+    // ----------------------------------------------------
+    TFoldedStacks() {
+        mRoot     = new TStackNode(NULL, NULL);
+        mNrStacks = 0;
+        mNrEvents = 0;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::~TFoldedStacks
+    //! Destructor
+    // ----------------------------------------------------
+    ~TFoldedStacks() {
+        delete mRoot;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::add
+    //! \brief Count an event for the current stack
+    //! \param aStack   The callstack with the event method on top
+    //! \param aElapsed The elapsed time of the event method
+    //! \param aCpuTime The CPU time of the event method
+    //! \param aMemory  The allocated bytes of the event method
+    // ----------------------------------------------------
+    void add(
+            TCallstack *aStack,
+            jlong       aElapsed,
+            jlong       aCpuTime,
+            jlong       aMemory) {
+
+        TStackNode    *aNode = mRoot;
+        TMonitorTimer *aTimer;
+        jint           i;
+
+        for (i = 0; i < aStack->getDepth(); i++) {
+            aTimer = (*aStack)[i];
+            if (aTimer->getMethod() != NULL) {
+                aNode = aNode->getChild(aTimer->getMethod());
+            }
+        }
+        if (aNode == mRoot) {
+            return;
+        }
+        if (aNode->mCount == 0) {
+            mNrStacks++;
+        }
+        mNrEvents++;
+        aNode->mCount++;
+        aNode->mElapsed += aElapsed;
+        aNode->mCpuTime += aCpuTime;
+        aNode->mMemory  += aMemory;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::reset
+    //! \brief Remove all stacks
+    // ----------------------------------------------------
+    void reset() {
+        delete mRoot;
+        mRoot     = new TStackNode(NULL, NULL);
+        mNrStacks = 0;
+        mNrEvents = 0;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::write
+    //! \brief Write the stacks in folded format
+    //! \param aFile   The output file
+    //! \param aWeight One of FOLDED_WEIGHT_*
+    //! \return The number of written stacks
+    // ----------------------------------------------------
+    jlong write(TMappedFile *aFile, int aWeight) {
+        TStackNode  *aNode;
+        TStackNode  *aFrame;
+        TStackNode **aFrames;
+        SAP_UC       aBuffer[64];
+        jlong        aNrLines = 0;
+        jint         aDepth;
+        jint         aMaxDepth = 0;
+
+        for (aNode = next(mRoot); aNode != NULL; aNode = next(aNode)) {
+            aDepth = 0;
+            for (aFrame = aNode; aFrame != mRoot; aFrame = aFrame->mParent) {
+                aDepth++;
+            }
+            aMaxDepth = max(aMaxDepth, aDepth);
+        }
+        aFrames = new TStackNode *[aMaxDepth + 1];
+
+        for (aNode = next(mRoot); aNode != NULL; aNode = next(aNode)) {
+            if (aNode->mCount == 0 || aNode->getWeight(aWeight) <= 0) {
+                continue;
+            }
+            aDepth = 0;
+            for (aFrame = aNode; aFrame != mRoot; aFrame = aFrame->mParent) {
+                aFrames[aDepth++] = aFrame;
+            }
+            while (aDepth-- > 0) {
+                aFile->write(aFrames[aDepth]->mName.str());
+                aFile->write(aDepth > 0 ? cU(";") : cU(" "));
+            }
+            aFile->write(TString::parseDecimal(aNode->getWeight(aWeight), aBuffer));
+            aFile->write(cU("\n"));
+            aNrLines++;
+        }
+        delete [] aFrames;
+        return aNrLines;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::getNrStacks
+    //! \return The number of distinct stacks
+    // ----------------------------------------------------
+    jlong getNrStacks() {
+        return mNrStacks;
+    }
+    // ----------------------------------------------------
+    // TFoldedStacks::getNrEvents
+    //! \return The number of aggregated events
+    // ----------------------------------------------------
+    jlong getNrEvents() {
+        return mNrEvents;
+    }
+};
+
+// ----------------------------------------------------
+//! \class TClassCache
+//! \brief Persistent decisions of the class rules
+//!
+//! The file is mapped into memory and holds an open addressed
+//! table of class decisions. Each entry is a single 64 bit word
+//! with the upper bits of the class name hash and the flags in the
+//! lower bits, so concurrent class loaders never see a torn entry.
+//! A lost insert only costs a rule evaluation at the next start.
+//! Each entry carries the generation of the rules it was evaluated
+//! with. A change of the rules starts a new generation, so entries of
+//! the previous rules are ignored without clearing the table under
+//! running class loaders. The table is cleared on open if the hash
+//! of the rules differs from the file.
+// ----------------------------------------------------
+#define CLASS_CACHE_MAGIC       "SKCACHE2"  //!< File header
+#define CLASS_CACHE_ENTRIES     262144      //!< Number of entries, power of 2
+#define CLASS_CACHE_PROBES      8           //!< Maximal probes for an entry
+#define CLASS_CACHE_FLAGS       0xFFFF      //!< Flag bits of an entry
+#define CLASS_CACHE_VALID       0x0001      //!< Entry is in use
+#define CLASS_CACHE_EXCLUDED    0x0002      //!< Class is excluded
+#define CLASS_CACHE_PROFILED    0x0004      //!< Class is profiled
+#define CLASS_CACHE_VISIBLE     0x0008      //!< Class is visible
+#define CLASS_CACHE_PLAIN       0x0010      //!< No method rule matches a method of the class
+#define CLASS_CACHE_GENERATION  0xFF00      //!< Generation bits of an entry
+#define CLASS_CACHE_GEN_SHIFT   8           //!< Position of the generation bits
+
+typedef struct {
+    SAP_A7          mMagic[8];      //!< CLASS_CACHE_MAGIC
+    jlong           mRulesHash;     //!< TProperties::getRulesHash of the entries
+    jlong           mSize;          //!< Number of entries
+    volatile jlong  mGeneration;    //!< Generation of valid entries, 1 to 255
+} TClassCacheHeader;
+
+class TClassCache {
+private:
+    static TClassCache *mInstance;  //!< Singleton instance
+    TString         mFileName;      //!< The file name
+    SAP_A7         *mBase;          //!< The mapped file
+    TClassCacheHeader *mHeader;     //!< Header in the mapped file
+    volatile jlong *mEntries;       //!< Entries in the mapped file
+    jlong           mNrHits;        //!< Lookups found in the cache
+    jlong           mNrMisses;      //!< Lookups evaluated by the rules
+    jlong           mNrDropped;     //!< Inserts without free entry
+    bool            mOpen;          //!< File is open and mapped
+#if defined (_WINDOWS)
+    HANDLE          mHandle;        //!< The file handle
+    HANDLE          mMapping;       //!< The mapping of the file
+#else
+    int             mHandle;        //!< The file descriptor
+#endif
+    // ----------------------------------------------------
+    // TClassCache::TClassCache
+    //! Constructor
+    // ----------------------------------------------------
+    TClassCache() {
+        mBase       = NULL;
+        mHeader     = NULL;
+        mEntries    = NULL;
+        mNrHits     = 0;
+        mNrMisses   = 0;
+        mNrDropped  = 0;
+        mOpen       = false;
+#if defined (_WINDOWS)
+        mHandle     = INVALID_HANDLE_VALUE;
+        mMapping    = NULL;
+#else
+        mHandle     = -1;
+#endif
+    }
+    // ----------------------------------------------------
+    // TClassCache::getSize
+    //! \return The size of the file in bytes
+    // ----------------------------------------------------
+    static jlong getSize() {
+        return sizeofR(TClassCacheHeader) + CLASS_CACHE_ENTRIES * sizeofR(jlong);
+    }
+    // ----------------------------------------------------
+    // TClassCache::map
+    //! \brief Open the file and map it
+    //! \return \c FALSE if the file cannot be mapped
+    // ----------------------------------------------------
+    bool map();
+    // ----------------------------------------------------
+    // TClassCache::unmap
+    //! \brief Write the pages to disk, release the mapping
+    //!        and close the file
+    // ----------------------------------------------------
+    void unmap();
+    // ----------------------------------------------------
+    // TClassCache::clear
+    //! \brief Drop all entries
+    //! \param aRulesHash The hash of the rules for new entries
+    // ----------------------------------------------------
+    void clear(jlong aRulesHash) {
+        memsetR(mBase, 0, (size_t)getSize());
+        memcpyR(mHeader->mMagic, CLASS_CACHE_MAGIC, sizeofR(mHeader->mMagic));
+        mHeader->mRulesHash  = aRulesHash;
+        mHeader->mSize       = CLASS_CACHE_ENTRIES;
+        mHeader->mGeneration = 1;
+    }
+    // ----------------------------------------------------
+    // TClassCache::isCurrent
+    //! \param  aEntry The entry
+    //! \return \c TRUE if the entry belongs to the current generation
+    // ----------------------------------------------------
+    bool isCurrent(jlong aEntry) {
+        return ((aEntry & CLASS_CACHE_GENERATION) >> CLASS_CACHE_GEN_SHIFT) == mHeader->mGeneration;
+    }
+    // ----------------------------------------------------
+    // TClassCache::getKey
+    //! \param  aName The class name
+    //! \return The class name hash without the flag bits
+    // ----------------------------------------------------
+    static jlong getKey(const SAP_UC *aName) {
+        return TString::getStableHash(aName) & ~(jlong)CLASS_CACHE_FLAGS;
+    }
+public:
+    // ----------------------------------------------------
+    // TClassCache::getInstance
+    //! Singleton constructor
+    // ----------------------------------------------------
+    static TClassCache *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new TClassCache();
+        }
+        return mInstance;
+    }
+    // ----------------------------------------------------
+    // TClassCache::initialize
+    //! \brief Open the file of the property ClassCache
+    //!
+    //! Entries written with other rules are dropped.
+    //! \return \c FALSE if the cache is disabled or the file
+    //!         cannot be mapped
+    // ----------------------------------------------------
+    bool initialize() {
+        TProperties  *aProperties = TProperties::getInstance();
+        const SAP_UC *aFileName   = aProperties->getClassCache();
+        jlong         aRulesHash  = aProperties->getRulesHash();
+
+        if (mOpen || aFileName == NULL) {
+            return mOpen;
+        }
+        mFileName = aFileName;
+        mOpen     = map();
+        if (!mOpen) {
+            ERROR_OUT(cU("class cache not available"), 0);
+            return false;
+        }
+        if (memcmp(mHeader->mMagic, CLASS_CACHE_MAGIC, sizeofR(mHeader->mMagic)) != 0 ||
+            mHeader->mSize      != CLASS_CACHE_ENTRIES ||
+            mHeader->mRulesHash != aRulesHash ||
+            mHeader->mGeneration < 1 || mHeader->mGeneration > 255) {
+            clear(aRulesHash);
+        }
+        return true;
+    }
+    // ----------------------------------------------------
+    // TClassCache::setRules
+    //! \brief Start a new generation if the rules have changed
+    //!
+    //! Entries of older generations are reset word by word, so a
+    //! generation number is free again when it is reused. Class
+    //! loaders may read and write the table in parallel.
+    //! \param aRulesHash The hash of the current rules
+    // ----------------------------------------------------
+    void setRules(jlong aRulesHash) {
+        if (!mOpen || mHeader->mRulesHash == aRulesHash) {
+            return;
+        }
+        mHeader->mRulesHash  = aRulesHash;
+        mHeader->mGeneration = (mHeader->mGeneration % 255) + 1;
+        MEMORY_BARRIER();
+
+        for (jint i = 0; i < CLASS_CACHE_ENTRIES; i++) {
+            if (mEntries[i] != 0 && !isCurrent(mEntries[i])) {
+                mEntries[i] = 0;
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TClassCache::getGeneration
+    //! \return The generation of the current rules
+    // ----------------------------------------------------
+    jint getGeneration() {
+        jint aGeneration = mOpen ? (jint)mHeader->mGeneration : 0;
+
+        // the rules are read after the generation
+        MEMORY_BARRIER();
+        return aGeneration;
+    }
+    // ----------------------------------------------------
+    // TClassCache::close
+    //! \brief Write the entries to disk and close the file
+    // ----------------------------------------------------
+    void close() {
+        if (!mOpen) {
+            return;
+        }
+        mOpen = false;
+        unmap();
+    }
+    // ----------------------------------------------------
+    // TClassCache::get
+    //! \param  aName The class name
+    //! \return The flags of the class or 0 if not cached with the current rules
+    // ----------------------------------------------------
+    jint get(const SAP_UC *aName) {
+        jlong aKey;
+        jlong aEntry;
+        jint  aPos;
+
+        if (!mOpen) {
+            return 0;
+        }
+        aKey = getKey(aName);
+        aPos = (jint)(aKey >> 16) & (CLASS_CACHE_ENTRIES - 1);
+
+        for (jint i = 0; i < CLASS_CACHE_PROBES; i++) {
+            aEntry = mEntries[(aPos + i) & (CLASS_CACHE_ENTRIES - 1)];
+            if (aEntry == 0) {
+                break;
+            }
+            if ((aEntry & ~(jlong)CLASS_CACHE_FLAGS) == aKey && isCurrent(aEntry)) {
+                mNrHits++;
+                return (jint)(aEntry & CLASS_CACHE_FLAGS & ~CLASS_CACHE_GENERATION);
+            }
+        }
+        mNrMisses++;
+        return 0;
+    }
+    // ----------------------------------------------------
+    // TClassCache::put
+    //! \brief Store the flags of a class
+    //!
+    //! An entry of a generation which has ended meanwhile is ignored
+    //! by get and reset with the next change of the rules.
+    //! \param aName       The class name
+    //! \param aFlags      The flags, CLASS_CACHE_VALID is added
+    //! \param aGeneration The generation of the rules of the decision
+    // ----------------------------------------------------
+    void put(const SAP_UC *aName, jint aFlags, jint aGeneration) {
+        jlong aKey;
+        jlong aEntry;
+        jint  aPos;
+
+        if (!mOpen) {
+            return;
+        }
+        aKey = getKey(aName);
+        aPos = (jint)(aKey >> 16) & (CLASS_CACHE_ENTRIES - 1);
+
+        for (jint i = 0; i < CLASS_CACHE_PROBES; i++) {
+            aEntry = mEntries[(aPos + i) & (CLASS_CACHE_ENTRIES - 1)];
+            if (aEntry == 0 || !isCurrent(aEntry) || (aEntry & ~(jlong)CLASS_CACHE_FLAGS) == aKey) {
+                mEntries[(aPos + i) & (CLASS_CACHE_ENTRIES - 1)] = 
+                    aKey | ((jlong)aGeneration << CLASS_CACHE_GEN_SHIFT) |
+                    ((aFlags | CLASS_CACHE_VALID) & CLASS_CACHE_FLAGS & ~CLASS_CACHE_GENERATION);
+                return;
+            }
+        }
+        mNrDropped++;
+    }
+    // ----------------------------------------------------
+    // TClassCache::dump
+    //! \brief Dump the cache statistic
+    //! \param aRootTag The result tag list
+    // ----------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[32];
+        TXmlTag *aTag;
+        jlong    aNrEntries = 0;
+
+        if (!mOpen) {
+            return;
+        }
+        for (jint i = 0; i < CLASS_CACHE_ENTRIES; i++) {
+            if (mEntries[i] != 0 && isCurrent(mEntries[i])) {
+                aNrEntries++;
+            }
+        }
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ClassCacheEntries"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(aNrEntries, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ClassCacheHits"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrHits, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ClassCacheMisses"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrMisses, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("ClassCacheDropped"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrDropped, aBuffer), PROPERTY_TYPE_INT);
+    }
+};
+
 // ----------------------------------------------------
 //! \class TMemoryBit
 //! \brief Manage a chunk of allocated memory
@@ -71,6 +71,11 @@ using namespace std;
 #  define SAPSOCKLEN_T socklen_t
 #  define USE_SECURE_STR
 #  define ACCESS(x,y)      _access    ((x),(y))
+#  define MEMORY_BARRIER() MemoryBarrier()
+#  define ATOMIC_ADD(p,n)  InterlockedExchangeAdd((volatile LONG *)(p), (n))
+#  define ATOMIC_SWAP(p,v) InterlockedExchangePointer((PVOID volatile *)(p), (v))
+#  define ATOMIC_ADD64(p,n)   InterlockedExchangeAdd64((volatile LONGLONG *)(p), (n))
+#  define ATOMIC_CAS64(p,o,n) (InterlockedCompareExchange64((volatile LONGLONG *)(p), (n), (o)) == (o))
 
 #else
 #  include <sys/time.h>
@@ -82,7 +87,14 @@ using namespace std;
 #  include <signal.h>
 #  include <pthread.h>
 #  include <sys/socket.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
 #  include <dirent.h>
+#  if defined (__linux__)
+#    include <sys/epoll.h>
+#    define USE_EPOLL
+#  endif
 
 #  define GET_SYSTIME(p)
 #  define CLOCK()        clock()
@@ -95,6 +107,11 @@ using namespace std;
 /* #  define NAME_MAX _POSIX_NAME_MAX */
 #  define ACCESS(x,y)    access    ((x),(y))
 #  define CLOSESOCKET(s) ::shutdown(s, 2)
+#  define MEMORY_BARRIER() __sync_synchronize()
+#  define ATOMIC_ADD(p,n)  __sync_fetch_and_add((p), (n))
+#  define ATOMIC_SWAP(p,v) __sync_lock_test_and_set((p), (v))
+#  define ATOMIC_ADD64(p,n)   __sync_fetch_and_add((p), (n))
+#  define ATOMIC_CAS64(p,o,n) __sync_bool_compare_and_swap((p), (o), (n))
 #endif
 
 #if defined   (SAPonNT)
@@ -26,6 +26,7 @@
 SHERLOK_AGENT = sherlok.dll
 SHERLOK_TEST  = profiler.exe
 SHERLOK_CTI   = ctilib.dll
+SHERLOK_DECODE = tracedec.exe
 
 CPPFLAGS = /GS /W3 /Zc:wchar_t /Zi /Gm /Od /sdl /fp:precise -DWIN32 -D_CRT_SECURE_NO_WARNINGS -D_WINSOCK_DEPRECATED_NO_WARNINGS -D_WINDOWS /D "_USRDLL_WINDLL" /D "_UNICODE" /D "UNICODE" /Zc:forScope /RTC1 /Gd /MDd /EHsc /nologo -I$(JAVA_HOME)\include -I$(JAVA_HOME)\include\win32
 
@@ -43,6 +44,12 @@ SHERLOK_TEST_SRC =      \
 SHERLOK_CTI_SRC =       \
         cti.cpp
 
+SHERLOK_DECODE_SRC =    \
+	tracedec.cpp    \
+	cti.cpp         \
+	cjvmti.cpp      \
+	system.cpp   
+
 SYSTEM_LIBS =           \
         Ws2_32.lib      \
         kernel32.lib    \
@@ -61,6 +68,7 @@ SYSTEM_LIBS =           \
 SHERLOK_AGENT_OBJ = $(SHERLOK_AGENT_SRC:.cpp=.obj) 
 SHERLOK_TEST_OBJ  = $(SHERLOK_TEST_SRC:.cpp=.obj) 
 SHERLOK_CTI_OBJ   = $(SHERLOK_CTI_SRC:.cpp=.obj)
+SHERLOK_DECODE_OBJ = $(SHERLOK_DECODE_SRC:.cpp=.obj)
 
 all         : $(SHERLOK_AGENT) $(SHERLOK_TEST) $(SHERLOK_CTI)
 
@@ -74,6 +82,11 @@ $(SHERLOK_CTI)   : $(SHERLOK_CTI_OBJ)
 $(SHERLOK_TEST)  : $(SHERLOK_TEST_OBJ)
 	link /OUT:$(SHERLOK_TEST) $(SHERLOK_TEST_OBJ) $(SYSTEM_LIBS)  /MANIFEST /NXCOMPAT /PDB:profiler.pdb /DEBUG /MACHINE:X64 /INCREMENTAL /SUBSYSTEM:CONSOLE /ManifestFile:"profiler.exe.intermediate.manifest" /ERRORREPORT:PROMPT /NOLOGO 
 
+decoder : $(SHERLOK_DECODE)
+
+$(SHERLOK_DECODE) : $(SHERLOK_DECODE_OBJ)
+	link /OUT:$(SHERLOK_DECODE) $(SHERLOK_DECODE_OBJ) $(SYSTEM_LIBS)  /MANIFEST /NXCOMPAT /PDB:tracedec.pdb /DEBUG /MACHINE:X64 /INCREMENTAL /SUBSYSTEM:CONSOLE /ManifestFile:"tracedec.exe.intermediate.manifest" /ERRORREPORT:PROMPT /NOLOGO 
+
 *.obj:*.cpp
 	$(CPP) $(CPPFLAGS) -c $**
 	
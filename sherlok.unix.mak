@@ -27,6 +27,7 @@ JAVA_PLATFORM = linux
 SHERLOK_AGENT = libsherlok.so
 SHERLOK_TEST  = profiler.exe
 SHERLOK_CTI   = libctilib.so
+SHERLOK_DECODE = tracedec
 
 CPPFLAGS      = -g -fPIC -pthread -Wall -m64 -I$(JAVA_HOME)/include -I$(JAVA_HOME)/include/$(JAVA_PLATFORM)
 
@@ -45,11 +46,19 @@ SHERLOK_TEST_SRC =      \
 SHERLOK_CTI_SRC =       \
         cti.cpp
 
+SHERLOK_DECODE_SRC =    \
+        tracedec.cpp    \
+        cti.cpp         \
+        cjvmti.cpp      \
+        cjvmpi.cpp      \
+        system.cpp
+
 SYSTEM_LIBS   =
 
 SHERLOK_AGENT_OBJ = $(SHERLOK_AGENT_SRC:.cpp=.o)
 SHERLOK_TEST_OBJ  = $(SHERLOK_TEST_SRC:.cpp=.o)
 SHERLOK_CTI_OBJ   = $(SHERLOK_CTI_SRC:.cpp=.o)
+SHERLOK_DECODE_OBJ = $(SHERLOK_DECODE_SRC:.cpp=.o)
 
 all    : $(SHERLOK_AGENT) $(SHERLOK_TEST) $(SHERLOK_CTI)
 
@@ -62,6 +71,11 @@ $(SHERLOK_TEST)  : $(SHERLOK_TEST_OBJ)
 $(SHERLOK_CTI) : $(SHERLOK_CTI_OBJ)
         $(CC) $(CPPFLAGS) -shared -o $(SHERLOK_CTI) $(SHERLOK_CTI_OBJ)
 
+decoder : $(SHERLOK_DECODE)
+
+$(SHERLOK_DECODE) : $(SHERLOK_DECODE_OBJ)
+        $(CC) $(CPPFLAGS) -o $(SHERLOK_DECODE) $(SHERLOK_DECODE_OBJ)
+
 .SUFFIXES: .cpp .o
 .cpp.o:
         $(CC) $(CPPFLAGS) -o $@ -c $<
@@ -106,6 +106,18 @@ public:
     static jlong getDiff(jlong aTime);
     static jlong getDiffHp(jlong aHpTime);
     // ----------------------------------------------------
+    // TSystem::scaleHp
+    //! \brief Convert a difference of high precision timestamps
+    //! \param  aHpDiff The difference of two TSystem::getTimestampHp values
+    //! \return The difference in microseconds
+    // ----------------------------------------------------
+    static jlong scaleHp(jlong aHpDiff);
+    // ----------------------------------------------------
+    // TSystem::getProcessId
+    //! \return The ID of the current process
+    // ----------------------------------------------------
+    static jint getProcessId();
+    // ----------------------------------------------------
     // TSystem::GetCurrentThreadCpuTime
     //! \brief Function used for Common Trace Interface 
     //!
@@ -1360,6 +1372,17 @@ public:
     // ----------------------------------------------------------------
     static SAP_UC* parseHex(jlong aInt, SAP_UC *aBuffer);
     // ----------------------------------------------------------------
+    // TString::parseDecimal
+    //! \brief Creates a plain decimal representation.
+    //!
+    //! In contrast to TString::parseInt the output has no decimal points,
+    //! as required for machine readable formats.
+    //! \param  aInt    The signed integer to parse
+    //! \param  aBuffer The work memory
+    //! \return The pointer to aBuffer
+    // ----------------------------------------------------------------
+    static SAP_UC* parseDecimal(jlong aInt, SAP_UC *aBuffer);
+    // ----------------------------------------------------------------
     // TString::parseBool
     //! \brief Creates a string representation for boolean values.
     //!
@@ -1916,6 +1939,31 @@ public:
         }
         return labs(aHash);
     }
+    // ----------------------------------------------------------------
+    // TString::getStableHash
+    //! \brief  FNV-1a hash, which does not depend on the platform.
+    //!
+    //! The value can be stored in files. Texts are chained by passing
+    //! the result of the previous text as seed.
+    //! \param  aText The text
+    //! \param  aSeed The hash of the preceding texts or 0 to start
+    //! \return The 64 bit hash code
+    // ----------------------------------------------------------------
+    static jlong getStableHash(const SAP_UC *aText, jlong aSeed = 0) {
+        unsigned long long aHash = (unsigned long long)aSeed;
+
+        if (aHash == 0) {
+            aHash = ((unsigned long long)0xCBF29CE4 << 32) | 0x84222325;
+        }
+        if (aText == NULL) {
+            return (jlong)aHash;
+        }
+        for (; *aText != 0; aText++) {
+            aHash ^= (unsigned long long)(unsigned)*aText;
+            aHash *= ((unsigned long long)1 << 40) | 0x1B3;
+        }
+        return (jlong)aHash;
+    }
 };
 
 // ----------------------------------------------------------------
@@ -2360,6 +2408,1048 @@ public:
     }
 };
 
+// ----------------------------------------------------------------
+//! \class TTopList
+//! \brief Selects the elements with the largest keys
+//!
+//! Keeps at most a given number of elements in a min-heap, so the
+//! smallest kept key is replaced if a larger one is inserted. Only
+//! the selected elements have to be formatted for output. Elements
+//! with equal keys are not replaced, so a list without sort key
+//! contains the first inserted elements.
+// ----------------------------------------------------------------
+template <class _Ty> class TTopList {
+private:
+    // ------------------------------------------------
+    //! \struct TTopEntry
+    //! \brief Key and element
+    // ------------------------------------------------
+    struct TTopEntry {
+        jlong   mKey;       //!< The sort key
+        _Ty     mElement;   //!< The element
+    };
+    TTopEntry  *mEntries;   //!< The heap
+    jint        mMaxSize;   //!< Maximal number of elements
+    jint        mSize;      //!< Number of elements
+    jlong       mCount;     //!< Number of inserted elements
+    // ------------------------------------------------
+    // TTopList::TTopList
+    //! Copy constructor
+    // ------------------------------------------------
+    TTopList(const TTopList &) {
+    }
+    // ------------------------------------------------
+    // TTopList::siftDown
+    //! \brief Restore the heap below a position
+    //! \param aPos  The start position
+    //! \param aSize The heap size
+    // ------------------------------------------------
+    void siftDown(jint aPos, jint aSize) {
+        TTopEntry aEntry = mEntries[aPos];
+        jint      aChild;
+
+        while ((aChild = 2 * aPos + 1) < aSize) {
+            if (aChild + 1 < aSize && mEntries[aChild + 1].mKey < mEntries[aChild].mKey) {
+                aChild++;
+            }
+            if (aEntry.mKey <= mEntries[aChild].mKey) {
+                break;
+            }
+            mEntries[aPos] = mEntries[aChild];
+            aPos = aChild;
+        }
+        mEntries[aPos] = aEntry;
+    }
+    // ------------------------------------------------
+    // TTopList::siftUp
+    //! \brief Restore the heap above a position
+    //! \param aPos  The start position
+    // ------------------------------------------------
+    void siftUp(jint aPos) {
+        TTopEntry aEntry = mEntries[aPos];
+        jint      aParent;
+
+        while (aPos > 0) {
+            aParent = (aPos - 1) / 2;
+            if (mEntries[aParent].mKey <= aEntry.mKey) {
+                break;
+            }
+            mEntries[aPos] = mEntries[aParent];
+            aPos = aParent;
+        }
+        mEntries[aPos] = aEntry;
+    }
+public:
+    // ------------------------------------------------
+    // TTopList::TTopList
+    //! \brief Constructor
+    //! \param aMaxSize Maximal number of elements
+    // ------------------------------------------------
+    TTopList(jint aMaxSize) {
+        mMaxSize = max((jint)1, aMaxSize);
+        mEntries = new TTopEntry[mMaxSize];
+        mSize    = 0;
+        mCount   = 0;
+    }
+    // ------------------------------------------------
+    // TTopList::~TTopList
+    //! Destructor
+    // ------------------------------------------------
+    ~TTopList() {
+        delete [] mEntries;
+    }
+    // ------------------------------------------------
+    // TTopList::insert
+    //! \brief Offer an element
+    //! \param aKey     The sort key
+    //! \param aElement The element
+    // ------------------------------------------------
+    void insert(jlong aKey, _Ty aElement) {
+        mCount++;
+        if (mSize < mMaxSize) {
+            mEntries[mSize].mKey     = aKey;
+            mEntries[mSize].mElement = aElement;
+            siftUp(mSize++);
+        }
+        else if (aKey > mEntries[0].mKey) {
+            mEntries[0].mKey     = aKey;
+            mEntries[0].mElement = aElement;
+            siftDown(0, mSize);
+        }
+    }
+    // ------------------------------------------------
+    // TTopList::sort
+    //! \brief Sort the selected elements by descending key
+    //!
+    //! Call once after the last insert.
+    // ------------------------------------------------
+    void sort() {
+        TTopEntry aEntry;
+
+        for (jint i = mSize - 1; i > 0; i--) {
+            aEntry      = mEntries[0];
+            mEntries[0] = mEntries[i];
+            mEntries[i] = aEntry;
+            siftDown(0, i);
+        }
+    }
+    // ------------------------------------------------
+    // TTopList::getSize
+    //! \return The number of selected elements
+    // ------------------------------------------------
+    jint getSize() {
+        return mSize;
+    }
+    // ------------------------------------------------
+    // TTopList::getCount
+    //! \return The number of inserted elements
+    // ------------------------------------------------
+    jlong getCount() {
+        return mCount;
+    }
+    // ------------------------------------------------
+    // TTopList::get
+    //! \param aInx The position in the list
+    //! \return The element at the given position
+    // ------------------------------------------------
+    _Ty get(jint aInx) {
+        return mEntries[aInx].mElement;
+    }
+};
+
+#define TRIE_PREFIX     1       //!< A rule ends here and matches any continuation
+#define TRIE_EXACT      2       //!< A rule ends here and matches only the full name
+// ----------------------------------------------------------------
+//! \class TPrefixTrie
+//! \brief Compiled list of name rules
+//!
+//! A rule "com.sap." matches all names starting with "com.sap", a
+//! rule without wildcard matches the name only, "." matches any name.
+//! These rules are stored in a character trie, so a name is checked
+//! with one walk along its characters. Rules starting with the
+//! wildcard are rare and checked with TString::findWithWildcard.
+//!
+//! TPrefixTrie::compile builds the nodes and the wildcard rules as a
+//! new generation and publishes it with one pointer. The previous
+//! generation is kept until the next compile, so readers never see
+//! released memory or a partly rewritten rule.
+// ----------------------------------------------------------------
+class TPrefixTrie {
+private:
+    // ------------------------------------------------
+    //! One character of a rule
+    // ------------------------------------------------
+    struct TNode {
+        SAP_UC  mChar;                      //!< Character of the edge to this node
+        jint    mChild;                     //!< First child or 0
+        jint    mNext;                      //!< Next sibling or 0
+        jint    mFlags;                     //!< TRIE_PREFIX or TRIE_EXACT
+    };
+    // ------------------------------------------------
+    //! One compiled generation of the rules
+    // ------------------------------------------------
+    struct TRules {
+        TNode   *mNodes;                    //!< Nodes, the root is at index 0
+        TString *mWildcards;                //!< Rules starting with the wildcard
+        jint     mNrWildcards;              //!< Number of rules starting with the wildcard
+    };
+    TRules * volatile mRules;               //!< The published rules
+    TRules         *mRetired;               //!< Rules of the previous compile
+    jint            mNrNodes;               //!< Used nodes
+    jint            mSize;                  //!< Allocated nodes
+    SAP_UC          mWildcard;              //!< The wildcard
+
+    // ------------------------------------------------
+    // TPrefixTrie::TPrefixTrie
+    //! Copy constructor
+    // ------------------------------------------------
+    TPrefixTrie(const TPrefixTrie &) {
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::newRules
+    //! \param aNrWildcards The number of rules starting with the wildcard
+    //! \return An empty generation
+    // ------------------------------------------------
+    TRules *newRules(jint aNrWildcards) {
+        TRules *aRules = new TRules;
+
+        mSize    = 64;
+        mNrNodes = 1;
+        aRules->mNodes       = new TNode[mSize];
+        aRules->mWildcards   = (aNrWildcards > 0) ? new TString[aNrWildcards] : NULL;
+        aRules->mNrWildcards = 0;
+        memsetR(aRules->mNodes, 0, sizeofR(TNode));
+        return aRules;
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::deleteRules
+    //! \param aRules The generation to release
+    // ------------------------------------------------
+    static void deleteRules(TRules *aRules) {
+        if (aRules != NULL) {
+            delete [] aRules->mNodes;
+            delete [] aRules->mWildcards;
+            delete aRules;
+        }
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::isWildcardRule
+    //! \param aRule The rule
+    //! \return \c TRUE if the rule starts with the wildcard
+    // ------------------------------------------------
+    bool isWildcardRule(const SAP_UC *aRule) {
+        return aRule[0] == mWildcard && aRule[1] != cU('\0');
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::addNode
+    //! \param aNodes The nodes in construction
+    //! \param aChar  The character of the edge
+    //! \return The index of the new node
+    // ------------------------------------------------
+    jint addNode(TNode **aNodes, SAP_UC aChar) {
+        TNode *aNewNodes;
+
+        if (mNrNodes == mSize) {
+            mSize    *= 2;
+            aNewNodes = new TNode[mSize];
+            memcpy(aNewNodes, *aNodes, mNrNodes * sizeofR(TNode));
+            delete [] *aNodes;
+            *aNodes   = aNewNodes;
+        }
+        (*aNodes)[mNrNodes].mChar  = aChar;
+        (*aNodes)[mNrNodes].mChild = 0;
+        (*aNodes)[mNrNodes].mNext  = 0;
+        (*aNodes)[mNrNodes].mFlags = 0;
+        return mNrNodes++;
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::insert
+    //! \brief Add a rule without leading wildcard
+    //! \param aNodes The nodes in construction
+    //! \param aRule  The rule
+    // ------------------------------------------------
+    void insert(TNode **aNodes, const SAP_UC *aRule) {
+        jint aLen   = (jint)STRLEN(aRule);
+        jint aFlags = TRIE_EXACT;
+        jint aNode  = 0;
+        jint aChild;
+        jint i;
+
+        if (aLen > 0 && aRule[aLen - 1] == mWildcard) {
+            aFlags = TRIE_PREFIX;
+            aLen--;
+        }
+        for (i = 0; i < aLen; i++) {
+            for (aChild  = (*aNodes)[aNode].mChild;
+                 aChild != 0 && (*aNodes)[aChild].mChar != aRule[i];
+                 aChild  = (*aNodes)[aChild].mNext) {
+            }
+            if (aChild == 0) {
+                aChild = addNode(aNodes, aRule[i]);
+                (*aNodes)[aChild].mNext = (*aNodes)[aNode].mChild;
+                (*aNodes)[aNode].mChild = aChild;
+            }
+            aNode = aChild;
+        }
+        (*aNodes)[aNode].mFlags |= aFlags;
+    }
+public:
+    // ------------------------------------------------
+    // TPrefixTrie::TPrefixTrie
+    //! \brief Constructor
+    //! \param aWildcard The wildcard of the rules
+    // ------------------------------------------------
+    TPrefixTrie(SAP_UC aWildcard = cU('.')) {
+        mWildcard = aWildcard;
+        mRetired  = NULL;
+        mRules    = newRules(0);
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::~TPrefixTrie
+    //! Destructor
+    // ------------------------------------------------
+    ~TPrefixTrie() {
+        deleteRules(mRules);
+        deleteRules(mRetired);
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::compile
+    //! \brief Replace the rules
+    //! \param aValues The rules
+    // ------------------------------------------------
+    void compile(TValues *aValues) {
+        TValues::iterator aPtr;
+        TRules *aRules;
+        jint    aNrWildcards = 0;
+
+        for (aPtr  = aValues->begin();
+             aPtr != aValues->end();
+             aPtr  = aValues->next()) {
+            if (isWildcardRule(*aPtr)) {
+                aNrWildcards++;
+            }
+        }
+        aRules = newRules(aNrWildcards);
+
+        for (aPtr  = aValues->begin();
+             aPtr != aValues->end();
+             aPtr  = aValues->next()) {
+            if (isWildcardRule(*aPtr)) {
+                aRules->mWildcards[aRules->mNrWildcards++] = *aPtr;
+                continue;
+            }
+            insert(&aRules->mNodes, *aPtr);
+        }
+        deleteRules(mRetired);
+        mRetired = mRules;
+        MEMORY_BARRIER();
+        mRules   = aRules;
+    }
+    // ------------------------------------------------
+    // TPrefixTrie::match
+    //! \param aName The name to check
+    //! \return \c TRUE if a rule matches the name
+    // ------------------------------------------------
+    bool match(const SAP_UC *aName) {
+        TRules        *aRules = mRules;
+        TNode         *aNodes = aRules->mNodes;
+        const SAP_UC  *aPtr   = aName;
+        jint           aNode  = 0;
+        jint           i;
+
+        if (aName == NULL) {
+            return false;
+        }
+        for (;;) {
+            if ((aNodes[aNode].mFlags & TRIE_PREFIX) != 0) {
+                return true;
+            }
+            if (*aPtr == cU('\0')) {
+                if ((aNodes[aNode].mFlags & TRIE_EXACT) != 0) {
+                    return true;
+                }
+                break;
+            }
+            for (aNode  = aNodes[aNode].mChild;
+                 aNode != 0 && aNodes[aNode].mChar != *aPtr;
+                 aNode  = aNodes[aNode].mNext) {
+            }
+            if (aNode == 0) {
+                break;
+            }
+            aPtr++;
+        }
+        if (aRules->mNrWildcards > 0) {
+            TString aString(aName);
+            for (i = 0; i < aRules->mNrWildcards; i++) {
+                if (aString.findWithWildcard(aRules->mWildcards[i].str(), mWildcard) != -1) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+#define SNAPSHOT_COLUMNS 6      //!< Number of counters in a snapshot
+// ----------------------------------------------------------------
+//! \class TSnapshot
+//! \brief Counters of an object at the previous delta dump
+//!
+//! The console dumps only the difference to the snapshot of the
+//! same session. The first update of a session sets the baseline.
+// ----------------------------------------------------------------
+class TSnapshot {
+private:
+    jint    mSlot;                          //!< Console session slot
+    jint    mSession;                       //!< Session of the snapshot
+    jlong   mTimestamp;                     //!< Time of the snapshot in ms
+    jlong   mInterval;                      //!< Time since the previous snapshot
+    jlong   mValues[SNAPSHOT_COLUMNS];      //!< Counters at the snapshot
+    jlong   mDeltas[SNAPSHOT_COLUMNS];      //!< Difference to the previous snapshot
+public:
+    TSnapshot *mNext;                       //!< Snapshot of the next used slot
+    // ------------------------------------------------
+    // TSnapshot::TSnapshot
+    //! Constructor
+    // ------------------------------------------------
+    TSnapshot(jint aSlot = 0) {
+        mSlot      = aSlot;
+        mNext      = NULL;
+        mSession   = -1;
+        mTimestamp = 0;
+        mInterval  = 0;
+        memsetR(mValues, 0, sizeofR(mValues));
+        memsetR(mDeltas, 0, sizeofR(mDeltas));
+    }
+    // ------------------------------------------------
+    // TSnapshot::getSlot
+    //! \return The console session slot
+    // ------------------------------------------------
+    jint getSlot() {
+        return mSlot;
+    }
+    // ------------------------------------------------
+    // TSnapshot::isValid
+    //! \param aSession The console session
+    //! \return \c TRUE if the session has a snapshot
+    // ------------------------------------------------
+    bool isValid(jint aSession) {
+        return mSession == aSession;
+    }
+    // ------------------------------------------------
+    // TSnapshot::update
+    //! \brief Take a new snapshot and keep the difference
+    //! \param aSession   The console session
+    //! \param aTimestamp The current time in ms
+    //! \param aValues    The counters indexed by sort column
+    //! \return \c TRUE if a counter changed
+    // ------------------------------------------------
+    bool update(jint aSession, jlong aTimestamp, const jlong *aValues) {
+        bool aValid   = isValid(aSession);
+        bool aChanged = false;
+        int  i;
+
+        for (i = 0; i < SNAPSHOT_COLUMNS; i++) {
+            mDeltas[i] = aValid ? aValues[i] - mValues[i] : 0;
+            mValues[i] = aValues[i];
+            aChanged   = aChanged || (mDeltas[i] != 0);
+        }
+        mInterval  = aValid ? aTimestamp - mTimestamp : 0;
+        mTimestamp = aTimestamp;
+        mSession   = aSession;
+        return aChanged;
+    }
+    // ------------------------------------------------
+    // TSnapshot::getDelta
+    //! \param aCol The sort column
+    //! \return The difference to the previous snapshot
+    // ------------------------------------------------
+    jlong getDelta(int aCol) {
+        if (aCol <= 0 || aCol >= SNAPSHOT_COLUMNS) {
+            return 0;
+        }
+        return mDeltas[aCol];
+    }
+    // ------------------------------------------------
+    // TSnapshot::getRate
+    //! \param aCol The sort column
+    //! \return The difference per second
+    // ------------------------------------------------
+    jlong getRate(int aCol) {
+        if (mInterval <= 0) {
+            return 0;
+        }
+        return getDelta(aCol) * 1000 / mInterval;
+    }
+};
+
+// ----------------------------------------------------------------
+//! \class TSnapshots
+//! \brief Snapshots of an object, one for each used console session slot
+//!
+//! A snapshot is allocated with the first delta dump of a slot,
+//! objects never dumped with delta have no snapshot at all.
+//! A slot reused by a new session starts with a new baseline.
+// ----------------------------------------------------------------
+class TSnapshots {
+private:
+    TSnapshot *mSnapshots;                  //!< List of snapshots of the used slots
+public:
+    // ------------------------------------------------
+    // TSnapshots::TSnapshots
+    //! Constructor
+    // ------------------------------------------------
+    TSnapshots() {
+        mSnapshots = NULL;
+    }
+    // ------------------------------------------------
+    // TSnapshots::~TSnapshots
+    //! Destructor
+    // ------------------------------------------------
+    ~TSnapshots() {
+        TSnapshot *aSnapshot;
+
+        while (mSnapshots != NULL) {
+            aSnapshot  = mSnapshots;
+            mSnapshots = aSnapshot->mNext;
+            delete aSnapshot;
+        }
+    }
+    // ------------------------------------------------
+    // TSnapshots::get
+    //! \param aSlot The console session slot
+    //! \return The snapshot of the slot
+    // ------------------------------------------------
+    TSnapshot *get(jint aSlot) {
+        TSnapshot *aSnapshot;
+
+        for (aSnapshot = mSnapshots; aSnapshot != NULL; aSnapshot = aSnapshot->mNext) {
+            if (aSnapshot->getSlot() == aSlot) {
+                return aSnapshot;
+            }
+        }
+        aSnapshot        = new TSnapshot(aSlot);
+        aSnapshot->mNext = mSnapshots;
+        mSnapshots       = aSnapshot;
+        return aSnapshot;
+    }
+    // ------------------------------------------------
+    // TSnapshots::update
+    //! \brief Take a snapshot of the counters of an object
+    //! \param aSlot      The console session slot
+    //! \param aSession   The console session
+    //! \param aTimestamp The current time in ms
+    //! \param aObject    Object with counters indexed by sort column
+    //! \return \c TRUE if a counter changed since the previous snapshot
+    // ------------------------------------------------
+    template <class _Ty>
+    bool update(jint aSlot, jint aSession, jlong aTimestamp, _Ty *aObject) {
+        jlong aValues[SNAPSHOT_COLUMNS];
+        int   i;
+
+        for (i = 0; i < SNAPSHOT_COLUMNS; i++) {
+            aValues[i] = aObject->compare(i, 0);
+        }
+        return get(aSlot)->update(aSession, aTimestamp, aValues);
+    }
+};
+
+#define SERIES_COLUMNS      32          //!< Maximal number of columns including the time
+#define SERIES_BLOCK        64          //!< Samples per encoded block
+#define SERIES_VARINT       10          //!< Maximal bytes of an encoded value
+// ----------------------------------------------------------------
+//! \class TSeries
+//! \brief Fixed memory ring of sampled counters
+//!
+//! Samples are collected in an open block. A full block is stored
+//! column by column, each value as zigzag varint of the difference
+//! to the previous sample of the column. Column 0 is the time in ms.
+//! Stored blocks are placed into a ring arena, the oldest blocks are
+//! dropped when the arena wraps.
+// ----------------------------------------------------------------
+class TSeries {
+private:
+    // ------------------------------------------------
+    //! Position of a stored block in the arena
+    // ------------------------------------------------
+    struct TBlock {
+        jint    mOffset;                    //!< Start in the arena
+        jint    mLength;                    //!< Encoded bytes
+        jint    mCount;                     //!< Number of samples
+        jlong   mFirst;                     //!< Time of the first sample
+        jlong   mLast;                      //!< Time of the last sample
+    };
+    TString         mNames[SERIES_COLUMNS]; //!< Column names
+    jint            mNrColumns;             //!< Number of columns including the time
+    unsigned char  *mArena;                 //!< Encoded blocks
+    jint            mArenaSize;             //!< Size of the arena in bytes
+    jint            mWrite;                 //!< Next write position in the arena
+    TBlock         *mBlocks;                //!< Ring of stored blocks
+    jint            mMaxBlocks;             //!< Size of the block ring
+    jint            mFirstBlock;            //!< Oldest stored block
+    jint            mNrBlocks;              //!< Number of stored blocks
+    jlong           mOpen[SERIES_COLUMNS][SERIES_BLOCK]; //!< Samples not yet encoded
+    jint            mNrOpen;                //!< Number of samples in the open block
+
+    // ------------------------------------------------
+    // TSeries::getBlock
+    //! \param aInx The index starting with the oldest block
+    //! \return The stored block
+    // ------------------------------------------------
+    TBlock *getBlock(jint aInx) {
+        return &mBlocks[(mFirstBlock + aInx) % mMaxBlocks];
+    }
+    // ------------------------------------------------
+    // TSeries::drop
+    //! \brief Remove the oldest blocks, which overlap the given range
+    //! \param aOffset The start of the range
+    //! \param aLength The size of the range
+    // ------------------------------------------------
+    void drop(jint aOffset, jint aLength) {
+        TBlock *aBlock;
+
+        while (mNrBlocks > 0) {
+            aBlock = getBlock(0);
+            if (mNrBlocks < mMaxBlocks &&
+               (aBlock->mOffset >= aOffset + aLength || 
+                aBlock->mOffset +  aBlock->mLength <= aOffset)) {
+                break;
+            }
+            mFirstBlock = (mFirstBlock + 1) % mMaxBlocks;
+            mNrBlocks --;
+        }
+    }
+    // ------------------------------------------------
+    // TSeries::seal
+    //! \brief Encode the open block into the arena
+    // ------------------------------------------------
+    void seal() {
+        jint            aBound = mNrColumns * mNrOpen * SERIES_VARINT;
+        jint            aCol;
+        jint            i;
+        jlong           aPrev;
+        unsigned char  *aPtr;
+        TBlock         *aBlock;
+
+        if (mNrOpen == 0) {
+            return;
+        }
+        if (mWrite + aBound > mArenaSize) {
+            mWrite = 0;
+        }
+        drop(mWrite, aBound);
+
+        aPtr = mArena + mWrite;
+        for (aCol = 0; aCol < mNrColumns; aCol++) {
+            aPrev = 0;
+            for (i = 0; i < mNrOpen; i++) {
+                aPtr  = putVarint(aPtr, mOpen[aCol][i] - aPrev);
+                aPrev = mOpen[aCol][i];
+            }
+        }
+        aBlock = getBlock(mNrBlocks);
+        aBlock->mOffset = mWrite;
+        aBlock->mLength = (jint)(aPtr - (mArena + mWrite));
+        aBlock->mCount  = mNrOpen;
+        aBlock->mFirst  = mOpen[0][0];
+        aBlock->mLast   = mOpen[0][mNrOpen - 1];
+
+        mWrite  += aBlock->mLength;
+        mNrBlocks++;
+        mNrOpen  = 0;
+    }
+    // ------------------------------------------------
+    // TSeries::putVarint
+    //! \brief Write a zigzag varint
+    //! \param aPtr   The write position
+    //! \param aValue The signed value
+    //! \return The position after the value
+    // ------------------------------------------------
+    static unsigned char *putVarint(unsigned char *aPtr, jlong aValue) {
+        unsigned long long aZigzag = ((unsigned long long)aValue << 1) ^ (unsigned long long)(aValue >> 63);
+
+        while (aZigzag >= 0x80) {
+            *aPtr++ = (unsigned char)(aZigzag | 0x80);
+            aZigzag >>= 7;
+        }
+        *aPtr++ = (unsigned char)aZigzag;
+        return aPtr;
+    }
+    // ------------------------------------------------
+    // TSeries::getVarint
+    //! \brief Read a zigzag varint
+    //! \param aPtr   The read position
+    //! \param aValue After call: The signed value
+    //! \return The position after the value
+    // ------------------------------------------------
+    static const unsigned char *getVarint(const unsigned char *aPtr, jlong *aValue) {
+        unsigned long long aZigzag = 0;
+        int                aShift  = 0;
+
+        do {
+            aZigzag |= (unsigned long long)(*aPtr & 0x7f) << aShift;
+            aShift  += 7;
+        } while (*aPtr++ & 0x80);
+
+        *aValue = (jlong)(aZigzag >> 1) ^ -(jlong)(aZigzag & 1);
+        return aPtr;
+    }
+public:
+    // ------------------------------------------------
+    // TSeries::TSeries
+    //! \brief Constructor
+    //! \param aArenaSize The memory for encoded blocks in bytes
+    // ------------------------------------------------
+    TSeries(jint aArenaSize) {
+        mArenaSize  = max(aArenaSize, 2 * SERIES_COLUMNS * SERIES_BLOCK * SERIES_VARINT);
+        mArena      = new unsigned char[mArenaSize];
+        mMaxBlocks  = mArenaSize / SERIES_BLOCK + 1;
+        mBlocks     = new TBlock[mMaxBlocks];
+        mNrColumns  = 1;
+        mNames[0]   = cU("Time");
+        mWrite      = 0;
+        mFirstBlock = 0;
+        mNrBlocks   = 0;
+        mNrOpen     = 0;
+    }
+    // ------------------------------------------------
+    // TSeries::~TSeries
+    //! Destructor
+    // ------------------------------------------------
+    ~TSeries() {
+        delete [] mArena;
+        delete [] mBlocks;
+    }
+    // ------------------------------------------------
+    // TSeries::addColumn
+    //! \brief Define a column before the first sample
+    //! \param aName The column name
+    //! \return The column index or -1 if the table is full
+    // ------------------------------------------------
+    jint addColumn(const SAP_UC *aName) {
+        if (mNrColumns >= SERIES_COLUMNS) {
+            return -1;
+        }
+        mNames[mNrColumns] = aName;
+        return mNrColumns++;
+    }
+    // ------------------------------------------------
+    // TSeries::add
+    //! \brief Add a sample
+    //! \param aTime   The time in ms
+    //! \param aValues The values of the columns 1 ... n
+    // ------------------------------------------------
+    void add(jlong aTime, const jlong *aValues) {
+        jint aCol;
+
+        mOpen[0][mNrOpen] = aTime;
+        for (aCol = 1; aCol < mNrColumns; aCol++) {
+            mOpen[aCol][mNrOpen] = aValues[aCol - 1];
+        }
+        if (++mNrOpen == SERIES_BLOCK) {
+            seal();
+        }
+    }
+    // ------------------------------------------------
+    // TSeries::getNrColumns
+    //! \return The number of columns including the time
+    // ------------------------------------------------
+    jint getNrColumns() {
+        return mNrColumns;
+    }
+    // ------------------------------------------------
+    // TSeries::getName
+    //! \param aCol The column index
+    //! \return The column name
+    // ------------------------------------------------
+    const SAP_UC *getName(jint aCol) {
+        return mNames[aCol].str();
+    }
+    // ------------------------------------------------
+    // TSeries::getNrBlocks
+    //! \return The number of blocks including the open block
+    // ------------------------------------------------
+    jint getNrBlocks() {
+        return mNrBlocks + 1;
+    }
+    // ------------------------------------------------
+    // TSeries::getLast
+    //! \param aInx The block index, the open block is the last one
+    //! \return The time of the last sample in the block
+    // ------------------------------------------------
+    jlong getLast(jint aInx) {
+        if (aInx == mNrBlocks) {
+            return (mNrOpen > 0) ? mOpen[0][mNrOpen - 1] : 0;
+        }
+        return getBlock(aInx)->mLast;
+    }
+    // ------------------------------------------------
+    // TSeries::decode
+    //! \brief Decode one column of a block
+    //! \param aInx    The block index, the open block is the last one
+    //! \param aCol    The column index
+    //! \param aValues After call: The values, at least SERIES_BLOCK entries
+    //! \return The number of samples
+    // ------------------------------------------------
+    jint decode(jint aInx, jint aCol, jlong *aValues) {
+        const unsigned char *aPtr;
+        TBlock              *aBlock;
+        jlong                aValue;
+        jlong                aPrev = 0;
+        jint                 i;
+
+        if (aInx == mNrBlocks) {
+            memcpyR(aValues, mOpen[aCol], mNrOpen * sizeofR(jlong));
+            return mNrOpen;
+        }
+        aBlock = getBlock(aInx);
+        aPtr   = mArena + aBlock->mOffset;
+
+        // skip the previous columns
+        for (i = aCol * aBlock->mCount; i > 0; i--) {
+            while (*aPtr++ & 0x80);
+        }
+        for (i = 0; i < aBlock->mCount; i++) {
+            aPtr       = getVarint(aPtr, &aValue);
+            aPrev     += aValue;
+            aValues[i] = aPrev;
+        }
+        return aBlock->mCount;
+    }
+    // ------------------------------------------------
+    // TSeries::getNrSamples
+    //! \return The number of samples in the store
+    // ------------------------------------------------
+    jlong getNrSamples() {
+        jlong aSamples = mNrOpen;
+
+        for (jint i = 0; i < mNrBlocks; i++) {
+            aSamples += getBlock(i)->mCount;
+        }
+        return aSamples;
+    }
+    // ------------------------------------------------
+    // TSeries::getNrBytes
+    //! \return The number of encoded bytes in the arena
+    // ------------------------------------------------
+    jlong getNrBytes() {
+        jlong aBytes = 0;
+
+        for (jint i = 0; i < mNrBlocks; i++) {
+            aBytes += getBlock(i)->mLength;
+        }
+        return aBytes;
+    }
+};
+
+#define BLOCK_CODEC_SIZE    (64 * 1024)     //!< Maximal raw size of a block
+#define BLOCK_CODEC_MAGIC   0x425A4C53      //!< Frame header "SLZB"
+#define BLOCK_CODEC_HASH    12              //!< Bits of the match hash
+#define BLOCK_CODEC_HEADER  (3 * sizeofR(jint)) //!< Magic, raw and stored size
+// ----------------------------------------------------------------
+//! \class TBlockCodec
+//! \brief Self-contained LZ4 block compression
+//!
+//! Blocks use the LZ4 block format: a token with literal and match
+//! length, the literals, a two byte offset and the match length
+//! extension. Files consist of frames of a header with magic, raw
+//! size and stored size followed by the block. A stored size equal
+//! to the raw size marks an uncompressed block. Since frames do not
+//! depend on each other a file can be read while it is written.
+// ----------------------------------------------------------------
+class TBlockCodec {
+private:
+    // ------------------------------------------------
+    // TBlockCodec::read32
+    //! \return Four bytes at the given position
+    // ------------------------------------------------
+    static unsigned int read32(const unsigned char *aPtr) {
+        unsigned int aValue;
+        memcpyR(&aValue, aPtr, sizeofR(unsigned int));
+        return aValue;
+    }
+    // ------------------------------------------------
+    // TBlockCodec::writeLength
+    //! \brief Write the extension of a length above 15
+    //! \return The new output position
+    // ------------------------------------------------
+    static unsigned char *writeLength(unsigned char *aOut, jint aLen) {
+        for (aLen -= 15; aLen >= 255; aLen -= 255) {
+            *aOut++ = 255;
+        }
+        *aOut++ = (unsigned char)aLen;
+        return aOut;
+    }
+    // ------------------------------------------------
+    // TBlockCodec::writeSequence
+    //! \brief Write literals and an optional match
+    //! \param aOut      The output position
+    //! \param aLiteral  The literals
+    //! \param aNrLit    The number of literals
+    //! \param aOffset   The match offset or 0 for the last sequence
+    //! \param aMatchLen The match length minus the minimal match
+    //! \return The new output position
+    // ------------------------------------------------
+    static unsigned char *writeSequence(
+            unsigned char       *aOut,
+            const unsigned char *aLiteral,
+            jint                 aNrLit,
+            jint                 aOffset,
+            jint                 aMatchLen) {
+
+        unsigned char *aToken = aOut++;
+
+        *aToken = (unsigned char)(min(aNrLit, (jint)15) << 4);
+        if (aNrLit >= 15) {
+            aOut = writeLength(aOut, aNrLit);
+        }
+        memcpyR(aOut, aLiteral, aNrLit);
+        aOut += aNrLit;
+
+        if (aOffset > 0) {
+            *aOut++  = (unsigned char)(aOffset & 0xFF);
+            *aOut++  = (unsigned char)(aOffset >> 8);
+            *aToken |= (unsigned char)min(aMatchLen, (jint)15);
+            if (aMatchLen >= 15) {
+                aOut = writeLength(aOut, aMatchLen);
+            }
+        }
+        return aOut;
+    }
+    // ------------------------------------------------
+    // TBlockCodec::readLength
+    //! \brief Read the extension of a length of 15
+    //! \return The length or -1 if the input is truncated
+    // ------------------------------------------------
+    static jint readLength(const unsigned char **aIn, const unsigned char *aEnd, jint aLen) {
+        unsigned char aByte;
+
+        if (aLen != 15) {
+            return aLen;
+        }
+        do {
+            if (*aIn >= aEnd) {
+                return -1;
+            }
+            aByte = *(*aIn)++;
+            aLen += aByte;
+        } while (aByte == 255);
+        return aLen;
+    }
+public:
+    // ------------------------------------------------
+    // TBlockCodec::getBound
+    //! \param aLen The raw size
+    //! \return The maximal compressed size
+    // ------------------------------------------------
+    static jint getBound(jint aLen) {
+        return aLen + aLen / 255 + 16;
+    }
+    // ------------------------------------------------
+    // TBlockCodec::compress
+    //! \brief Compress a block
+    //! \param aSrc The raw data
+    //! \param aLen The raw size, at most BLOCK_CODEC_SIZE
+    //! \param aDst The output of at least getBound(aLen) bytes
+    //! \return The compressed size
+    // ------------------------------------------------
+    static jint compress(const SAP_A7 *aSrc, jint aLen, SAP_A7 *aDst) {
+        const unsigned char *aIn     = reinterpret_cast<const unsigned char *>(aSrc);
+        unsigned char       *aOut    = reinterpret_cast<unsigned char *>(aDst);
+        jint                 aTable[1 << BLOCK_CODEC_HASH];
+        jint                 aPos    = 0;
+        jint                 aAnchor = 0;
+        jint                 aRef;
+        jint                 aEnd;
+        unsigned int         aHash;
+        unsigned int         aSeq;
+
+        memsetR(aTable, -1, sizeofR(aTable));
+
+        // the last match starts 12 bytes and ends 5 bytes before the end
+        while (aPos < aLen - 12) {
+            aSeq  = read32(aIn + aPos);
+            aHash = (aSeq * 2654435761U) >> (32 - BLOCK_CODEC_HASH);
+            aRef  = aTable[aHash];
+            aTable[aHash] = aPos;
+
+            if (aRef < 0 || aPos - aRef > 0xFFFF || read32(aIn + aRef) != aSeq) {
+                aPos++;
+                continue;
+            }
+            aEnd = aPos + 4;
+            aRef = aRef + 4;
+            while (aEnd < aLen - 5 && aIn[aEnd] == aIn[aRef]) {
+                aEnd++;
+                aRef++;
+            }
+            aOut    = writeSequence(aOut, aIn + aAnchor, aPos - aAnchor, aEnd - aRef, aEnd - aPos - 4);
+            aPos    = aEnd;
+            aAnchor = aEnd;
+        }
+        aOut = writeSequence(aOut, aIn + aAnchor, aLen - aAnchor, 0, 0);
+        return (jint)(aOut - reinterpret_cast<unsigned char *>(aDst));
+    }
+    // ------------------------------------------------
+    // TBlockCodec::decompress
+    //! \brief Decompress a block
+    //! \param aSrc    The compressed data
+    //! \param aLen    The compressed size
+    //! \param aDst    The output
+    //! \param aDstLen The size of the output
+    //! \return The raw size or -1 if the block is corrupt
+    // ------------------------------------------------
+    static jint decompress(const SAP_A7 *aSrc, jint aLen, SAP_A7 *aDst, jint aDstLen) {
+        const unsigned char *aIn     = reinterpret_cast<const unsigned char *>(aSrc);
+        const unsigned char *aInEnd  = aIn + aLen;
+        unsigned char       *aOut    = reinterpret_cast<unsigned char *>(aDst);
+        unsigned char       *aOutEnd = aOut + aDstLen;
+        const unsigned char *aMatch;
+        jint                 aToken;
+        jint                 aNrLit;
+        jint                 aMatchLen;
+        jint                 aOffset;
+
+        while (aIn < aInEnd) {
+            aToken = *aIn++;
+            aNrLit = readLength(&aIn, aInEnd, aToken >> 4);
+            if (aNrLit < 0 || aNrLit > aInEnd - aIn || aNrLit > aOutEnd - aOut) {
+                return -1;
+            }
+            memcpyR(aOut, aIn, aNrLit);
+            aIn  += aNrLit;
+            aOut += aNrLit;
+
+            // the last sequence has no match
+            if (aIn == aInEnd) {
+                break;
+            }
+            if (aInEnd - aIn < 2) {
+                return -1;
+            }
+            aOffset   = aIn[0] | (aIn[1] << 8);
+            aIn      += 2;
+            aMatchLen = readLength(&aIn, aInEnd, aToken & 0x0F);
+            if (aMatchLen < 0) {
+                return -1;
+            }
+            aMatchLen += 4;
+            if (aOffset == 0 || 
+                aOffset > aOut - reinterpret_cast<unsigned char *>(aDst) ||
+                aMatchLen > aOutEnd - aOut) {
+                return -1;
+            }
+            // the match may overlap the output
+            aMatch = aOut - aOffset;
+            while (aMatchLen-- > 0) {
+                *aOut++ = *aMatch++;
+            }
+        }
+        return (jint)(aOut - reinterpret_cast<unsigned char *>(aDst));
+    }
+};
+
 // -----------------------------------------------------------------
 static const unsigned gHashValue = 999983;
 // -----------------------------------------------------------------
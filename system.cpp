@@ -30,6 +30,7 @@
 #include "tracer.h"
 #include "profiler.h"
 #include "monitor.h"
+#include "heap.h"
 #include "javapi.h"
 
 // ----------------------------------------------------------------
@@ -121,20 +122,33 @@ jlong TSystem::getDiffHp(jlong aHpTime) {
     if (aDiffTime < aHpTime) {
         return 0;
     }
-
+    return scaleHp(aDiffTime - aHpTime);
+};
+// ----------------------------------------------------
+// TSystem::getProcessId
+// ----------------------------------------------------
+jint TSystem::getProcessId() {
+#ifdef _WINDOWS
+    return (jint)GetCurrentProcessId();
+#else
+    return (jint)getpid();
+#endif
+};
+// ----------------------------------------------------
+// TSystem::scaleHp
+// ----------------------------------------------------
+jlong TSystem::scaleHp(jlong aHpDiff) {
     // Output in microseconds
 #ifdef _WINDOWS
     if (mHasHpcTimer) {
-        aDiffTime = (jlong)floor((aDiffTime - aHpTime) * mScale);
+        return (jlong)floor(aHpDiff * mScale);
     }
     else {
-        aDiffTime = (aDiffTime - aHpTime)/10;
+        return aHpDiff/10;
     }
 #else 
-    aDiffTime = (aDiffTime - aHpTime);
+    return aHpDiff;
 #endif
-    return aDiffTime;
-
 };
 
 // ----------------------------------------------------------------
@@ -314,6 +328,433 @@ long TSystem::Execute(const SAP_UC *aCmdLine) {
 }
 
 
+// ----------------------------------------------------
+// TMappedFile::openHandle
+// ----------------------------------------------------
+bool TMappedFile::openHandle(bool aAppend) {
+    jlong aSize = 0;
+
+#ifdef _WINDOWS
+    LARGE_INTEGER aFileSize;
+
+    mHandle = CreateFileA(
+            mFileName.a7_str(), 
+            GENERIC_READ | GENERIC_WRITE, 
+            FILE_SHARE_READ, 
+            NULL,
+            aAppend ? OPEN_ALWAYS : CREATE_ALWAYS, 
+            FILE_ATTRIBUTE_NORMAL, 
+            NULL);
+
+    if (mHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (aAppend && GetFileSizeEx(mHandle, &aFileSize)) {
+        aSize = aFileSize.QuadPart;
+    }
+#else
+    struct stat aStat;
+
+    /*SAPUNICODEOK_LIBFCT*/
+    mHandle = ::open(mFileName.a7_str(), O_RDWR | O_CREAT | (aAppend ? 0 : O_TRUNC), 0644);
+    if (mHandle < 0) {
+        return false;
+    }
+    if (aAppend && fstat(mHandle, &aStat) == 0) {
+        aSize = (jlong)aStat.st_size;
+    }
+#endif
+    mOffset = (aSize / MAPPED_SEGMENT_SIZE) * MAPPED_SEGMENT_SIZE;
+    mPos    = aSize - mOffset;
+    return true;
+}
+// ----------------------------------------------------
+// TMappedFile::closeHandle
+// ----------------------------------------------------
+void TMappedFile::closeHandle() {
+#ifdef _WINDOWS
+    LARGE_INTEGER aSize;
+
+    if (mHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    aSize.QuadPart = mOffset + mPos;
+    SetFilePointerEx(mHandle, aSize, NULL, FILE_BEGIN);
+    SetEndOfFile(mHandle);
+    CloseHandle(mHandle);
+    mHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mHandle < 0) {
+        return;
+    }
+    if (ftruncate(mHandle, (off_t)(mOffset + mPos)) != 0) {
+        ERROR_OUT(cU("truncate mapped file"), errno);
+    }
+    ::close(mHandle);
+    mHandle = -1;
+#endif
+    mOffset = 0;
+    mPos    = 0;
+}
+// ----------------------------------------------------
+// TMappedFile::map
+// ----------------------------------------------------
+bool TMappedFile::map() {
+#ifdef _WINDOWS
+    LARGE_INTEGER aSize;
+    LARGE_INTEGER aOffset;
+
+    aSize.QuadPart   = mOffset + MAPPED_SEGMENT_SIZE;
+    aOffset.QuadPart = mOffset;
+    mMapping = CreateFileMappingA(mHandle, NULL, PAGE_READWRITE, aSize.HighPart, aSize.LowPart, NULL);
+    if (mMapping == NULL) {
+        return false;
+    }
+    mBase = (SAP_A7 *)MapViewOfFile(mMapping, FILE_MAP_WRITE, aOffset.HighPart, aOffset.LowPart, MAPPED_SEGMENT_SIZE);
+    if (mBase == NULL) {
+        CloseHandle(mMapping);
+        mMapping = NULL;
+        return false;
+    }
+#else
+    void *aBase;
+
+    if (ftruncate(mHandle, (off_t)(mOffset + MAPPED_SEGMENT_SIZE)) != 0) {
+        ERROR_OUT(cU("extend mapped file"), errno);
+        return false;
+    }
+    aBase = mmap(NULL, MAPPED_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mHandle, (off_t)mOffset);
+    if (aBase == MAP_FAILED) {
+        ERROR_OUT(cU("map file"), errno);
+        return false;
+    }
+    mBase = (SAP_A7 *)aBase;
+#endif
+    return true;
+}
+// ----------------------------------------------------
+// TMappedFile::unmap
+// ----------------------------------------------------
+void TMappedFile::unmap(bool aSync) {
+    if (mBase == NULL) {
+        return;
+    }
+#ifdef _WINDOWS
+    if (aSync) {
+        FlushViewOfFile(mBase, (SIZE_T)mPos);
+        FlushFileBuffers(mHandle);
+    }
+    UnmapViewOfFile(mBase);
+    CloseHandle(mMapping);
+    mMapping = NULL;
+#else
+    if (aSync) {
+        msync(mBase, (size_t)mPos, MS_SYNC);
+    }
+    munmap(mBase, MAPPED_SEGMENT_SIZE);
+#endif
+    mBase = NULL;
+}
+// ----------------------------------------------------
+// TMappedFile::sync
+// ----------------------------------------------------
+void TMappedFile::sync() {
+    lock();
+    if (!mOpen) {
+        unlock();
+        return;
+    }
+    flushBlock();
+    if (mOpen) {
+#ifdef _WINDOWS
+        FlushViewOfFile(mBase, (SIZE_T)mPos);
+        FlushFileBuffers(mHandle);
+#else
+        msync(mBase, (size_t)mPos, MS_SYNC);
+#endif
+    }
+    unlock();
+}
+// ----------------------------------------------------
+// TMappedFile::rename
+// ----------------------------------------------------
+void TMappedFile::rename(TString *aFrom, TString *aTo) {
+#ifdef _WINDOWS
+    MoveFileExA(aFrom->a7_str(), aTo->a7_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    /*SAPUNICODEOK_LIBFCT*/
+    ::rename(aFrom->a7_str(), aTo->a7_str());
+#endif
+}
+// ----------------------------------------------------
+// TClassCache::map
+// ----------------------------------------------------
+bool TClassCache::map() {
+#ifdef _WINDOWS
+    LARGE_INTEGER aSize;
+
+    mHandle = CreateFileA(
+            mFileName.a7_str(), 
+            GENERIC_READ | GENERIC_WRITE, 
+            FILE_SHARE_READ, 
+            NULL,
+            OPEN_ALWAYS, 
+            FILE_ATTRIBUTE_NORMAL, 
+            NULL);
+
+    if (mHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    aSize.QuadPart = getSize();
+    mMapping = CreateFileMappingA(mHandle, NULL, PAGE_READWRITE, aSize.HighPart, aSize.LowPart, NULL);
+    if (mMapping != NULL) {
+        mBase = (SAP_A7 *)MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)getSize());
+    }
+    if (mBase == NULL) {
+        unmap();
+        return false;
+    }
+#else
+    void *aBase;
+
+    /*SAPUNICODEOK_LIBFCT*/
+    mHandle = ::open(mFileName.a7_str(), O_RDWR | O_CREAT, 0644);
+    if (mHandle < 0) {
+        return false;
+    }
+    if (ftruncate(mHandle, (off_t)getSize()) != 0) {
+        ERROR_OUT(cU("extend class cache"), errno);
+        unmap();
+        return false;
+    }
+    aBase = mmap(NULL, (size_t)getSize(), PROT_READ | PROT_WRITE, MAP_SHARED, mHandle, 0);
+    if (aBase == MAP_FAILED) {
+        ERROR_OUT(cU("map class cache"), errno);
+        unmap();
+        return false;
+    }
+    mBase = (SAP_A7 *)aBase;
+#endif
+    mHeader  = (TClassCacheHeader *)mBase;
+    mEntries = (volatile jlong *)(mBase + sizeofR(TClassCacheHeader));
+    return true;
+}
+// ----------------------------------------------------
+// TClassCache::unmap
+// ----------------------------------------------------
+void TClassCache::unmap() {
+#ifdef _WINDOWS
+    if (mBase != NULL) {
+        FlushViewOfFile(mBase, (SIZE_T)getSize());
+        UnmapViewOfFile(mBase);
+    }
+    if (mMapping != NULL) {
+        CloseHandle(mMapping);
+        mMapping = NULL;
+    }
+    if (mHandle != INVALID_HANDLE_VALUE) {
+        FlushFileBuffers(mHandle);
+        CloseHandle(mHandle);
+        mHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mBase != NULL) {
+        msync(mBase, (size_t)getSize(), MS_SYNC);
+        munmap(mBase, (size_t)getSize());
+    }
+    if (mHandle >= 0) {
+        ::close(mHandle);
+        mHandle = -1;
+    }
+#endif
+    mBase    = NULL;
+    mHeader  = NULL;
+    mEntries = NULL;
+}
+// ----------------------------------------------------
+// TSession::wouldBlock
+// ----------------------------------------------------
+bool TSession::wouldBlock() {
+#ifdef _WINDOWS
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+// ----------------------------------------------------
+// TSession::waitWritable
+// ----------------------------------------------------
+bool TSession::waitWritable(int aTimeout) {
+    fd_set         aWrite;
+    struct timeval aTime;
+
+    FD_ZERO(&aWrite);
+    FD_SET(mSocketFd, &aWrite);
+    aTime.tv_sec  = aTimeout / 1000;
+    aTime.tv_usec = (aTimeout % 1000) * 1000;
+    return ::select((int)mSocketFd + 1, NULL, &aWrite, NULL, &aTime) > 0;
+}
+// ----------------------------------------------------
+// TSession::drain
+// ----------------------------------------------------
+void TSession::drain(jint aLen) {
+    TConsole *aConsole = TConsole::getInstance();
+    bool      aWritable;
+
+    aLen = min(aLen, SESSION_QUEUE_SIZE);
+    for (;;) {
+        flush();
+        if (mState == SESSION_CLOSED || mOutputLen + aLen <= SESSION_QUEUE_SIZE) {
+            return;
+        }
+        mDraining = true;
+        aConsole->unlock();
+        aWritable = waitWritable(SESSION_FLUSH_TIMEOUT);
+        aConsole->lock();
+        mDraining = false;
+        aConsole->notifyDrained();
+
+        if (!aWritable) {
+            mState = SESSION_CLOSED;
+            return;
+        }
+    }
+}
+// ----------------------------------------------------
+// TSession::waitDrained
+// ----------------------------------------------------
+void TSession::waitDrained() {
+    TConsole::getInstance()->waitDrained();
+}
+// ----------------------------------------------------
+// TConsole::setNonBlocking
+// ----------------------------------------------------
+bool TConsole::setNonBlocking(SOCKET aSocket) {
+#ifdef _WINDOWS
+    u_long aMode = 1;
+    return ioctlsocket(aSocket, FIONBIO, &aMode) == 0;
+#else
+    int aFlags = fcntl(aSocket, F_GETFL, 0);
+    return aFlags != -1 && fcntl(aSocket, F_SETFL, aFlags | O_NONBLOCK) != -1;
+#endif
+}
+// ----------------------------------------------------
+// TConsole::closeSocket
+// ----------------------------------------------------
+void TConsole::closeSocket(SOCKET aSocket) {
+    CLOSESOCKET(aSocket);
+#ifndef _WINDOWS
+    ::close(aSocket);
+#endif
+}
+// ----------------------------------------------------
+// TConsole::registerSocket
+// ----------------------------------------------------
+void TConsole::registerSocket(SOCKET aSocket, TSession *aSession, int aMode) {
+#if defined (USE_EPOLL)
+    struct epoll_event aEvent;
+
+    if (mPollFd < 0) {
+        mPollFd = epoll_create(CONSOLE_SESSIONS + 1);
+    }
+    memsetR(&aEvent, 0, sizeofR(aEvent));
+    aEvent.events   = EPOLLIN;
+    aEvent.data.ptr = aSession;
+    if (aSession != NULL && aSession->mPollOut) {
+        aEvent.events |= EPOLLOUT;
+    }
+    switch (aMode) {
+        case CONSOLE_POLL_ADD:
+            epoll_ctl(mPollFd, EPOLL_CTL_ADD, aSocket, &aEvent);
+            break;
+        case CONSOLE_POLL_MOD:
+            epoll_ctl(mPollFd, EPOLL_CTL_MOD, aSocket, &aEvent);
+            break;
+        default:
+            epoll_ctl(mPollFd, EPOLL_CTL_DEL, aSocket, &aEvent);
+            break;
+    }
+#endif
+    // select builds the socket sets on each call
+}
+// ----------------------------------------------------
+// TConsole::wait
+// ----------------------------------------------------
+void TConsole::wait(int aTimeout) {
+    TSession *aSession;
+    int       aCount;
+    int       i;
+#if defined (USE_EPOLL)
+    struct epoll_event aEvents[CONSOLE_SESSIONS + 1];
+
+    if (mPollFd < 0) {
+        usleep(aTimeout * 1000);
+        return;
+    }
+    aCount = epoll_wait(mPollFd, aEvents, CONSOLE_SESSIONS + 1, aTimeout);
+    for (i = 0; i < aCount; i++) {
+        aSession = (TSession *)aEvents[i].data.ptr;
+        if (aSession == NULL) {
+            onAccept();
+            continue;
+        }
+        if ((aEvents[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0) {
+            onReadable(aSession);
+        }
+        if ((aEvents[i].events & EPOLLOUT) != 0) {
+            onWritable(aSession);
+        }
+    }
+#else
+    TSession      *aReady[CONSOLE_SESSIONS];
+    SOCKET         aMax = mSocket;
+    fd_set         aRead;
+    fd_set         aWrite;
+    struct timeval aTime;
+
+    FD_ZERO(&aRead);
+    FD_ZERO(&aWrite);
+    if (mSocket > 0) {
+        FD_SET(mSocket, &aRead);
+    }
+    lock();
+    for (i = 0; i < CONSOLE_SESSIONS; i++) {
+        aReady[i] = NULL;
+        aSession  = mSessions[i];
+        if (aSession == NULL || aSession->mState == SESSION_CLOSED) {
+            continue;
+        }
+        aReady[i] = aSession;
+        FD_SET(aSession->mSocketFd, &aRead);
+        if (aSession->mOutputLen > 0) {
+            FD_SET(aSession->mSocketFd, &aWrite);
+        }
+        aMax = max(aMax, aSession->mSocketFd);
+    }
+    unlock();
+
+    aTime.tv_sec  = aTimeout / 1000;
+    aTime.tv_usec = (aTimeout % 1000) * 1000;
+    aCount = ::select((int)aMax + 1, &aRead, &aWrite, NULL, &aTime);
+    if (aCount <= 0) {
+        return;
+    }
+    if (mSocket > 0 && FD_ISSET(mSocket, &aRead)) {
+        onAccept();
+    }
+    for (i = 0; i < CONSOLE_SESSIONS; i++) {
+        if (aReady[i] == NULL) {
+            continue;
+        }
+        if (FD_ISSET(aReady[i]->mSocketFd, &aRead)) {
+            onReadable(aReady[i]);
+        }
+        if (FD_ISSET(aReady[i]->mSocketFd, &aWrite)) {
+            onWritable(aReady[i]);
+        }
+    }
+#endif
+}
 // ----------------------------------------------------
 // TString::parseInt
 // ----------------------------------------------------
@@ -511,6 +952,27 @@ void TSystem::startup() {
 #   endif
 }
 
+// ----------------------------------------------------
+// TString::parseDecimal
+// ----------------------------------------------------
+SAP_UC *TString::parseDecimal(
+        jlong   aInt, 
+        SAP_UC *aBuffer) {
+
+    int                i      = 0;
+    unsigned long long aValue = (aInt < 0) ? 0 - (unsigned long long)aInt : (unsigned long long)aInt;
+
+    do {
+        aBuffer[i++] = (SAP_UC)(48 + aValue % 10);
+        aValue = aValue / 10;
+    } while (aValue > 0);
+
+    if (aInt < 0) {
+        aBuffer[i++] = cU('-');
+    }
+    aBuffer[i] = 0;
+    return reverse(aBuffer);
+}
 // ----------------------------------------------------
 // TString::parseHex
 // ----------------------------------------------------
@@ -641,14 +1103,26 @@ SAP_UC      TSystem::mBuffer[128];
 
 TMonitor    *TMonitor::mInstance        = NULL;
 TTracer     *TTracer::mInstance         = NULL;
+TTraceBinary *TTraceBinary::mInstance   = NULL;
+TClassCache  *TClassCache::mInstance    = NULL;
 TProperties *TProperties::mInstance     = NULL;
 TLogger     *TLogger::mInstance         = NULL;
+jvmtiEnv     *TMappedFile::mJvmti        = NULL;
+jrawMonitorID TMappedFile::mMonitor      = NULL;
 TConsole    *TConsole::mInstance        = NULL;
 TWriter     *TWriter::mInstance         = NULL;
+TOutputQueue *TOutputQueue::mInstance   = NULL;
+TMetricsServer *TMetricsServer::mInstance = NULL;
 TSecurity   *TSecurity::mInstance       = NULL;
 TCallstack  *TMonitorThread::mGCallstack = new TCallstack(1024);
 jint         TMonitorThread::mGlobalHash = 1;
+volatile jint TMonitorMethod::mEpoch     = 0;
+jint         TMonitorMethod::mResetGeneration = 0;
+jrawMonitorID TMonitorMethod::mResolveMonitor = NULL;
 TCommand    *TCommand::mInstance        = NULL;
+THeapGraph  *THeapGraph::mInstance      = NULL;
+THeapDump   *THeapDump::mInstance       = NULL;
+THeapPath   *THeapPath::mInstance       = NULL;
 
 TThreadList  TMonitorThread::mThreads;
 unsigned int TMonitor::gTransaction     = 1;
@@ -0,0 +1,138 @@
+// -----------------------------------------------------------------
+//
+// Author: Albert Rossmann
+// File  : tracedec.cpp
+// Date  : 18.10.2026
+// Abstract:
+//    Decoder for binary method trace files and compressed
+//    log and trace files
+//
+// Copyright (C) 2015  Albert Zedlitz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// -----------------------------------------------------------------
+#include "cti.h"
+#include "ptypes.h"
+#include "standard.h"
+#include "extended.h"
+#include "console.h"
+#include "tracer.h"
+#include "profiler.h"
+#include "monitor.h"
+
+// ----------------------------------------------------------------
+//! Convert a file written with LogFileCompression=yes to text.
+//! The file may still be written, reading stops at the first
+//! frame which is not complete.
+// ----------------------------------------------------------------
+static bool unpack(const char *aInFile, const char *aOutFile) {
+    ifstream  aIn (aInFile,  ios::in  | ios::binary);
+    ofstream  aOut(aOutFile, ios::out | ios::binary | ios::trunc);
+    jint      aHeader[3];
+    jint      aLen;
+    bool      aResult  = aIn.is_open() && aOut.is_open();
+    SAP_A7   *aPacked  = new SAP_A7[BLOCK_CODEC_SIZE];
+    SAP_A7   *aBlock   = new SAP_A7[BLOCK_CODEC_SIZE];
+
+    while (aResult && aIn.read((char *)aHeader, BLOCK_CODEC_HEADER)) {
+        // the mapped file is zero filled behind the last frame
+        if (aHeader[0] != BLOCK_CODEC_MAGIC) {
+            break;
+        }
+        if (aHeader[1] <= 0 || aHeader[1] > BLOCK_CODEC_SIZE ||
+            aHeader[2] <= 0 || aHeader[2] > aHeader[1]) {
+            aResult = false;
+            break;
+        }
+        if (!aIn.read(aPacked, aHeader[2])) {
+            break;
+        }
+        if (aHeader[2] == aHeader[1]) {
+            aOut.write(aPacked, aHeader[1]);
+            continue;
+        }
+        aLen = TBlockCodec::decompress(aPacked, aHeader[2], aBlock, BLOCK_CODEC_SIZE);
+        if (aLen != aHeader[1]) {
+            aResult = false;
+            break;
+        }
+        aOut.write(aBlock, aLen);
+    }
+    delete [] aPacked;
+    delete [] aBlock;
+    return aResult;
+}
+// ----------------------------------------------------------------
+//! Convert a binary trace file written with "trace add method -b"
+//! or a compressed log or trace file
+//! usage: tracedec [-ascii|-xml|-tree|-unpack] <trace file> <output file>
+// ----------------------------------------------------------------
+int main(int argc, char **argv) {
+    int           i;
+    bool          aUnpack  = false;
+    int           aType    = XMLWRITER_TYPE_LINE;
+    const char   *aInFile  = NULL;
+    const char   *aOutFile = NULL;
+    TMappedFile   aFile;
+    TString       aOutName;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-ascii")) {
+            aType = XMLWRITER_TYPE_LINE;
+        }
+        else if (!strcmp(argv[i], "-xml")) {
+            aType = XMLWRITER_TYPE_XML;
+        }
+        else if (!strcmp(argv[i], "-tree")) {
+            aType = XMLWRITER_TYPE_TREE;
+        }
+        else if (!strcmp(argv[i], "-unpack")) {
+            aUnpack = true;
+        }
+        else if (aInFile == NULL) {
+            aInFile  = argv[i];
+        }
+        else {
+            aOutFile = argv[i];
+        }
+    }
+
+    if (aInFile == NULL || aOutFile == NULL) {
+        cerr << "usage: tracedec [-ascii|-xml|-tree|-unpack] <trace file> <output file>" << endl;
+        return 1;
+    }
+
+    if (aUnpack) {
+        if (!unpack(aInFile, aOutFile)) {
+            cerr << "tracedec: " << aInFile << " is not a valid compressed file" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    aOutName.assignR(aOutFile, strlen(aOutFile));
+    if (!aFile.open(aOutName.str())) {
+        cerr << "tracedec: cannot open " << aOutFile << endl;
+        return 1;
+    }
+    TXmlWriter aWriter(aType, false, &aFile);
+
+    if (!TTraceBinary::decode(aInFile, &aWriter)) {
+        cerr << "tracedec: " << aInFile << " is not a valid trace file" << endl;
+        aFile.close();
+        return 1;
+    }
+    aFile.close();
+    return 0;
+}
@@ -19,6 +19,842 @@
 #define EVENT_TRIGGER    128     //!< Trace trigger
 #define EVENT_VARIABLES  256     //!< Trace variables
 
+#define TRACE_BINARY_SIZE     4096          //!< Records per thread buffer
+#define TRACE_BINARY_MAGIC    0x54524b53    //!< File magic "SKRT"
+#define TRACE_BINARY_VERSION  1             //!< File format version
+#define TRACE_BINARY_ENTER    1             //!< Record for method enter
+#define TRACE_BINARY_EXIT     2             //!< Record for method exit
+#define TRACE_BLOCK_METHOD    'M'           //!< Method definition block
+#define TRACE_BLOCK_THREAD    'T'           //!< Thread definition block
+#define TRACE_BLOCK_EVENTS    'E'           //!< Event block
+
+#define TRACE_METHOD_ENTRY(g,i)     (((jlong)(g) << 32) | (jlong)(unsigned int)(i)) //!< Generation and index of a defined method
+#define TRACE_METHOD_GENERATION(e)  ((jint)((e) >> 32))                             //!< Trace file of a defined method
+#define TRACE_METHOD_INDEX(e)       ((jint)((e) & 0xFFFFFFFF))                      //!< Index of a defined method
+
+#define PERFETTO_PACKET_SIZE       4096     //!< Maximal size of a trace packet
+#define PERFETTO_NAME_SIZE         1024     //!< Maximal length of a name
+#define PERFETTO_NESTING           4        //!< Maximal nesting of messages
+#define PERFETTO_TRACE_PACKET      1        //!< Trace.packet
+#define PERFETTO_PACKET_TIMESTAMP  8        //!< TracePacket.timestamp
+#define PERFETTO_PACKET_SEQUENCE   10       //!< TracePacket.trusted_packet_sequence_id
+#define PERFETTO_PACKET_EVENT      11       //!< TracePacket.track_event
+#define PERFETTO_PACKET_INTERNED   12       //!< TracePacket.interned_data
+#define PERFETTO_PACKET_FLAGS      13       //!< TracePacket.sequence_flags
+#define PERFETTO_PACKET_TRACK      60       //!< TracePacket.track_descriptor
+#define PERFETTO_TRACK_UUID        1        //!< TrackDescriptor.uuid
+#define PERFETTO_TRACK_THREAD      4        //!< TrackDescriptor.thread
+#define PERFETTO_THREAD_PID        1        //!< ThreadDescriptor.pid
+#define PERFETTO_THREAD_TID        2        //!< ThreadDescriptor.tid
+#define PERFETTO_THREAD_NAME       5        //!< ThreadDescriptor.thread_name
+#define PERFETTO_EVENT_TYPE        9        //!< TrackEvent.type
+#define PERFETTO_EVENT_NAME_IID    10       //!< TrackEvent.name_iid
+#define PERFETTO_EVENT_TRACK       11       //!< TrackEvent.track_uuid
+#define PERFETTO_INTERNED_NAME     2        //!< InternedData.event_names
+#define PERFETTO_NAME_IID          1        //!< EventName.iid
+#define PERFETTO_NAME_NAME         2        //!< EventName.name
+#define PERFETTO_SLICE_BEGIN       1        //!< TrackEvent.TYPE_SLICE_BEGIN
+#define PERFETTO_SLICE_END         2        //!< TrackEvent.TYPE_SLICE_END
+#define PERFETTO_SEQ_CLEARED       1        //!< SEQ_INCREMENTAL_STATE_CLEARED
+#define PERFETTO_SEQ_NEEDS_STATE   2        //!< SEQ_NEEDS_INCREMENTAL_STATE
+#define PERFETTO_SEQUENCE_ID       1        //!< The writer thread is the only sequence
+
+// ----------------------------------------------------
+//! \struct TTraceRecord
+//! \brief Fixed size record for binary method trace
+// ----------------------------------------------------
+typedef struct STraceRecord {
+    jlong   mTimestamp;     //!< High precision timestamp
+    jlong   mCpuTime;       //!< CPU time of the call on exit
+    jint    mMethod;        //!< Method index
+    jshort  mDepth;         //!< Stack depth
+    jshort  mEvent;         //!< Enter or exit
+} TTraceRecord;
+
+// ----------------------------------------------------
+//! \class TTraceBuffer
+//! \brief Ring buffer for binary trace records of one thread
+//!
+//! The owning thread is the only writer and the trace writer
+//! thread is the only reader, so no lock is required. If the
+//! ring is full the record is counted as lost.
+// ----------------------------------------------------
+class TTraceBuffer {
+    friend class TTraceBinary;
+private:
+    TTraceRecord    mRecords[TRACE_BINARY_SIZE];  //!< The ring
+    volatile jint   mWrite;         //!< Write position of the owner thread
+    volatile jint   mRead;          //!< Read position of the writer thread
+    volatile bool   mClosed;        //!< Owner thread has terminated
+    jlong           mThreadID;      //!< Thread ID
+    TString         mThreadName;    //!< Thread name
+    jlong           mLost;          //!< Records lost on overflow
+    jlong           mLostWritten;   //!< Lost records already reported
+    TTraceBuffer   *mNext;          //!< Next buffer of the writer
+public:
+    // ----------------------------------------------------
+    // TTraceBuffer::TTraceBuffer
+    //! Constructor
+    //! \param aThreadID   The owner thread
+    //! \param aThreadName The thread name
+    // ----------------------------------------------------
+    TTraceBuffer(jlong aThreadID, const SAP_UC *aThreadName) {
+        mThreadName  = aThreadName;
+        mWrite       = 0;
+        mRead        = 0;
+        mClosed      = false;
+        mThreadID    = aThreadID;
+        mLost        = 0;
+        mLostWritten = 0;
+        mNext        = NULL;
+    }
+    // ----------------------------------------------------
+    // TTraceBuffer::put
+    //! \brief Append a record
+    //! \param aMethod      The method index
+    //! \param aEvent       TRACE_BINARY_ENTER or TRACE_BINARY_EXIT
+    //! \param aDepth       The stack depth
+    //! \param aTimestamp   The high precision timestamp
+    //! \param aCpuTime     The CPU time of the call
+    //! \return \c FALSE if the ring is full
+    // ----------------------------------------------------
+    inline bool put(
+            jint    aMethod,
+            jshort  aEvent,
+            jint    aDepth,
+            jlong   aTimestamp,
+            jlong   aCpuTime) {
+
+        TTraceRecord *aRecord;
+        jint          aNext = (mWrite + 1) % TRACE_BINARY_SIZE;
+
+        if (aNext == mRead) {
+            mLost++;
+            return false;
+        }
+        aRecord             = &mRecords[mWrite];
+        aRecord->mTimestamp = aTimestamp;
+        aRecord->mCpuTime   = aCpuTime;
+        aRecord->mMethod    = aMethod;
+        aRecord->mDepth     = (jshort)aDepth;
+        aRecord->mEvent     = aEvent;
+
+        MEMORY_BARRIER();
+        mWrite = aNext;
+        return true;
+    }
+    // ----------------------------------------------------
+    // TTraceBuffer::close
+    //! \brief Release the buffer to the writer thread
+    // ----------------------------------------------------
+    void close() {
+        MEMORY_BARRIER();
+        mClosed = true;
+    }
+};
+
+// ----------------------------------------------------
+//! \class TTracePacket
+//! \brief Encoder for one Perfetto trace packet
+//!
+//! The packet is encoded as protobuf field "packet" of the
+//! Perfetto "Trace" message, so packets can be appended to
+//! the file one by one. Nested messages reserve four bytes
+//! for the length, which is patched as redundant varint when
+//! the message is complete.
+// ----------------------------------------------------
+class TTracePacket {
+private:
+    unsigned char   mData[PERFETTO_PACKET_SIZE];    //!< Encoded packet
+    jint            mStack[PERFETTO_NESTING];       //!< Length positions of open messages
+    jint            mLen;                           //!< Encoded bytes
+    jint            mDepth;                         //!< Open messages
+    // ----------------------------------------------------
+    // TTracePacket::putVarint
+    //! \brief Append a base 128 varint
+    //! \param aValue The value
+    // ----------------------------------------------------
+    void putVarint(jlong aValue) {
+        unsigned long long aBits = (unsigned long long)aValue;
+
+        while (aBits >= 0x80 && mLen < PERFETTO_PACKET_SIZE) {
+            mData[mLen++] = (unsigned char)(aBits | 0x80);
+            aBits >>= 7;
+        }
+        if (mLen < PERFETTO_PACKET_SIZE) {
+            mData[mLen++] = (unsigned char)aBits;
+        }
+    }
+public:
+    // ----------------------------------------------------
+    // TTracePacket::TTracePacket
+    //! Constructor
+    // ----------------------------------------------------
+    TTracePacket() {
+        mLen   = 0;
+        mDepth = 0;
+    }
+    // ----------------------------------------------------
+    // TTracePacket::begin
+    //! \brief Start a new trace packet on the writer sequence
+    //! \param aFlags The sequence flags
+    // ----------------------------------------------------
+    void begin(jint aFlags) {
+        mLen   = 0;
+        mDepth = 0;
+        beginMessage(PERFETTO_TRACE_PACKET);
+        addVarint(PERFETTO_PACKET_SEQUENCE, PERFETTO_SEQUENCE_ID);
+        if (aFlags != 0) {
+            addVarint(PERFETTO_PACKET_FLAGS, aFlags);
+        }
+    }
+    // ----------------------------------------------------
+    // TTracePacket::addVarint
+    //! \brief Append an integer field
+    //! \param aField The field number
+    //! \param aValue The value
+    // ----------------------------------------------------
+    void addVarint(jint aField, jlong aValue) {
+        putVarint(aField << 3);
+        putVarint(aValue);
+    }
+    // ----------------------------------------------------
+    // TTracePacket::addString
+    //! \brief Append a string field
+    //!
+    //! Names are truncated to PERFETTO_NAME_SIZE characters
+    //! \param aField The field number
+    //! \param aValue The value
+    // ----------------------------------------------------
+    void addString(jint aField, const SAP_UC *aValue) {
+        TString        aString(aValue);
+        const SAP_A7  *aChars = aString.a7_str();
+        jint           aSize  = (jint)strlen(aChars);
+
+        aSize = min(aSize, PERFETTO_NAME_SIZE);
+        if (mLen + aSize + 8 > PERFETTO_PACKET_SIZE) {
+            return;
+        }
+        putVarint((aField << 3) | 2);
+        putVarint(aSize);
+        memcpy(mData + mLen, aChars, aSize);
+        mLen += aSize;
+    }
+    // ----------------------------------------------------
+    // TTracePacket::beginMessage
+    //! \brief Open a nested message field
+    //! \param aField The field number
+    // ----------------------------------------------------
+    void beginMessage(jint aField) {
+        if (mDepth >= PERFETTO_NESTING || mLen + 8 > PERFETTO_PACKET_SIZE) {
+            return;
+        }
+        putVarint((aField << 3) | 2);
+        mStack[mDepth++] = mLen;
+        mLen += 4;
+    }
+    // ----------------------------------------------------
+    // TTracePacket::endMessage
+    //! \brief Close the innermost nested message
+    // ----------------------------------------------------
+    void endMessage() {
+        jint aPos;
+        jint aSize;
+
+        if (mDepth == 0) {
+            return;
+        }
+        aPos  = mStack[--mDepth];
+        aSize = mLen - aPos - 4;
+        mData[aPos]     = (unsigned char)(( aSize        & 0x7f) | 0x80);
+        mData[aPos + 1] = (unsigned char)(((aSize >> 7)  & 0x7f) | 0x80);
+        mData[aPos + 2] = (unsigned char)(((aSize >> 14) & 0x7f) | 0x80);
+        mData[aPos + 3] = (unsigned char)( (aSize >> 21) & 0x7f);
+    }
+    // ----------------------------------------------------
+    // TTracePacket::write
+    //! \brief Close all messages and write the packet
+    //! \param aFile The trace file
+    // ----------------------------------------------------
+    void write(ofstream &aFile) {
+        while (mDepth > 0) {
+            endMessage();
+        }
+        aFile.write((const char *)mData, mLen);
+    }
+};
+
+// ----------------------------------------------------
+//! \class TTraceBinary
+//! \brief Writer for binary method trace files
+//!
+//! Traced threads append fixed size records to their own
+//! TTraceBuffer. The writer thread drains all buffers to the
+//! trace file. Methods and threads are written as definition
+//! blocks on first use, so the events only carry indices.
+//! The file is turned into text or XML by the trace decoder.
+//!
+//! Alternatively the writer streams the records as Perfetto
+//! track events: each thread is a track, enter and exit are
+//! slices, and method names are interned with the method index.
+//! Such files are loaded directly by the Perfetto UI.
+// ----------------------------------------------------
+class TTraceBinary {
+private:
+    static TTraceBinary *mInstance;     //!< Singleton
+    jvmtiEnv        *mJvmti;            //!< Tool interface for the monitor
+    jrawMonitorID    mMonitor;          //!< Sync with writer thread
+    ofstream         mFile;             //!< Trace file
+    TTraceBuffer    *mBuffers;          //!< Buffers of traced threads
+    TProperties     *mProperties;       //!< Configuration
+    jint             mGeneration;       //!< Incremented for each file
+    jint             mNrMethods;        //!< Defined methods in the file
+    jlong            mNrRecords;        //!< Records written
+    jlong            mNrLost;           //!< Records lost
+    volatile bool    mActive;           //!< Trace file is open
+    bool             mPerfetto;         //!< Write Perfetto trace packets
+    bool             mCleared;          //!< Perfetto sequence has been started
+    jlong            mStartHp;          //!< High precision time at open
+    jlong            mStartTime;        //!< Time at open in microseconds
+    TTracePacket     mPacket;           //!< Perfetto packet encoder
+    // ----------------------------------------------------
+    // TTraceBinary::TTraceBinary
+    //! Constructor
+    // ----------------------------------------------------
+    TTraceBinary() {
+        mProperties = TProperties::getInstance();
+        mJvmti      = NULL;
+        mMonitor    = NULL;
+        mBuffers    = NULL;
+        mGeneration = 0;
+        mNrMethods  = 0;
+        mNrRecords  = 0;
+        mNrLost     = 0;
+        mActive     = false;
+        mPerfetto   = false;
+        mCleared    = false;
+        mStartHp    = 0;
+        mStartTime  = 0;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::TTraceBinary
+    //! Copy constructor
+    // ----------------------------------------------------
+    TTraceBinary(const TTraceBinary &) {
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::writeString
+    //! \brief Write a length prefixed string
+    //! \param aString The string
+    // ----------------------------------------------------
+    void writeString(const SAP_UC *aString) {
+        TString aValue(aString);
+        jint    aLen = (jint)STRLEN(aString);
+
+        mFile.write((const char *)&aLen, sizeof(jint));
+        mFile.write((const char *)aValue.a7_str(), aLen);
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::writeThread
+    //! \brief Write the thread definition block
+    //! \param aBuffer The thread buffer
+    // ----------------------------------------------------
+    void writeThread(TTraceBuffer *aBuffer) {
+        jint aType = TRACE_BLOCK_THREAD;
+
+        if (mPerfetto) {
+            beginPacket(0);
+            mPacket.beginMessage(PERFETTO_PACKET_TRACK);
+            mPacket.addVarint(PERFETTO_TRACK_UUID, aBuffer->mThreadID + 1);
+            mPacket.beginMessage(PERFETTO_TRACK_THREAD);
+            mPacket.addVarint(PERFETTO_THREAD_PID,  TSystem::getProcessId());
+            mPacket.addVarint(PERFETTO_THREAD_TID,  (jint)aBuffer->mThreadID);
+            mPacket.addString(PERFETTO_THREAD_NAME, aBuffer->mThreadName.str());
+            mPacket.write(mFile);
+            return;
+        }
+        mFile.write((const char *)&aType,             sizeof(jint));
+        mFile.write((const char *)&aBuffer->mThreadID, sizeof(jlong));
+        writeString(aBuffer->mThreadName.str());
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::beginPacket
+    //! \brief Start a Perfetto packet
+    //!
+    //! The first packet of a file clears the incremental state,
+    //! so the interned method names of the file start from scratch.
+    //! \param aFlags The sequence flags
+    // ----------------------------------------------------
+    void beginPacket(jint aFlags) {
+        if (!mCleared) {
+            aFlags  |= PERFETTO_SEQ_CLEARED;
+            mCleared = true;
+        }
+        mPacket.begin(aFlags);
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::writeEvents
+    //! \brief Write the records of a thread as Perfetto slices
+    //! \param aBuffer The thread buffer
+    //! \param aCount  The number of records from the read position
+    // ----------------------------------------------------
+    void writeEvents(TTraceBuffer *aBuffer, jint aCount) {
+        TTraceRecord *aRecord;
+        jint          i;
+
+        for (i = 0; i < aCount; i++) {
+            aRecord = &aBuffer->mRecords[(aBuffer->mRead + i) % TRACE_BINARY_SIZE];
+
+            beginPacket(PERFETTO_SEQ_NEEDS_STATE);
+            mPacket.addVarint(PERFETTO_PACKET_TIMESTAMP, 
+                    1000 * (mStartTime + TSystem::scaleHp(aRecord->mTimestamp - mStartHp)));
+            mPacket.beginMessage(PERFETTO_PACKET_EVENT);
+            mPacket.addVarint(PERFETTO_EVENT_TRACK, aBuffer->mThreadID + 1);
+            if (aRecord->mEvent == TRACE_BINARY_ENTER) {
+                mPacket.addVarint(PERFETTO_EVENT_TYPE,     PERFETTO_SLICE_BEGIN);
+                mPacket.addVarint(PERFETTO_EVENT_NAME_IID, aRecord->mMethod);
+            }
+            else {
+                mPacket.addVarint(PERFETTO_EVENT_TYPE,     PERFETTO_SLICE_END);
+            }
+            mPacket.write(mFile);
+        }
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::readString
+    //! \brief Read a length prefixed string
+    //! \param aFile   The input stream
+    //! \param aString The result
+    //! \return \c FALSE on a corrupted file
+    // ----------------------------------------------------
+    static bool readString(ifstream &aFile, TString *aString) {
+        jint  aLen = 0;
+        char *aBuffer;
+
+        aFile.read((char *)&aLen, sizeof(jint));
+        if (!aFile || aLen < 0 || aLen > 0x10000) {
+            return false;
+        }
+        aBuffer = new char[aLen + 1];
+        aFile.read(aBuffer, aLen);
+        aString->assignR(aBuffer, aLen);
+        delete [] aBuffer;
+        return !aFile.fail();
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::flush
+    //! \brief Drain all buffers to the trace file
+    //!
+    //! Must be called with the monitor held. Buffers of
+    //! terminated threads are deleted once drained.
+    // ----------------------------------------------------
+    void flush() {
+        TTraceBuffer  *aBuffer;
+        TTraceBuffer **aLink;
+        jint           aWrite;
+        jint           aCount;
+        jint           aType = TRACE_BLOCK_EVENTS;
+        jlong          aLost;
+        bool           aClosed;
+
+        aLink = &mBuffers;
+        while ((aBuffer = *aLink) != NULL) {
+            aClosed = aBuffer->mClosed;
+            MEMORY_BARRIER();
+            aWrite  = aBuffer->mWrite;
+            aCount  = (aWrite - aBuffer->mRead + TRACE_BINARY_SIZE) % TRACE_BINARY_SIZE;
+            aLost   = aBuffer->mLost - aBuffer->mLostWritten;
+
+            if (aCount > 0 && mActive && mPerfetto) {
+                // Lost records are only counted, the slices of
+                // the Perfetto trace have no marker for gaps
+                writeEvents(aBuffer, aCount);
+                mNrRecords += aCount;
+                mNrLost    += aLost;
+            }
+            else if ((aCount > 0 || aLost > 0) && mActive && !mPerfetto) {
+                mFile.write((const char *)&aType,             sizeof(jint));
+                mFile.write((const char *)&aBuffer->mThreadID, sizeof(jlong));
+                mFile.write((const char *)&aCount,            sizeof(jint));
+                mFile.write((const char *)&aLost,             sizeof(jlong));
+
+                // The records may wrap around the end of the ring
+                if (aBuffer->mRead + aCount > TRACE_BINARY_SIZE) {
+                    mFile.write((const char *)&aBuffer->mRecords[aBuffer->mRead], 
+                                (TRACE_BINARY_SIZE - aBuffer->mRead) * sizeof(TTraceRecord));
+                    mFile.write((const char *)&aBuffer->mRecords[0], 
+                                aWrite * sizeof(TTraceRecord));
+                }
+                else {
+                    mFile.write((const char *)&aBuffer->mRecords[aBuffer->mRead], 
+                                aCount * sizeof(TTraceRecord));
+                }
+                mNrRecords += aCount;
+                mNrLost    += aLost;
+            }
+            aBuffer->mLostWritten += aLost;
+            MEMORY_BARRIER();
+            aBuffer->mRead = aWrite;
+
+            if (aClosed) {
+                *aLink = aBuffer->mNext;
+                delete aBuffer;
+            }
+            else {
+                aLink = &aBuffer->mNext;
+            }
+        }
+        if (mActive) {
+            mFile.flush();
+        }
+    }
+public:
+    // ----------------------------------------------------
+    // TTraceBinary::getInstance
+    //! Singleton constructor
+    // ----------------------------------------------------
+    static TTraceBinary *getInstance() {
+        if (mInstance == NULL) {
+            mInstance = new TTraceBinary();
+        }
+        return mInstance;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::initialize
+    //! \brief Create the monitor for the writer thread
+    //! \param aJvmti The Java tool interface
+    // ----------------------------------------------------
+    void initialize(jvmtiEnv *aJvmti) {
+        if (mMonitor == NULL) {
+            mJvmti = aJvmti;
+            mJvmti->CreateRawMonitor(/*SAPUNICODEOK_CHARTYPE*/(char*)cR("_TraceBinary"), &mMonitor);
+        }
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::isActive
+    //! \return \c TRUE if the trace file is open
+    // ----------------------------------------------------
+    inline bool isActive() {
+        return mActive;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::getGeneration
+    //! \return The generation of the current trace file
+    // ----------------------------------------------------
+    inline jint getGeneration() {
+        return mGeneration;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::open
+    //! \brief Create the trace file
+    //! \param aFileName The file name relative to the profiler path
+    //! \param aPerfetto Write Perfetto trace packets instead of records
+    //! \return \c TRUE on success
+    // ----------------------------------------------------
+    bool open(const SAP_UC *aFileName, bool aPerfetto = false) {
+        TTraceBuffer *aBuffer;
+        TString       aFile;
+        jint    aMagic   = TRACE_BINARY_MAGIC;
+        jint    aVersion = TRACE_BINARY_VERSION;
+        jlong   aTime    = TSystem::getTimestamp();
+
+        if (mMonitor == NULL) {
+            return false;
+        }
+        close();
+
+        mJvmti->RawMonitorEnter(mMonitor);
+        aFile.concat(mProperties->getPath());
+        aFile.concat(FILESEPARATOR);
+        aFile.concat(aFileName);
+        mFile.open(aFile.a7_str(), ios::out | ios::binary | ios::trunc);
+
+        if (mFile.is_open()) {
+            mPerfetto  = aPerfetto;
+            mCleared   = false;
+            mStartHp   = TSystem::getTimestampHp();
+            mStartTime = 1000 * aTime;
+
+            if (!mPerfetto) {
+                mFile.write((const char *)&aMagic,   sizeof(jint));
+                mFile.write((const char *)&aVersion, sizeof(jint));
+                mFile.write((const char *)&aTime,    sizeof(jlong));
+            }
+            mGeneration++;
+            mNrMethods = 0;
+            mNrRecords = 0;
+            mNrLost    = 0;
+            mActive    = true;
+
+            // Discard old records, threads keep their buffers
+            for (aBuffer  = mBuffers;
+                 aBuffer != NULL;
+                 aBuffer  = aBuffer->mNext) {
+                aBuffer->mRead        = aBuffer->mWrite;
+                aBuffer->mLostWritten = aBuffer->mLost;
+                writeThread(aBuffer);
+            }
+        }
+        mJvmti->RawMonitorExit(mMonitor);
+        return mActive;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::close
+    //! \brief Drain all buffers and close the trace file
+    // ----------------------------------------------------
+    void close() {
+        if (mMonitor == NULL || !mActive) {
+            return;
+        }
+        mJvmti->RawMonitorEnter(mMonitor);
+        flush();
+        mActive = false;
+        mFile.close();
+        mJvmti->RawMonitorExit(mMonitor);
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::attach
+    //! \brief Create the buffer for a traced thread
+    //! \param aThreadID    The thread ID
+    //! \param aThreadName  The thread name
+    //! \return The buffer, released by TTraceBuffer::close
+    // ----------------------------------------------------
+    TTraceBuffer *attach(
+            jlong           aThreadID,
+            const SAP_UC   *aThreadName) {
+
+        TTraceBuffer *aBuffer = new TTraceBuffer(aThreadID, aThreadName);
+
+        mJvmti->RawMonitorEnter(mMonitor);
+        aBuffer->mNext = mBuffers;
+        mBuffers       = aBuffer;
+
+        if (mActive) {
+            writeThread(aBuffer);
+        }
+        mJvmti->RawMonitorExit(mMonitor);
+        return aBuffer;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::defineMethod
+    //! \brief Assign an index to a method
+    //! \param aClassName   The class name
+    //! \param aMethodName  The method name
+    //! \return The method index for the trace records
+    // ----------------------------------------------------
+    jint defineMethod(
+            const SAP_UC   *aClassName,
+            const SAP_UC   *aMethodName) {
+
+        jint aIndex;
+        jint aType = TRACE_BLOCK_METHOD;
+
+        mJvmti->RawMonitorEnter(mMonitor);
+        aIndex = ++mNrMethods;
+        if (mActive && mPerfetto) {
+            TString aName(aClassName);
+            aName.concat(cU("."));
+            aName.concat(aMethodName);
+
+            beginPacket(PERFETTO_SEQ_NEEDS_STATE);
+            mPacket.beginMessage(PERFETTO_PACKET_INTERNED);
+            mPacket.beginMessage(PERFETTO_INTERNED_NAME);
+            mPacket.addVarint(PERFETTO_NAME_IID,  aIndex);
+            mPacket.addString(PERFETTO_NAME_NAME, aName.str());
+            mPacket.write(mFile);
+        }
+        else if (mActive) {
+            mFile.write((const char *)&aType,  sizeof(jint));
+            mFile.write((const char *)&aIndex, sizeof(jint));
+            writeString(aClassName);
+            writeString(aMethodName);
+        }
+        mJvmti->RawMonitorExit(mMonitor);
+        return aIndex;
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::defineMethod
+    //! \brief Assign an index to a method once per trace file
+    //!
+    //! The entry is checked and written under the writer monitor,
+    //! so a method is defined only once. Readers see the generation
+    //! and the index together in one word.
+    //! \param aEntry       The entry of the method, see TRACE_METHOD_ENTRY
+    //! \param aClassName   The class name
+    //! \param aMethodName  The method name
+    //! \return The method index for the trace records
+    // ----------------------------------------------------
+    jint defineMethod(
+            volatile jlong *aEntry,
+            const SAP_UC   *aClassName,
+            const SAP_UC   *aMethodName) {
+
+        jlong aValue;
+
+        mJvmti->RawMonitorEnter(mMonitor);
+        aValue = *aEntry;
+        if (TRACE_METHOD_GENERATION(aValue) != mGeneration) {
+            aValue  = TRACE_METHOD_ENTRY(mGeneration, defineMethod(aClassName, aMethodName));
+            MEMORY_BARRIER();
+            *aEntry = aValue;
+        }
+        mJvmti->RawMonitorExit(mMonitor);
+        return TRACE_METHOD_INDEX(aValue);
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::run
+    //! \brief Writer thread loop
+    //!
+    //! Drains the thread buffers every 100 ms
+    // ----------------------------------------------------
+    void run() {
+        for (;;) {
+            mJvmti->RawMonitorEnter(mMonitor);
+            mJvmti->RawMonitorWait(mMonitor, 100);
+            flush();
+            mJvmti->RawMonitorExit(mMonitor);
+        }
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::dump
+    //! \brief Dump writer state
+    //! \param aRootTag The output tag list
+    // ----------------------------------------------------
+    void dump(TXmlTag *aRootTag) {
+        SAP_UC   aBuffer[32];
+        TXmlTag *aTag;
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("TraceRecords"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrRecords, aBuffer), PROPERTY_TYPE_INT);
+
+        aTag = aRootTag->addTag(cU("Monitor"));
+        aTag->addAttribute(cU("Name"),  cU("TraceLost"));
+        aTag->addAttribute(cU("Value"), TString::parseInt(mNrLost, aBuffer), PROPERTY_TYPE_INT);
+    }
+    // ----------------------------------------------------
+    // TTraceBinary::decode
+    //! \brief Convert a binary trace file to the trace output
+    //!
+    //! Each record is printed as "Trace" tag with the attributes
+    //! of the method trace.
+    //! \param aFileName    The binary trace file
+    //! \param aWriter      The formatter
+    //! \return \c FALSE if the file could not be read
+    // ----------------------------------------------------
+    static bool decode(
+            const char     *aFileName,
+            TXmlWriter     *aWriter) {
+
+        ifstream      aFile;
+        TTraceRecord  aRecord;
+        TString      *aNames    = NULL;
+        TString      *aTmp;
+        TString       aThreadName;
+        jint          aSize     = 0;
+        jint          aNewSize;
+        jint          aMagic    = 0;
+        jint          aVersion  = 0;
+        jint          aType;
+        jint          aIndex;
+        jint          aCount;
+        jint          i;
+        jlong         aTime;
+        jlong         aThreadID;
+        jlong         aLost;
+        bool          aResult   = true;
+        SAP_UC        aBuffer[128];
+
+        aFile.open(aFileName, ios::in | ios::binary);
+        aFile.read((char *)&aMagic,   sizeof(jint));
+        aFile.read((char *)&aVersion, sizeof(jint));
+        aFile.read((char *)&aTime,    sizeof(jlong));
+
+        if (!aFile || aMagic != TRACE_BINARY_MAGIC || aVersion != TRACE_BINARY_VERSION) {
+            return false;
+        }
+
+        while (aResult && aFile.read((char *)&aType, sizeof(jint))) {
+            switch (aType) {
+                case TRACE_BLOCK_METHOD:
+                    aFile.read((char *)&aIndex, sizeof(jint));
+                    if (!aFile || aIndex <= 0) {
+                        aResult = false;
+                        break;
+                    }
+                    // Class and method name at 2*index and 2*index+1
+                    if (aIndex >= aSize) {
+                        aNewSize = max(aIndex + 1, 2 * aSize);
+                        aTmp     = new TString[2 * aNewSize];
+                        for (i = 0; i < 2 * aSize; i++) {
+                            aTmp[i] = aNames[i].str();
+                        }
+                        delete [] aNames;
+                        aNames = aTmp;
+                        aSize  = aNewSize;
+                    }
+                    aResult = readString(aFile, &aNames[2 * aIndex]) && 
+                              readString(aFile, &aNames[2 * aIndex + 1]);
+                    break;
+
+                case TRACE_BLOCK_THREAD:
+                    aFile.read((char *)&aThreadID, sizeof(jlong));
+                    aResult = readString(aFile, &aThreadName);
+                    if (aResult) {
+                        TXmlTag aTag(cU("Trace"));
+                        aTag.addAttribute(cU("Type"),       cU("Thread"));
+                        aTag.addAttribute(cU("ThreadId"),   TString::parseHex(aThreadID, aBuffer));
+                        aTag.addAttribute(cU("ThreadName"), aThreadName.str());
+                        aWriter->printTrace(&aTag);
+                    }
+                    break;
+
+                case TRACE_BLOCK_EVENTS:
+                    aFile.read((char *)&aThreadID, sizeof(jlong));
+                    aFile.read((char *)&aCount,    sizeof(jint));
+                    aFile.read((char *)&aLost,     sizeof(jlong));
+
+                    for (i = 0; i < aCount && aFile.read((char *)&aRecord, sizeof(TTraceRecord)); i++) {
+                        TXmlTag aTag(cU("Trace"));
+
+                        aTag.addAttribute(cU("Type"),       cU("Method"));
+                        aTag.addAttribute(cU("Event"),      (aRecord.mEvent == TRACE_BINARY_ENTER) ? cU("Enter") : cU("Exit"));
+                        if (aRecord.mMethod > 0 && aRecord.mMethod < aSize) {
+                            aTag.addAttribute(cU("MethodName"), aNames[2 * aRecord.mMethod + 1].str());
+                            aTag.addAttribute(cU("ClassName"),  aNames[2 * aRecord.mMethod].str());
+                        }
+                        else {
+                            aTag.addAttribute(cU("MethodName"), cU("<unknown>"));
+                            aTag.addAttribute(cU("ClassName"),  cU("<unknown>"));
+                        }
+                        aTag.addAttribute(cU("CpuTime"),    TString::parseInt(aRecord.mCpuTime,   aBuffer));
+                        aTag.addAttribute(cU("Depth"),      TString::parseInt(aRecord.mDepth,     aBuffer), PROPERTY_TYPE_INT);
+                        aTag.addAttribute(cU("ThreadId"),   TString::parseHex(aThreadID,          aBuffer));
+                        aTag.addAttribute(cU("Timestamp"),  TString::parseInt(aRecord.mTimestamp, aBuffer));
+                        aWriter->printTrace(&aTag);
+                    }
+
+                    if (aLost > 0) {
+                        TXmlTag aTag(cU("Trace"));
+                        aTag.addAttribute(cU("Type"),       cU("Lost"));
+                        aTag.addAttribute(cU("ThreadId"),   TString::parseHex(aThreadID, aBuffer));
+                        aTag.addAttribute(cU("Info"),       TString::parseInt(aLost,     aBuffer));
+                        aWriter->printTrace(&aTag);
+                    }
+                    aResult = (i == aCount);
+                    break;
+
+                default:
+                    aResult = false;
+                    break;
+            }
+        }
+        delete [] aNames;
+        return aResult;
+    }
+};
+
+
 // ----------------------------------------------------
 //! \class TTracer
 //! \brief Implements trace functions
@@ -42,6 +878,8 @@ private:
     bool mTraceFull;            
     bool mTraceContention;      //!< Trace contention
     bool mTraceClass;           
+    bool mTraceBinary;          //!< Trace methods to binary file
+    bool mTraceFolded;          //!< Aggregate trace stacks
     bool mForce;
     bool mConsOut;
     int  mEventType;
@@ -53,7 +891,7 @@ private:
     jlong           mMaxMemoryUsed;
     jlong           mMaxCount;
     jlong           mDeltaMemory;
-    SAP_ofstream    mFile;    
+    TMappedFile     mFile;    
     jlong           mInfo;
     TString         mThreadName;
     const  SAP_UC  *mTriggerPoint;
@@ -88,6 +926,8 @@ private:
         mTraceCounter   = false;
         mTraceMethod    = false;
         mTraceClass     = false;
+        mTraceBinary    = false;
+        mTraceFolded    = false;
         mTraceEvent     = false;
         mTraceThread    = false;
         mTraceException = false;
@@ -134,6 +974,8 @@ public:
         if (mTraceTrigger)    aValue.concat(cU("/trigger"));
         if (mTraceThread)     aValue.concat(cU("/thread"));
         if (mTraceGC)         aValue.concat(cU("/gc"));
+        if (mTraceBinary)     aValue.concat(cU("/binary"));
+        if (mTraceFolded)     aValue.concat(cU("/folded"));
 
         aTag->addAttribute(cU("Name") , cU("Trace"));
         aTag->addAttribute(cU("Value"), aValue.str());
@@ -144,9 +986,10 @@ private:
     //! Prints a formatted line to trace file and console
     // ----------------------------------------------------
     void print() {
-        if (mFile.rdbuf()->is_open()) {
+        if (mFile.isOpen()) {
             mStream << ends;
-            mFile   << mStream.str() << endl;
+            mFile.write(mStream.str().c_str());
+            mFile.write(cU("\n"));
         }
         else if (mConsOut) {
             mStream << ends;
@@ -260,7 +1103,12 @@ public:
             aFile.concat(mProperties->getPath());
             aFile.concat(FILESEPARATOR);
             aFile.concat(aFileName);
-            mFile.rdbuf()->open(aFile.a7_str(), ios::out);
+            mFile.open(
+                    aFile.str(), 
+                    mProperties->getLogFileSize(), 
+                    mProperties->getLogFileCount(),
+                    false,
+                    mProperties->doLogFileCompression());
         }
     }
     // ----------------------------------------------------
@@ -268,14 +1116,22 @@ public:
     //! Close trace file
     // ----------------------------------------------------
     void closeFile() {
-        if (!mFile.rdbuf()->is_open()) {
+        if (!mFile.isOpen()) {
             return;
         }
         TXmlTag aRootTag(cU("Trace"));
         mWriter.printTrace(&aRootTag, 0);
+        TOutputQueue::getInstance()->sync();
         mFile.close();
     }
     // ----------------------------------------------------
+    // TTrace::syncFile
+    //! Write the trace file to disk
+    // ----------------------------------------------------
+    void syncFile() {
+        mFile.sync();
+    }
+    // ----------------------------------------------------
     // TTrace::printTrace
     //! \brief Trace tag list
     //! \param aRootTag The tag list to trace
@@ -405,6 +1261,54 @@ public:
         if (mTraceMethod) {
             setOptions(aEnable, aOptions);
         }
+        setTraceBinary(aEnable, aOptions);
+    }
+    // ----------------------------------------------------
+    // TTrace::setTraceBinary
+    //! \brief Write method trace records to a binary file
+    //! \param aEnable Enable/Disable binary trace
+    //! \param aOptions Trace options
+    //!         - -b&gt;name&lt; Binary trace file
+    //!         - -p&gt;name&lt; Perfetto trace file
+    // ----------------------------------------------------
+    void setTraceBinary(bool aEnable, TValues *aOptions) {
+        TValues::iterator aPtr;
+        TString           aFileName;
+
+        if (mTraceBinary) {
+            TTraceBinary::getInstance()->close();
+            mTraceBinary = false;
+        }
+        if (!aEnable || aOptions == NULL) {
+            return;
+        }
+        for (aPtr  = aOptions->begin();
+             aPtr != aOptions->end();
+             aPtr  = aOptions->next()) {
+            if (!STRNCMP((*aPtr), cU("-b"), 2)) {
+                aFileName = ((*aPtr) + 2);
+                aFileName.trim();
+                if (aFileName.pcount() == 0) {
+                    aFileName = cU("sherlok.trc");
+                }
+                mTraceBinary = TTraceBinary::getInstance()->open(aFileName.str());
+            }
+            else if (!STRNCMP((*aPtr), cU("-p"), 2)) {
+                aFileName = ((*aPtr) + 2);
+                aFileName.trim();
+                if (aFileName.pcount() == 0) {
+                    aFileName = cU("sherlok.perfetto-trace");
+                }
+                mTraceBinary = TTraceBinary::getInstance()->open(aFileName.str(), true);
+            }
+        }
+    }
+    // ----------------------------------------------------
+    // TTrace::doTraceBinary
+    //! \return \c TRUE if method events go to the binary trace
+    // ----------------------------------------------------
+    inline bool doTraceBinary() {
+        return mTraceStarted && mTraceBinary;
     }
     // ----------------------------------------------------
     // TTrace::setTraceContention
@@ -507,6 +1411,21 @@ public:
         return doTraceStack() && mTraceFull;
     }
     // ----------------------------------------------------
+    // TTrace::setTraceFolded
+    //! \param aEnable Enable/Disable stack aggregation
+    // ----------------------------------------------------
+    void setTraceFolded(bool aEnable) {
+        mTraceFolded = aEnable;
+    }
+    // ----------------------------------------------------
+    // TTrace::doTraceFolded
+    //! \return \c TRUE if trace events are aggregated as
+    //!         folded stacks instead of printed
+    // ----------------------------------------------------
+    bool doTraceFolded() {
+        return mTraceStarted && mTraceFolded;
+    }
+    // ----------------------------------------------------
     // TTrace::setTraceParameter
     //! \param aEnable Enable/Disable Parameter tracing
     // ----------------------------------------------------
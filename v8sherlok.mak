@@ -47,6 +47,7 @@ SHERLOK_HEADERS =		\
 	tracer.h			\
 	profiler.h			\
 	monitor.h			\
+	heap.h				\
 	extended.h			\
 	standard.h			\
 	ptypes.h